@@ -24,9 +24,79 @@
  */
 #include "flat_shader.h"
 
+// for the 0xrrggbbaa_rgbaf literals
+using namespace Magnum::Math::Literals;
+
 using namespace osp;
 using namespace osp::draw;
 
+namespace
+{
+
+/**
+ * @brief Check if an entity's mesh and texture are uploaded. Entities without them are skipped.
+ */
+bool resident(adera::shader::ACtxDrawFlat const& rData, DrawEnt const ent, bool const textured) noexcept
+{
+    return    (*rData.pMeshId)[ent].m_glId != lgrn::id_null<MeshGlId>()
+           && ( ! textured || (*rData.pDiffuseTexId)[ent].m_glId != lgrn::id_null<TexGlId>());
+}
+
+void draw_packet(
+        adera::shader::ACtxDrawFlat&    rData,
+        adera::shader::FlatGL3D&        rShader,
+        DrawEnt const                   ent,
+        DrawPacket const&               packet)
+{
+    bool const textured = bool(rShader.flags() & adera::shader::FlatGL3D::Flag::Textured);
+    if ( ! resident(rData, ent, textured))
+    {
+        return;
+    }
+
+    if (textured)
+    {
+        TexGlId const texGlId = (*rData.pDiffuseTexId)[ent].m_glId;
+        rShader.bindTexture(rData.pTexGl->get(texGlId));
+    }
+
+    if (rData.pColor != nullptr)
+    {
+        rShader.setColor((*rData.pColor)[ent]);
+    }
+
+    MeshGlId const      meshId = (*rData.pMeshId)[ent].m_glId;
+    Magnum::GL::Mesh    &rMesh = rData.pMeshGl->get(meshId);
+
+    rShader.setTransformationProjectionMatrix(packet.m_viewProjTf)
+           .draw(rMesh);
+}
+
+} // namespace
+
+void adera::shader::setup_flat(
+        [[maybe_unused]] ViewProjMatrix const& viewProj,
+        EntityToDraw::UserData_t    userData) noexcept
+{
+    void* const pData   = std::get<0>(userData);
+    void* const pShader = std::get<1>(userData);
+    assert(pData   != nullptr);
+    assert(pShader != nullptr);
+
+    auto &rData   = *reinterpret_cast<ACtxDrawFlat*>(pData);
+    auto &rShader = *reinterpret_cast<FlatGL3D*>(pShader);
+
+    FlatGL3D &rInstShader = (rShader.flags() & FlatGL3D::Flag::Textured)
+                          ? rData.shaderDiffuseInstanced
+                          : rData.shaderUntexturedInstanced;
+
+    if (rInstShader.id() != 0)
+    {
+        // Per-instance transforms already include view and projection
+        rInstShader.setTransformationProjectionMatrix(Magnum::Matrix4{});
+    }
+}
+
 void adera::shader::draw_ent_flat(
         DrawEnt                     ent,
         ViewProjMatrix const&       viewProj,
@@ -40,23 +110,76 @@ void adera::shader::draw_ent_flat(
     auto &rData   = *reinterpret_cast<ACtxDrawFlat*>(pData);
     auto &rShader = *reinterpret_cast<FlatGL3D*>(pShader);
 
-    // Collect uniform information
-    Matrix4 const &drawTf = (*rData.pDrawTf)[ent];
+    draw_packet(rData, rShader, ent, SysRender::make_packet((*rData.pDrawTf)[ent], viewProj));
+}
+
+void adera::shader::draw_ents_flat_instanced(
+        ArrayView<DrawEnt const>    ents,
+        ArrayView<DrawPacket const> packets,
+        ViewProjMatrix const&       viewProj,
+        EntityToDraw::UserData_t    userData) noexcept
+{
+    void* const pData   = std::get<0>(userData);
+    void* const pShader = std::get<1>(userData);
+    assert(pData   != nullptr);
+    assert(pShader != nullptr);
+
+    auto &rData   = *reinterpret_cast<ACtxDrawFlat*>(pData);
+    auto &rShader = *reinterpret_cast<FlatGL3D*>(pShader);
 
-    if (rShader.flags() & FlatGL3D::Flag::Textured)
+    bool const hasPackets = ! packets.isEmpty();
+    assert( ! hasPackets || packets.size() == ents.size());
+
+    bool const textured = bool(rShader.flags() & FlatGL3D::Flag::Textured);
+    FlatGL3D &rInstShader = textured ? rData.shaderDiffuseInstanced : rData.shaderUntexturedInstanced;
+
+    if (rInstShader.id() == 0 || ents.size() < 2)
     {
-        TexGlId const texGlId = (*rData.pDiffuseTexId)[ent].m_glId;
-        rShader.bindTexture(rData.pTexGl->get(texGlId));
+        for (std::size_t i = 0; i < ents.size(); ++i)
+        {
+            draw_packet(rData, rShader, ents[i], hasPackets ? packets[i] : SysRender::make_packet((*rData.pDrawTf)[ents[i]], viewProj));
+        }
+        return;
     }
 
-    if (rData.pColor != nullptr)
+    // Split into runs of the same mesh, texture, and color
+    auto const same_as = [&rData, textured] (DrawEnt const a, DrawEnt const b) noexcept
     {
-        rShader.setColor((*rData.pColor)[ent]);
-    }
+        return    (*rData.pMeshId)[a].m_glId == (*rData.pMeshId)[b].m_glId
+               && ( ! textured || (*rData.pDiffuseTexId)[a].m_glId == (*rData.pDiffuseTexId)[b].m_glId)
+               && (rData.pColor == nullptr || (*rData.pColor)[a] == (*rData.pColor)[b]);
+    };
 
-    MeshGlId const      meshId = (*rData.pMeshId)[ent].m_glId;
-    Magnum::GL::Mesh    &rMesh = rData.pMeshGl->get(meshId);
+    std::size_t first = 0;
+    while (first < ents.size())
+    {
+        std::size_t const last = SysRender::run_end(ents, first, same_as);
+        DrawEnt const firstEnt = ents[first];
 
-    rShader.setTransformationProjectionMatrix(viewProj.m_viewProj * drawTf)
-           .draw(rMesh);
+        if ( ! resident(rData, firstEnt, textured))
+        {
+            first = last;
+            continue;
+        }
+
+        rData.instances.clear();
+        for (std::size_t i = first; i < last; ++i)
+        {
+            DrawPacket const packet = hasPackets ? packets[i] : SysRender::make_packet((*rData.pDrawTf)[ents[i]], viewProj);
+            rData.instances.push_back({packet.m_viewProjTf, {}});
+        }
+
+        if (textured)
+        {
+            rInstShader.bindTexture(rData.pTexGl->get((*rData.pDiffuseTexId)[firstEnt].m_glId));
+        }
+
+        rInstShader.setColor((rData.pColor != nullptr) ? (*rData.pColor)[firstEnt] : 0xffffffff_rgbaf);
+
+        MeshGlId const meshId = (*rData.pMeshId)[firstEnt].m_glId;
+
+        SysRenderGL::draw_instanced(*rData.pRenderGl, meshId, {rData.instances.data(), rData.instances.size()}, rInstShader);
+
+        first = last;
+    }
 }
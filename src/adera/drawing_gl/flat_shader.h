@@ -28,6 +28,8 @@
 
 #include <Magnum/Shaders/FlatGL.h>
 
+#include <vector>
+
 namespace adera::shader
 {
 
@@ -39,6 +41,10 @@ struct ACtxDrawFlat
     FlatGL3D                    shaderUntextured    {Corrade::NoCreate};
     FlatGL3D                    shaderDiffuse       {Corrade::NoCreate};
 
+    // Optional, with InstancedTransformation. Used by draw_ents_flat_instanced.
+    FlatGL3D                    shaderUntexturedInstanced   {Corrade::NoCreate};
+    FlatGL3D                    shaderDiffuseInstanced      {Corrade::NoCreate};
+
     osp::draw::DrawTransforms_t    *pDrawTf         {nullptr};
     osp::draw::DrawEntColors_t     *pColor          {nullptr};
     osp::draw::TexGlEntStorage_t   *pDiffuseTexId   {nullptr};
@@ -46,6 +52,10 @@ struct ACtxDrawFlat
 
     osp::draw::TexGlStorage_t      *pTexGl          {nullptr};
     osp::draw::MeshGlStorage_t     *pMeshGl         {nullptr};
+    osp::draw::RenderGL            *pRenderGl       {nullptr};
+
+    // Scratch space for draw_ents_flat_instanced
+    std::vector<osp::draw::InstanceGL> instances;
 
     osp::draw::MaterialId materialId { lgrn::id_null<osp::draw::MaterialId>() };
 
@@ -59,14 +69,35 @@ struct ACtxDrawFlat
         pMeshId         = &rScnRenderGl .m_meshId;
         pTexGl          = &rRenderGl    .m_texGl;
         pMeshGl         = &rRenderGl    .m_meshGl;
+        pRenderGl       = &rRenderGl;
     }
 };
 
+/**
+ * @brief Set uniforms of the instanced shaders, once per pass for each shader
+ */
+void setup_flat(
+        osp::draw::ViewProjMatrix const&     viewProj,
+        osp::draw::EntityToDraw::UserData_t  userData) noexcept;
+
 void draw_ent_flat(
         osp::draw::DrawEnt                   ent,
         osp::draw::ViewProjMatrix const&     viewProj,
         osp::draw::EntityToDraw::UserData_t  userData) noexcept;
 
+/**
+ * @brief Draw entities with instancing, one draw call per run of entities that share a mesh and
+ *        texture
+ *
+ * Matrices are taken from packets if there are any. Falls back to drawing one by one if the
+ * instanced shaders weren't created.
+ */
+void draw_ents_flat_instanced(
+        osp::ArrayView<osp::draw::DrawEnt const>    ents,
+        osp::ArrayView<osp::draw::DrawPacket const> packets,
+        osp::draw::ViewProjMatrix const&            viewProj,
+        osp::draw::EntityToDraw::UserData_t         userData) noexcept;
+
 struct ArgsForSyncDrawEntFlat
 {
     osp::draw::DrawEntSet_t const&              hasMaterial;
@@ -82,7 +113,8 @@ inline void sync_drawent_flat(osp::draw::DrawEnt ent, ArgsForSyncDrawEntFlat con
 {
     bool const hasMaterial = args.hasMaterial.contains(ent);
     bool const hasTexture =    (args.diffuse.size() > std::size_t(ent))
-                            && (args.diffuse[ent].m_glId != lgrn::id_null<osp::draw::TexGlId>());
+                            && (   args.diffuse[ent].m_glId        != lgrn::id_null<osp::draw::TexGlId>()
+                                || args.diffuse[ent].m_pendingGlId != lgrn::id_null<osp::draw::TexGlId>());
 
     FlatGL3D *pShader = hasTexture
                       ? &args.rData.shaderDiffuse
@@ -91,7 +123,7 @@ inline void sync_drawent_flat(osp::draw::DrawEnt ent, ArgsForSyncDrawEntFlat con
     if (args.pStorageTransparent != nullptr)
     {
         auto value = (hasMaterial && args.transparent.contains(ent))
-                   ? std::make_optional(osp::draw::EntityToDraw{&draw_ent_flat, {&args.rData, pShader}})
+                   ? std::make_optional(osp::draw::EntityToDraw{&draw_ent_flat, {&args.rData, pShader}, &draw_ents_flat_instanced, &setup_flat})
                    : std::nullopt;
 
         osp::storage_assign(*args.pStorageTransparent, ent, std::move(value));
@@ -100,7 +132,7 @@ inline void sync_drawent_flat(osp::draw::DrawEnt ent, ArgsForSyncDrawEntFlat con
     if (args.pStorageOpaque != nullptr)
     {
         auto value = (hasMaterial && args.opaque.contains(ent))
-                   ? std::make_optional(osp::draw::EntityToDraw{&draw_ent_flat, {&args.rData, pShader}})
+                   ? std::make_optional(osp::draw::EntityToDraw{&draw_ent_flat, {&args.rData, pShader}, &draw_ents_flat_instanced, &setup_flat})
                    : std::nullopt;
 
         osp::storage_assign(*args.pStorageOpaque, ent, std::move(value));
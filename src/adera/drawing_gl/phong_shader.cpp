@@ -30,55 +30,11 @@ using namespace Magnum::Math::Literals;
 using namespace osp;
 using namespace osp::draw;
 
-void adera::shader::draw_ent_phong(
-        DrawEnt                     ent,
-        ViewProjMatrix const&       viewProj,
-        EntityToDraw::UserData_t    userData) noexcept
+namespace
 {
-    using Flag = PhongGL::Flag;
-
-    void* const pData   = std::get<0>(userData);
-    void* const pShader = std::get<1>(userData);
-    assert(pData   != nullptr);
-    assert(pShader != nullptr);
-
-    auto &rData   = *reinterpret_cast<ACtxDrawPhong*>(pData);
-    auto &rShader = *reinterpret_cast<PhongGL*>(pShader);
-
-    // Collect uniform information
-    Matrix4 const &drawTf = (*rData.pDrawTf)[ent];
-
-    Magnum::Matrix4 entRelative = viewProj.m_view * drawTf;
-
-    /* 4th component indicates light type. A value of 0.0f indicates that the
-     * light is a direction light coming from the specified direction relative
-     * to the camera.
-     */
-    //Vector4 light = ;
-
-    if (rShader.flags() & Flag::DiffuseTexture)
-    {
-        TexGlId const texGlId = (*rData.pDiffuseTexId)[ent].m_glId;
-        Magnum::GL::Texture2D &rTexture = rData.pTexGl->get(texGlId);
-        rShader.bindDiffuseTexture(rTexture);
-
-        if (rShader.flags() & (Flag::AmbientTexture | Flag::AlphaMask))
-        {
-            rShader.bindAmbientTexture(rTexture);
-        }
-    }
-
-    if (rData.pColor != nullptr)
-    {
-        rShader.setDiffuseColor((*rData.pColor)[ent]);
-    }
-
-    MeshGlId const      meshId = (*rData.pMeshId)[ent].m_glId;
-    Magnum::GL::Mesh    &rMesh = rData.pMeshGl->get(meshId);
-
-    Matrix3 a{viewProj.m_view};
-
 
+void set_lights(adera::shader::PhongGL &rShader, ViewProjMatrix const& viewProj)
+{
     // Lights with w=0.0f are directional lights
     // Directonal lights are camera-relative, so we need 'viewProj.m_view *'
     auto const lightPositions =
@@ -105,10 +61,186 @@ void adera::shader::draw_ent_phong(
         .setSpecularColor(0xffffff00_rgbaf)
         .setLightColors(lightColors)
         .setLightSpecularColors(lightSpecColors)
-        .setLightPositions(lightPositions)
-        .setTransformationMatrix(entRelative)
-        .setProjectionMatrix(viewProj.m_proj)
-        .setNormalMatrix(entRelative.normalMatrix())
+        .setLightPositions(lightPositions);
+}
+
+void bind_diffuse(adera::shader::PhongGL &rShader, Magnum::GL::Texture2D &rTexture)
+{
+    using Flag = adera::shader::PhongGL::Flag;
+
+    rShader.bindDiffuseTexture(rTexture);
+
+    if (rShader.flags() & (Flag::AmbientTexture | Flag::AlphaMask))
+    {
+        rShader.bindAmbientTexture(rTexture);
+    }
+}
+
+/**
+ * @brief Check if an entity's mesh and texture are uploaded. Entities without them are skipped.
+ */
+bool resident(adera::shader::ACtxDrawPhong const& rData, DrawEnt const ent, bool const textured) noexcept
+{
+    return    (*rData.pMeshId)[ent].m_glId != lgrn::id_null<MeshGlId>()
+           && ( ! textured || (*rData.pDiffuseTexId)[ent].m_glId != lgrn::id_null<TexGlId>());
+}
+
+void draw_packet(
+        adera::shader::ACtxDrawPhong&   rData,
+        adera::shader::PhongGL&         rShader,
+        DrawEnt const                   ent,
+        DrawPacket const&               packet)
+{
+    using Flag = adera::shader::PhongGL::Flag;
+
+    bool const textured = bool(rShader.flags() & Flag::DiffuseTexture);
+    if ( ! resident(rData, ent, textured))
+    {
+        return;
+    }
+
+    if (textured)
+    {
+        TexGlId const texGlId = (*rData.pDiffuseTexId)[ent].m_glId;
+        bind_diffuse(rShader, rData.pTexGl->get(texGlId));
+    }
+
+    if (rData.pColor != nullptr)
+    {
+        rShader.setDiffuseColor((*rData.pColor)[ent]);
+    }
+
+    MeshGlId const      meshId = (*rData.pMeshId)[ent].m_glId;
+    Magnum::GL::Mesh    &rMesh = rData.pMeshGl->get(meshId);
+
+    // Lights and projection are already set by setup_phong
+    rShader
+        .setTransformationMatrix(packet.m_viewTf)
+        .setNormalMatrix(packet.m_normal)
         .draw(rMesh);
 }
 
+} // namespace
+
+void adera::shader::setup_phong(
+        ViewProjMatrix const&       viewProj,
+        EntityToDraw::UserData_t    userData) noexcept
+{
+    using Flag = PhongGL::Flag;
+
+    void* const pData   = std::get<0>(userData);
+    void* const pShader = std::get<1>(userData);
+    assert(pData   != nullptr);
+    assert(pShader != nullptr);
+
+    auto &rData   = *reinterpret_cast<ACtxDrawPhong*>(pData);
+    auto &rShader = *reinterpret_cast<PhongGL*>(pShader);
+
+    set_lights(rShader, viewProj);
+    rShader.setProjectionMatrix(viewProj.m_proj);
+
+    PhongGL &rInstShader = (rShader.flags() & Flag::DiffuseTexture)
+                         ? rData.shaderDiffuseInstanced
+                         : rData.shaderUntexturedInstanced;
+
+    if (rInstShader.id() != 0)
+    {
+        // Per-instance transforms are already relative to the camera
+        set_lights(rInstShader, viewProj);
+        rInstShader
+            .setTransformationMatrix(Magnum::Matrix4{})
+            .setNormalMatrix(Magnum::Matrix3x3{})
+            .setProjectionMatrix(viewProj.m_proj);
+    }
+}
+
+void adera::shader::draw_ent_phong(
+        DrawEnt                     ent,
+        ViewProjMatrix const&       viewProj,
+        EntityToDraw::UserData_t    userData) noexcept
+{
+    void* const pData   = std::get<0>(userData);
+    void* const pShader = std::get<1>(userData);
+    assert(pData   != nullptr);
+    assert(pShader != nullptr);
+
+    auto &rData   = *reinterpret_cast<ACtxDrawPhong*>(pData);
+    auto &rShader = *reinterpret_cast<PhongGL*>(pShader);
+
+    draw_packet(rData, rShader, ent, SysRender::make_packet((*rData.pDrawTf)[ent], viewProj));
+}
+
+
+void adera::shader::draw_ents_phong_instanced(
+        ArrayView<DrawEnt const>    ents,
+        ArrayView<DrawPacket const> packets,
+        ViewProjMatrix const&       viewProj,
+        EntityToDraw::UserData_t    userData) noexcept
+{
+    using Flag = PhongGL::Flag;
+
+    void* const pData   = std::get<0>(userData);
+    void* const pShader = std::get<1>(userData);
+    assert(pData   != nullptr);
+    assert(pShader != nullptr);
+
+    auto &rData   = *reinterpret_cast<ACtxDrawPhong*>(pData);
+    auto &rShader = *reinterpret_cast<PhongGL*>(pShader);
+
+    bool const hasPackets = ! packets.isEmpty();
+    assert( ! hasPackets || packets.size() == ents.size());
+
+    bool const textured = bool(rShader.flags() & Flag::DiffuseTexture);
+    PhongGL &rInstShader = textured ? rData.shaderDiffuseInstanced : rData.shaderUntexturedInstanced;
+
+    if (rInstShader.id() == 0 || ents.size() < 2)
+    {
+        for (std::size_t i = 0; i < ents.size(); ++i)
+        {
+            draw_packet(rData, rShader, ents[i], hasPackets ? packets[i] : SysRender::make_packet((*rData.pDrawTf)[ents[i]], viewProj));
+        }
+        return;
+    }
+
+    // Split into runs of the same mesh, texture, and color
+    auto const same_as = [&rData, textured] (DrawEnt const a, DrawEnt const b) noexcept
+    {
+        return    (*rData.pMeshId)[a].m_glId == (*rData.pMeshId)[b].m_glId
+               && ( ! textured || (*rData.pDiffuseTexId)[a].m_glId == (*rData.pDiffuseTexId)[b].m_glId)
+               && (rData.pColor == nullptr || (*rData.pColor)[a] == (*rData.pColor)[b]);
+    };
+
+    std::size_t first = 0;
+    while (first < ents.size())
+    {
+        std::size_t const last = SysRender::run_end(ents, first, same_as);
+        DrawEnt const firstEnt = ents[first];
+
+        if ( ! resident(rData, firstEnt, textured))
+        {
+            first = last;
+            continue;
+        }
+
+        // Instance transforms are relative to the camera, same as draw_ent_phong
+        rData.instances.clear();
+        for (std::size_t i = first; i < last; ++i)
+        {
+            DrawPacket const packet = hasPackets ? packets[i] : SysRender::make_packet((*rData.pDrawTf)[ents[i]], viewProj);
+            rData.instances.push_back({packet.m_viewTf, packet.m_normal});
+        }
+
+        if (textured)
+        {
+            bind_diffuse(rInstShader, rData.pTexGl->get((*rData.pDiffuseTexId)[firstEnt].m_glId));
+        }
+
+        rInstShader.setDiffuseColor((rData.pColor != nullptr) ? (*rData.pColor)[firstEnt] : 0xffffffff_rgbaf);
+
+        MeshGlId const meshId = (*rData.pMeshId)[firstEnt].m_glId;
+
+        SysRenderGL::draw_instanced(*rData.pRenderGl, meshId, {rData.instances.data(), rData.instances.size()}, rInstShader);
+
+        first = last;
+    }
+}
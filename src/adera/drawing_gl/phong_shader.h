@@ -28,6 +28,8 @@
 
 #include <Magnum/Shaders/PhongGL.h>
 
+#include <vector>
+
 namespace adera::shader
 {
 
@@ -41,6 +43,10 @@ struct ACtxDrawPhong
     PhongGL                     shaderUntextured    {Corrade::NoCreate};
     PhongGL                     shaderDiffuse       {Corrade::NoCreate};
 
+    // Optional, with InstancedTransformation. Used by draw_ents_phong_instanced.
+    PhongGL                     shaderUntexturedInstanced   {Corrade::NoCreate};
+    PhongGL                     shaderDiffuseInstanced      {Corrade::NoCreate};
+
     osp::draw::DrawTransforms_t    *pDrawTf         {nullptr};
     osp::draw::DrawEntColors_t     *pColor          {nullptr};
     osp::draw::TexGlEntStorage_t   *pDiffuseTexId   {nullptr};
@@ -48,6 +54,10 @@ struct ACtxDrawPhong
 
     osp::draw::TexGlStorage_t      *pTexGl          {nullptr};
     osp::draw::MeshGlStorage_t     *pMeshGl         {nullptr};
+    osp::draw::RenderGL            *pRenderGl       {nullptr};
+
+    // Scratch space for draw_ents_phong_instanced
+    std::vector<osp::draw::InstanceGL> instances;
 
     osp::draw::MaterialId materialId { lgrn::id_null<osp::draw::MaterialId>() };
 
@@ -61,14 +71,35 @@ struct ACtxDrawPhong
         pMeshId         = &rScnRenderGl .m_meshId;
         pTexGl          = &rRenderGl    .m_texGl;
         pMeshGl         = &rRenderGl    .m_meshGl;
+        pRenderGl       = &rRenderGl;
     }
 };
 
+/**
+ * @brief Set lights and camera uniforms, once per pass for each shader
+ */
+void setup_phong(
+        osp::draw::ViewProjMatrix const&     viewProj,
+        osp::draw::EntityToDraw::UserData_t  userData) noexcept;
+
 void draw_ent_phong(
         osp::draw::DrawEnt                   ent,
         osp::draw::ViewProjMatrix const&     viewProj,
         osp::draw::EntityToDraw::UserData_t  userData) noexcept;
 
+/**
+ * @brief Draw entities with instancing, one draw call per run of entities that share a mesh and
+ *        texture
+ *
+ * Matrices are taken from packets if there are any. Falls back to drawing one by one if the
+ * instanced shaders weren't created.
+ */
+void draw_ents_phong_instanced(
+        osp::ArrayView<osp::draw::DrawEnt const>    ents,
+        osp::ArrayView<osp::draw::DrawPacket const> packets,
+        osp::draw::ViewProjMatrix const&            viewProj,
+        osp::draw::EntityToDraw::UserData_t         userData) noexcept;
+
 struct ArgsForSyncDrawEntPhong
 {
     osp::draw::DrawEntSet_t const&              hasMaterial;
@@ -84,7 +115,9 @@ inline void sync_drawent_phong(osp::draw::DrawEnt ent, ArgsForSyncDrawEntPhong c
 {
 
     bool const hasMaterial = args.hasMaterial.contains(ent);
-    bool const hasTexture = (args.diffuse.size() > std::size_t(ent)) && (args.diffuse[ent].m_glId != lgrn::id_null<osp::draw::TexGlId>());
+    bool const hasTexture =    (args.diffuse.size() > std::size_t(ent))
+                            && (   args.diffuse[ent].m_glId        != lgrn::id_null<osp::draw::TexGlId>()
+                                || args.diffuse[ent].m_pendingGlId != lgrn::id_null<osp::draw::TexGlId>());
 
     PhongGL *pShader = hasTexture
                      ? &args.rData.shaderDiffuse
@@ -93,7 +126,7 @@ inline void sync_drawent_phong(osp::draw::DrawEnt ent, ArgsForSyncDrawEntPhong c
     if (args.pStorageTransparent != nullptr)
     {
         auto value = (hasMaterial && args.transparent.contains(ent))
-                   ? std::make_optional(osp::draw::EntityToDraw{&draw_ent_phong, {&args.rData, pShader}})
+                   ? std::make_optional(osp::draw::EntityToDraw{&draw_ent_phong, {&args.rData, pShader}, &draw_ents_phong_instanced, &setup_phong})
                    : std::nullopt;
 
         osp::storage_assign(*args.pStorageTransparent, ent, std::move(value));
@@ -102,7 +135,7 @@ inline void sync_drawent_phong(osp::draw::DrawEnt ent, ArgsForSyncDrawEntPhong c
     if (args.pStorageOpaque != nullptr)
     {
         auto value = (hasMaterial && args.opaque.contains(ent))
-                   ? std::make_optional(osp::draw::EntityToDraw{&draw_ent_phong, {&args.rData, pShader}})
+                   ? std::make_optional(osp::draw::EntityToDraw{&draw_ent_phong, {&args.rData, pShader}, &draw_ents_phong_instanced, &setup_phong})
                    : std::nullopt;
 
         osp::storage_assign(*args.pStorageOpaque, ent, std::move(value));
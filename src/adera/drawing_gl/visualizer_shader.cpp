@@ -45,6 +45,12 @@ void adera::shader::draw_ent_visualizer(
     assert(pData != nullptr);
     auto &rData = *reinterpret_cast<ACtxDrawMeshVisualizer*>(pData);
 
+    MeshGlId const meshId = (*rData.m_pMeshId)[ent].m_glId;
+    if (meshId == lgrn::id_null<MeshGlId>())
+    {
+        return; // Not uploaded yet
+    }
+
     Matrix4 const&  drawTf      = (*rData.m_pDrawTf)[ent];
     Matrix4 const   entRelative = viewProj.m_view * drawTf;
 
@@ -61,8 +67,7 @@ void adera::shader::draw_ent_visualizer(
         Magnum::GL::Renderer::setDepthMask(GL_FALSE);
     }
 
-    MeshGlId const      meshId = (*rData.m_pMeshId)[ent].m_glId;
-    Magnum::GL::Mesh    &rMesh = rData.m_pMeshGl->get(meshId);
+    Magnum::GL::Mesh &rMesh = rData.m_pMeshGl->get(meshId);
 
     rShader
         .setViewportSize(Vector2{Magnum::GL::defaultFramebuffer.viewport().size()})
@@ -85,6 +85,89 @@ struct ACtxSceneGraph
 
 using ACompTransformStorage_t = Storage_t<ActiveEnt, ACompTransform>;
 
+/**
+ * @brief Progress of incrementally reordering a component storage to match scene graph order
+ *
+ * See SysSceneGraph::defrag_storage
+ */
+struct TreeOrderDefrag
+{
+    TreePos_t       m_cursor        {1};    // Next tree position to visit, 0 is the tree root
+    std::size_t     m_packed        {0};    // Next index in the storage's packed array to fill
+};
+
+/**
+ * @brief Generations of entity transforms, to find which of them changed
+ *
+ * m_subtree of an entity changes along with m_transform of the entity or any of its descendants.
+ * Anything following transforms can keep its own TransformGenerations of what it last used, and
+ * skip over whole subtrees that didn't change.
+ */
+struct TransformGenerations
+{
+    void resize(std::size_t const ents, uint32_t const value = 0)
+    {
+        m_transform .resize(ents, value);
+        m_subtree   .resize(ents, value);
+    }
+
+    osp::KeyedVec<ActiveEnt, uint32_t>   m_transform;
+    osp::KeyedVec<ActiveEnt, uint32_t>   m_subtree;
+};
+
+/**
+ * @brief Generation that is never written by transform_changed, for entities not seen yet
+ */
+inline constexpr uint32_t gc_transformGenUnseen = ~uint32_t{0};
+
+/**
+ * @brief Transforms as separate position, rotation, and scale arrays, with cached world matrices
+ *
+ * Positions and rotations can be read, interpolated, or copied into snapshots without touching
+ * anything else, and rotations don't drift like repeatedly multiplied matrices do.
+ *
+ * There is no shared dirty set. Each cached world matrix records which local generation and which
+ * parent world generation it was calculated from, and is stale once either of them changes. An
+ * update only reads and writes the entries of entities it updates and of their ancestors, so
+ * ranges of separate root subtrees can be updated in parallel.
+ *
+ * Modify through SysTransformTRS.
+ */
+struct ACtxTransformTRS
+{
+    void resize(std::size_t const ents)
+    {
+        m_position          .resize(ents);
+        m_rotation          .resize(ents);
+        m_scale             .resize(ents, Vector3{1.0f});
+        m_has               .resize(ents);
+        m_localGen          .resize(ents, 0);
+        m_world             .resize(ents);
+        m_worldGen          .resize(ents, 0);
+        m_worldFromLocal    .resize(ents, gc_transformGenUnseen);
+        m_worldFromParentGen.resize(ents, gc_transformGenUnseen);
+        m_worldFromParent   .resize(ents, lgrn::id_null<ActiveEnt>());
+    }
+
+    // Relative to parent
+    osp::KeyedVec<ActiveEnt, Vector3>       m_position;
+    osp::KeyedVec<ActiveEnt, Quaternion>    m_rotation;
+    osp::KeyedVec<ActiveEnt, Vector3>       m_scale;
+    ActiveEntSet_t                          m_has;
+
+    // Changes every time an entity's position, rotation, or scale is set
+    osp::KeyedVec<ActiveEnt, uint32_t>      m_localGen;
+
+    // Relative to the scene's origin. m_worldGen changes every time m_world is recalculated.
+    osp::KeyedVec<ActiveEnt, Matrix4>       m_world;
+    osp::KeyedVec<ActiveEnt, uint32_t>      m_worldGen;
+
+    // What each m_world was last calculated from
+    osp::KeyedVec<ActiveEnt, uint32_t>      m_worldFromLocal;
+    osp::KeyedVec<ActiveEnt, uint32_t>      m_worldFromParentGen;
+    osp::KeyedVec<ActiveEnt, ActiveEnt>     m_worldFromParent;
+};
+
 /**
  * @brief Storage for basic components
  */
@@ -94,6 +177,55 @@ struct ACtxBasic
 
     ACtxSceneGraph                      m_scnGraph;
     ACompTransformStorage_t             m_transform;
+    TreeOrderDefrag                     m_transformDefrag;
+
+    // Written by transform_changed
+    TransformGenerations                m_transformGen;
+};
+
+/**
+ * @brief Record that an entity's transform was written
+ *
+ * Only the ancestors the entity has at the time are marked. Entities added to the scene graph
+ * afterwards must be marked again, or have an ancestor that is marked too.
+ */
+inline void transform_changed(ACtxBasic &rCtxBasic, ActiveEnt const ent) noexcept
+{
+    TransformGenerations &rGen = rCtxBasic.m_transformGen;
+
+    if (rGen.m_transform.size() <= std::size_t(ent))
+    {
+        rGen.resize(rCtxBasic.m_activeIds.capacity());
+    }
+
+    rGen.m_transform[ent] = (rGen.m_transform[ent] + 1) % gc_transformGenUnseen;
+
+    ActiveEnt const     null        = lgrn::id_null<ActiveEnt>();
+    auto const          &entParent  = rCtxBasic.m_scnGraph.m_entParent;
+    for (ActiveEnt cur = ent; cur != null; cur = (std::size_t(cur) < entParent.size()) ? entParent[cur] : null)
+    {
+        rGen.m_subtree[cur] = (rGen.m_subtree[cur] + 1) % gc_transformGenUnseen;
+    }
+}
+
+/**
+ * @brief Floating origin, keeps the area of interest close to the scene's origin
+ *
+ * Scene positions are floats that lose precision far from the origin. Once a focus point (usually
+ * the camera target) strays further than m_threshold, a shift is requested, and everything in the
+ * scene is translated back towards the origin all at once.
+ */
+struct ACtxFloatingOrigin
+{
+    // Shift once the focus is further than this from the origin along any axis, in meters
+    float       m_threshold     {512.0f};
+
+    // Translation requested by whatever owns the focus, applied and cleared by the next update
+    Vector3     m_request;
+
+    // Sum of translations applied since this was last cleared. For systems outside of the scene,
+    // such as draw transforms, to follow along. Cleared by that system once per frame.
+    Vector3     m_applied;
 };
 
 template<typename IT_T>
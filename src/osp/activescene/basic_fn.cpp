@@ -25,8 +25,10 @@
 #include "basic_fn.h"
 
 #include <Corrade/Containers/ArrayViewStl.h>
+#include <Magnum/Math/Functions.h>
 
 #include <algorithm>
+#include <utility>
 
 using namespace osp;
 using namespace osp::active;
@@ -101,6 +103,98 @@ SubtreeBuilder SysSceneGraph::add_descendants(ACtxSceneGraph& rScnGraph, uint32_
     return out;
 }
 
+void SysSceneGraph::add_descendants_batch(
+        ACtxSceneGraph&                 rScnGraph,
+        ArrayView<SubtreeRequest const> requests,
+        std::vector<SubtreeBuilder>&    rOut)
+{
+    rOut.clear();
+    rOut.reserve(requests.size());
+
+    struct Insert
+    {
+        TreePos_t   pos;        // Position before any shifting, at end of the parent's subtree
+        TreePos_t   parentPos;
+        uint32_t    request;
+    };
+
+    auto const parent_pos = [&rScnGraph] (ActiveEnt const parent) -> TreePos_t
+    {
+        return (parent == lgrn::id_null<ActiveEnt>()) ? 0 : rScnGraph.m_entToTreePos[parent];
+    };
+
+    std::vector<Insert> inserts;
+    inserts.reserve(requests.size());
+
+    uint32_t total = 0;
+    for (uint32_t i = 0; i < requests.size(); ++i)
+    {
+        TreePos_t const parentPos = parent_pos(requests[i].parent);
+        inserts.push_back({parentPos + 1 + rScnGraph.m_treeDescendants[parentPos], parentPos, i});
+        total += requests[i].descendantCount;
+    }
+
+    // A parent's subtree can end at the same place as its ancestors' subtrees. Deeper parents go
+    // first, so their new descendants stay within their own subtree.
+    std::stable_sort(inserts.begin(), inserts.end(), [] (Insert const& lhs, Insert const& rhs)
+    {
+        return (lhs.pos != rhs.pos) ? (lhs.pos < rhs.pos) : (lhs.parentPos > rhs.parentPos);
+    });
+
+    TreePos_t const treeOldSize = rScnGraph.m_treeDescendants[0] + 1;
+    TreePos_t const treeNewSize = treeOldSize + total;
+
+    rScnGraph.m_treeToEnt.resize(treeNewSize);
+    rScnGraph.m_treeDescendants.resize(treeNewSize);
+
+    // Back to front, move each run of existing entities between insert positions right by the
+    // total size of all inserts before it, leaving space for the subtrees in between.
+
+    std::vector<TreePos_t> reservedFirst(requests.size());
+
+    auto const itTreeEntsFirst = rScnGraph.m_treeToEnt.begin();
+    auto const itTreeDescFirst = rScnGraph.m_treeDescendants.begin();
+
+    uint32_t  shift  = total;
+    TreePos_t runEnd = treeOldSize;
+    for (auto itInsert = inserts.rbegin(); itInsert != inserts.rend(); ++itInsert)
+    {
+        TreePos_t const runFirst = itInsert->pos;
+
+        if (shift != 0 && runFirst != runEnd)
+        {
+            std::for_each(itTreeEntsFirst + runFirst, itTreeEntsFirst + runEnd,
+                          [&rScnGraph, shift] (ActiveEnt const ent)
+            {
+                rScnGraph.m_entToTreePos[ent] += shift;
+            });
+            std::move_backward(itTreeEntsFirst + runFirst, itTreeEntsFirst + runEnd, itTreeEntsFirst + runEnd + shift);
+            std::move_backward(itTreeDescFirst + runFirst, itTreeDescFirst + runEnd, itTreeDescFirst + runEnd + shift);
+        }
+
+        shift -= requests[itInsert->request].descendantCount;
+        reservedFirst[itInsert->request] = runFirst + shift;
+        runEnd = runFirst;
+    }
+
+    // Update descendant counts of parents and their ancestors, now that positions are final
+    for (SubtreeRequest const& request : requests)
+    {
+        ActiveEnt parent = request.parent;
+        while (parent != lgrn::id_null<ActiveEnt>())
+        {
+            rScnGraph.m_treeDescendants[rScnGraph.m_entToTreePos[parent]] += request.descendantCount;
+            parent = rScnGraph.m_entParent[parent];
+        }
+        rScnGraph.m_treeDescendants[0] += request.descendantCount;
+    }
+
+    for (uint32_t i = 0; i < requests.size(); ++i)
+    {
+        rOut.emplace_back(rScnGraph, requests[i].parent, reservedFirst[i], reservedFirst[i] + requests[i].descendantCount);
+    }
+}
+
 ArrayView<ActiveEnt const> SysSceneGraph::descendants(ACtxSceneGraph const& rScnGraph, ActiveEnt root)
 {
     TreePos_t const rootPos = rScnGraph.m_entToTreePos[root];
@@ -210,3 +304,160 @@ void SysSceneGraph::do_delete(ACtxSceneGraph& rScnGraph)
 
     rScnGraph.m_delete.clear();
 }
+
+void SysTransformTRS::set(
+        ACtxTransformTRS&       rTRS,
+        ActiveEnt const         ent,
+        Vector3 const           position,
+        Quaternion const        rotation,
+        Vector3 const           scale) noexcept
+{
+    rTRS.m_position[ent]    = position;
+    rTRS.m_rotation[ent]    = rotation;
+    rTRS.m_scale[ent]       = scale;
+    rTRS.m_localGen[ent]    = (rTRS.m_localGen[ent] + 1) % gc_transformGenUnseen;
+    rTRS.m_has.insert(ent);
+}
+
+void SysTransformTRS::set_matrix(ACtxTransformTRS& rTRS, ActiveEnt const ent, Matrix4 const& matrix) noexcept
+{
+    set(rTRS, ent, matrix.translation(), Quaternion::fromMatrix(matrix.rotation()), matrix.scaling());
+}
+
+void SysTransformTRS::remove(ACtxTransformTRS& rTRS, ActiveEnt const ent) noexcept
+{
+    rTRS.m_has.erase(ent);
+    rTRS.m_scale[ent]           = Vector3{1.0f};
+    rTRS.m_worldFromLocal[ent]  = gc_transformGenUnseen;
+}
+
+Matrix4 SysTransformTRS::local_matrix(ACtxTransformTRS const& trs, ActiveEnt const ent) noexcept
+{
+    Magnum::Math::Matrix3x3<float> rotScale = trs.m_rotation[ent].toMatrix();
+    Vector3 const& scale = trs.m_scale[ent];
+
+    rotScale[0] *= scale.x();
+    rotScale[1] *= scale.y();
+    rotScale[2] *= scale.z();
+
+    return Matrix4::from(rotScale, trs.m_position[ent]);
+}
+
+ActiveEnt SysTransformTRS::transform_parent(ACtxTransformTRS const& trs, ACtxSceneGraph const& scnGraph, ActiveEnt const ent) noexcept
+{
+    // Entities without transforms pass their parent's matrix through
+    ActiveEnt parent = scnGraph.m_entParent[ent];
+    while (parent != lgrn::id_null<ActiveEnt>() && ! trs.m_has.contains(parent))
+    {
+        parent = scnGraph.m_entParent[parent];
+    }
+    return parent;
+}
+
+bool SysTransformTRS::is_world_stale(ACtxTransformTRS const& trs, ActiveEnt const ent, ActiveEnt const parent) noexcept
+{
+    uint32_t const parentGen = (parent == lgrn::id_null<ActiveEnt>()) ? 0 : trs.m_worldGen[parent];
+
+    return    trs.m_worldFromLocal[ent]     != trs.m_localGen[ent]
+           || trs.m_worldFromParent[ent]    != parent
+           || trs.m_worldFromParentGen[ent] != parentGen;
+}
+
+void SysTransformTRS::update_world(ACtxTransformTRS& rTRS, ActiveEnt const ent, ActiveEnt const parent) noexcept
+{
+    if (parent == lgrn::id_null<ActiveEnt>())
+    {
+        rTRS.m_world[ent]               = local_matrix(rTRS, ent);
+        rTRS.m_worldFromParentGen[ent]  = 0;
+    }
+    else
+    {
+        rTRS.m_world[ent]               = rTRS.m_world[parent] * local_matrix(rTRS, ent);
+        rTRS.m_worldFromParentGen[ent]  = rTRS.m_worldGen[parent];
+    }
+
+    rTRS.m_worldFromLocal[ent]  = rTRS.m_localGen[ent];
+    rTRS.m_worldFromParent[ent] = parent;
+    rTRS.m_worldGen[ent]        = (rTRS.m_worldGen[ent] + 1) % gc_transformGenUnseen;
+}
+
+Matrix4 const& SysTransformTRS::world_matrix(ACtxTransformTRS& rTRS, ACtxSceneGraph const& scnGraph, ActiveEnt const ent) noexcept
+{
+    static constexpr Matrix4 const identity{};
+
+    if ( ! rTRS.m_has.contains(ent) )
+    {
+        return identity;
+    }
+
+    // Parent may be stale too, bring it up to date first
+    ActiveEnt const parent = transform_parent(rTRS, scnGraph, ent);
+    if (parent != lgrn::id_null<ActiveEnt>())
+    {
+        world_matrix(rTRS, scnGraph, parent);
+    }
+
+    if (is_world_stale(rTRS, ent, parent))
+    {
+        update_world(rTRS, ent, parent);
+    }
+
+    return rTRS.m_world[ent];
+}
+
+void SysTransformTRS::update_world_range(
+        ACtxTransformTRS&       rTRS,
+        ACtxSceneGraph const&   scnGraph,
+        TreePos_t const         first,
+        TreePos_t const         last,
+        ActiveEntVec_t&         rUpdated)
+{
+    for (TreePos_t pos = first; pos != last; ++pos)
+    {
+        ActiveEnt const ent = scnGraph.m_treeToEnt[pos];
+        if ( ! rTRS.m_has.contains(ent) )
+        {
+            continue;
+        }
+
+        ActiveEnt const parent = transform_parent(rTRS, scnGraph, ent);
+        if (is_world_stale(rTRS, ent, parent))
+        {
+            update_world(rTRS, ent, parent);
+            rUpdated.push_back(ent);
+        }
+    }
+}
+
+Vector3 SysFloatingOrigin::rebase_translation(Vector3 const focus, float const threshold) noexcept
+{
+    // Whole thresholds along each axis, pointing back towards the origin
+    return -Magnum::Math::sign(focus) * Magnum::Math::floor(Magnum::Math::abs(focus) / threshold) * threshold;
+}
+
+Vector3 SysFloatingOrigin::take_request(ACtxFloatingOrigin& rFloatOrigin) noexcept
+{
+    Vector3 const translate = std::exchange(rFloatOrigin.m_request, {});
+    rFloatOrigin.m_applied += translate;
+    return translate;
+}
+
+void SysFloatingOrigin::collect_roots(ACtxSceneGraph const& scnGraph, ActiveEntVec_t& rRoots)
+{
+    rRoots.clear();
+    for (ActiveEnt const root : SysSceneGraph::children(scnGraph))
+    {
+        rRoots.push_back(root);
+    }
+}
+
+void SysFloatingOrigin::translate_roots(ACompTransformStorage_t& rTf, ArrayView<ActiveEnt const> const roots, Vector3 const translate) noexcept
+{
+    for (ActiveEnt const root : roots)
+    {
+        if (rTf.contains(root))
+        {
+            rTf.get(root).m_transform.translation() += translate;
+        }
+    }
+}
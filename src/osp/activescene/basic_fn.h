@@ -124,6 +124,15 @@ private:
 
 using ChildRange_t = lgrn::IteratorPair<ChildIterator, ChildIterator>;
 
+/**
+ * @brief Space to reserve for a new subtree, see SysSceneGraph::add_descendants_batch
+ */
+struct SubtreeRequest
+{
+    ActiveEnt   parent          {lgrn::id_null<ActiveEnt>()};
+    uint32_t    descendantCount {0};
+};
+
 class SysSceneGraph
 {
 public:
@@ -135,6 +144,26 @@ public:
      */
     [[nodiscard]] static SubtreeBuilder add_descendants(ACtxSceneGraph& rScnGraph, uint32_t descendantCount, ActiveEnt root = lgrn::id_null<ActiveEnt>());
 
+    /**
+     * @brief Add new subtrees under many different parents at once
+     *
+     * Each call to add_descendants that doesn't add to the end of the tree shifts everything
+     * after it. This sorts requests by where they go in the tree, then makes space for all of them
+     * in a single pass from back to front, so each existing entity is moved at most once.
+     *
+     * Subtrees under the same parent are placed in the same order as their requests.
+     *
+     * @param rScnGraph [ref] Scene graph to add to
+     * @param requests  [in] Parents and number of descendants to reserve. Parents must already be
+     *                       in the tree, not within space reserved by the same batch.
+     * @param rOut      [out] Cleared, then filled with one SubtreeBuilder per request, in the same
+     *                        order. All of their reserved space must be used.
+     */
+    static void add_descendants_batch(
+            ACtxSceneGraph&                 rScnGraph,
+            ArrayView<SubtreeRequest const> requests,
+            std::vector<SubtreeBuilder>&    rOut);
+
     /**
      * @return Iterable range of an entity's descendants
      */
@@ -167,12 +196,195 @@ public:
     template<typename ITA_T, typename ITB_T>
     static void queue_delete_entities(ACtxSceneGraph& rScnGraph, ActiveEntVec_t &rDelete, ITA_T const& first, ITB_T const& last);
 
+    /**
+     * @brief Move components around in a storage's packed array to match scene graph order
+     *
+     * ActiveEnts are recycled, so components of entities that are next to each other in the tree
+     * end up scattered through memory after a while of spawning and deleting. This walks the tree
+     * from where the last call left off, swapping each visited entity's component into the next
+     * packed slot. ActiveEnts themselves don't change, so nothing else needs to be remapped.
+     *
+     * The tree and storage can change between calls. Order is only approximate until the next
+     * full pass, but the storage always stays valid.
+     *
+     * @param scnGraph  [in] Scene graph
+     * @param rStorage  [ref] Storage to reorder
+     * @param rDefrag   [ref] Progress, carried between calls
+     * @param maxVisit  [in] Maximum number of tree positions to visit in this call
+     *
+     * @return True if a full pass over the tree was just completed
+     */
+    template<typename COMP_T>
+    static bool defrag_storage(
+            ACtxSceneGraph const&           scnGraph,
+            Storage_t<ActiveEnt, COMP_T>&   rStorage,
+            TreeOrderDefrag&                rDefrag,
+            std::size_t                     maxVisit)
+    {
+        return defrag_storage_by(scnGraph, rStorage, rDefrag, maxVisit,
+                                 [] (ActiveEnt const ent) noexcept { return ent; });
+    }
+
+    /**
+     * @brief Reorder a storage keyed by something other than ActiveEnt, such as DrawEnt, to
+     *        match scene graph order
+     *
+     * Same as the ActiveEnt overload, but each visited entity's component is found through
+     * activeToKey. Components without an ActiveEnt end up after all of the ones with one.
+     *
+     * @param activeToKey   [in] Key associated with each ActiveEnt, null for none
+     */
+    template<typename KEY_T, typename COMP_T>
+    static bool defrag_storage(
+            ACtxSceneGraph const&               scnGraph,
+            KeyedVec<ActiveEnt, KEY_T> const&   activeToKey,
+            Storage_t<KEY_T, COMP_T>&           rStorage,
+            TreeOrderDefrag&                    rDefrag,
+            std::size_t                         maxVisit)
+    {
+        return defrag_storage_by(scnGraph, rStorage, rDefrag, maxVisit,
+                                 [&activeToKey] (ActiveEnt const ent) noexcept
+        {
+            return (std::size_t(ent) < activeToKey.size()) ? activeToKey[ent] : lgrn::id_null<KEY_T>();
+        });
+    }
+
 private:
 
+    template<typename KEY_T, typename COMP_T, typename KEYOF_T>
+    static bool defrag_storage_by(
+            ACtxSceneGraph const&           scnGraph,
+            Storage_t<KEY_T, COMP_T>&       rStorage,
+            TreeOrderDefrag&                rDefrag,
+            std::size_t                     maxVisit,
+            KEYOF_T&&                       keyOf);
+
     static void do_delete(ACtxSceneGraph& rScnGraph);
 
 }; // class SysSceneGraph
 
+class SysTransformTRS
+{
+public:
+
+    /**
+     * @brief Add or overwrite a transform
+     *
+     * World matrices of the entity and its descendants become stale, without visiting them.
+     *
+     * @param rTRS      [ref] Transforms, must be resized to fit ent
+     * @param ent       [in] Entity to set
+     * @param position  [in] Position relative to parent
+     * @param rotation  [in] Rotation relative to parent, must be normalized
+     * @param scale     [in] Scale along each local axis
+     */
+    static void set(
+            ACtxTransformTRS&       rTRS,
+            ActiveEnt               ent,
+            Vector3                 position,
+            Quaternion              rotation,
+            Vector3                 scale = Vector3{1.0f}) noexcept;
+
+    /**
+     * @brief Set a transform from a matrix without shear, such as one from a physics engine
+     */
+    static void set_matrix(ACtxTransformTRS& rTRS, ActiveEnt ent, Matrix4 const& matrix) noexcept;
+
+    static void remove(ACtxTransformTRS& rTRS, ActiveEnt ent) noexcept;
+
+    /**
+     * @return Matrix of an entity relative to its parent
+     */
+    static Matrix4 local_matrix(ACtxTransformTRS const& trs, ActiveEnt ent) noexcept;
+
+    /**
+     * @brief Get an entity's matrix relative to the scene's origin, recalculating it and any stale
+     *        ancestors first if needed
+     *
+     * Entities without a transform are treated as identity.
+     */
+    static Matrix4 const& world_matrix(ACtxTransformTRS& rTRS, ACtxSceneGraph const& scnGraph, ActiveEnt ent) noexcept;
+
+    /**
+     * @brief Recalculate stale world matrices for a range of whole root subtrees, by tree position
+     *
+     * Parents come before their descendants in the tree, so each stale entity only needs its
+     * parent's already up-to-date cached matrix. Nothing outside of the range is written, so
+     * ranges that don't overlap can be updated in parallel, each with its own rUpdated.
+     *
+     * @param rTRS      [ref] Transforms
+     * @param scnGraph  [in] Scene graph
+     * @param first     [in] Tree position of the first root, must not be within another subtree
+     * @param last      [in] One past the last tree position, must be the end of a subtree
+     * @param rUpdated  [out] Entities with a recalculated world matrix are appended, in tree order
+     */
+    static void update_world_range(
+            ACtxTransformTRS&       rTRS,
+            ACtxSceneGraph const&   scnGraph,
+            TreePos_t               first,
+            TreePos_t               last,
+            ActiveEntVec_t&         rUpdated);
+
+private:
+
+    static ActiveEnt transform_parent(ACtxTransformTRS const& trs, ACtxSceneGraph const& scnGraph, ActiveEnt ent) noexcept;
+
+    static bool is_world_stale(ACtxTransformTRS const& trs, ActiveEnt ent, ActiveEnt parent) noexcept;
+
+    static void update_world(ACtxTransformTRS& rTRS, ActiveEnt ent, ActiveEnt parent) noexcept;
+
+}; // class SysTransformTRS
+
+class SysFloatingOrigin
+{
+public:
+
+    /**
+     * @brief Get the translation that brings a focus point back within threshold of the origin
+     *
+     * Translations are whole multiples of threshold along each axis, so shifts don't accumulate
+     * rounding errors in positions that are already aligned.
+     *
+     * @return Translation to add to all positions, zero if focus is close enough
+     */
+    static Vector3 rebase_translation(Vector3 focus, float threshold) noexcept;
+
+    /**
+     * @brief Clear the requested translation, and add it to m_applied
+     *
+     * The scene may update several times between whatever reads m_applied, so translations
+     * accumulate until it is cleared.
+     *
+     * @param rFloatOrigin  [ref] Floating origin to take the request from
+     *
+     * @return Translation to apply to the scene, zero if none was requested
+     */
+    static Vector3 take_request(ACtxFloatingOrigin& rFloatOrigin) noexcept;
+
+    /**
+     * @brief Collect the direct children of the scene graph's root
+     *
+     * Only these have transforms relative to the scene's origin. Descendants are relative to their
+     * parents, and follow along when roots are translated.
+     *
+     * @param scnGraph  [in] Scene graph
+     * @param rRoots    [out] Cleared, then filled with root entities in tree order
+     */
+    static void collect_roots(ACtxSceneGraph const& scnGraph, ActiveEntVec_t& rRoots);
+
+    /**
+     * @brief Translate the transforms of root entities
+     *
+     * Roots without a transform are skipped.
+     *
+     * @param rTf       [ref] Transforms to modify
+     * @param roots     [in] Range of roots from collect_roots
+     * @param translate [in] Translation to add
+     */
+    static void translate_roots(ACompTransformStorage_t& rTf, ArrayView<ActiveEnt const> roots, Vector3 translate) noexcept;
+
+}; // class SysFloatingOrigin
+
 template<typename ITA_T, typename ITB_T>
 void SysSceneGraph::cut(ACtxSceneGraph& rScnGraph, ITA_T first, ITB_T const& last)
 {
@@ -208,5 +420,47 @@ void SysSceneGraph::queue_delete_entities(ACtxSceneGraph& rScnGraph, ActiveEntVe
     SysSceneGraph::cut(rScnGraph, first, last);
 }
 
+template<typename KEY_T, typename COMP_T, typename KEYOF_T>
+bool SysSceneGraph::defrag_storage_by(
+        ACtxSceneGraph const&           scnGraph,
+        Storage_t<KEY_T, COMP_T>&       rStorage,
+        TreeOrderDefrag&                rDefrag,
+        std::size_t                     maxVisit,
+        KEYOF_T&&                       keyOf)
+{
+    entt::basic_sparse_set<KEY_T> const &packed = rStorage;
+
+    TreePos_t const treeSize = TreePos_t(scnGraph.m_treeToEnt.size());
+
+    while (maxVisit != 0 && rDefrag.m_cursor < treeSize)
+    {
+        KEY_T const key = keyOf(scnGraph.m_treeToEnt[rDefrag.m_cursor]);
+        ++rDefrag.m_cursor;
+        --maxVisit;
+
+        if (key == lgrn::id_null<KEY_T>() || ! rStorage.contains(key))
+        {
+            continue;
+        }
+
+        if (rDefrag.m_packed < rStorage.size())
+        {
+            KEY_T const occupant = packed.data()[rDefrag.m_packed];
+            if (occupant != key)
+            {
+                rStorage.swap_elements(occupant, key);
+            }
+        }
+        ++rDefrag.m_packed;
+    }
+
+    if (rDefrag.m_cursor >= treeSize)
+    {
+        rDefrag = {};
+        return true;
+    }
+    return false;
+}
+
 } // namespace osp::active
 
@@ -0,0 +1,84 @@
+/**
+ * Open Space Program
+ * Copyright © 2019-2021 Open Space Program Project
+ *
+ * MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#pragma once
+
+#include "basic.h"
+
+#include "../core/keyed_vector.h"
+#include "../core/math_types.h"
+
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+namespace osp::active
+{
+
+/**
+ * @brief Axis-aligned bounding box, in meters
+ */
+struct Aabb
+{
+    Vector3 m_min;
+    Vector3 m_max;
+};
+
+/**
+ * @brief Dynamic AABB tree over entities, for picking, culling, and proximity queries
+ *
+ * Each leaf stores a 'fat' box, which is the entity's box grown by m_margin. Entities can move
+ * around within their fat box without touching the tree at all; only ones that move out of it
+ * are removed and inserted again. Internal nodes are kept balanced by tree rotations as leaves
+ * are inserted and removed, so queries stay O(log n) for well spread out entities.
+ *
+ * Modify through SysEntBvh.
+ */
+struct ACtxEntBvh
+{
+    using NodeId = std::uint32_t;
+
+    static constexpr NodeId smc_null = std::numeric_limits<NodeId>::max();
+
+    struct Node
+    {
+        Aabb        m_box;
+        NodeId      m_parent    {smc_null};
+        NodeId      m_childA    {smc_null}; // smc_null for leaves
+        NodeId      m_childB    {smc_null};
+        int         m_height    {0};        // 0 for leaves, -1 for free nodes
+        ActiveEnt   m_ent       {lgrn::id_null<ActiveEnt>()};
+    };
+
+    std::vector<Node>               m_nodes;
+    std::vector<NodeId>             m_freeNodes;
+    NodeId                          m_root      {smc_null};
+
+    KeyedVec<ActiveEnt, NodeId>     m_entToLeaf;
+
+    // Fat boxes are grown by this much along each axis, in meters
+    float                           m_margin    {0.5f};
+};
+
+} // namespace osp::active
@@ -0,0 +1,299 @@
+/**
+ * Open Space Program
+ * Copyright © 2019-2021 Open Space Program Project
+ *
+ * MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include "bvh_fn.h"
+
+#include <utility>
+
+namespace osp::active
+{
+
+Aabb SysEntBvh::transform_aabb(Aabb const& box, Matrix4 const& tf) noexcept
+{
+    // Each axis of the matrix stretches the box along that axis, pick whichever of the two
+    // corners are further apart per component
+    Aabb out{tf.translation(), tf.translation()};
+    for (int col = 0; col < 3; ++col)
+    {
+        Vector3 const axis  = tf[col].xyz();
+        Vector3 const a     = axis * box.m_min[col];
+        Vector3 const b     = axis * box.m_max[col];
+        out.m_min += Magnum::Math::min(a, b);
+        out.m_max += Magnum::Math::max(a, b);
+    }
+    return out;
+}
+
+bool SysEntBvh::update(ACtxEntBvh& rBvh, ActiveEnt const ent, Aabb const& box)
+{
+    if (std::size_t(ent) >= rBvh.m_entToLeaf.size())
+    {
+        rBvh.m_entToLeaf.resize(std::size_t(ent) + 1, ACtxEntBvh::smc_null);
+    }
+
+    NodeId leaf = rBvh.m_entToLeaf[ent];
+
+    if (leaf != ACtxEntBvh::smc_null)
+    {
+        if (box_contains(rBvh.m_nodes[leaf].m_box, box))
+        {
+            return false;
+        }
+        remove_leaf(rBvh, leaf);
+    }
+    else
+    {
+        leaf = alloc_node(rBvh);
+        rBvh.m_entToLeaf[ent] = leaf;
+    }
+
+    Vector3 const margin{rBvh.m_margin};
+    ACtxEntBvh::Node &rLeaf = rBvh.m_nodes[leaf];
+    rLeaf.m_box     = {box.m_min - margin, box.m_max + margin};
+    rLeaf.m_ent     = ent;
+    rLeaf.m_height  = 0;
+
+    insert_leaf(rBvh, leaf);
+    return true;
+}
+
+void SysEntBvh::remove(ACtxEntBvh& rBvh, ActiveEnt const ent) noexcept
+{
+    if ( ! contains(rBvh, ent) )
+    {
+        return;
+    }
+
+    NodeId const leaf = std::exchange(rBvh.m_entToLeaf[ent], ACtxEntBvh::smc_null);
+    remove_leaf(rBvh, leaf);
+    free_node(rBvh, leaf);
+}
+
+SysEntBvh::NodeId SysEntBvh::alloc_node(ACtxEntBvh& rBvh)
+{
+    if ( ! rBvh.m_freeNodes.empty() )
+    {
+        NodeId const node = rBvh.m_freeNodes.back();
+        rBvh.m_freeNodes.pop_back();
+        rBvh.m_nodes[node] = {};
+        return node;
+    }
+
+    rBvh.m_nodes.emplace_back();
+    return NodeId(rBvh.m_nodes.size() - 1);
+}
+
+void SysEntBvh::free_node(ACtxEntBvh& rBvh, NodeId const node) noexcept
+{
+    rBvh.m_nodes[node].m_height = -1;
+    rBvh.m_freeNodes.push_back(node);
+}
+
+void SysEntBvh::insert_leaf(ACtxEntBvh& rBvh, NodeId const leaf) noexcept
+{
+    using Node = ACtxEntBvh::Node;
+
+    if (rBvh.m_root == ACtxEntBvh::smc_null)
+    {
+        rBvh.m_root = leaf;
+        rBvh.m_nodes[leaf].m_parent = ACtxEntBvh::smc_null;
+        return;
+    }
+
+    Aabb const leafBox = rBvh.m_nodes[leaf].m_box;
+
+    // Walk down to the sibling that increases total surface area the least. Going down a level
+    // costs growing the current node to fit the leaf, which all of its descendants 'inherit'.
+    NodeId sibling = rBvh.m_root;
+    while (rBvh.m_nodes[sibling].m_height > 0)
+    {
+        Node const &rNode       = rBvh.m_nodes[sibling];
+        float const area        = box_area(rNode.m_box);
+        float const combined    = box_area(box_union(rNode.m_box, leafBox));
+
+        // Cost of making a new parent for this node and the leaf
+        float const cost        = 2.0f * combined;
+        float const inherited   = 2.0f * (combined - area);
+
+        auto const descend_cost = [&rBvh, &leafBox, inherited] (NodeId const child) noexcept -> float
+        {
+            Node const &rChild  = rBvh.m_nodes[child];
+            float const grown   = box_area(box_union(rChild.m_box, leafBox));
+            return (rChild.m_height == 0)
+                 ? grown + inherited
+                 : grown - box_area(rChild.m_box) + inherited;
+        };
+
+        float const costA = descend_cost(rNode.m_childA);
+        float const costB = descend_cost(rNode.m_childB);
+
+        if (cost < costA && cost < costB)
+        {
+            break;
+        }
+
+        sibling = (costA < costB) ? rNode.m_childA : rNode.m_childB;
+    }
+
+    // Make a new parent in place of the sibling
+    NodeId const newParent  = alloc_node(rBvh);
+    Node &rSibling          = rBvh.m_nodes[sibling];
+    Node &rNewParent        = rBvh.m_nodes[newParent];
+    NodeId const oldParent  = rSibling.m_parent;
+
+    rNewParent.m_parent     = oldParent;
+    rNewParent.m_box        = box_union(rSibling.m_box, leafBox);
+    rNewParent.m_height     = rSibling.m_height + 1;
+    rNewParent.m_childA     = sibling;
+    rNewParent.m_childB     = leaf;
+    rSibling.m_parent       = newParent;
+    rBvh.m_nodes[leaf].m_parent = newParent;
+
+    if (oldParent == ACtxEntBvh::smc_null)
+    {
+        rBvh.m_root = newParent;
+    }
+    else
+    {
+        Node &rOldParent = rBvh.m_nodes[oldParent];
+        (rOldParent.m_childA == sibling ? rOldParent.m_childA : rOldParent.m_childB) = newParent;
+    }
+
+    refit_upwards(rBvh, newParent);
+}
+
+void SysEntBvh::remove_leaf(ACtxEntBvh& rBvh, NodeId const leaf) noexcept
+{
+    using Node = ACtxEntBvh::Node;
+
+    if (leaf == rBvh.m_root)
+    {
+        rBvh.m_root = ACtxEntBvh::smc_null;
+        return;
+    }
+
+    NodeId const parent         = rBvh.m_nodes[leaf].m_parent;
+    Node const &rParent         = rBvh.m_nodes[parent];
+    NodeId const grandParent    = rParent.m_parent;
+    NodeId const sibling        = (rParent.m_childA == leaf) ? rParent.m_childB : rParent.m_childA;
+
+    // Sibling takes the parent's place
+    rBvh.m_nodes[sibling].m_parent = grandParent;
+    if (grandParent == ACtxEntBvh::smc_null)
+    {
+        rBvh.m_root = sibling;
+    }
+    else
+    {
+        Node &rGrandParent = rBvh.m_nodes[grandParent];
+        (rGrandParent.m_childA == parent ? rGrandParent.m_childA : rGrandParent.m_childB) = sibling;
+    }
+
+    free_node(rBvh, parent);
+    refit_upwards(rBvh, grandParent);
+}
+
+void SysEntBvh::refit_upwards(ACtxEntBvh& rBvh, NodeId node) noexcept
+{
+    while (node != ACtxEntBvh::smc_null)
+    {
+        node = balance(rBvh, node);
+
+        ACtxEntBvh::Node &rNode         = rBvh.m_nodes[node];
+        ACtxEntBvh::Node const &rChildA = rBvh.m_nodes[rNode.m_childA];
+        ACtxEntBvh::Node const &rChildB = rBvh.m_nodes[rNode.m_childB];
+
+        rNode.m_height  = 1 + std::max(rChildA.m_height, rChildB.m_height);
+        rNode.m_box     = box_union(rChildA.m_box, rChildB.m_box);
+
+        node = rNode.m_parent;
+    }
+}
+
+SysEntBvh::NodeId SysEntBvh::balance(ACtxEntBvh& rBvh, NodeId const iA) noexcept
+{
+    using Node = ACtxEntBvh::Node;
+
+    Node const &rNode = rBvh.m_nodes[iA];
+    if (rNode.m_height < 2)
+    {
+        return iA;
+    }
+
+    // Rotate the taller child (iUp) into A's position. The taller of iUp's children stays with
+    // it, the shorter one is handed down to A in place of iUp.
+    auto const rotate_up = [&rBvh, iA] (NodeId const iUp, NodeId const iOther, bool const upIsChildA) noexcept -> NodeId
+    {
+        Node &rA    = rBvh.m_nodes[iA];
+        Node &rUp   = rBvh.m_nodes[iUp];
+
+        NodeId const iTall  = (rBvh.m_nodes[rUp.m_childA].m_height > rBvh.m_nodes[rUp.m_childB].m_height) ? rUp.m_childA : rUp.m_childB;
+        NodeId const iShort = (iTall == rUp.m_childA) ? rUp.m_childB : rUp.m_childA;
+
+        rUp.m_childA    = iA;
+        rUp.m_childB    = iTall;
+        rUp.m_parent    = rA.m_parent;
+        rA.m_parent     = iUp;
+
+        if (rUp.m_parent == ACtxEntBvh::smc_null)
+        {
+            rBvh.m_root = iUp;
+        }
+        else
+        {
+            Node &rParent = rBvh.m_nodes[rUp.m_parent];
+            (rParent.m_childA == iA ? rParent.m_childA : rParent.m_childB) = iUp;
+        }
+
+        (upIsChildA ? rA.m_childA : rA.m_childB) = iShort;
+        rBvh.m_nodes[iShort].m_parent = iA;
+
+        Node const &rOther  = rBvh.m_nodes[iOther];
+        Node const &rShort  = rBvh.m_nodes[iShort];
+        Node const &rTall   = rBvh.m_nodes[iTall];
+
+        rA.m_box        = box_union(rOther.m_box, rShort.m_box);
+        rA.m_height     = 1 + std::max(rOther.m_height, rShort.m_height);
+        rUp.m_box       = box_union(rA.m_box, rTall.m_box);
+        rUp.m_height    = 1 + std::max(rA.m_height, rTall.m_height);
+
+        return iUp;
+    };
+
+    NodeId const iB     = rNode.m_childA;
+    NodeId const iC     = rNode.m_childB;
+    int const imbalance = rBvh.m_nodes[iC].m_height - rBvh.m_nodes[iB].m_height;
+
+    if (imbalance > 1)
+    {
+        return rotate_up(iC, iB, false);
+    }
+    if (imbalance < -1)
+    {
+        return rotate_up(iB, iC, true);
+    }
+    return iA;
+}
+
+} // namespace osp::active
@@ -0,0 +1,381 @@
+/**
+ * Open Space Program
+ * Copyright © 2019-2021 Open Space Program Project
+ *
+ * MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#pragma once
+
+#include "bvh.h"
+
+#include "../core/math_frustum.h"
+
+#include <Magnum/Math/Functions.h>
+
+#include <algorithm>
+
+namespace osp::active
+{
+
+class SysEntBvh
+{
+    using NodeId = ACtxEntBvh::NodeId;
+
+public:
+
+    /**
+     * @brief Get the box that contains another box after it's transformed
+     */
+    static Aabb transform_aabb(Aabb const& box, Matrix4 const& tf) noexcept;
+
+    static Aabb box_union(Aabb const& a, Aabb const& b) noexcept
+    {
+        return { Magnum::Math::min(a.m_min, b.m_min), Magnum::Math::max(a.m_max, b.m_max) };
+    }
+
+    static bool box_overlaps(Aabb const& a, Aabb const& b) noexcept
+    {
+        return    a.m_min.x() <= b.m_max.x() && b.m_min.x() <= a.m_max.x()
+               && a.m_min.y() <= b.m_max.y() && b.m_min.y() <= a.m_max.y()
+               && a.m_min.z() <= b.m_max.z() && b.m_min.z() <= a.m_max.z();
+    }
+
+    static bool box_contains(Aabb const& outer, Aabb const& inner) noexcept
+    {
+        return    outer.m_min.x() <= inner.m_min.x() && inner.m_max.x() <= outer.m_max.x()
+               && outer.m_min.y() <= inner.m_min.y() && inner.m_max.y() <= outer.m_max.y()
+               && outer.m_min.z() <= inner.m_min.z() && inner.m_max.z() <= outer.m_max.z();
+    }
+
+    static bool contains(ACtxEntBvh const& bvh, ActiveEnt const ent) noexcept
+    {
+        return std::size_t(ent) < bvh.m_entToLeaf.size() && bvh.m_entToLeaf[ent] != ACtxEntBvh::smc_null;
+    }
+
+    /**
+     * @return Fat box of an entity in the tree
+     */
+    static Aabb const& fat_box(ACtxEntBvh const& bvh, ActiveEnt const ent) noexcept
+    {
+        return bvh.m_nodes[bvh.m_entToLeaf[ent]].m_box;
+    }
+
+    /**
+     * @brief Add an entity to the tree, or update the box of one that's already in it
+     *
+     * This is cheap if the entity's box is still within its fat box, which is the case for most
+     * entities in a typical update.
+     *
+     * @param rBvh      [ref] Tree to update
+     * @param ent       [in] Entity to add or update
+     * @param box       [in] Current box of the entity
+     *
+     * @return True if the entity was added or reinserted, false if the tree was left untouched
+     */
+    static bool update(ACtxEntBvh& rBvh, ActiveEnt ent, Aabb const& box);
+
+    /**
+     * @brief Remove an entity from the tree. Does nothing if it isn't in the tree.
+     */
+    static void remove(ACtxEntBvh& rBvh, ActiveEnt ent) noexcept;
+
+    /**
+     * @brief Call func(ActiveEnt) for each entity whose fat box overlaps a box
+     */
+    template<typename FUNC_T>
+    static void query_box(ACtxEntBvh const& bvh, Aabb const& box, FUNC_T&& func);
+
+    /**
+     * @brief Call func(ActiveEnt) for each entity whose fat box overlaps a sphere
+     */
+    template<typename FUNC_T>
+    static void query_sphere(ACtxEntBvh const& bvh, Vector3 center, float radius, FUNC_T&& func);
+
+    /**
+     * @brief Call func(ActiveEnt) for each entity whose fat box is at least partially inside a
+     *        frustum
+     *
+     * Subtrees entirely inside the frustum are reported without testing each of their leaves.
+     */
+    template<typename FUNC_T>
+    static void query_frustum(ACtxEntBvh const& bvh, math::Frustum const& frustum, FUNC_T&& func);
+
+    /**
+     * @brief Call func(ActiveEnt, float enter) for each entity whose fat box is hit by a ray
+     *
+     * func returns the new maximum distance to search. For picking the closest entity, return the
+     * distance of an exact hit against the entity, or maxDistance to keep searching as before.
+     *
+     * @param bvh           [in] Tree to search
+     * @param origin        [in] Start of the ray
+     * @param direction     [in] Direction of the ray, distances are in multiples of its length
+     * @param maxDistance   [in] Distance along the ray to stop searching
+     * @param func          [in] Called with each entity hit, and the distance it's entered at
+     */
+    template<typename FUNC_T>
+    static void query_ray(ACtxEntBvh const& bvh, Vector3 origin, Vector3 direction, float maxDistance, FUNC_T&& func);
+
+private:
+
+    template<typename FUNC_T>
+    static void visit_subtree(ACtxEntBvh const& bvh, NodeId node, std::vector<NodeId>& rStack, FUNC_T& func);
+
+    static NodeId   alloc_node(ACtxEntBvh& rBvh);
+    static void     free_node(ACtxEntBvh& rBvh, NodeId node) noexcept;
+
+    static void     insert_leaf(ACtxEntBvh& rBvh, NodeId leaf) noexcept;
+    static void     remove_leaf(ACtxEntBvh& rBvh, NodeId leaf) noexcept;
+
+    /**
+     * @brief Recalculate boxes and heights from a node up to the root, rotating any unbalanced
+     *        nodes along the way
+     */
+    static void     refit_upwards(ACtxEntBvh& rBvh, NodeId node) noexcept;
+
+    /**
+     * @brief Rotate a node's taller child up if the node is unbalanced
+     *
+     * @return Node now in the position of the original node
+     */
+    static NodeId   balance(ACtxEntBvh& rBvh, NodeId node) noexcept;
+
+    static float    box_area(Aabb const& box) noexcept
+    {
+        Vector3 const size = box.m_max - box.m_min;
+        return size.x() * size.y() + size.y() * size.z() + size.z() * size.x();
+    }
+};
+
+template<typename FUNC_T>
+void SysEntBvh::visit_subtree(ACtxEntBvh const& bvh, NodeId const node, std::vector<NodeId>& rStack, FUNC_T& func)
+{
+    std::size_t const base = rStack.size();
+    rStack.push_back(node);
+    while (rStack.size() != base)
+    {
+        ACtxEntBvh::Node const &rNode = bvh.m_nodes[rStack.back()];
+        rStack.pop_back();
+        if (rNode.m_height == 0)
+        {
+            func(rNode.m_ent);
+        }
+        else
+        {
+            rStack.push_back(rNode.m_childA);
+            rStack.push_back(rNode.m_childB);
+        }
+    }
+}
+
+template<typename FUNC_T>
+void SysEntBvh::query_box(ACtxEntBvh const& bvh, Aabb const& box, FUNC_T&& func)
+{
+    if (bvh.m_root == ACtxEntBvh::smc_null)
+    {
+        return;
+    }
+
+    std::vector<NodeId> stack;
+    stack.reserve(64);
+    stack.push_back(bvh.m_root);
+
+    while ( ! stack.empty() )
+    {
+        ACtxEntBvh::Node const &rNode = bvh.m_nodes[stack.back()];
+        stack.pop_back();
+
+        if ( ! box_overlaps(rNode.m_box, box) )
+        {
+            continue;
+        }
+
+        if (rNode.m_height == 0)
+        {
+            func(rNode.m_ent);
+        }
+        else
+        {
+            stack.push_back(rNode.m_childA);
+            stack.push_back(rNode.m_childB);
+        }
+    }
+}
+
+template<typename FUNC_T>
+void SysEntBvh::query_sphere(ACtxEntBvh const& bvh, Vector3 const center, float const radius, FUNC_T&& func)
+{
+    if (bvh.m_root == ACtxEntBvh::smc_null)
+    {
+        return;
+    }
+
+    float const radiusSq = radius * radius;
+
+    std::vector<NodeId> stack;
+    stack.reserve(64);
+    stack.push_back(bvh.m_root);
+
+    while ( ! stack.empty() )
+    {
+        ACtxEntBvh::Node const &rNode = bvh.m_nodes[stack.back()];
+        stack.pop_back();
+
+        // Distance from center to the closest point in the box
+        Vector3 const closest = Magnum::Math::clamp(center, rNode.m_box.m_min, rNode.m_box.m_max);
+        if ((closest - center).dot() > radiusSq)
+        {
+            continue;
+        }
+
+        if (rNode.m_height == 0)
+        {
+            func(rNode.m_ent);
+        }
+        else
+        {
+            stack.push_back(rNode.m_childA);
+            stack.push_back(rNode.m_childB);
+        }
+    }
+}
+
+template<typename FUNC_T>
+void SysEntBvh::query_frustum(ACtxEntBvh const& bvh, math::Frustum const& frustum, FUNC_T&& func)
+{
+    if (bvh.m_root == ACtxEntBvh::smc_null)
+    {
+        return;
+    }
+
+    std::vector<NodeId> stack;
+    stack.reserve(64);
+    stack.push_back(bvh.m_root);
+
+    while ( ! stack.empty() )
+    {
+        NodeId const node = stack.back();
+        ACtxEntBvh::Node const &rNode = bvh.m_nodes[node];
+        stack.pop_back();
+
+        Vector3 const center    = (rNode.m_box.m_min + rNode.m_box.m_max) * 0.5f;
+        Vector3 const extent    = (rNode.m_box.m_max - rNode.m_box.m_min) * 0.5f;
+
+        bool outside    = false;
+        bool inside     = true;
+        for (Vector4 const& plane : frustum.m_planes)
+        {
+            Vector3 const normal    = plane.xyz();
+            float const dist        = Magnum::Math::dot(normal, center) + plane.w();
+            float const reach       = Magnum::Math::dot(Magnum::Math::abs(normal), extent);
+
+            if (dist + reach < 0.0f)
+            {
+                outside = true;
+                break;
+            }
+            inside = inside && (dist - reach >= 0.0f);
+        }
+
+        if (outside)
+        {
+            continue;
+        }
+
+        if (inside)
+        {
+            visit_subtree(bvh, node, stack, func);
+        }
+        else if (rNode.m_height == 0)
+        {
+            func(rNode.m_ent);
+        }
+        else
+        {
+            stack.push_back(rNode.m_childA);
+            stack.push_back(rNode.m_childB);
+        }
+    }
+}
+
+template<typename FUNC_T>
+void SysEntBvh::query_ray(ACtxEntBvh const& bvh, Vector3 const origin, Vector3 const direction, float maxDistance, FUNC_T&& func)
+{
+    if (bvh.m_root == ACtxEntBvh::smc_null)
+    {
+        return;
+    }
+
+    // Only used along axes the ray isn't parallel to
+    Vector3 const invDir = Vector3{1.0f} / direction;
+
+    auto const enter_distance = [&origin, &direction, &invDir] (Aabb const& box, float const maxDist) noexcept -> float
+    {
+        float enter = 0.0f;
+        float exit  = maxDist;
+        for (int i = 0; i < 3; ++i)
+        {
+            if (direction[i] == 0.0f)
+            {
+                // Parallel to this pair of planes, the ray is always or never between them.
+                // Using invDir here would give 0 * inf = NaN if the origin is on one of them.
+                if (origin[i] < box.m_min[i] || box.m_max[i] < origin[i])
+                {
+                    return -1.0f;
+                }
+                continue;
+            }
+
+            float const t0 = (box.m_min[i] - origin[i]) * invDir[i];
+            float const t1 = (box.m_max[i] - origin[i]) * invDir[i];
+            enter   = std::max(enter, std::min(t0, t1));
+            exit    = std::min(exit,  std::max(t0, t1));
+        }
+        return (enter <= exit) ? enter : -1.0f;
+    };
+
+    std::vector<NodeId> stack;
+    stack.reserve(64);
+    stack.push_back(bvh.m_root);
+
+    while ( ! stack.empty() )
+    {
+        ACtxEntBvh::Node const &rNode = bvh.m_nodes[stack.back()];
+        stack.pop_back();
+
+        float const enter = enter_distance(rNode.m_box, maxDistance);
+        if (enter < 0.0f)
+        {
+            continue;
+        }
+
+        if (rNode.m_height == 0)
+        {
+            maxDistance = std::min(maxDistance, float(func(rNode.m_ent, enter)));
+        }
+        else
+        {
+            stack.push_back(rNode.m_childA);
+            stack.push_back(rNode.m_childB);
+        }
+    }
+}
+
+} // namespace osp::active
@@ -31,6 +31,8 @@
 #include <Magnum/Trade/Trade.h>
 #include <Magnum/Trade/PbrMetallicRoughnessMaterialData.h>
 
+#include <utility>
+
 using Corrade::Containers::ArrayView;
 
 using osp::restypes::gc_importer;
@@ -38,19 +40,165 @@ using osp::restypes::gc_importer;
 namespace osp::active
 {
 
+uint32_t SysPrefabInit::get_template(
+        ACtxPrefabs&                        rPrefabs,
+        Resources&                          rResources,
+        ResId const                         importer,
+        PrefabId const                      prefab)
+{
+    uint64_t const key = (uint64_t(importer) << 32) | uint64_t(prefab);
+
+    if (auto const found = rPrefabs.templateIds.find(key);
+        found != rPrefabs.templateIds.end())
+    {
+        return found->second;
+    }
+
+    if ( ! rPrefabs.templateImporters.contains(importer) )
+    {
+        rPrefabs.templateImporters.emplace(importer, rResources.owner_create(gc_importer, importer));
+    }
+
+    auto const id = uint32_t(rPrefabs.templates.size());
+    rPrefabs.templates.emplace_back(compile_template(rResources, importer, prefab));
+    rPrefabs.templateIds.emplace(key, id);
+    return id;
+}
+
+void SysPrefabInit::clear_templates(
+        ACtxPrefabs&                        rPrefabs,
+        Resources&                          rResources) noexcept
+{
+    for ([[maybe_unused]] auto && [_, rOwner] : std::exchange(rPrefabs.templateImporters, {}))
+    {
+        rResources.owner_destroy(gc_importer, std::move(rOwner));
+    }
+    rPrefabs.templates.clear();
+    rPrefabs.templateIds.clear();
+}
+
+PrefabTemplate SysPrefabInit::compile_template(
+        Resources const&                    rResources,
+        ResId const                         importer,
+        PrefabId const                      prefab)
+{
+    auto const &rImportData = rResources.data_get<osp::ImporterData const>(gc_importer, importer);
+    auto const &rPrefabData = rResources.data_get<osp::Prefabs const>(gc_importer, importer);
+
+    auto const objects  = lgrn::Span<int const>{rPrefabData.m_prefabs[prefab]};
+    auto const parents  = lgrn::Span<int const>{rPrefabData.m_prefabParents[prefab]};
+    std::size_t const count = objects.size();
+
+    PrefabTemplate out;
+    out.parents     .assign(parents.begin(), parents.end());
+    out.descendants .resize(count);
+    out.transforms  .resize(count);
+    out.shapes      .resize(count);
+
+    std::vector<bool> hasCollider(count, false);
+    std::vector<bool> needDrawTf(count, false);
+
+    // Mark an object and all of its ancestors
+    auto const mark_ancestors = [&parents] (std::vector<bool>& rMarks, int object) noexcept
+    {
+        while (object != -1 && ! rMarks[object])
+        {
+            rMarks[object] = true;
+            object = parents[object];
+        }
+    };
+
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        ObjId const     obj     = objects[i];
+        float const     mass    = rPrefabData.m_objMass[obj];
+        EShape const    shape   = rPrefabData.m_objShape[obj];
+
+        out.descendants[i]  = uint32_t(rImportData.m_objDescendants[obj]);
+        out.transforms[i]   = {rImportData.m_objTransforms[obj]};
+        out.shapes[i]       = shape;
+
+        if (mass != 0.0f)
+        {
+            Vector3 const scale = rImportData.m_objTransforms[obj].scaling();
+            Vector3 const inertia = collider_inertia_tensor(shape, scale, mass);
+            Vector3 const offset{0.0f, 0.0f, 0.0f};
+            out.massObjs.push_back(uint32_t(i));
+            out.masses.push_back(ACompMass{ offset, inertia, mass });
+        }
+
+        if ( (mass != 0.0f) || (shape != EShape::None) )
+        {
+            mark_ancestors(hasCollider, int(i));
+        }
+
+        // Objects with LOD meshes are only drawn as part of their base mesh's LOD chain
+        int const meshImportId = rImportData.m_objMeshes[obj];
+        if (meshImportId == -1 || rImportData.m_meshIsLod[meshImportId])
+        {
+            continue;
+        }
+
+        mark_ancestors(needDrawTf, int(i));
+
+        ResId texRes = lgrn::id_null<ResId>();
+        int const matImportId = rImportData.m_objMaterials[obj];
+        Magnum::Trade::MaterialData const &mat = *rImportData.m_materials.at(matImportId);
+
+        if (mat.types() & Magnum::Trade::MaterialType::PbrMetallicRoughness)
+        {
+            auto const& matPbr = mat.as<Magnum::Trade::PbrMetallicRoughnessMaterialData>();
+            if (auto const baseColor = matPbr.baseColorTexture();
+                baseColor != -1)
+            {
+                texRes = rImportData.m_textures[baseColor];
+            }
+        }
+
+        out.meshObjs    .push_back(uint32_t(i));
+        out.meshes      .push_back(rImportData.m_meshes[meshImportId]);
+        out.diffuseTex  .push_back(texRes);
+        out.transparent .push_back(mat.alphaMode() == Magnum::Trade::MaterialAlphaMode::Blend);
+
+        out.meshLodsOffset.push_back(uint32_t(out.meshLods.size()));
+        for (int lod = rImportData.m_meshNextLod[meshImportId]; lod != -1; lod = rImportData.m_meshNextLod[lod])
+        {
+            out.meshLods.push_back(rImportData.m_meshes[lod]);
+        }
+    }
+    out.meshLodsOffset.push_back(uint32_t(out.meshLods.size()));
+
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        if (hasCollider[i])
+        {
+            out.colliderObjs.push_back(uint32_t(i));
+        }
+        if (needDrawTf[i])
+        {
+            out.drawTfObjs.push_back(uint32_t(i));
+        }
+    }
+
+    return out;
+}
+
 void SysPrefabInit::create_activeents(
         ACtxPrefabs&                        rPrefabs,
         ACtxBasic&                          rBasic,
         Resources&                          rResources)
 {
-    // Count number of entities needed to be created
+    // Look up templates and count number of entities needed to be created
+    rPrefabs.spawnTemplate.resize(rPrefabs.spawnRequest.size());
+
     std::size_t totalEnts = 0;
-    for (TmpPrefabRequest const& rPfBasic : rPrefabs.spawnRequest)
+    for (std::size_t i = 0; i < rPrefabs.spawnRequest.size(); ++i)
     {
-        auto const& rPrefabData = rResources.data_get<Prefabs>(gc_importer, rPfBasic.m_importerRes);
-        auto const& objects     = rPrefabData.m_prefabs[rPfBasic.m_prefabId];
+        TmpPrefabRequest const &rPfBasic = rPrefabs.spawnRequest[i];
+        uint32_t const tmplId = get_template(rPrefabs, rResources, rPfBasic.m_importerRes, rPfBasic.m_prefabId);
 
-        totalEnts += objects.size();
+        rPrefabs.spawnTemplate[i] = tmplId;
+        totalEnts += rPrefabs.templates[tmplId].parents.size();
     }
 
     // Create entities
@@ -59,210 +207,98 @@ void SysPrefabInit::create_activeents(
 
     // Assign new entities to each prefab to create
     rPrefabs.spawnedEntsOffset.resize(rPrefabs.spawnRequest.size());
-    auto itEntAvailable = std::begin(rPrefabs.newEnts);
-    auto itPfEntSpanOut = std::begin(rPrefabs.spawnedEntsOffset);
-    for (TmpPrefabRequest& rPfBasic : rPrefabs.spawnRequest)
+    ActiveEnt const *pEntAvailable = rPrefabs.newEnts.data();
+    for (std::size_t i = 0; i < rPrefabs.spawnRequest.size(); ++i)
     {
-        auto const& rPrefabData = rResources.data_get<Prefabs>(gc_importer, rPfBasic.m_importerRes);
-        auto const& objects     = rPrefabData.m_prefabs[rPfBasic.m_prefabId];
-
-        (*itPfEntSpanOut) = { &(*itEntAvailable), objects.size() };
+        std::size_t const size = rPrefabs.templates[rPrefabs.spawnTemplate[i]].parents.size();
 
-        std::advance(itEntAvailable, objects.size());
-        std::advance(itPfEntSpanOut, 1);
+        rPrefabs.spawnedEntsOffset[i] = { pEntAvailable, size };
+        pEntAvailable += size;
     }
 
-    assert(itEntAvailable == std::end(rPrefabs.newEnts));
+    assert(pEntAvailable == rPrefabs.newEnts.data() + rPrefabs.newEnts.size());
 }
 
 void SysPrefabInit::add_to_subtree(
-        TmpPrefabRequest const&             basic,
+        PrefabTemplate const&               tmpl,
         ArrayView<ActiveEnt const>          ents,
-        Resources const&                    rResources,
         SubtreeBuilder&                     bldPrefab) noexcept
 {
-    auto const &rImportData = rResources.data_get<osp::ImporterData const>(
-            gc_importer, basic.m_importerRes);
-    auto const &rPrefabData = rResources.data_get<osp::Prefabs const>(
-            gc_importer, basic.m_importerRes);
-
-    auto const& objs    = rPrefabData.m_prefabs[basic.m_prefabId];
-    auto const& parents = rPrefabData.m_prefabParents[basic.m_prefabId];
-
-    auto itObj      = std::begin(objs);
-    auto itEnt      = std::begin(ents);
-
     auto const add_child_recurse
-            = [&rImportData, &itObj, &itEnt, &parents] (auto&& self, SubtreeBuilder& bldParent) -> void
+            = [&tmpl, &ents] (auto&& self, SubtreeBuilder& bldParent, uint32_t const obj) -> void
     {
-        std::size_t const descendants   = rImportData.m_objDescendants[*itObj];
-        auto bldChildren = bldParent.add_child(*itEnt, descendants);
-        auto children = rImportData.m_objChildren[*itObj];
-
-        std::advance(itObj, 1);
-        std::advance(itEnt, 1);
+        uint32_t const descendants  = tmpl.descendants[obj];
+        SubtreeBuilder bldChildren  = bldParent.add_child(ents[obj], descendants);
 
-        for ([[maybe_unused]] ObjId const child : children)
+        uint32_t const last = obj + 1 + descendants;
+        for (uint32_t child = obj + 1; child != last; child += tmpl.descendants[child] + 1)
         {
-            self(self, bldChildren);
+            self(self, bldChildren, child);
         }
     };
 
-    add_child_recurse(add_child_recurse, bldPrefab);
-
-    assert(itObj == std::end(objs));
-    assert(itEnt == std::end(ents));
+    add_child_recurse(add_child_recurse, bldPrefab, 0);
 }
 
 void SysPrefabInit::init_transforms(
         ACtxPrefabs const&                  rPrefabs,
-        Resources const&                    rResources,
         ACompTransformStorage_t&            rTransform) noexcept
 {
-    auto itPfEnts = rPrefabs.spawnedEntsOffset.begin();
-
-    for (TmpPrefabRequest const& rPfBasic : rPrefabs.spawnRequest)
+    for (std::size_t i = 0; i < rPrefabs.spawnRequest.size(); ++i)
     {
-        auto const &rImportData = rResources.data_get<osp::ImporterData const>(
-                gc_importer, rPfBasic.m_importerRes);
-        auto const &rPrefabData = rResources.data_get<osp::Prefabs const>(
-                gc_importer, rPfBasic.m_importerRes);
-
-        auto const objects = rPrefabData.m_prefabs[rPfBasic.m_prefabId];
-        auto const parents = rPrefabData.m_prefabParents[rPfBasic.m_prefabId];
-
-        for (std::size_t i = 0; i < objects.size(); ++i)
-        {
-            Matrix4 const& transform = (parents[i] == -1)
-                    ? *rPfBasic.m_pTransform
-                    : rImportData.m_objTransforms[objects[i]];
-            ActiveEnt const ent = (*itPfEnts)[i];
-            rTransform.emplace(ent, transform);
-        }
+        TmpPrefabRequest const  &rPfBasic   = rPrefabs.spawnRequest[i];
+        PrefabTemplate const    &rTmpl      = rPrefabs.templates[rPrefabs.spawnTemplate[i]];
+        auto const              ents        = rPrefabs.spawnedEntsOffset[i];
 
-        ++itPfEnts;
+        // Copy all local transforms at once, then place the root
+        rTransform.insert(ents.begin(), ents.end(), rTmpl.transforms.begin());
+        rTransform.get(ents[0]).m_transform = *rPfBasic.m_pTransform;
     }
 }
 
 void SysPrefabInit::init_info(
-            ACtxPrefabs&                    rPrefabs,
-            Resources const&                rResources) noexcept
+            ACtxPrefabs&                    rPrefabs) noexcept
 {
-    auto itPfEnts = rPrefabs.spawnedEntsOffset.begin();
-
-    for (TmpPrefabRequest const& rPfBasic : rPrefabs.spawnRequest)
+    for (std::size_t i = 0; i < rPrefabs.spawnRequest.size(); ++i)
     {
-        auto const &rImportData = rResources.data_get<osp::ImporterData const>(
-                gc_importer, rPfBasic.m_importerRes);
-        auto const &rPrefabData = rResources.data_get<osp::Prefabs const>(
-                gc_importer, rPfBasic.m_importerRes);
-
-        auto const ents     = ArrayView<ActiveEnt const>{*itPfEnts};
-        auto const objects = rPrefabData.m_prefabs[rPfBasic.m_prefabId];
-        auto const parents = rPrefabData.m_prefabParents[rPfBasic.m_prefabId];
+        TmpPrefabRequest const  &rPfBasic   = rPrefabs.spawnRequest[i];
+        auto const              ents        = rPrefabs.spawnedEntsOffset[i];
 
-        for (std::size_t i = 0; i < objects.size(); ++i)
+        for (std::size_t j = 0; j < ents.size(); ++j)
         {
-            ActiveEnt const ent = ents[i];
-            PrefabInstanceInfo &rInfo = rPrefabs.instanceInfo[ent];
+            PrefabInstanceInfo &rInfo = rPrefabs.instanceInfo[ents[j]];
             rInfo.importer  = rPfBasic.m_importerRes;
             rInfo.prefab    = rPfBasic.m_prefabId;
-            rInfo.obj       = static_cast<ObjId>(i);
-
-            if (parents[i] == -1)
-            {
-                rPrefabs.roots.insert(ent);
-            }
+            rInfo.obj       = static_cast<ObjId>(j);
         }
 
-        ++itPfEnts;
+        rPrefabs.roots.insert(ents[0]);
     }
 }
 
 void SysPrefabInit::init_physics(
             ACtxPrefabs const&              rPrefabs,
-            Resources const&                rResources,
             ACtxPhysics&                    rCtxPhys) noexcept
 {
-
-    auto itPfEnts = rPrefabs.spawnedEntsOffset.begin();
-
-    for (TmpPrefabRequest const& rPfBasic : rPrefabs.spawnRequest)
+    for (std::size_t i = 0; i < rPrefabs.spawnRequest.size(); ++i)
     {
-        auto const &rImportData = rResources.data_get<osp::ImporterData const>(
-                gc_importer, rPfBasic.m_importerRes);
-        auto const &rPrefabData = rResources.data_get<osp::Prefabs const>(
-                gc_importer, rPfBasic.m_importerRes);
-
-        auto const ents     = ArrayView<ActiveEnt const>{*itPfEnts};
-        auto const objects  = lgrn::Span<int const>     {rPrefabData.m_prefabs[rPfBasic.m_prefabId]};
-        auto const parents  = lgrn::Span<int const>     {rPrefabData.m_prefabParents[rPfBasic.m_prefabId]};
+        PrefabTemplate const    &rTmpl  = rPrefabs.templates[rPrefabs.spawnTemplate[i]];
+        auto const              ents    = rPrefabs.spawnedEntsOffset[i];
 
-#if 0
-        auto const assign_dyn_recurse = [&rCtxPhys, ents, objects, parents] (auto const& self, int objectId, ActiveEnt ent) -> void
+        for (std::size_t j = 0; j < ents.size(); ++j)
         {
-            int const parentId = parents[objectId];
-            if (parentId == -1)
-            {
-                return;
-            }
-
-            ActiveEnt const parentEnt = ents[parentId];
-
-            if ( ! rCtxPhys.m_totalDyn.contains(parentEnt) )
-            {
-                rCtxPhys.m_totalDyn.emplace(parentEnt);
-            }
-
-            self(self, parentId, parentEnt);
-        };
-#endif
+            rCtxPhys.m_shape[ents[j]] = rTmpl.shapes[j];
+        }
 
-        auto const assign_collider_recurse
-                = [&rHasColliders = rCtxPhys.m_hasColliders, ents, objects, parents]
-                  (auto const& self, int objectId, ActiveEnt ent) -> void
+        for (std::size_t j = 0; j < rTmpl.massObjs.size(); ++j)
         {
-            if (rHasColliders.contains(ent))
-            {
-                return; // HasColliders bit already set, this means all ancestors have it set too
-            }
-            rHasColliders.insert(ent);
-
-            int const parentId = parents[objectId];
-
-            if (parentId != -1)
-            {
-                self(self, parentId, ents[parentId]);
-            }
-        };
+            rCtxPhys.m_mass.emplace(ents[rTmpl.massObjs[j]], rTmpl.masses[j]);
+        }
 
-        for (std::size_t i = 0; i < objects.size(); ++i)
+        for (uint32_t const obj : rTmpl.colliderObjs)
         {
-            ActiveEnt const ent         = ents[i];
-            int const       objectId    = objects[i];
-            float const     mass        = rPrefabData.m_objMass[objectId];
-            EShape const    shape       = rPrefabData.m_objShape[objectId];
-
-
-            rCtxPhys.m_shape[ent] = shape;
-
-            if (mass != 0.0f)
-            {
-                Vector3 const scale = rImportData.m_objTransforms[objectId].scaling();
-                Vector3 const inertia = collider_inertia_tensor(shape, scale, mass);
-                Vector3 const offset{0.0f, 0.0f, 0.0f};
-                rCtxPhys.m_mass.emplace( ent, ACompMass{ offset, inertia, mass } );
-
-                //assign_dyn_recurse(assign_dyn_recurse, objectId, ent);
-            }
-
-            if ( (mass != 0.0f) || (shape != EShape::None) )
-            {
-                assign_collider_recurse(assign_collider_recurse, objectId, ent);
-            }
+            rCtxPhys.m_hasColliders.insert(ents[obj]);
         }
-
-        std::advance(itPfEnts, 1);
     }
 }
 
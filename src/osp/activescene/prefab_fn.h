@@ -28,6 +28,7 @@
 #include "physics.h"
 
 #include "../core/array_view.h"
+#include "../core/id_map.h"
 #include "../core/resourcetypes.h"
 #include "../vehicles/prefabs.h"
 
@@ -53,6 +54,42 @@ struct TmpPrefabRequest
     Matrix4 const* m_pTransform{nullptr};
 };
 
+/**
+ * @brief A prefab flattened into arrays, compiled once then cloned for each spawn
+ *
+ * All arrays are indexed by object index within the prefab, which is also the order that the
+ * prefab's entities are added to the scene graph (depth-first, root first).
+ */
+struct PrefabTemplate
+{
+    std::vector<int32_t>        parents;        // -1 for the root
+    std::vector<uint32_t>       descendants;
+    std::vector<ACompTransform> transforms;     // Root's transform is replaced when spawned
+    std::vector<EShape>         shapes;
+
+    // Objects with mass, and their mass components
+    std::vector<uint32_t>       massObjs;
+    std::vector<ACompMass>      masses;
+
+    // Objects that have colliders, or have descendants with colliders
+    std::vector<uint32_t>       colliderObjs;
+
+    // Objects with meshes, and their mesh and base color texture resources. Null if no texture.
+    // Objects with blended materials are drawn as transparent.
+    std::vector<uint32_t>       meshObjs;
+    std::vector<ResId>          meshes;
+    std::vector<ResId>          diffuseTex;
+    std::vector<bool>           transparent;
+
+    // Simpler LOD meshes of each mesh, most detailed first. Those of meshes[j] are from
+    // meshLodsOffset[j] to meshLodsOffset[j + 1].
+    std::vector<ResId>          meshLods;
+    std::vector<uint32_t>       meshLodsOffset;
+
+    // Objects that have meshes, or have descendants with meshes
+    std::vector<uint32_t>       drawTfObjs;
+};
+
 struct PrefabInstanceInfo
 {
     ResId       importer    { lgrn::id_null<ResId>() };
@@ -66,39 +103,80 @@ struct ACtxPrefabs
     std::vector< ArrayView<ActiveEnt const> >   spawnedEntsOffset;
     std::vector<ActiveEnt>                      newEnts;
 
+    // Index into templates for each spawnRequest, set by create_activeents
+    std::vector<uint32_t>                       spawnTemplate;
+
     osp::active::ActiveEntSet_t                 roots;
     KeyedVec<ActiveEnt, PrefabInstanceInfo>     instanceInfo;
+
+    // Compiled on first spawn. Keyed by importer ResId in the upper 32 bits, and PrefabId in the
+    // lower. Importers are owned while they have templates, so their ResIds can't be reused by
+    // another importer underneath the cache. See SysPrefabInit::clear_templates
+    std::vector<PrefabTemplate>                 templates;
+    IdMap_t<uint64_t, uint32_t>                 templateIds;
+    IdMap_t<ResId, ResIdOwner_t>                templateImporters;
 };
 
 class SysPrefabInit
 {
 public:
 
+    /**
+     * @brief Get the template of a prefab, compiling it if this is the first time it's used
+     *
+     * @return Index into ACtxPrefabs::templates
+     */
+    static uint32_t get_template(
+            ACtxPrefabs&                rPrefabs,
+            Resources&                  rResources,
+            ResId                       importer,
+            PrefabId                    prefab);
+
+    /**
+     * @brief Discard all templates and release their importers
+     *
+     * Call this before an importer's data is reloaded, and before the Resources are destroyed.
+     * Template indices in spawnTemplate become invalid, so no spawns can be in progress.
+     *
+     * @param rPrefabs      [ref] Prefabs to clear templates of
+     * @param rResources    [ref] Application Resources
+     */
+    static void clear_templates(
+            ACtxPrefabs&                rPrefabs,
+            Resources&                  rResources) noexcept;
+
+    /**
+     * @brief Create entities for all spawn requests, and assign each request its template
+     *
+     * Other init functions only read from templates, and don't access Resources.
+     */
     static void create_activeents(
             ACtxPrefabs&                rPrefabs,
             ACtxBasic&                  rBasic,
             Resources&                  rResources);
 
     static void add_to_subtree(
-            TmpPrefabRequest const&     basic,
+            PrefabTemplate const&       tmpl,
             ArrayView<ActiveEnt const>  ents,
-            Resources const&            rResources,
             SubtreeBuilder&             rSubtree) noexcept;
 
     static void init_transforms(
             ACtxPrefabs const&          rPrefabs,
-            Resources const&            rResources,
             ACompTransformStorage_t&    rTransform) noexcept;
 
     static void init_info(
-            ACtxPrefabs&                rPrefabs,
-            Resources const&            rResources) noexcept;
+            ACtxPrefabs&                rPrefabs) noexcept;
 
     static void init_physics(
             ACtxPrefabs const&          rPrefabs,
-            Resources const&            rResources,
             ACtxPhysics&                rCtxPhys) noexcept;
 
+private:
+
+    static PrefabTemplate compile_template(
+            Resources const&            rResources,
+            ResId                       importer,
+            PrefabId                    prefab);
 };
 
 
@@ -0,0 +1,68 @@
+/**
+ * Open Space Program
+ * Copyright © 2019-2020 Open Space Program Project
+ *
+ * MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#pragma once
+
+#include "math_types.h"
+
+#include <array>
+
+namespace osp::math
+{
+
+/**
+ * @brief Six planes bounding a view volume, such as from a camera
+ *
+ * Each plane is stored as (normal, distance), with normals pointing inwards. A point p is inside
+ * a plane if dot(normal, p) + distance >= 0.
+ */
+struct Frustum
+{
+    std::array<Vector4, 6> m_planes;
+};
+
+/**
+ * @brief Get the planes of a view volume from a combined projection and camera matrix
+ *
+ * @param viewProj  [in] Projection matrix times inverted camera matrix
+ */
+inline Frustum frustum_from_matrix(Matrix4 const& viewProj) noexcept
+{
+    Vector4 const row0 = viewProj.row(0);
+    Vector4 const row1 = viewProj.row(1);
+    Vector4 const row2 = viewProj.row(2);
+    Vector4 const row3 = viewProj.row(3);
+
+    Frustum out{{ row3 + row0, row3 - row0,     // left, right
+                  row3 + row1, row3 - row1,     // bottom, top
+                  row3 + row2, row3 - row2 }};  // near, far
+
+    for (Vector4 &rPlane : out.m_planes)
+    {
+        rPlane /= rPlane.xyz().length();
+    }
+    return out;
+}
+
+} // namespace osp::math
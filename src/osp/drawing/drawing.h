@@ -43,6 +43,8 @@
 #include <longeron/id_management/registry_stl.hpp>
 #include <longeron/id_management/id_set_stl.hpp>
 
+#include <vector>
+
 namespace osp::draw
 {
 
@@ -70,6 +72,37 @@ enum class MeshId : uint32_t { };
 enum class TexId : uint32_t { };
 
 
+/**
+ * @brief Bounding sphere of a mesh, relative to the mesh's own origin
+ *
+ * Negative radius if bounds aren't known, such as for meshes not made from a resource. These are
+ * never culled.
+ */
+struct MeshBounds
+{
+    Vector3 m_center;
+    float   m_radius{-1.0f};
+};
+
+/**
+ * @brief Simpler versions of a mesh to draw instead when it appears small on screen
+ *
+ * Screen size is the diameter of a mesh's bounding sphere as a fraction of the viewport's height,
+ * measured with the camera's vertical field of view.
+ * m_levels[i] is drawn once the screen size drops below its m_maxScreenSize, which must decrease
+ * from one level to the next.
+ */
+struct MeshLodChain
+{
+    struct Level
+    {
+        MeshId  m_mesh;
+        float   m_maxScreenSize;
+    };
+
+    std::vector<Level> m_levels;
+};
+
 using MeshRefCount_t    = lgrn::IdRefCount<MeshId>;
 using MeshIdOwner_t     = MeshRefCount_t::Owner_t;
 
@@ -84,6 +117,11 @@ struct ACtxDrawing
     // Scene-space Meshes
     lgrn::IdRegistryStl<MeshId>             m_meshIds;
     MeshRefCount_t                          m_meshRefCounts;
+    KeyedVec<MeshId, MeshBounds>            m_meshBounds;
+
+    // LODs of meshes that have them, keyed by the full-detail mesh. LODs of resource meshes are
+    // refcounted through ACtxDrawingRes::m_meshLodOwners.
+    IdMap_t<MeshId, MeshLodChain>           m_meshLods;
 
     // Scene-space Textures
     lgrn::IdRegistryStl<TexId>              m_texIds;
@@ -108,6 +146,17 @@ struct ACtxDrawingRes
     // Associate Mesh Ids with resources
     IdMap_t<ResId, MeshId>                  m_resToMesh;
     IdMap_t<MeshId, ResIdOwner_t>           m_meshToRes;
+
+    // References to the LOD meshes of resource meshes, keyed by the full-detail mesh. These are
+    // released along with the full-detail mesh in SysRender::release_mesh_resource.
+    IdMap_t<MeshId, std::vector<MeshIdOwner_t>> m_meshLodOwners;
+
+    // Resources that were associated or dissociated since these were last cleared, so renderers
+    // only need to look at what changed
+    std::vector<ResId>                      m_texNew;
+    std::vector<ResId>                      m_texRemoved;
+    std::vector<ResId>                      m_meshNew;
+    std::vector<ResId>                      m_meshRemoved;
 };
 
 using DrawEntColors_t = KeyedVec<DrawEnt, Magnum::Color4>;
@@ -126,11 +175,14 @@ struct ACtxSceneRender
         m_opaque.resize(size);
         m_transparent.resize(size);
         m_visible.resize(size);
+        m_onScreen.resize(size);
 
         m_drawTransform .resize(size);
         m_color         .resize(size, {1.0f, 1.0f, 1.0f, 1.0f}); // Default white
         m_diffuseTex    .resize(size);
         m_mesh          .resize(size);
+        m_meshLod       .resize(size, lgrn::id_null<MeshId>());
+        m_lodLevel      .resize(size, 0);
 
         for (MaterialId matId : m_materialIds)
         {
@@ -141,6 +193,7 @@ struct ACtxSceneRender
     void resize_active(std::size_t const size)
     {
         m_needDrawTf.resize(size);
+        m_drawTfGen         .resize(size, active::gc_transformGenUnseen);
         m_activeToDraw      .resize(size, lgrn::id_null<DrawEnt>());
         drawTfObserverEnable.resize(size, 0);
     }
@@ -152,9 +205,15 @@ struct ACtxSceneRender
     DrawEntSet_t                            m_visible;
     DrawEntColors_t                         m_color;
 
+    // DrawEnts in m_visible that passed frustum culling, see SysRender::cull_frustum
+    DrawEntSet_t                            m_onScreen;
+
     active::ActiveEntSet_t                  m_needDrawTf;
     KeyedVec<active::ActiveEnt, DrawEnt>    m_activeToDraw;
 
+    // Transform generations that m_drawTransform was last calculated from
+    active::TransformGenerations            m_drawTfGen;
+
     KeyedVec<active::ActiveEnt, uint16_t>   drawTfObserverEnable;
     DrawTransforms_t                        m_drawTransform;
 
@@ -165,6 +224,10 @@ struct ACtxSceneRender
     KeyedVec<DrawEnt, MeshIdOwner_t>        m_mesh;
     DrawEntVec_t                            m_meshDirty;
 
+    // LOD mesh to draw instead of m_mesh, null for full detail. See SysRender::select_lods
+    KeyedVec<DrawEnt, MeshId>               m_meshLod;
+    KeyedVec<DrawEnt, uint8_t>              m_lodLevel;
+
     lgrn::IdRegistryStl<MaterialId>         m_materialIds;
     KeyedVec<MaterialId, Material>          m_materials;
 };
@@ -25,12 +25,59 @@
 #include "drawing_fn.h"
 #include "own_restypes.h"
 
+#include "../core/math_frustum.h"
 #include "../core/Resources.h"
 
+#include <Corrade/Containers/Array.h>
+#include <Magnum/Math/Functions.h>
+#include <Magnum/Trade/MeshData.h>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <limits>
+
 using namespace osp;
 using namespace osp::active;
 using namespace osp::draw;
 
+namespace
+{
+
+MeshBounds calc_mesh_bounds(Magnum::Trade::MeshData const& meshData)
+{
+    if ( ! meshData.hasAttribute(Magnum::Trade::MeshAttribute::Position) )
+    {
+        return {};
+    }
+
+    Corrade::Containers::Array<Vector3> const positions = meshData.positions3DAsArray();
+    if (positions.isEmpty())
+    {
+        return {};
+    }
+
+    // Center of the bounding box is close enough to the smallest sphere for culling
+    Vector3 min = positions[0];
+    Vector3 max = positions[0];
+    for (Vector3 const& pos : positions)
+    {
+        min = Magnum::Math::min(min, pos);
+        max = Magnum::Math::max(max, pos);
+    }
+
+    Vector3 const center = (min + max) * 0.5f;
+    float radiusSq = 0.0f;
+    for (Vector3 const& pos : positions)
+    {
+        radiusSq = std::max(radiusSq, (pos - center).dot());
+    }
+
+    return {center, std::sqrt(radiusSq)};
+}
+
+} // namespace
+
 MeshId SysRender::own_mesh_resource(ACtxDrawing& rCtxDrawing, ACtxDrawingRes& rCtxDrawingRes, Resources &rResources, ResId const resId)
 {
     auto const& [it, success] = rCtxDrawingRes.m_resToMesh.try_emplace(resId);
@@ -39,7 +86,20 @@ MeshId SysRender::own_mesh_resource(ACtxDrawing& rCtxDrawing, ACtxDrawingRes& rC
         ResIdOwner_t owner = rResources.owner_create(restypes::gc_mesh, resId);
         MeshId const meshId = rCtxDrawing.m_meshIds.create();
         rCtxDrawingRes.m_meshToRes.emplace(meshId, std::move(owner));
+        rCtxDrawingRes.m_meshNew.push_back(resId);
         it->second = meshId;
+
+        rCtxDrawing.m_meshBounds.resize(rCtxDrawing.m_meshIds.capacity());
+        if (auto const *pMeshData = rResources.data_try_get<Magnum::Trade::MeshData>(restypes::gc_mesh, resId);
+            pMeshData != nullptr)
+        {
+            rCtxDrawing.m_meshBounds[meshId] = calc_mesh_bounds(*pMeshData);
+        }
+        else
+        {
+            // MeshIds are reused, don't keep bounds from a previous mesh
+            rCtxDrawing.m_meshBounds[meshId] = MeshBounds{};
+        }
         return meshId;
     }
     return it->second;
@@ -50,15 +110,76 @@ TexId SysRender::own_texture_resource(ACtxDrawing& rCtxDrawing, ACtxDrawingRes&
     auto const& [it, success] = rCtxDrawingRes.m_resToTex.try_emplace(resId);
     if (success)
     {
-        ResIdOwner_t owner = rResources.owner_create(restypes::gc_mesh, resId);
+        ResIdOwner_t owner = rResources.owner_create(restypes::gc_texture, resId);
         TexId const texId = rCtxDrawing.m_texIds.create();
         rCtxDrawingRes.m_texToRes.emplace(texId, std::move(owner));
+        rCtxDrawingRes.m_texNew.push_back(resId);
         it->second = texId;
         return texId;
     }
     return it->second;
 };
 
+bool SysRender::release_mesh_resource(ACtxDrawing& rCtxDrawing, ACtxDrawingRes& rCtxDrawingRes, Resources &rResources, MeshId const meshId)
+{
+    auto const it = rCtxDrawingRes.m_meshToRes.find(meshId);
+    if (it == rCtxDrawingRes.m_meshToRes.end())
+    {
+        return false;
+    }
+
+    ResId const resId = it->second.value();
+    rResources.owner_destroy(restypes::gc_mesh, std::move(it->second));
+    rCtxDrawingRes.m_meshToRes.erase(it);
+    rCtxDrawingRes.m_resToMesh.erase(resId);
+    rCtxDrawingRes.m_meshRemoved.push_back(resId);
+
+    rCtxDrawing.m_meshLods.erase(meshId);
+    if (std::size_t(meshId) < rCtxDrawing.m_meshBounds.size())
+    {
+        rCtxDrawing.m_meshBounds[meshId] = MeshBounds{};
+    }
+    rCtxDrawing.m_meshIds.remove(meshId);
+
+    // Release LODs after this mesh's own entries are gone, as the map may rehash while releasing
+    if (auto lodIt = rCtxDrawingRes.m_meshLodOwners.find(meshId);
+        lodIt != rCtxDrawingRes.m_meshLodOwners.end())
+    {
+        std::vector<MeshIdOwner_t> lodOwners = std::move(lodIt->second);
+        rCtxDrawingRes.m_meshLodOwners.erase(lodIt);
+
+        for (MeshIdOwner_t &rOwner : lodOwners)
+        {
+            MeshId const lod = rOwner.value();
+            rCtxDrawing.m_meshRefCounts.ref_release(std::move(rOwner));
+            if (rCtxDrawing.m_meshRefCounts[std::size_t(lod)] == 0)
+            {
+                release_mesh_resource(rCtxDrawing, rCtxDrawingRes, rResources, lod);
+            }
+        }
+    }
+    return true;
+}
+
+bool SysRender::release_texture_resource(ACtxDrawing& rCtxDrawing, ACtxDrawingRes& rCtxDrawingRes, Resources &rResources, TexId const texId)
+{
+    auto const it = rCtxDrawingRes.m_texToRes.find(texId);
+    if (it == rCtxDrawingRes.m_texToRes.end())
+    {
+        return false;
+    }
+
+    ResId const resId = it->second.value();
+    rResources.owner_destroy(restypes::gc_texture, std::move(it->second));
+    rCtxDrawingRes.m_texToRes.erase(it);
+    rCtxDrawingRes.m_resToTex.erase(resId);
+    rCtxDrawingRes.m_texRemoved.push_back(resId);
+
+    rCtxDrawing.m_texIds.remove(texId);
+    return true;
+}
+
+
 void SysRender::clear_owners(ACtxSceneRender& rCtxScnRdr, ACtxDrawing& rCtxDrawing)
 {
     for (TexIdOwner_t &rOwner : std::exchange(rCtxScnRdr.m_diffuseTex, {}))
@@ -78,16 +199,26 @@ void SysRender::clear_owners(ACtxSceneRender& rCtxScnRdr, ACtxDrawing& rCtxDrawi
     }
 }
 
-void SysRender::clear_resource_owners(ACtxDrawingRes& rCtxDrawingRes, Resources &rResources)
+void SysRender::clear_resource_owners(ACtxDrawing& rCtxDrawing, ACtxDrawingRes& rCtxDrawingRes, Resources &rResources)
 {
+    for ([[maybe_unused]] auto && [_, rOwners] : std::exchange(rCtxDrawingRes.m_meshLodOwners, {}))
+    {
+        for (MeshIdOwner_t &rOwner : rOwners)
+        {
+            rCtxDrawing.m_meshRefCounts.ref_release(std::move(rOwner));
+        }
+    }
+
     for ([[maybe_unused]] auto && [_, rOwner] : std::exchange(rCtxDrawingRes.m_texToRes, {}))
     {
+        rCtxDrawingRes.m_texRemoved.push_back(rOwner.value());
         rResources.owner_destroy(restypes::gc_texture, std::move(rOwner));
     }
     rCtxDrawingRes.m_resToTex.clear();
 
     for ([[maybe_unused]] auto && [_, rOwner] : std::exchange(rCtxDrawingRes.m_meshToRes, {}))
     {
+        rCtxDrawingRes.m_meshRemoved.push_back(rOwner.value());
         rResources.owner_destroy(restypes::gc_mesh, std::move(rOwner));
     }
     rCtxDrawingRes.m_resToMesh.clear();
@@ -101,4 +232,206 @@ MeshIdOwner_t SysRender::add_drawable_mesh(ACtxDrawing& rDrawing, ACtxDrawingRes
     return rDrawing.m_meshRefCounts.ref_add(meshId);
 }
 
+void SysRender::cull_frustum(
+        ACtxSceneRender&    rScnRender,
+        ACtxDrawing const&  drawing,
+        Matrix4 const&      viewProj,
+        std::size_t const   first,
+        std::size_t const   last) noexcept
+{
+    constexpr float     inf         = std::numeric_limits<float>::infinity();
+    constexpr std::size_t batchSize = 64;
+
+    math::Frustum const frustum = math::frustum_from_matrix(viewProj);
+
+    // Spheres are gathered into separate arrays per component, so the plane tests below are
+    // simple loops over floats that the compiler can vectorize
+    std::array<float, batchSize>    centerX;
+    std::array<float, batchSize>    centerY;
+    std::array<float, batchSize>    centerZ;
+    std::array<float, batchSize>    radius;
+    std::array<uint8_t, batchSize>  inside;
+
+    for (std::size_t batch = first; batch < last; batch += batchSize)
+    {
+        std::size_t const count = std::min(batchSize, last - batch);
+
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            DrawEnt const drawEnt = DrawEnt::from_index(batch + i);
+
+            MeshBounds bounds;
+            if (MeshIdOwner_t const &rMesh = rScnRender.m_mesh[drawEnt];
+                rMesh.has_value() && std::size_t(rMesh.value()) < drawing.m_meshBounds.size())
+            {
+                bounds = drawing.m_meshBounds[rMesh.value()];
+            }
+
+            Matrix4 const &drawTf   = rScnRender.m_drawTransform[drawEnt];
+            Vector3 const center    = drawTf.transformPoint(bounds.m_center);
+            float const maxScaleSq  = std::max({drawTf[0].xyz().dot(), drawTf[1].xyz().dot(), drawTf[2].xyz().dot()});
+
+            centerX[i]  = center.x();
+            centerY[i]  = center.y();
+            centerZ[i]  = center.z();
+            radius[i]   = (bounds.m_radius < 0.0f) ? inf : bounds.m_radius * std::sqrt(maxScaleSq);
+            inside[i]   = 1;
+        }
+
+        for (Vector4 const& plane : frustum.m_planes)
+        {
+            for (std::size_t i = 0; i < count; ++i)
+            {
+                float const dist = plane.x() * centerX[i] + plane.y() * centerY[i] + plane.z() * centerZ[i] + plane.w();
+                inside[i] &= uint8_t(dist >= -radius[i]);
+            }
+        }
+
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            DrawEnt const drawEnt = DrawEnt::from_index(batch + i);
+            if (inside[i] != 0 && rScnRender.m_visible.contains(drawEnt))
+            {
+                rScnRender.m_onScreen.insert(drawEnt);
+            }
+            else
+            {
+                rScnRender.m_onScreen.erase(drawEnt);
+            }
+        }
+    }
+}
+
+void SysRender::set_mesh_lods(
+        ACtxDrawing&                    rDrawing,
+        MeshId const                    base,
+        ArrayView<MeshId const> const   lods,
+        float const                     firstScreenSize)
+{
+    if (lods.isEmpty())
+    {
+        rDrawing.m_meshLods.erase(base);
+        return;
+    }
+
+    MeshLodChain &rChain = rDrawing.m_meshLods[base];
+    rChain.m_levels.clear();
+    rChain.m_levels.reserve(lods.size());
+
+    float screenSize = firstScreenSize;
+    for (MeshId const lod : lods)
+    {
+        rChain.m_levels.push_back({lod, screenSize});
+        screenSize *= 0.5f;
+    }
+}
 
+void SysRender::own_mesh_lods(
+        ACtxDrawing&                rDrawing,
+        ACtxDrawingRes&             rDrawingRes,
+        Resources&                  rResources,
+        MeshId const                base,
+        ArrayView<ResId const>      lodRes)
+{
+    if (lodRes.isEmpty() || rDrawing.m_meshLods.contains(base))
+    {
+        return;
+    }
+
+    std::vector<MeshId> lods;
+    lods.reserve(lodRes.size());
+    std::vector<MeshIdOwner_t> &rLodOwners = rDrawingRes.m_meshLodOwners[base];
+    for (ResId const res : lodRes)
+    {
+        MeshId const lod = own_mesh_resource(rDrawing, rDrawingRes, rResources, res);
+        lods.push_back(lod);
+        rLodOwners.push_back(rDrawing.m_meshRefCounts.ref_add(lod));
+    }
+
+    set_mesh_lods(rDrawing, base, {lods.data(), lods.size()});
+}
+
+void SysRender::select_lods(
+        ACtxSceneRender&    rScnRender,
+        ACtxDrawing const&  drawing,
+        Camera const&       camera,
+        float const         hysteresis,
+        std::size_t const   first,
+        std::size_t const   last) noexcept
+{
+    if (drawing.m_meshLods.empty())
+    {
+        return;
+    }
+
+    // Camera::m_fov is horizontal, as used by Matrix4::perspectiveProjection. Convert to
+    // vertical, which MeshLodChain screen sizes are relative to.
+    Vector3 const   camPos      = camera.m_transform.translation();
+    float const     tanHalfFov  = std::tan(0.5f * Magnum::Rad{camera.m_fov}.value()) / camera.m_aspectRatio;
+
+    for (std::size_t i = first; i < last; ++i)
+    {
+        DrawEnt const drawEnt = DrawEnt::from_index(i);
+
+        MeshIdOwner_t const &rMesh = rScnRender.m_mesh[drawEnt];
+        if ( ! rScnRender.m_visible.contains(drawEnt) || ! rMesh.has_value() )
+        {
+            continue;
+        }
+
+        MeshId const    meshId  = rMesh.value();
+        uint8_t         level   = 0;
+        MeshId          lodMesh = lgrn::id_null<MeshId>();
+
+        if (auto const foundIt = drawing.m_meshLods.find(meshId);
+            foundIt != drawing.m_meshLods.end() && std::size_t(meshId) < drawing.m_meshBounds.size())
+        {
+            auto const          &levels = foundIt->second.m_levels;
+            MeshBounds const    &bounds = drawing.m_meshBounds[meshId];
+            Matrix4 const       &drawTf = rScnRender.m_drawTransform[drawEnt];
+
+            float const maxScaleSq  = std::max({drawTf[0].xyz().dot(), drawTf[1].xyz().dot(), drawTf[2].xyz().dot()});
+            float const radius      = bounds.m_radius * std::sqrt(maxScaleSq);
+            float const distance    = (drawTf.transformPoint(bounds.m_center) - camPos).length();
+
+            // Meshes without known bounds, or that the camera is inside of, stay at full detail
+            if (bounds.m_radius >= 0.0f && distance > radius)
+            {
+                float const screenSize = radius / (distance * tanHalfFov);
+
+                level = std::min<uint8_t>(rScnRender.m_lodLevel[drawEnt], uint8_t(levels.size()));
+
+                while (level < levels.size() && screenSize < levels[level].m_maxScreenSize * (1.0f - hysteresis))
+                {
+                    ++level;
+                }
+                while (level > 0 && screenSize > levels[level - 1].m_maxScreenSize * (1.0f + hysteresis))
+                {
+                    --level;
+                }
+
+                lodMesh = (level == 0) ? lgrn::id_null<MeshId>() : levels[level - 1].m_mesh;
+            }
+        }
+
+        rScnRender.m_lodLevel[drawEnt] = level;
+
+        if (rScnRender.m_meshLod[drawEnt] != lodMesh)
+        {
+            rScnRender.m_meshLod[drawEnt] = lodMesh;
+            rScnRender.m_meshDirty.push_back(drawEnt);
+        }
+    }
+}
+
+void SysRender::translate_draw_transforms(
+        DrawTransforms_t&   rDrawTf,
+        Vector3 const       translate,
+        std::size_t const   first,
+        std::size_t const   last) noexcept
+{
+    for (std::size_t i = first; i < last; ++i)
+    {
+        rDrawTf[DrawEnt::from_index(i)].translation() += translate;
+    }
+}
@@ -29,6 +29,10 @@
 #include "../activescene/basic.h"
 #include "../activescene/basic_fn.h"
 
+#include <cassert>
+#include <type_traits>
+#include <vector>
+
 namespace osp::draw
 {
 
@@ -42,7 +46,8 @@ namespace osp::draw
  * Draw transforms can be calculated by SysRender::update_draw_transforms, or potentially by a
  * future system that takes physics engine interpolation or animations into account.
  * DrawTfObservers provides a way to tap into this procedure to call custom functions for other
- * systems.
+ * systems. Observers are only called for draw transforms that changed; use
+ * SysRender::needs_draw_transforms to have one called again.
  *
  * To use, write into DrawTfObservers::observers[i]
  * Enable per-DrawEnt by setting ACtxSceneRender::drawTfObserverEnable[drawEnt] bit [i]
@@ -78,6 +83,17 @@ struct ViewProjMatrix
     Matrix4 m_proj;
 };
 
+/**
+ * @brief Matrices of a DrawEnt precomputed for a single pass, so draw functions don't need to
+ *        do any math before issuing GL commands
+ */
+struct DrawPacket
+{
+    Matrix4             m_viewTf;       // view * draw transform
+    Matrix4             m_viewProjTf;   // proj * view * draw transform
+    Magnum::Matrix3x3   m_normal;       // m_viewTf.normalMatrix()
+};
+
 /**
  * @brief Stores a draw function and user data needed to draw a single entity
  */
@@ -95,11 +111,37 @@ struct EntityToDraw
     using ShaderDrawFnc_t = void (*)(
             DrawEnt, ViewProjMatrix const&, UserData_t) noexcept;
 
+    /**
+     * @brief A function pointer to draw many entities at once, such as with instancing
+     *
+     * @param ArrayView         [in] Entities to draw, all with the same draw and data
+     * @param ArrayView         [in] Precomputed packets parallel to the entities, or empty
+     * @param ViewProjMatrix    [in] View and projection matrix
+     * @param UserData_t        [in] Non-owning user data
+     */
+    using ShaderDrawBatchFnc_t = void (*)(
+            ArrayView<DrawEnt const>, ArrayView<DrawPacket const>, ViewProjMatrix const&, UserData_t) noexcept;
+
+    /**
+     * @brief A function pointer to set up a shader once per pass, before any of its entities
+     *        are drawn. Used for uniforms that are constant over a frame, such as lights.
+     *
+     * @param ViewProjMatrix    [in] View and projection matrix
+     * @param UserData_t        [in] Non-owning user data
+     */
+    using ShaderSetupFnc_t = void (*)(ViewProjMatrix const&, UserData_t) noexcept;
+
     ShaderDrawFnc_t draw;
 
     // Non-owning user data passed to draw function, such as the shader
     UserData_t data;
 
+    // Optional, entities are drawn one by one with draw if null. Used by SysRenderGL::draw_queue.
+    ShaderDrawBatchFnc_t drawBatch{nullptr};
+
+    // Optional, called once per pass for each distinct setup and data
+    ShaderSetupFnc_t setup{nullptr};
+
 }; // struct EntityToDraw
 
 /**
@@ -116,6 +158,9 @@ struct RenderGroup
 
     DrawEnts_t entities;
 
+    // Progress of reordering entities to match scene graph order
+    active::TreeOrderDefrag defrag;
+
 }; // struct RenderGroup
 
 class SysRender
@@ -149,6 +194,36 @@ public:
             Resources& rResources,
             ResId resId);
 
+    /**
+     * @brief Dissociate a scene mesh from its resource and delete its MeshId
+     *
+     * Only call once nothing refers to the mesh anymore. The resource is added to
+     * ACtxDrawingRes::m_meshRemoved so renderers can release their copies. LOD meshes in
+     * ACtxDrawingRes::m_meshLodOwners are released too, and are themselves released once nothing
+     * else refers to them.
+     *
+     * @return false if the mesh isn't associated with a resource
+     */
+    static bool release_mesh_resource(
+            ACtxDrawing& rCtxDrawing,
+            ACtxDrawingRes& rCtxDrawingRes,
+            Resources& rResources,
+            MeshId meshId);
+
+    /**
+     * @brief Dissociate a scene texture from its resource and delete its TexId
+     *
+     * Only call once nothing refers to the texture anymore. The resource is added to
+     * ACtxDrawingRes::m_texRemoved so renderers can release their copies.
+     *
+     * @return false if the texture isn't associated with a resource
+     */
+    static bool release_texture_resource(
+            ACtxDrawing& rCtxDrawing,
+            ACtxDrawingRes& rCtxDrawingRes,
+            Resources& rResources,
+            TexId texId);
+
     /**
      * @brief Remove all mesh and texture components, aware of refcounts
      */
@@ -157,27 +232,66 @@ public:
     /**
      * @brief Dissociate resources from the scene's meshes and textures
      *
+     * All of them are added to the removed lists.
+     *
+     * @param rCtxDrawing       [ref] Drawing data, LOD mesh references are released
      * @param rCtxDrawingRes    [ref] Resource drawing data
      * @param rResources        [ref] Application Resources
      */
     static void clear_resource_owners(
+            ACtxDrawing&                            rCtxDrawing,
             ACtxDrawingRes&                         rCtxDrawingRes,
             Resources&                              rResources);
 
+    /**
+     * @brief Make an entity and its ancestors need draw transforms, and recalculate them next update
+     *
+     * @param scnGraph      [in] Scene graph
+     * @param rNeedDrawTf   [ref] Entities that need draw transforms
+     * @param rDrawTfGen    [ref] Generations draw transforms were last calculated from, the
+     *                            entity's are reset so it is recalculated even if unchanged
+     * @param ent           [in] Entity to draw
+     */
     static inline void needs_draw_transforms(
             active::ACtxSceneGraph const&           scnGraph,
             active::ActiveEntSet_t&                 rNeedDrawTf,
+            active::TransformGenerations&           rDrawTfGen,
             active::ActiveEnt                       ent);
 
     struct ArgsForUpdDrawTransform
     {
         active::ACtxSceneGraph const&               scnGraph;
         active::ACompTransformStorage_t const&      transforms;
+        active::TransformGenerations const&         transformGen;
         KeyedVec<active::ActiveEnt, DrawEnt> const& activeToDraw;
         active::ActiveEntSet_t const&               needDrawTf;
+        active::TransformGenerations&               rDrawTfGen;
         DrawTransforms_t&                           rDrawTf;
     };
 
+    /**
+     * @brief Stack of parent matrices for update_draw_transforms_range
+     *
+     * Keep one around and pass it to every call, so calls don't allocate once it has grown as
+     * deep as the scene graph.
+     */
+    struct DrawTfParent
+    {
+        Matrix4             drawTf;
+        active::TreePos_t   subtreeLast;
+        bool                changed;
+    };
+    using DrawTfStack_t = std::vector<DrawTfParent>;
+
+    /**
+     * @brief Calculate draw transforms of root entities and their descendants
+     *
+     * @param args      [ref] Scene graph, transforms, and draw transforms to write
+     * @param first     [in] Iterator to first root entity to update
+     * @param last      [in] Iterator to one past the last root entity
+     * @param func      [in] Called for each draw transform calculated, with depth starting at 1
+     *                       for roots
+     */
     template<typename IT_T, typename ITB_T, typename FUNC_T = UpdDrawTransformNoOp>
     static void update_draw_transforms(
             ArgsForUpdDrawTransform     args,
@@ -185,39 +299,185 @@ public:
             ITB_T const&                last,
             FUNC_T                      func = {});
 
+    /**
+     * @brief Calculate draw transforms of a range of whole root subtrees, by tree position
+     *
+     * ACtxSceneGraph is stored in pre-order, so this is a single forward pass over the range,
+     * keeping a stack of parent matrices instead of recursing. Subtrees of entities not in
+     * needDrawTf are skipped over entirely, and so are subtrees whose generation in transformGen
+     * matches rDrawTfGen. Only entities whose own transform or an ancestor's changed are written
+     * and passed to func; the rest of the path down to them is only multiplied through.
+     *
+     * @param args      [ref] Scene graph, transforms, and draw transforms to write
+     * @param rStack    [ref] Scratch space, empty before and after
+     * @param first     [in] Tree position of the first root, must not be within another subtree
+     * @param last      [in] One past the last tree position, must be the end of a subtree
+     * @param func      [in] Called for each draw transform calculated, with depth starting at 1
+     *                       for roots
+     */
+    template<typename FUNC_T = UpdDrawTransformNoOp>
+    static void update_draw_transforms_range(
+            ArgsForUpdDrawTransform     args,
+            DrawTfStack_t&              rStack,
+            active::TreePos_t           first,
+            active::TreePos_t           last,
+            FUNC_T                      func = {});
+
+    /**
+     * @brief Translate a range of draw transforms, such as after a floating origin shift
+     *
+     * @param rDrawTf   [ref] Draw transforms to modify
+     * @param translate [in] Translation to add
+     * @param first     [in] First DrawEnt index to translate
+     * @param last      [in] One past the last DrawEnt index to translate
+     */
+    static void translate_draw_transforms(
+            DrawTransforms_t&           rDrawTf,
+            Vector3                     translate,
+            std::size_t                 first,
+            std::size_t                 last) noexcept;
+
+    /**
+     * @brief Write which DrawEnts in m_visible are within view into m_onScreen, for a range of
+     *        DrawEnts
+     *
+     * Each DrawEnt is tested as a bounding sphere, from its mesh's MeshBounds and draw transform.
+     * DrawEnts without known bounds always pass.
+     *
+     * @param rScnRender    [ref] Scene render, m_onScreen is written
+     * @param drawing       [in] Mesh bounds
+     * @param viewProj      [in] Projection matrix times inverted camera matrix
+     * @param first         [in] First DrawEnt index to cull
+     * @param last          [in] One past the last DrawEnt index to cull
+     */
+    static void cull_frustum(
+            ACtxSceneRender&            rScnRender,
+            ACtxDrawing const&          drawing,
+            Matrix4 const&              viewProj,
+            std::size_t                 first,
+            std::size_t                 last) noexcept;
+
+    /**
+     * @brief Set the LODs of a mesh, replacing any it had before
+     *
+     * Each LOD is used below half the screen size of the one before it.
+     *
+     * @param rDrawing          [ref] Drawing data
+     * @param base              [in] Full-detail mesh
+     * @param lods              [in] Simpler meshes, most detailed first. Empty to remove LODs.
+     * @param firstScreenSize   [in] Screen size below which lods[0] is used
+     */
+    static void set_mesh_lods(
+            ACtxDrawing&                rDrawing,
+            MeshId                      base,
+            ArrayView<MeshId const>     lods,
+            float                       firstScreenSize = 0.5f);
+
+    /**
+     * @brief Own the LOD meshes of a resource mesh and set them as its LODs, if it has none yet
+     *
+     * The LODs are referenced through ACtxDrawingRes::m_meshLodOwners, so they're released along
+     * with the base mesh by release_mesh_resource.
+     *
+     * @param rDrawing          [ref] Drawing data
+     * @param rDrawingRes       [ref] Resource drawing data
+     * @param rResources        [ref] Application Resources
+     * @param base              [in] Full-detail mesh, owned from a resource
+     * @param lodRes            [in] Mesh resources of the LODs, most detailed first
+     */
+    static void own_mesh_lods(
+            ACtxDrawing&                rDrawing,
+            ACtxDrawingRes&             rDrawingRes,
+            Resources&                  rResources,
+            MeshId                      base,
+            ArrayView<ResId const>      lodRes);
+
+    /**
+     * @brief Pick which LOD to draw for a range of DrawEnts, from their size on screen
+     *
+     * DrawEnts in m_visible whose mesh has a MeshLodChain are given a new m_meshLod, and pushed
+     * to m_meshDirty if it changed. A DrawEnt only switches to a coarser level once it's
+     * (1 - hysteresis) times smaller than the threshold, and back only once it's
+     * (1 + hysteresis) times larger, so LODs don't flicker back and forth near a threshold.
+     *
+     * @param rScnRender    [ref] Scene render, m_meshLod, m_lodLevel, and m_meshDirty are written
+     * @param drawing       [in] Mesh bounds and LODs
+     * @param camera        [in] Camera to measure screen size from
+     * @param hysteresis    [in] Fraction of a threshold to overshoot before switching levels
+     * @param first         [in] First DrawEnt index to select for
+     * @param last          [in] One past the last DrawEnt index to select for
+     */
+    static void select_lods(
+            ACtxSceneRender&            rScnRender,
+            ACtxDrawing const&          drawing,
+            Camera const&               camera,
+            float                       hysteresis,
+            std::size_t                 first,
+            std::size_t                 last) noexcept;
+
+    /**
+     * @brief Calculate the DrawPacket of a draw transform for a pass
+     */
+    static DrawPacket make_packet(Matrix4 const& drawTf, ViewProjMatrix const& viewProj) noexcept
+    {
+        Matrix4 const viewTf = viewProj.m_view * drawTf;
+        return { viewTf, viewProj.m_proj * viewTf, viewTf.normalMatrix() };
+    }
+
+    /**
+     * @brief Find the end of a run of consecutive DrawEnts that can be drawn together
+     *
+     * @param ents      [in] Entities to draw
+     * @param first     [in] Index of the run's first entity
+     * @param sameAs    [in] Callable (DrawEnt a, DrawEnt b) -> bool, true if b can be drawn along with a
+     *
+     * @return Index one past the run's last entity
+     */
+    template<typename SAME_T>
+    static std::size_t run_end(ArrayView<DrawEnt const> ents, std::size_t first, SAME_T&& sameAs) noexcept
+    {
+        std::size_t last = first + 1;
+        while (last < ents.size() && sameAs(ents[first], ents[last]))
+        {
+            ++last;
+        }
+        return last;
+    }
+
+    /**
+     * @brief Remove mesh and texture components of deleted DrawEnts
+     *
+     * Meshes and textures left without any references are dissociated from their resources,
+     * see release_mesh_resource and release_texture_resource.
+     */
     template<typename IT_T>
     static void update_delete_drawing(
-            ACtxSceneRender& rCtxScnRdr, ACtxDrawing& rCtxDrawing, IT_T const& first, IT_T const& last);
+            ACtxSceneRender&    rCtxScnRdr,
+            ACtxDrawing&        rCtxDrawing,
+            ACtxDrawingRes&     rCtxDrawingRes,
+            Resources&          rResources,
+            IT_T const&         first,
+            IT_T const&         last);
 
     static MeshIdOwner_t add_drawable_mesh(ACtxDrawing& rDrawing, ACtxDrawingRes& rDrawingRes, Resources& rResources, PkgId const pkg, std::string_view const name);
 
     static constexpr decltype(auto) gen_drawable_mesh_adder(ACtxDrawing& rDrawing, ACtxDrawingRes& rDrawingRes, Resources& rResources, PkgId const pkg);
 
-private:
-
-    template<typename FUNC_T>
-    static void update_draw_transforms_recurse(
-            ArgsForUpdDrawTransform     args,
-            active::ActiveEnt           ent,
-            Matrix4 const&              parentTf,
-            int                         depth,
-            FUNC_T&                     func);
-
 }; // class SysRender
 
 void SysRender::needs_draw_transforms(
         active::ACtxSceneGraph const&   scnGraph,
         active::ActiveEntSet_t&         rNeedDrawTf,
+        active::TransformGenerations&   rDrawTfGen,
         active::ActiveEnt               ent)
 {
-    rNeedDrawTf.insert(ent);
-
-    active::ActiveEnt const parentEnt = scnGraph.m_entParent[ent];
+    rDrawTfGen.m_transform[ent] = active::gc_transformGenUnseen;
 
-    if (   parentEnt != lgrn::id_null<active::ActiveEnt>()
-        && ! rNeedDrawTf.contains(parentEnt) )
+    // Ancestors that were already drawn would otherwise skip over this entity's subtree
+    for (active::ActiveEnt cur = ent; cur != lgrn::id_null<active::ActiveEnt>(); cur = scnGraph.m_entParent[cur])
     {
-        SysRender::needs_draw_transforms(scnGraph, rNeedDrawTf, parentEnt);
+        rNeedDrawTf.insert(cur);
+        rDrawTfGen.m_subtree[cur] = active::gc_transformGenUnseen;
     }
 }
 
@@ -228,73 +488,144 @@ void SysRender::update_draw_transforms(
         ITB_T const&                last,
         FUNC_T                      func)
 {
-    static constexpr Matrix4 const identity{};
+    DrawTfStack_t stack;
 
     while (first != last)
     {
         active::ActiveEnt const ent = *first;
+        active::TreePos_t const pos = args.scnGraph.m_entToTreePos[ent];
 
-        if (args.needDrawTf.contains(ent))
-        {
-            update_draw_transforms_recurse(args, ent, identity, true, func);
-        }
+        update_draw_transforms_range(args, stack, pos, pos + 1 + args.scnGraph.m_treeDescendants[pos], func);
 
         std::advance(first, 1);
     }
 }
 
 template<typename FUNC_T>
-void SysRender::update_draw_transforms_recurse(
+void SysRender::update_draw_transforms_range(
         ArgsForUpdDrawTransform     args,
-        active::ActiveEnt           ent,
-        Matrix4 const&              parentTf,
-        int                         depth,
-        FUNC_T&                     func)
+        DrawTfStack_t&              rStack,
+        active::TreePos_t const     first,
+        active::TreePos_t const     last,
+        FUNC_T                      func)
 {
     using namespace osp::active;
 
-    Matrix4 const& entTf        = args.transforms.get(ent).m_transform;
-    Matrix4 const& entDrawTf    = (depth == 0) ? (entTf) : (parentTf * entTf);
+    DrawTfStack_t &parents = rStack;
+    assert(parents.empty());
 
-    func(entDrawTf, ent, depth);
-
-    DrawEnt const drawEnt = args.activeToDraw[ent];
-    if (drawEnt != lgrn::id_null<DrawEnt>())
+    // Entities that were never marked with transform_changed are at generation 0
+    auto const gen_of = [] (KeyedVec<ActiveEnt, uint32_t> const& gens, ActiveEnt const ent) noexcept
     {
-        args.rDrawTf[drawEnt] = entDrawTf;
-    }
+        return (std::size_t(ent) < gens.size()) ? gens[ent] : uint32_t{0};
+    };
 
-    for (ActiveEnt entChild : SysSceneGraph::children(args.scnGraph, ent))
+    TreePos_t pos = first;
+    while (pos != last)
     {
-        if (args.needDrawTf.contains(entChild))
+        // Leave subtrees that ended
+        while ( ! parents.empty() && parents.back().subtreeLast == pos )
+        {
+            parents.pop_back();
+        }
+
+        ActiveEnt const ent           = args.scnGraph.m_treeToEnt[pos];
+        uint32_t const  descendants   = args.scnGraph.m_treeDescendants[pos];
+        bool const      parentChanged = ! parents.empty() && parents.back().changed;
+        uint32_t const  subtreeGen    = gen_of(args.transformGen.m_subtree, ent);
+
+        if (   ! args.needDrawTf.contains(ent)
+            || ( ! parentChanged && subtreeGen == args.rDrawTfGen.m_subtree[ent] ) )
+        {
+            pos += 1 + descendants;
+            continue;
+        }
+
+        uint32_t const  tfGen   = gen_of(args.transformGen.m_transform, ent);
+        bool const      changed = parentChanged || tfGen != args.rDrawTfGen.m_transform[ent];
+
+        args.rDrawTfGen.m_subtree[ent]   = subtreeGen;
+        args.rDrawTfGen.m_transform[ent] = tfGen;
+
+        Matrix4 const& entTf     = args.transforms.get(ent).m_transform;
+        Matrix4 const  entDrawTf = parents.empty() ? entTf : (parents.back().drawTf * entTf);
+
+        if (changed)
+        {
+            func(entDrawTf, ent, int(parents.size()) + 1);
+
+            DrawEnt const drawEnt = args.activeToDraw[ent];
+            if (drawEnt != lgrn::id_null<DrawEnt>())
+            {
+                args.rDrawTf[drawEnt] = entDrawTf;
+            }
+        }
+
+        if (descendants != 0)
         {
-            update_draw_transforms_recurse(args, entChild, entDrawTf, depth + 1, func);
+            parents.push_back({entDrawTf, pos + 1 + descendants, changed});
         }
+
+        ++pos;
     }
+
+    parents.clear();
 }
 
 
+/**
+ * @return Id that was released if nothing refers to it anymore, otherwise null
+ */
 template<typename STORAGE_T, typename REFCOUNT_T>
-void remove_refcounted(
+auto remove_refcounted(
         DrawEnt const ent, STORAGE_T &rStorage, REFCOUNT_T &rRefcount)
 {
     auto &rOwner = rStorage[ent];
+    using Id_t = std::decay_t<decltype(rOwner.value())>;
+
     if (rOwner.has_value())
     {
+        Id_t const id = rOwner.value();
         rRefcount.ref_release(std::move(rOwner));
+        if (rRefcount[std::size_t(id)] == 0)
+        {
+            return id;
+        }
     }
+    return lgrn::id_null<Id_t>();
 }
 
 template<typename IT_T>
 void SysRender::update_delete_drawing(
-        ACtxSceneRender& rCtxScnRdr, ACtxDrawing& rCtxDrawing, IT_T const& first, IT_T const& last)
+        ACtxSceneRender&    rCtxScnRdr,
+        ACtxDrawing&        rCtxDrawing,
+        ACtxDrawingRes&     rCtxDrawingRes,
+        Resources&          rResources,
+        IT_T const&         first,
+        IT_T const&         last)
 {
     for (auto it = first; it != last; std::advance(it, 1))
     {
         DrawEnt const drawEnt = *it;
 
-        remove_refcounted(drawEnt, rCtxScnRdr.m_diffuseTex, rCtxDrawing.m_texRefCounts);
-        remove_refcounted(drawEnt, rCtxScnRdr.m_mesh,       rCtxDrawing.m_meshRefCounts);
+        if (TexId const unusedTex = remove_refcounted(drawEnt, rCtxScnRdr.m_diffuseTex, rCtxDrawing.m_texRefCounts);
+            unusedTex != lgrn::id_null<TexId>())
+        {
+            release_texture_resource(rCtxDrawing, rCtxDrawingRes, rResources, unusedTex);
+        }
+
+        if (MeshId const unusedMesh = remove_refcounted(drawEnt, rCtxScnRdr.m_mesh, rCtxDrawing.m_meshRefCounts);
+            unusedMesh != lgrn::id_null<MeshId>())
+        {
+            release_mesh_resource(rCtxDrawing, rCtxDrawingRes, rResources, unusedMesh);
+        }
+
+        rCtxScnRdr.m_meshLod[drawEnt]   = lgrn::id_null<MeshId>();
+        rCtxScnRdr.m_lodLevel[drawEnt]  = 0;
+
+        // Reused DrawEnts may be drawn differently
+        rCtxScnRdr.m_opaque     .erase(drawEnt);
+        rCtxScnRdr.m_transparent.erase(drawEnt);
     }
 }
 
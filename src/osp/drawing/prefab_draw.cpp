@@ -39,34 +39,18 @@ using namespace osp::draw;
 using osp::restypes::gc_importer;
 
 void SysPrefabDraw::init_drawents(
-        ACtxPrefabs&                rPrefabs,
-        Resources&                  rResources,
-        ACtxBasic const&            rBasic,
-        ACtxDrawing&                rDrawing,
+        ACtxPrefabs const&          rPrefabs,
         ACtxSceneRender&            rScnRender)
 {
-    auto itPfEnts = rPrefabs.spawnedEntsOffset.begin();
-
-    for (TmpPrefabRequest const& request : rPrefabs.spawnRequest)
+    for (std::size_t i = 0; i < rPrefabs.spawnRequest.size(); ++i)
     {
-        auto const &rImportData = rResources.data_get<osp::ImporterData const>(gc_importer, request.m_importerRes);
-        auto const &rPrefabData = rResources.data_get<osp::Prefabs const>     (gc_importer, request.m_importerRes);
-        auto const objects      = rPrefabData.m_prefabs[request.m_prefabId];
-        auto const ents         = ArrayView<ActiveEnt const>{*itPfEnts};
+        PrefabTemplate const    &rTmpl  = rPrefabs.templates[rPrefabs.spawnTemplate[i]];
+        auto const              ents    = rPrefabs.spawnedEntsOffset[i];
 
-        for (std::size_t i = 0; i < objects.size(); ++i)
+        for (uint32_t const obj : rTmpl.meshObjs)
         {
-            int const meshImportId = rImportData.m_objMeshes[objects[i]];
-            if (meshImportId == -1)
-            {
-                continue;
-            }
-
-            ActiveEnt const ent = ents[i];
-            rScnRender.m_activeToDraw[ent] = rScnRender.m_drawIds.create();
+            rScnRender.m_activeToDraw[ents[obj]] = rScnRender.m_drawIds.create();
         }
-
-        ++itPfEnts;
     }
 }
 
@@ -93,7 +77,7 @@ void SysPrefabDraw::resync_drawents(
             PrefabInstanceInfo const &rInfo = rPrefabs.instanceInfo[ent];
 
             int const meshImportId = rImportData.m_objMeshes[objects[rInfo.obj]];
-            if (meshImportId == -1)
+            if (meshImportId == -1 || rImportData.m_meshIsLod[meshImportId])
             {
                 continue;
             }
@@ -113,68 +97,45 @@ void SysPrefabDraw::init_mesh_texture_material(
         ACtxSceneRender&            rScnRender,
         MaterialId                  material)
 {
-    auto itPfEnts = rPrefabs.spawnedEntsOffset.begin();
-
-    for (TmpPrefabRequest const& request : rPrefabs.spawnRequest)
+    for (std::size_t i = 0; i < rPrefabs.spawnRequest.size(); ++i)
     {
-        auto const &rImportData = rResources.data_get<osp::ImporterData const>(gc_importer, request.m_importerRes);
-        auto const &rPrefabData = rResources.data_get<osp::Prefabs const>     (gc_importer, request.m_importerRes);
-        auto const objects  = lgrn::Span<int const>{rPrefabData.m_prefabs[request.m_prefabId]};
-        auto const parents  = lgrn::Span<int const>{rPrefabData.m_prefabParents[request.m_prefabId]};
-        auto const ents     = ArrayView<ActiveEnt const>{*itPfEnts};
-
-        // All ancestors of each entity that has a mesh
-        auto const needs_draw_transform
-            = [&parents, &ents, &rDrawing, &needDrawTf = rScnRender.m_needDrawTf]
-              (auto&& self, int const object, ActiveEnt const ent) noexcept -> void
-        {
-            needDrawTf.insert(ent);
+        PrefabTemplate const    &rTmpl  = rPrefabs.templates[rPrefabs.spawnTemplate[i]];
+        auto const              ents    = rPrefabs.spawnedEntsOffset[i];
 
-            int const parentObj = parents[object];
-
-            if (parentObj != -1)
-            {
-                self(self, parentObj, ents[parentObj]);
-            }
-        };
-
-        for (std::size_t i = 0; i < objects.size(); ++i)
+        // Entities with meshes and all of their ancestors
+        for (uint32_t const obj : rTmpl.drawTfObjs)
         {
-            ActiveEnt const ent = ents[i];
-
-            // Check if object has mesh
-            int const meshImportId = rImportData.m_objMeshes[objects[i]];
-            if (meshImportId == -1)
-            {
-                continue;
-            }
-
-            needs_draw_transform(needs_draw_transform, objects[i], ent);
+            rScnRender.m_needDrawTf.insert(ents[obj]);
+        }
 
-            DrawEnt const drawEnt = rScnRender.m_activeToDraw[ent];
+        for (std::size_t j = 0; j < rTmpl.meshObjs.size(); ++j)
+        {
+            DrawEnt const drawEnt = rScnRender.m_activeToDraw[ents[rTmpl.meshObjs[j]]];
 
-            osp::ResId const meshRes = rImportData.m_meshes[meshImportId];
-            MeshId const meshId = SysRender::own_mesh_resource(rDrawing, rDrawingRes, rResources, meshRes);
+            MeshId const meshId = SysRender::own_mesh_resource(rDrawing, rDrawingRes, rResources, rTmpl.meshes[j]);
             rScnRender.m_mesh[drawEnt] = rDrawing.m_meshRefCounts.ref_add(meshId);
             rScnRender.m_meshDirty.push_back(drawEnt);
 
-            int const matImportId = rImportData.m_objMaterials[objects[i]];
+            uint32_t const lodsFirst = rTmpl.meshLodsOffset[j];
+            SysRender::own_mesh_lods(rDrawing, rDrawingRes, rResources, meshId,
+                                     {rTmpl.meshLods.data() + lodsFirst, rTmpl.meshLodsOffset[j + 1] - lodsFirst});
 
-            if (Magnum::Trade::MaterialData const &mat = *rImportData.m_materials.at(matImportId);
-                mat.types() & Magnum::Trade::MaterialType::PbrMetallicRoughness)
+            if (osp::ResId const texRes = rTmpl.diffuseTex[j];
+                texRes != lgrn::id_null<osp::ResId>())
             {
-                auto const& matPbr = mat.as<Magnum::Trade::PbrMetallicRoughnessMaterialData>();
-                if (auto const baseColor = matPbr.baseColorTexture();
-                    baseColor != -1)
-                {
-                    osp::ResId const texRes = rImportData.m_textures[baseColor];
-                    TexId const texId = SysRender::own_texture_resource(rDrawing, rDrawingRes, rResources, texRes);
-                    rScnRender.m_diffuseTex[drawEnt] = rDrawing.m_texRefCounts.ref_add(texId);
-                    rScnRender.m_diffuseDirty.push_back(drawEnt);
-                }
+                TexId const texId = SysRender::own_texture_resource(rDrawing, rDrawingRes, rResources, texRes);
+                rScnRender.m_diffuseTex[drawEnt] = rDrawing.m_texRefCounts.ref_add(texId);
+                rScnRender.m_diffuseDirty.push_back(drawEnt);
             }
 
-            rScnRender.m_opaque.insert(drawEnt);
+            if (rTmpl.transparent[j])
+            {
+                rScnRender.m_transparent.insert(drawEnt);
+            }
+            else
+            {
+                rScnRender.m_opaque.insert(drawEnt);
+            }
             rScnRender.m_visible.insert(drawEnt);
 
             if (material != lgrn::id_null<MaterialId>())
@@ -183,8 +144,6 @@ void SysPrefabDraw::init_mesh_texture_material(
                 rScnRender.m_materials[material].m_ents.insert(drawEnt);
             }
         }
-
-        ++itPfEnts;
     }
 }
 
@@ -198,6 +157,8 @@ void SysPrefabDraw::resync_mesh_texture_material(
         ACtxSceneRender&            rScnRender,
         MaterialId                  material)
 {
+    std::vector<ResId> lodRes;
+
     for (ActiveEnt const root : rPrefabs.roots)
     {
         PrefabInstanceInfo const &rRootInfo = rPrefabs.instanceInfo[root];
@@ -214,12 +175,12 @@ void SysPrefabDraw::resync_mesh_texture_material(
             PrefabInstanceInfo const &rInfo = rPrefabs.instanceInfo[ent];
 
             int const meshImportId = rImportData.m_objMeshes[objects[rInfo.obj]];
-            if (meshImportId == -1)
+            if (meshImportId == -1 || rImportData.m_meshIsLod[meshImportId])
             {
                 continue;
             }
 
-            SysRender::needs_draw_transforms(rBasic.m_scnGraph, rScnRender.m_needDrawTf, ent);
+            SysRender::needs_draw_transforms(rBasic.m_scnGraph, rScnRender.m_needDrawTf, rScnRender.m_drawTfGen, ent);
 
             DrawEnt const drawEnt = rScnRender.m_activeToDraw[ent];
 
@@ -228,10 +189,17 @@ void SysPrefabDraw::resync_mesh_texture_material(
             rScnRender.m_mesh[drawEnt] = rDrawing.m_meshRefCounts.ref_add(meshId);
             rScnRender.m_meshDirty.push_back(drawEnt);
 
+            lodRes.clear();
+            for (int lod = rImportData.m_meshNextLod[meshImportId]; lod != -1; lod = rImportData.m_meshNextLod[lod])
+            {
+                lodRes.push_back(rImportData.m_meshes[lod]);
+            }
+            SysRender::own_mesh_lods(rDrawing, rDrawingRes, rResources, meshId, {lodRes.data(), lodRes.size()});
+
             int const matImportId = rImportData.m_objMaterials[objects[rPrefabs.instanceInfo[ent].obj]];
+            Magnum::Trade::MaterialData const &mat = *rImportData.m_materials.at(matImportId);
 
-            if (Magnum::Trade::MaterialData const &mat = *rImportData.m_materials.at(matImportId);
-                mat.types() & Magnum::Trade::MaterialType::PbrMetallicRoughness)
+            if (mat.types() & Magnum::Trade::MaterialType::PbrMetallicRoughness)
             {
                 auto const& matPbr = mat.as<Magnum::Trade::PbrMetallicRoughnessMaterialData>();
                 if (auto const baseColor = matPbr.baseColorTexture();
@@ -244,7 +212,14 @@ void SysPrefabDraw::resync_mesh_texture_material(
                 }
             }
 
-            rScnRender.m_opaque.insert(drawEnt);
+            if (mat.alphaMode() == Magnum::Trade::MaterialAlphaMode::Blend)
+            {
+                rScnRender.m_transparent.insert(drawEnt);
+            }
+            else
+            {
+                rScnRender.m_opaque.insert(drawEnt);
+            }
             rScnRender.m_visible.insert(drawEnt);
 
             if (material != lgrn::id_null<MaterialId>())
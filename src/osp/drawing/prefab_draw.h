@@ -36,14 +36,12 @@ class SysPrefabDraw
     using ACtxBasic         = osp::active::ACtxBasic;
     using ACtxPrefabs       = osp::active::ACtxPrefabs;
     using ActiveEnt         = osp::active::ActiveEnt;
+    using PrefabTemplate    = osp::active::PrefabTemplate;
     using TmpPrefabRequest  = osp::active::TmpPrefabRequest;
 public:
 
     static void init_drawents(
-            ACtxPrefabs&                rPrefabs,
-            Resources&                  rResources,
-            ACtxBasic const&            rBasic,
-            ACtxDrawing&                rDrawing,
+            ACtxPrefabs const&          rPrefabs,
             ACtxSceneRender&            rScnRender);
 
     static void resync_drawents(
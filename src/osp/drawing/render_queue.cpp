@@ -0,0 +1,184 @@
+/**
+ * Open Space Program
+ * Copyright © 2019-2021 Open Space Program Project
+ *
+ * MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include "render_queue.h"
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cmath>
+#include <iterator>
+#include <utility>
+
+namespace osp::draw
+{
+
+namespace
+{
+
+template <typename T>
+uint32_t find_or_add(std::vector<T>& rVec, T const& value)
+{
+    auto const found = std::find(rVec.begin(), rVec.end(), value);
+    if (found != rVec.end())
+    {
+        return uint32_t(std::distance(rVec.begin(), found));
+    }
+    rVec.push_back(value);
+    return uint32_t(rVec.size() - 1);
+}
+
+} // namespace
+
+uint32_t SysRenderQueue::depth_key(float const distance, float const farPlane) noexcept
+{
+    constexpr float maxDepth = float((uint32_t(1) << RenderKey::smc_depthBits) - 1);
+
+    float const scaled = std::log2(1.0f + std::max(distance, 0.0f)) / std::log2(1.0f + farPlane);
+    return uint32_t(std::clamp(scaled, 0.0f, 1.0f) * maxDepth);
+}
+
+void SysRenderQueue::build(RenderQueue& rQueue, ArgsForBuild const& args)
+{
+    rQueue.keys     .clear();
+    rQueue.ents     .clear();
+    rQueue.shaders  .clear();
+    rQueue.materials.clear();
+
+    rQueue.keys.reserve(args.group.entities.size());
+    rQueue.ents.reserve(args.group.entities.size());
+
+    // Only the z row of the view matrix is needed for depth
+    Vector4 const viewZ = args.view.row(2);
+
+    // Depth is the only field of back-to-front keys, so only the pass is state
+    rQueue.stateMask = args.backToFront
+                     ? RenderKey::field(~uint32_t(0), RenderKey::smc_passBits, RenderKey::smc_passShift)
+                     : ~((uint64_t(1) << RenderKey::smc_depthBits) - 1);
+
+    for (auto const& [drawEnt, toDraw] : entt::basic_view{args.group.entities}.each())
+    {
+        if ( ! args.visible.contains(drawEnt) )
+        {
+            continue;
+        }
+
+        Vector3 const pos       = args.scnRender.m_drawTransform[drawEnt].translation();
+        float const distance    = -(viewZ.x() * pos.x() + viewZ.y() * pos.y() + viewZ.z() * pos.z() + viewZ.w());
+        uint32_t const depth    = depth_key(distance, args.farPlane);
+
+        if (args.backToFront)
+        {
+            rQueue.keys.push_back(RenderKey::pack_depth_only(args.pass, depth_key_back_to_front(depth)));
+            rQueue.ents.push_back(drawEnt);
+            continue;
+        }
+
+        uint32_t const shader   = find_or_add(rQueue.shaders,   toDraw.draw);
+        uint32_t const material = find_or_add(rQueue.materials, toDraw.data);
+
+        MeshIdOwner_t const &rMesh  = args.scnRender.m_mesh[drawEnt];
+        TexIdOwner_t const  &rTex   = args.scnRender.m_diffuseTex[drawEnt];
+        uint32_t const mesh     = rMesh.has_value() ? uint32_t(rMesh.value()) : 0u;
+        uint32_t const texture  = rTex .has_value() ? uint32_t(rTex .value()) : 0u;
+
+        rQueue.keys.push_back(RenderKey::pack(args.pass, shader, material, mesh, texture, depth));
+        rQueue.ents.push_back(drawEnt);
+    }
+
+    rQueue.packets.resize(rQueue.ents.size());
+}
+
+void SysRenderQueue::prepare_packets(
+        RenderQueue&            rQueue,
+        ACtxSceneRender const&  scnRender,
+        ViewProjMatrix const&   viewProj,
+        std::size_t const       first,
+        std::size_t const       last) noexcept
+{
+    assert(last <= rQueue.ents.size() && rQueue.packets.size() == rQueue.ents.size());
+
+    for (std::size_t i = first; i < last; ++i)
+    {
+        rQueue.packets[i] = SysRender::make_packet(scnRender.m_drawTransform[rQueue.ents[i]], viewProj);
+    }
+}
+
+void SysRenderQueue::sort(RenderQueue& rQueue)
+{
+    constexpr int digitBits     = 8;
+    constexpr int digitCount    = 64 / digitBits;
+    constexpr int bucketCount   = 1 << digitBits;
+
+    std::size_t const count = rQueue.keys.size();
+    if (count < 2)
+    {
+        return;
+    }
+
+    // Histograms of all digits in a single pass over the keys
+    std::array<std::array<uint32_t, bucketCount>, digitCount> histograms{};
+    for (uint64_t const key : rQueue.keys)
+    {
+        for (int digit = 0; digit < digitCount; ++digit)
+        {
+            ++histograms[digit][(key >> (digit * digitBits)) & (bucketCount - 1)];
+        }
+    }
+
+    rQueue.keysTmp.resize(count);
+    rQueue.entsTmp.resize(count);
+
+    for (int digit = 0; digit < digitCount; ++digit)
+    {
+        std::array<uint32_t, bucketCount> &rHist = histograms[digit];
+        int const shift = digit * digitBits;
+
+        // All keys are in the same bucket, this digit doesn't change the order
+        if (rHist[(rQueue.keys[0] >> shift) & (bucketCount - 1)] == count)
+        {
+            continue;
+        }
+
+        // Turn counts into starting offsets
+        uint32_t offset = 0;
+        for (uint32_t &rBucket : rHist)
+        {
+            offset += std::exchange(rBucket, offset);
+        }
+
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            uint64_t const key  = rQueue.keys[i];
+            uint32_t const dst  = rHist[(key >> shift) & (bucketCount - 1)]++;
+            rQueue.keysTmp[dst] = key;
+            rQueue.entsTmp[dst] = rQueue.ents[i];
+        }
+
+        std::swap(rQueue.keys, rQueue.keysTmp);
+        std::swap(rQueue.ents, rQueue.entsTmp);
+    }
+}
+
+} // namespace osp::draw
@@ -0,0 +1,183 @@
+/**
+ * Open Space Program
+ * Copyright © 2019-2021 Open Space Program Project
+ *
+ * MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#pragma once
+
+#include "drawing_fn.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace osp::draw
+{
+
+/**
+ * @brief Packs draw state into 64-bit keys, so sorting by key groups together draws that share
+ *        state
+ *
+ * From most to least significant: pass, shader, material, mesh, texture, depth. Fields that
+ * don't fit their bits wrap around, which only makes sorting less effective.
+ */
+struct RenderKey
+{
+    static constexpr int smc_depthBits      = 16;
+    static constexpr int smc_textureBits    = 14;
+    static constexpr int smc_meshBits       = 16;
+    static constexpr int smc_materialBits   = 8;
+    static constexpr int smc_shaderBits     = 8;
+    static constexpr int smc_passBits       = 2;
+
+    static constexpr int smc_textureShift   = smc_depthBits;
+    static constexpr int smc_meshShift      = smc_textureShift  + smc_textureBits;
+    static constexpr int smc_materialShift  = smc_meshShift     + smc_meshBits;
+    static constexpr int smc_shaderShift    = smc_materialShift + smc_materialBits;
+    static constexpr int smc_passShift      = smc_shaderShift   + smc_shaderBits;
+
+    static_assert(smc_passShift + smc_passBits == 64);
+
+    static constexpr uint64_t field(uint32_t const value, int const bits, int const shift) noexcept
+    {
+        return (uint64_t(value) & ((uint64_t(1) << bits) - 1)) << shift;
+    }
+
+    static constexpr uint64_t pack(
+            uint32_t pass, uint32_t shader, uint32_t material, uint32_t mesh, uint32_t texture, uint32_t depth) noexcept
+    {
+        return    field(pass,     smc_passBits,     smc_passShift)
+                | field(shader,   smc_shaderBits,   smc_shaderShift)
+                | field(material, smc_materialBits, smc_materialShift)
+                | field(mesh,     smc_meshBits,     smc_meshShift)
+                | field(texture,  smc_textureBits,  smc_textureShift)
+                | field(depth,    smc_depthBits,    0);
+    }
+
+    /**
+     * @brief Pack a key for blended passes, sorted by depth alone within the pass
+     *
+     * Depth is placed right below the pass and all other fields are left zero. Sorting then only
+     * has to go over the depth digits, and draws of the same state that happen to be next to each
+     * other can still be batched.
+     */
+    static constexpr uint64_t pack_depth_only(uint32_t pass, uint32_t depth) noexcept
+    {
+        return    field(pass,     smc_passBits,     smc_passShift)
+                | field(depth,    smc_depthBits,    smc_passShift - smc_depthBits);
+    }
+};
+
+/**
+ * @brief DrawEnts of a RenderGroup in the order they should be drawn
+ *
+ * Rebuilt every frame. Reuse the same RenderQueue to avoid reallocating.
+ */
+struct RenderQueue
+{
+    // Parallel, sorted by key after SysRenderQueue::sort
+    std::vector<uint64_t>                           keys;
+    std::vector<DrawEnt>                            ents;
+
+    // Parallel to ents, filled by SysRenderQueue::prepare_packets after sorting
+    std::vector<DrawPacket>                         packets;
+
+    // Bits of keys that describe draw state. Consecutive draws with the same state can be
+    // batched together.
+    uint64_t                                        stateMask{0};
+
+    // Distinct draw functions and user data seen while building, index is used as the key's
+    // shader and material fields
+    std::vector<EntityToDraw::ShaderDrawFnc_t>      shaders;
+    std::vector<EntityToDraw::UserData_t>           materials;
+
+    // Scratch space for sorting
+    std::vector<uint64_t>                           keysTmp;
+    std::vector<DrawEnt>                            entsTmp;
+};
+
+class SysRenderQueue
+{
+public:
+
+    struct ArgsForBuild
+    {
+        RenderGroup const&      group;
+        DrawEntSet_t const&     visible;
+        ACtxSceneRender const&  scnRender;
+        Matrix4 const&          view;
+        float                   farPlane;
+        uint32_t                pass;
+        bool                    backToFront{false};
+    };
+
+    /**
+     * @brief Clear a queue, then add all visible DrawEnts of a RenderGroup with their keys
+     *
+     * Depth is measured from the camera logarithmically, so near objects are well separated
+     * even with very far far-planes. Closer objects have smaller keys.
+     *
+     * If backToFront is set, keys are made with RenderKey::pack_depth_only and flipped depth
+     * instead, so a sorted queue draws further objects first, as needed for blending.
+     */
+    static void build(RenderQueue& rQueue, ArgsForBuild const& args);
+
+    /**
+     * @brief Sort a queue by key, ascending. Stable.
+     *
+     * LSD radix sort with 8-bit digits. Digits that are the same for all keys are skipped, which
+     * is common for the pass and shader fields. Back-to-front keys only take the two depth digits.
+     */
+    static void sort(RenderQueue& rQueue);
+
+    /**
+     * @brief Compute DrawPackets for a range of a sorted queue
+     *
+     * Only reads the scene and writes packets[first, last).
+     *
+     * @param rQueue    [ref] Queue after build and sort
+     * @param scnRender [in] Scene with draw transforms
+     * @param viewProj  [in] View and projection matrix of the pass
+     * @param first     [in] First queue index
+     * @param last      [in] One past the last queue index
+     */
+    static void prepare_packets(
+            RenderQueue&            rQueue,
+            ACtxSceneRender const&  scnRender,
+            ViewProjMatrix const&   viewProj,
+            std::size_t             first,
+            std::size_t             last) noexcept;
+
+    /**
+     * @brief Quantize a view-space distance into a depth field
+     */
+    static uint32_t depth_key(float distance, float farPlane) noexcept;
+
+    /**
+     * @brief Flip depth so that further objects sort first, such as for blended passes
+     */
+    static constexpr uint32_t depth_key_back_to_front(uint32_t const depth) noexcept
+    {
+        return ((uint32_t(1) << RenderKey::smc_depthBits) - 1) - depth;
+    }
+};
+
+} // namespace osp::draw
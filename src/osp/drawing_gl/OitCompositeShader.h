@@ -0,0 +1,88 @@
+/**
+ * Open Space Program
+ * Copyright © 2019-2024 Open Space Program Project
+ *
+ * MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#pragma once
+
+#include <Magnum/GL/AbstractShaderProgram.h>
+#include <Magnum/GL/Attribute.h>
+
+namespace osp
+{
+
+/**
+ * @brief Composites blended order-independent transparency over an opaque framebuffer
+ *
+ * Reads an accumulation texture (RGB: sum of color times alpha, A: sum of alpha) and a
+ * revealage texture (R: product of one minus alpha), and outputs their average color with an
+ * alpha of one minus revealage. Draw with (SourceAlpha, OneMinusSourceAlpha) blending.
+ */
+class OitCompositeShader : public Magnum::GL::AbstractShaderProgram
+{
+public:
+    // Vertex attribs, same as FullscreenTriShader
+    typedef Magnum::GL::Attribute<0, Magnum::Vector2> Position;
+    typedef Magnum::GL::Attribute<1, Magnum::Vector2> TextureCoordinates;
+
+    // Outputs
+    enum class EOutputs : Magnum::UnsignedInt
+    {
+        ColorOutput = 0
+    };
+
+    OitCompositeShader();
+
+    using AbstractShaderProgram::AbstractShaderProgram;
+
+    /**
+     * Composites transparency by drawing a fullscreen triangle
+     *
+     * @param surface       - The fullscreen triangle mesh data
+     * @param accumulation  - Accumulated color and alpha
+     * @param revealage     - Product of one minus alpha
+     */
+    void composite(
+            Magnum::GL::Mesh& surface,
+            Magnum::GL::Texture2D& accumulation,
+            Magnum::GL::Texture2D& revealage);
+private:
+    // Uniforms
+    enum class EUniformPos : Magnum::Int
+    {
+        AccumulationSampler = 0,
+        RevealageSampler = 1
+    };
+
+    // Texture2D slots
+    enum class ETextureSlot : Magnum::Int
+    {
+        Accumulation = 0,
+        Revealage = 1
+    };
+
+    // Hide irrelevant calls
+    using Magnum::GL::AbstractShaderProgram::drawTransformFeedback;
+    using Magnum::GL::AbstractShaderProgram::dispatchCompute;
+};
+
+} // namespace osp
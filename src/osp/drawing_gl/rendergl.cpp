@@ -31,6 +31,7 @@
 #include "../util/logging.h"
 
 #include <Magnum/ImageView.h>
+#include <Magnum/PixelFormat.h>
 
 #include <Magnum/GL/Buffer.h>
 #include <Magnum/GL/DefaultFramebuffer.h>
@@ -46,6 +47,12 @@
 
 #include <Magnum/Mesh.h>
 #include <Magnum/MeshTools/Compile.h>
+#include <Magnum/Shaders/GenericGL.h>
+
+#include <algorithm>
+#include <cassert>
+#include <utility>
+#include <vector>
 
 using Magnum::Trade::MeshData;
 using Magnum::Trade::TextureData;
@@ -59,9 +66,271 @@ using osp::ResId;
 using osp::draw::SysRenderGL;
 using osp::draw::RenderGL;
 
+using osp::draw::DrawEnt;
 using osp::draw::TexGlId;
 using osp::draw::MeshGlId;
 
+namespace
+{
+
+/**
+ * @brief Calls EntityToDraw::setup once per distinct setup function and user data within a pass
+ */
+struct PassSetup
+{
+    void operator()(osp::draw::EntityToDraw const& toDraw, osp::draw::ViewProjMatrix const& viewProj)
+    {
+        if (toDraw.setup == nullptr)
+        {
+            return;
+        }
+
+        // Passes only use a handful of shaders, a linear search is fine
+        for (auto const& [setup, data] : m_done)
+        {
+            if (setup == toDraw.setup && data == toDraw.data)
+            {
+                return;
+            }
+        }
+
+        m_done.emplace_back(toDraw.setup, toDraw.data);
+        toDraw.setup(viewProj, toDraw.data);
+    }
+
+    std::vector< std::pair<osp::draw::EntityToDraw::ShaderSetupFnc_t,
+                           osp::draw::EntityToDraw::UserData_t> > m_done;
+};
+
+// Resources get a GL Id right away, so entities can be synced to them. The GL object is only
+// created by SysRenderGL::upload_pending, which makes the Id resident.
+
+void compile_texture(ResId const texRes, osp::Resources& rResources, RenderGL& rRenderGl)
+{
+    using namespace osp;
+
+    // New element will be emplaced if it isn't present yet
+    auto const [it, success] = rRenderGl.m_resToTex.try_emplace(texRes);
+    if ( ! success)
+    {
+        return; // Already compiled
+    }
+
+    // Create new Texture GL Id
+    TexGlId const newId = rRenderGl.m_texIds.create();
+
+    // Create owner, this adds to the resource's reference count
+    ResIdOwner_t renderOwner
+            = rResources.owner_create(restypes::gc_texture, texRes);
+
+    // Track with two-way map and store owner
+    rRenderGl.m_texToRes.emplace(newId, std::move(renderOwner));
+    it->second = newId;
+
+    rRenderGl.m_texResident.resize(rRenderGl.m_texIds.capacity());
+    rRenderGl.m_texUploadQueue.push_back(texRes);
+}
+
+void compile_mesh(ResId const meshRes, osp::Resources& rResources, RenderGL& rRenderGl)
+{
+    using namespace osp;
+
+    // New element will be emplaced if it isn't present yet
+    auto const [it, success] = rRenderGl.m_resToMesh.try_emplace(meshRes);
+    if ( ! success)
+    {
+        return; // Already compiled
+    }
+
+    // Create new Mesh GL Id
+    MeshGlId const newId = rRenderGl.m_meshIds.create();
+
+    // Create owner, this adds to the resource's reference count
+    ResIdOwner_t renderOwner
+            = rResources.owner_create(restypes::gc_mesh, meshRes);
+
+    // Track with two-way map and store owner
+    rRenderGl.m_meshToRes.emplace(newId, std::move(renderOwner));
+    it->second = newId;
+
+    rRenderGl.m_meshResident.resize(rRenderGl.m_meshIds.capacity());
+    rRenderGl.m_meshUploadQueue.push_back(meshRes);
+}
+
+std::size_t upload_texture(ResId const texRes, osp::Resources& rResources, RenderGL& rRenderGl)
+{
+    using namespace osp;
+
+    using Magnum::GL::textureFormat;
+
+    auto const it = rRenderGl.m_resToTex.find(texRes);
+    if (it == rRenderGl.m_resToTex.end())
+    {
+        return 0; // Released before it was uploaded
+    }
+
+    if (rRenderGl.m_texResident.contains(it->second))
+    {
+        return 0; // Already uploaded, the resource was queued more than once
+    }
+
+    ResId const imgRes = rResources.data_get<TextureImgSource>(restypes::gc_texture, texRes);
+    auto const &texData = rResources.data_get<TextureData>(restypes::gc_texture, texRes);
+    auto const &imgData = rResources.data_get<ImageData2D>(restypes::gc_image, imgRes);
+
+    if (texData.type() != Magnum::Trade::TextureType::Texture2D)
+    {
+
+        OSP_LOG_WARN("Unsupported texture type for texture resource: {}",
+                     rResources.name(restypes::gc_texture, texRes));
+        return 0;
+    }
+
+    Magnum::GL::Texture2D texture;
+    texture.setMinificationFilter(texData.minificationFilter(),
+                                  texData.mipmapFilter())
+           .setMagnificationFilter(texData.magnificationFilter())
+           .setWrapping(texData.wrapping().xy())
+           .setStorage(1, textureFormat(imgData.format()), imgData.size())
+           .setSubImage(0, {}, imgData);
+
+    rRenderGl.m_texGl.emplace(it->second, std::move(texture));
+    rRenderGl.m_texResident.insert(it->second);
+
+    return imgData.data().size();
+}
+
+std::size_t upload_mesh(ResId const meshRes, osp::Resources& rResources, RenderGL& rRenderGl)
+{
+    using namespace osp;
+
+    auto const it = rRenderGl.m_resToMesh.find(meshRes);
+    if (it == rRenderGl.m_resToMesh.end())
+    {
+        return 0; // Released before it was uploaded
+    }
+
+    MeshGlId const meshGlId = it->second;
+    if (rRenderGl.m_meshResident.contains(meshGlId))
+    {
+        return 0; // Already uploaded, the resource was queued more than once
+    }
+
+    // Get mesh data
+    auto const &meshData = rResources.data_get<MeshData>(restypes::gc_mesh, meshRes);
+
+    rRenderGl.m_meshGl.emplace(meshGlId, Magnum::MeshTools::compile(meshData));
+    rRenderGl.m_meshResident.insert(meshGlId);
+
+    return meshData.vertexData().size() + meshData.indexData().size();
+}
+
+void release_texture(ResId const texRes, osp::Resources& rResources, RenderGL& rRenderGl)
+{
+    using namespace osp;
+
+    auto const it = rRenderGl.m_resToTex.find(texRes);
+    if (it == rRenderGl.m_resToTex.end())
+    {
+        return;
+    }
+
+    TexGlId const texGlId = it->second;
+    rRenderGl.m_resToTex.erase(it);
+
+    if (rRenderGl.m_texResident.contains(texGlId))
+    {
+        rRenderGl.m_texGl.remove(texGlId);
+        rRenderGl.m_texResident.erase(texGlId);
+    }
+
+    auto ownerIt = rRenderGl.m_texToRes.find(texGlId);
+    rResources.owner_destroy(restypes::gc_texture, std::move(ownerIt->second));
+    rRenderGl.m_texToRes.erase(ownerIt);
+
+    rRenderGl.m_texIds.remove(texGlId);
+}
+
+void release_mesh(ResId const meshRes, osp::Resources& rResources, RenderGL& rRenderGl)
+{
+    using namespace osp;
+
+    auto const it = rRenderGl.m_resToMesh.find(meshRes);
+    if (it == rRenderGl.m_resToMesh.end())
+    {
+        return;
+    }
+
+    MeshGlId const meshGlId = it->second;
+    rRenderGl.m_resToMesh.erase(it);
+
+    // Instance buffer is attached to the mesh, remove the mesh first
+    if (rRenderGl.m_meshResident.contains(meshGlId))
+    {
+        rRenderGl.m_meshGl.remove(meshGlId);
+        rRenderGl.m_meshResident.erase(meshGlId);
+    }
+    rRenderGl.m_meshInstanceBuf.erase(meshGlId);
+
+    auto ownerIt = rRenderGl.m_meshToRes.find(meshGlId);
+    rResources.owner_destroy(restypes::gc_mesh, std::move(ownerIt->second));
+    rRenderGl.m_meshToRes.erase(ownerIt);
+
+    rRenderGl.m_meshIds.remove(meshGlId);
+}
+
+/**
+ * @brief Draw glId right away if it's resident, otherwise keep drawing what was there before
+ */
+template <typename COMP_T, typename GLID_T>
+void assign_when_resident(
+        COMP_T&                         rComp,
+        GLID_T const                    glId,
+        lgrn::IdSetStl<GLID_T> const&   resident,
+        std::vector<DrawEnt>&           rPending,
+        DrawEnt const                   ent)
+{
+    if (resident.contains(glId))
+    {
+        rComp.m_glId        = glId;
+        rComp.m_pendingGlId = lgrn::id_null<GLID_T>();
+    }
+    else
+    {
+        if (rComp.m_pendingGlId == lgrn::id_null<GLID_T>())
+        {
+            rPending.push_back(ent);
+        }
+        rComp.m_pendingGlId = glId;
+    }
+}
+
+template <typename STORAGE_T, typename GLID_T>
+void promote_resident(
+        std::vector<DrawEnt>&           rPending,
+        STORAGE_T&                      rComps,
+        lgrn::IdSetStl<GLID_T> const&   resident)
+{
+    auto const stillPending = [&rComps, &resident] (DrawEnt const ent) -> bool
+    {
+        auto &rComp = rComps[ent];
+        if (rComp.m_pendingGlId == lgrn::id_null<GLID_T>())
+        {
+            return false; // Component was removed or reassigned since
+        }
+        if ( ! resident.contains(rComp.m_pendingGlId))
+        {
+            return true;
+        }
+        rComp.m_glId = std::exchange(rComp.m_pendingGlId, lgrn::id_null<GLID_T>());
+        return false;
+    };
+
+    rPending.erase(std::remove_if(rPending.begin(), rPending.end(), stillPending), rPending.end());
+}
+
+} // namespace
+
 void SysRenderGL::setup_context(RenderGL& rCtxGl)
 {
     using namespace Magnum;
@@ -109,61 +378,83 @@ void SysRenderGL::setup_context(RenderGL& rCtxGl)
     }
 }
 
-void SysRenderGL::compile_resource_textures(
-        ACtxDrawingRes const&   rCtxDrawRes,
-        Resources&              rResources,
-        RenderGL&               rRenderGl)
+void SysRenderGL::set_oit(RenderGL& rRenderGl, bool const enable)
 {
-    // TODO: Eventually have dirty flags instead of checking every entry.
+    using namespace Magnum;
 
-    for ([[maybe_unused]] auto const & [_, scnOwner] : rCtxDrawRes.m_texToRes)
+    if (rRenderGl.m_useOit == enable)
+    {
+        return;
+    }
+
+    rRenderGl.m_useOit = enable;
+
+    if ( ! enable )
     {
-        ResId const texRes = scnOwner.value();
+        rRenderGl.m_oitFbo              = GL::Framebuffer{NoCreate};
+        rRenderGl.m_oitCompositeShader  = OitCompositeShader{NoCreate};
 
-        // New element will be emplaced if it isn't present yet
-        auto const [it, success] = rRenderGl.m_resToTex.try_emplace(texRes);
-        if ( ! success)
+        for (TexGlId const texGlId : {rRenderGl.m_oitAccum, rRenderGl.m_oitReveal})
         {
-            continue;
+            rRenderGl.m_texGl.remove(texGlId);
+            rRenderGl.m_texIds.remove(texGlId);
         }
+        rRenderGl.m_oitAccum    = lgrn::id_null<TexGlId>();
+        rRenderGl.m_oitReveal   = lgrn::id_null<TexGlId>();
+        return;
+    }
 
-        // New element emplaced, this means we've just found a resource that
-        // isn't synchronized yet.
+    rRenderGl.m_oitCompositeShader = OitCompositeShader{};
 
-        using Magnum::GL::SamplerWrapping;
-        using Magnum::GL::SamplerFilter;
-        using Magnum::GL::textureFormat;
+    Vector2i const viewSize = rRenderGl.m_fbo.viewport().size();
 
-        // Create new Texture GL Id
-        TexGlId const newId = rRenderGl.m_texIds.create();
+    rRenderGl.m_oitAccum = rRenderGl.m_texIds.create();
+    GL::Texture2D &rAccum = rRenderGl.m_texGl.emplace(rRenderGl.m_oitAccum);
+    rAccum.setStorage(1, GL::TextureFormat::RGBA16F, viewSize);
 
-        // Create owner, this adds to the resource's reference count
-        ResIdOwner_t renderOwner
-                = rResources.owner_create(restypes::gc_texture, texRes);
+    rRenderGl.m_oitReveal = rRenderGl.m_texIds.create();
+    GL::Texture2D &rReveal = rRenderGl.m_texGl.emplace(rRenderGl.m_oitReveal);
+    rReveal.setStorage(1, GL::TextureFormat::R16F, viewSize);
 
-        // Track with two-way map and store owner
-        rRenderGl.m_texToRes.emplace(newId, std::move(renderOwner));
-        it->second = newId;
+    rRenderGl.m_oitFbo = GL::Framebuffer{ Range2Di{{0, 0}, viewSize} };
+    rRenderGl.m_oitFbo.attachTexture(GL::Framebuffer::ColorAttachment{0}, rAccum, 0);
+    rRenderGl.m_oitFbo.attachTexture(GL::Framebuffer::ColorAttachment{1}, rReveal, 0);
+    rRenderGl.m_oitFbo.attachRenderbuffer(GL::Framebuffer::BufferAttachment::DepthStencil, rRenderGl.m_fboDepthStencil);
+}
 
-        ResId const imgRes = rResources.data_get<TextureImgSource>(restypes::gc_texture, texRes);
-        auto const &texData = rResources.data_get<TextureData>(restypes::gc_texture, texRes);
-        auto const &imgData = rResources.data_get<ImageData2D>(restypes::gc_image, imgRes);
+void SysRenderGL::compile_resource_textures(
+        ACtxDrawingRes const&   rCtxDrawRes,
+        Resources&              rResources,
+        RenderGL&               rRenderGl)
+{
+    // Resources may have been removed then added again, or the other way around, since the
+    // last compile. Only act on what the scene currently uses.
 
-        if (texData.type() != Magnum::Trade::TextureType::Texture2D)
+    for (ResId const texRes : rCtxDrawRes.m_texRemoved)
+    {
+        if ( ! rCtxDrawRes.m_resToTex.contains(texRes))
         {
+            release_texture(texRes, rResources, rRenderGl);
+        }
+    }
 
-            OSP_LOG_WARN("Unsupported texture type for texture resource: {}",
-                         rResources.name(restypes::gc_texture, texRes));
-            continue;
+    for (ResId const texRes : rCtxDrawRes.m_texNew)
+    {
+        if (rCtxDrawRes.m_resToTex.contains(texRes))
+        {
+            compile_texture(texRes, rResources, rRenderGl);
         }
+    }
+}
 
-        rRenderGl.m_texGl.emplace(newId)
-                .setMinificationFilter(texData.minificationFilter(),
-                                       texData.mipmapFilter())
-                .setMagnificationFilter(texData.magnificationFilter())
-                .setWrapping(texData.wrapping().xy())
-                .setStorage(1, textureFormat(imgData.format()), imgData.size())
-                .setSubImage(0, {}, imgData);
+void SysRenderGL::compile_all_resource_textures(
+        ACtxDrawingRes const&   rCtxDrawRes,
+        Resources&              rResources,
+        RenderGL&               rRenderGl)
+{
+    for ([[maybe_unused]] auto const & [_, scnOwner] : rCtxDrawRes.m_texToRes)
+    {
+        compile_texture(scnOwner.value(), rResources, rRenderGl);
     }
 }
 
@@ -172,54 +463,73 @@ void SysRenderGL::compile_resource_meshes(
         Resources&              rResources,
         RenderGL&               rRenderGl)
 {
-    // TODO: Eventually have dirty flags instead of checking every entry.
-
-    for ([[maybe_unused]] auto const & [_, scnOwner] : rCtxDrawRes.m_meshToRes)
+    for (ResId const meshRes : rCtxDrawRes.m_meshRemoved)
     {
-        ResId const meshRes = scnOwner.value();
-
-        // New element will be emplaced if it isn't present yet
-        auto const [it, success] = rRenderGl.m_resToMesh.try_emplace(meshRes);
-        if ( ! success)
+        if ( ! rCtxDrawRes.m_resToMesh.contains(meshRes))
         {
-            continue;
+            release_mesh(meshRes, rResources, rRenderGl);
         }
+    }
 
-        // New element emplaced, this means we've just found a resource that
-        // isn't synchronized yet.
-
-        // Create new Mesh GL Id
-        MeshGlId const newId = rRenderGl.m_meshIds.create();
+    for (ResId const meshRes : rCtxDrawRes.m_meshNew)
+    {
+        if (rCtxDrawRes.m_resToMesh.contains(meshRes))
+        {
+            compile_mesh(meshRes, rResources, rRenderGl);
+        }
+    }
+}
 
-        // Create owner, this adds to the resource's reference count
-        ResIdOwner_t renderOwner
-                = rResources.owner_create(restypes::gc_mesh, meshRes);
+void SysRenderGL::compile_all_resource_meshes(
+        ACtxDrawingRes const&   rCtxDrawRes,
+        Resources&              rResources,
+        RenderGL&               rRenderGl)
+{
+    for ([[maybe_unused]] auto const & [_, scnOwner] : rCtxDrawRes.m_meshToRes)
+    {
+        compile_mesh(scnOwner.value(), rResources, rRenderGl);
+    }
+}
 
-        // Track with two-way map and store owner
-        rRenderGl.m_meshToRes.emplace(newId, std::move(renderOwner));
-        it->second = newId;
+void SysRenderGL::upload_pending(
+        RenderGL&               rRenderGl,
+        Resources&              rResources,
+        std::size_t const       byteBudget)
+{
+    std::size_t used = 0;
 
-        // Get mesh data
-        auto const &meshData = rResources.data_get<MeshData>(restypes::gc_mesh, meshRes);
+    // Meshes first, entities are invisible without them
+    upload_queue(rRenderGl.m_meshUploadQueue, used, byteBudget, [&] (ResId const res)
+    {
+        return upload_mesh(res, rResources, rRenderGl);
+    });
 
-        // Compile and store mesh
-        rRenderGl.m_meshGl.emplace(newId, Magnum::MeshTools::compile(meshData));
-    }
+    upload_queue(rRenderGl.m_texUploadQueue, used, byteBudget, [&] (ResId const res)
+    {
+        return upload_texture(res, rResources, rRenderGl);
+    });
 }
 
 void SysRenderGL::sync_drawent_mesh(
         DrawEnt const                               ent,
         KeyedVec<DrawEnt, MeshIdOwner_t> const&     cmpMeshIds,
+        KeyedVec<DrawEnt, MeshId> const&            lodMeshIds,
         IdMap_t<MeshId, ResIdOwner_t> const&        meshToRes,
-        MeshGlEntStorage_t&                         rCmpMeshGl,
+        ACtxSceneRenderGL&                          rScnRenderGl,
         RenderGL&                                   rRenderGl)
 {
-    ACompMeshGl &rEntMeshGl = rCmpMeshGl[ent];
-    MeshIdOwner_t const& entMeshScnId = cmpMeshIds[ent];
+    ACompMeshGl &rEntMeshGl = rScnRenderGl.m_meshId[ent];
+    MeshIdOwner_t const& entMeshOwner = cmpMeshIds[ent];
 
     // Make sure dirty entity has a MeshId component
-    if (entMeshScnId.has_value())
+    if (entMeshOwner.has_value())
     {
+        MeshId entMeshScnId = entMeshOwner.value();
+        if (std::size_t(ent) < lodMeshIds.size() && lodMeshIds[ent] != lgrn::id_null<MeshId>())
+        {
+            entMeshScnId = lodMeshIds[ent];
+        }
+
         // Check if scene mesh ID is properly synchronized
         if (rEntMeshGl.m_scnId == entMeshScnId)
         {
@@ -234,18 +544,20 @@ void SysRenderGL::sync_drawent_mesh(
         {
             ResId const meshResId = foundIt->second;
 
-            // Mesh should have been loaded beforehand, assign it!
-            rEntMeshGl.m_glId = rRenderGl.m_resToMesh.at(meshResId);
+            // Mesh should have been compiled beforehand, assign it once it's uploaded
+            assign_when_resident(rEntMeshGl, rRenderGl.m_resToMesh.at(meshResId),
+                                 rRenderGl.m_meshResident, rScnRenderGl.m_meshPending, ent);
         }
         else
         {
             OSP_LOG_WARN("No mesh data found for Mesh {} from Entity {}",
-                         std::size_t(entMeshScnId.value()), std::size_t(ent));
+                         std::size_t(entMeshScnId), std::size_t(ent));
         }
     }
     else
     {
-        if (rEntMeshGl.m_glId != lgrn::id_null<MeshGlId>())
+        if (   rEntMeshGl.m_glId        != lgrn::id_null<MeshGlId>()
+            || rEntMeshGl.m_pendingGlId != lgrn::id_null<MeshGlId>())
         {
             // ACompMesh removed, remove ACompMeshGL too
             rEntMeshGl = {};
@@ -261,10 +573,10 @@ void SysRenderGL::sync_drawent_texture(
         DrawEnt const                               ent,
         KeyedVec<DrawEnt, TexIdOwner_t> const&      cmpTexIds,
         IdMap_t<TexId, ResIdOwner_t> const&         texToRes,
-        TexGlEntStorage_t&                          rCmpTexGl,
+        ACtxSceneRenderGL&                          rScnRenderGl,
         RenderGL&                                   rRenderGl)
 {
-    ACompTexGl &rEntTexGl = rCmpTexGl[ent];
+    ACompTexGl &rEntTexGl = rScnRenderGl.m_diffuseTexId[ent];
     TexIdOwner_t const& entTexScnId = cmpTexIds[ent];
 
     // Make sure dirty entity has a MeshId component
@@ -284,8 +596,9 @@ void SysRenderGL::sync_drawent_texture(
         {
             ResId const texResId = foundIt->second;
 
-            // Mesh should have been loaded beforehand, assign it!
-            rEntTexGl.m_glId = rRenderGl.m_resToTex.at(texResId);
+            // Texture should have been compiled beforehand, assign it once it's uploaded
+            assign_when_resident(rEntTexGl, rRenderGl.m_resToTex.at(texResId),
+                                 rRenderGl.m_texResident, rScnRenderGl.m_texPending, ent);
         }
         else
         {
@@ -295,7 +608,8 @@ void SysRenderGL::sync_drawent_texture(
     }
     else
     {
-        if (rEntTexGl.m_glId != lgrn::id_null<TexGlId>())
+        if (   rEntTexGl.m_glId         != lgrn::id_null<TexGlId>()
+            || rEntTexGl.m_pendingGlId  != lgrn::id_null<TexGlId>())
         {
             // ACompMesh removed, remove ACompMeshGL too
             rEntTexGl = {};
@@ -307,6 +621,12 @@ void SysRenderGL::sync_drawent_texture(
     }
 }
 
+void SysRenderGL::sync_drawent_pending(ACtxSceneRenderGL& rScnRenderGl, RenderGL const& renderGl)
+{
+    promote_resident(rScnRenderGl.m_meshPending, rScnRenderGl.m_meshId,       renderGl.m_meshResident);
+    promote_resident(rScnRenderGl.m_texPending,  rScnRenderGl.m_diffuseTexId, renderGl.m_texResident);
+}
+
 void SysRenderGL::display_texture(
         RenderGL& rRenderGl, Magnum::GL::Texture2D& rTex)
 {
@@ -357,6 +677,21 @@ void SysRenderGL::render_opaque(
     draw_group(group, visible, viewProj);
 }
 
+void SysRenderGL::render_opaque(
+        RenderGroup const& group,
+        RenderQueue const& queue,
+        ViewProjMatrix const& viewProj)
+{
+    using Magnum::GL::Renderer;
+
+    Renderer::enable(Renderer::Feature::DepthTest);
+    Renderer::enable(Renderer::Feature::FaceCulling);
+    Renderer::disable(Renderer::Feature::Blending);
+    Renderer::setDepthMask(GL_TRUE);
+
+    draw_queue(group, queue, viewProj);
+}
+
 void SysRenderGL::render_transparent(
         RenderGroup const& group,
         DrawEntSet_t const& visible,
@@ -378,16 +713,163 @@ void SysRenderGL::render_transparent(
     draw_group(group, visible, viewProj);
 }
 
+void SysRenderGL::render_transparent(
+        RenderGroup const& group,
+        RenderQueue const& queue,
+        ViewProjMatrix const& viewProj)
+{
+    using Magnum::GL::Renderer;
+
+    Renderer::enable(Renderer::Feature::DepthTest);
+    Renderer::disable(Renderer::Feature::FaceCulling);
+    Renderer::enable(Renderer::Feature::Blending);
+    Renderer::setBlendFunction(
+            Renderer::BlendFunction::SourceAlpha,
+            Renderer::BlendFunction::OneMinusSourceAlpha);
+
+    // Drawn back to front, so transparent objects don't need to hide each other
+    Renderer::setDepthMask(GL_FALSE);
+
+    draw_queue(group, queue, viewProj);
+
+    Renderer::setDepthMask(GL_TRUE);
+}
+
+void SysRenderGL::render_transparent_oit(
+        RenderGL& rRenderGl,
+        RenderGroup const& group,
+        DrawEntSet_t const& visible,
+        ViewProjMatrix const& viewProj)
+{
+    using Magnum::GL::Renderer;
+    using Magnum::GL::Framebuffer;
+    using Magnum::Shaders::GenericGL3D;
+
+    assert(rRenderGl.m_oitFbo.id() != 0);
+
+    Framebuffer &rOitFbo = rRenderGl.m_oitFbo;
+    rOitFbo.bind();
+    rOitFbo.mapForDraw({{0, Framebuffer::ColorAttachment{0}}, {1, Framebuffer::ColorAttachment{1}}});
+    rOitFbo.clearColor(0, Magnum::Color4{0.0f});
+    rOitFbo.clearColor(1, Magnum::Color4{1.0f});
+
+    Renderer::enable(Renderer::Feature::DepthTest);
+    Renderer::disable(Renderer::Feature::FaceCulling);
+    Renderer::enable(Renderer::Feature::Blending);
+    Renderer::setDepthMask(GL_FALSE);
+
+    // Shaders only have a single color output, so each target takes a separate pass
+
+    // Sum of color times alpha, and sum of alpha
+    rOitFbo.mapForDraw({{GenericGL3D::ColorOutput, Framebuffer::ColorAttachment{0}}});
+    Renderer::setBlendFunction(
+            Renderer::BlendFunction::SourceAlpha,   Renderer::BlendFunction::One,
+            Renderer::BlendFunction::One,           Renderer::BlendFunction::One);
+    draw_group(group, visible, viewProj);
+
+    // Product of one minus alpha
+    rOitFbo.mapForDraw({{GenericGL3D::ColorOutput, Framebuffer::ColorAttachment{1}}});
+    Renderer::setBlendFunction(
+            Renderer::BlendFunction::Zero,
+            Renderer::BlendFunction::OneMinusSourceAlpha);
+    draw_group(group, visible, viewProj);
+
+    // Composite over the opaque scene
+    rRenderGl.m_fbo.bind();
+    Renderer::disable(Renderer::Feature::DepthTest);
+    Renderer::setBlendFunction(
+            Renderer::BlendFunction::SourceAlpha,
+            Renderer::BlendFunction::OneMinusSourceAlpha);
+
+    rRenderGl.m_oitCompositeShader.composite(
+            rRenderGl.m_meshGl.get(rRenderGl.m_fullscreenTri),
+            rRenderGl.m_texGl.get(rRenderGl.m_oitAccum),
+            rRenderGl.m_texGl.get(rRenderGl.m_oitReveal));
+
+    Renderer::setDepthMask(GL_TRUE);
+}
+
 void SysRenderGL::draw_group(
         RenderGroup const& group,
         DrawEntSet_t const& visible,
         ViewProjMatrix const& viewProj)
 {
+    PassSetup setup;
+
     for (auto const& [ent, toDraw] : entt::basic_view{group.entities}.each())
     {
         if (visible.contains(ent))
         {
+            setup(toDraw, viewProj);
             toDraw.draw(ent, viewProj, toDraw.data);
         }
     }
 }
+
+void SysRenderGL::draw_queue(
+        RenderGroup const& group,
+        RenderQueue const& queue,
+        ViewProjMatrix const& viewProj)
+{
+    PassSetup setup;
+
+    std::size_t const count = queue.ents.size();
+    std::size_t first = 0;
+
+    bool const hasPackets = (queue.packets.size() == count);
+
+    while (first < count)
+    {
+        DrawEnt const       ent     = queue.ents[first];
+        EntityToDraw const  &toDraw = group.entities.get(ent);
+        std::size_t         last    = first + 1;
+
+        setup(toDraw, viewProj);
+
+        if (toDraw.drawBatch == nullptr)
+        {
+            toDraw.draw(ent, viewProj, toDraw.data);
+            first = last;
+            continue;
+        }
+
+        // Extend the run while only depth differs. Also compare draw and data, since key fields
+        // can wrap around, and aren't there at all in back-to-front keys.
+        uint64_t const state = queue.keys[first] & queue.stateMask;
+        while (   last < count
+               && (queue.keys[last] & queue.stateMask) == state)
+        {
+            EntityToDraw const &next = group.entities.get(queue.ents[last]);
+            if (next.draw != toDraw.draw || next.data != toDraw.data)
+            {
+                break;
+            }
+            ++last;
+        }
+
+        ArrayView<DrawPacket const> const packets = hasPackets
+                ? ArrayView<DrawPacket const>{&queue.packets[first], last - first}
+                : ArrayView<DrawPacket const>{};
+
+        toDraw.drawBatch({&queue.ents[first], last - first}, packets, viewProj, toDraw.data);
+        first = last;
+    }
+}
+
+Magnum::GL::Buffer& SysRenderGL::instance_buffer(RenderGL& rRenderGl, MeshGlId const meshId)
+{
+    using Magnum::Shaders::GenericGL3D;
+
+    auto const [it, created] = rRenderGl.m_meshInstanceBuf.try_emplace(meshId);
+    Magnum::GL::Buffer &rBuffer = it->second;
+
+    if (created)
+    {
+        rRenderGl.m_meshGl.get(meshId).addVertexBufferInstanced(
+                rBuffer, 1, 0,
+                GenericGL3D::TransformationMatrix{},
+                GenericGL3D::NormalMatrix{});
+    }
+
+    return rBuffer;
+}
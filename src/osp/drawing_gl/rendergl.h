@@ -25,9 +25,12 @@
 #pragma once
 
 #include "FullscreenTriShader.h"
+#include "OitCompositeShader.h"
 
 #include "../drawing/drawing_fn.h"
+#include "../drawing/render_queue.h"
 
+#include <Magnum/GL/Buffer.h>
 #include <Magnum/GL/Mesh.h>
 #include <Magnum/GL/Texture.h>
 #include <Magnum/GL/Framebuffer.h>
@@ -36,8 +39,11 @@
 #include <Magnum/Trade/MeshData.h>
 #include <Magnum/Trade/ImageData.h>
 
+#include <longeron/id_management/id_set_stl.hpp>
 #include <longeron/id_management/registry_stl.hpp>
 
+#include <vector>
+
 namespace osp::draw
 {
 
@@ -47,6 +53,21 @@ enum class MeshGlId : uint32_t { };
 using TexGlStorage_t    = Storage_t<TexGlId, Magnum::GL::Texture2D>;
 using MeshGlStorage_t   = Storage_t<MeshGlId, Magnum::GL::Mesh>;
 
+/**
+ * @brief Per-instance vertex attributes for instanced drawing
+ *
+ * Matches GenericGL3D TransformationMatrix and NormalMatrix attributes, which are understood by
+ * Magnum's Phong and Flat shaders with InstancedTransformation.
+ *
+ * There's no per-instance color. The instance buffer stays attached to the GL mesh, and a Color4
+ * attribute would replace the mesh's own vertex colors for every shader drawing it afterwards.
+ */
+struct InstanceGL
+{
+    Matrix4                 m_transform;
+    Magnum::Matrix3x3       m_normalMatrix;
+};
+
 /**
  * @brief Main renderer state and essential GL resources
  *
@@ -64,6 +85,17 @@ struct RenderGL
     Magnum::GL::Renderbuffer            m_fboDepthStencil{Corrade::NoCreate};
     Magnum::GL::Framebuffer             m_fbo{Corrade::NoCreate};
 
+    // Order-independent transparency targets, only exist while enabled by SysRenderGL::set_oit.
+    // Shares m_fboDepthStencil with m_fbo.
+    TexGlId                             m_oitAccum{lgrn::id_null<TexGlId>()};
+    TexGlId                             m_oitReveal{lgrn::id_null<TexGlId>()};
+    Magnum::GL::Framebuffer             m_oitFbo{Corrade::NoCreate};
+    OitCompositeShader                  m_oitCompositeShader{Corrade::NoCreate};
+
+    // Draw transparent objects with render_transparent_oit instead of sorting them.
+    // Only change through SysRenderGL::set_oit.
+    bool                                m_useOit{false};
+
     // Renderer-space GL Textures
     lgrn::IdRegistryStl<TexGlId>        m_texIds;
     TexGlStorage_t                      m_texGl;
@@ -80,18 +112,45 @@ struct RenderGL
     IdMap_t<ResId, MeshGlId>            m_resToMesh;
     IdMap_t<MeshGlId, ResIdOwner_t>     m_meshToRes;
 
+    // Instance attribute buffers of GL Meshes that were drawn instanced at least once
+    IdMap_t<MeshGlId, Magnum::GL::Buffer> m_meshInstanceBuf;
+
+    // Resources that have a GL Id, but aren't uploaded yet, oldest first
+    std::vector<ResId>                  m_meshUploadQueue;
+    std::vector<ResId>                  m_texUploadQueue;
+
+    // GL Ids of resources that are uploaded, and are in m_meshGl or m_texGl
+    lgrn::IdSetStl<MeshGlId>            m_meshResident;
+    lgrn::IdSetStl<TexGlId>             m_texResident;
+
+    // Bytes to upload per frame, see SysRenderGL::upload_pending
+    std::size_t                         m_uploadBudget{8u * 1024u * 1024u};
+
 };
 
+/**
+ * @brief GL texture of a DrawEnt
+ *
+ * m_glId is always resident, or null if nothing is resident yet. m_pendingGlId is the texture
+ * that will replace it once uploaded, see SysRenderGL::sync_drawent_pending.
+ */
 struct ACompTexGl
 {
-    TexId       m_scnId     {lgrn::id_null<TexId>()};
-    TexGlId     m_glId      {lgrn::id_null<TexGlId>()};
+    TexId       m_scnId         {lgrn::id_null<TexId>()};
+    TexGlId     m_glId          {lgrn::id_null<TexGlId>()};
+    TexGlId     m_pendingGlId   {lgrn::id_null<TexGlId>()};
 };
 
+/**
+ * @brief GL mesh of a DrawEnt, resident the same way as ACompTexGl
+ *
+ * Switching LODs keeps drawing the previous mesh until the new one is uploaded.
+ */
 struct ACompMeshGl
 {
-    MeshId      m_scnId     {lgrn::id_null<MeshId>()};
-    MeshGlId    m_glId      {lgrn::id_null<MeshGlId>()};
+    MeshId      m_scnId         {lgrn::id_null<MeshId>()};
+    MeshGlId    m_glId          {lgrn::id_null<MeshGlId>()};
+    MeshGlId    m_pendingGlId   {lgrn::id_null<MeshGlId>()};
 };
 
 using MeshGlEntStorage_t    = KeyedVec<DrawEnt, ACompMeshGl>;
@@ -104,6 +163,10 @@ struct ACtxSceneRenderGL
 {
     MeshGlEntStorage_t      m_meshId;
     TexGlEntStorage_t       m_diffuseTexId;
+
+    // DrawEnts that were given an m_pendingGlId. May contain DrawEnts that no longer have one.
+    std::vector<DrawEnt>    m_meshPending;
+    std::vector<DrawEnt>    m_texPending;
 };
 
 /**
@@ -123,6 +186,17 @@ public:
      */
     static void setup_context(RenderGL& rRenderGl);
 
+    /**
+     * @brief Enable or disable order-independent transparency
+     *
+     * Targets and shader for render_transparent_oit are created when enabled, and deleted
+     * when disabled. Call after setup_context.
+     *
+     * @param rRenderGl [ref] Renderer state, with offscreen framebuffer already set up
+     * @param enable    [in] Use render_transparent_oit instead of sorting transparent objects
+     */
+    static void set_oit(RenderGL& rRenderGl, bool enable);
+
     /**
      * @brief Display a fullscreen texture to the default framebuffer
      *
@@ -135,10 +209,15 @@ public:
     static void clear_resource_owners(RenderGL& rRenderGl, Resources& rResources);
 
     /**
-     * @brief Compile GPU-side TexGlIds for textures loaded from a Resource (TexId + ResId)
+     * @brief Compile GPU-side TexGlIds for textures newly loaded from a Resource (TexId + ResId),
+     *        and release ones the scene no longer uses
+     *
+     * Only looks at ACtxDrawingRes::m_texNew and m_texRemoved. New textures only get an Id, and are
+     * uploaded later by upload_pending. Released textures must not be used by any other scene sharing
+     * the same RenderGL.
      *
      * @param rCtxDrawRes   [in] Resources used by the scene
-     * @param rResources    [ref] Application Resources shared with the scene. New resource owners may be created.
+     * @param rResources    [ref] Application Resources shared with the scene. Resource owners may be created or destroyed.
      * @param rRenderGl     [ref] Renderer state
      */
     static void compile_resource_textures(
@@ -147,10 +226,24 @@ public:
             RenderGL& rRenderGl);
 
     /**
-     * @brief Compile GPU-side MeshGlIds for meshes loaded from a Resource (MeshId + ResId)
+     * @brief Compile GPU-side TexGlIds for all textures used by a scene, such as for a fresh
+     *        RenderGL
+     */
+    static void compile_all_resource_textures(
+            ACtxDrawingRes const& rCtxDrawRes,
+            Resources& rResources,
+            RenderGL& rRenderGl);
+
+    /**
+     * @brief Compile GPU-side MeshGlIds for meshes newly loaded from a Resource (MeshId + ResId),
+     *        and release ones the scene no longer uses
+     *
+     * Only looks at ACtxDrawingRes::m_meshNew and m_meshRemoved. New meshes only get an Id, and are
+     * uploaded later by upload_pending. Released meshes must not be used by any other scene sharing
+     * the same RenderGL.
      *
      * @param rCtxDrawRes   [in] Resources used by the scene
-     * @param rResources    [ref] Application Resources shared with the scene. New resource owners may be created.
+     * @param rResources    [ref] Application Resources shared with the scene. Resource owners may be created or destroyed.
      * @param rRenderGl     [ref] Renderer state
      */
     static void compile_resource_meshes(
@@ -158,20 +251,74 @@ public:
             Resources& rResources,
             RenderGL& rRenderGl);
 
+    /**
+     * @brief Compile GPU-side MeshGlIds for all meshes used by a scene, such as for a fresh
+     *        RenderGL
+     */
+    static void compile_all_resource_meshes(
+            ACtxDrawingRes const& rCtxDrawRes,
+            Resources& rResources,
+            RenderGL& rRenderGl);
+
+    /**
+     * @brief Upload meshes and textures queued by the compile functions, oldest first
+     *
+     * Uploaded resources become resident. Until then, DrawEnts keep the resident mesh or texture
+     * they had before, or aren't drawn if they had none. Stops once byteBudget is used up, but
+     * always uploads at least one resource if any are queued.
+     *
+     * @param rRenderGl     [ref] Renderer state
+     * @param rResources    [in] Application Resources with mesh and image data
+     * @param byteBudget    [in] Approximate number of bytes to upload
+     */
+    static void upload_pending(
+            RenderGL& rRenderGl,
+            Resources& rResources,
+            std::size_t byteBudget);
+
+    /**
+     * @brief Upload from the front of a queue until out of budget, then remove what was uploaded
+     *
+     * If nothing was uploaded yet (rUsed is 0), uploads continue until one actually uploads
+     * something, so a resource larger than the budget can't stall the queue.
+     *
+     * @param rQueue    [ref] Resources to upload, oldest first
+     * @param rUsed     [ref] Bytes uploaded so far, added to
+     * @param budget    [in] Bytes to stop at
+     * @param upload    [in] Callable (ResId) -> std::size_t, uploads a resource and returns
+     *                       its size in bytes, or 0 if there was nothing to upload
+     */
+    template <typename UPLOAD_T>
+    static void upload_queue(std::vector<ResId>& rQueue, std::size_t& rUsed, std::size_t const budget, UPLOAD_T&& upload)
+    {
+        std::size_t done = 0;
+        while (done < rQueue.size() && (rUsed < budget || rUsed == 0))
+        {
+            rUsed += upload(rQueue[done]);
+            ++done;
+        }
+        rQueue.erase(rQueue.begin(), rQueue.begin() + std::ptrdiff_t(done));
+    }
+
     /**
      * @brief Synchronize an entity's MeshId component to an ACompMeshGl
      *
+     * Meshes that aren't resident yet are set as the m_pendingGlId, and the entity is added to
+     * m_meshPending.
+     *
      * @param ent           [in] DrawEnt with mesh to synchronize
      * @param cmpMeshIds    [in] Scene Mesh Id component
+     * @param lodMeshIds    [in] Selected LOD meshes, used over cmpMeshIds where not null
      * @param meshToRes     [in] Scene's Mesh Id to Resource Id
-     * @param rCmpMeshGl    [ref] Renderer-side ACompMeshGl components
+     * @param rScnRenderGl  [ref] Renderer-side ACompMeshGl components and pending DrawEnts
      * @param rRenderGl     [ref] Renderer state
      */
     static void sync_drawent_mesh(
             DrawEnt                                     ent,
             KeyedVec<DrawEnt, MeshIdOwner_t> const&     cmpMeshIds,
+            KeyedVec<DrawEnt, MeshId> const&            lodMeshIds,
             IdMap_t<MeshId, ResIdOwner_t> const&        meshToRes,
-            MeshGlEntStorage_t&                         rCmpMeshGl,
+            ACtxSceneRenderGL&                          rScnRenderGl,
             RenderGL&                                   rRenderGl);
 
     template <typename ITA_T, typename ITB_T>
@@ -179,30 +326,34 @@ public:
             ITA_T const&                                first,
             ITB_T const&                                last,
             KeyedVec<DrawEnt, MeshIdOwner_t> const&     cmpMeshIds,
+            KeyedVec<DrawEnt, MeshId> const&            lodMeshIds,
             IdMap_t<MeshId, ResIdOwner_t> const&        meshToRes,
-            MeshGlEntStorage_t&                         rCmpMeshGl,
+            ACtxSceneRenderGL&                          rScnRenderGl,
             RenderGL&                                   rRenderGl)
     {
         std::for_each(first, last, [&] (DrawEnt const ent)
         {
-            sync_drawent_mesh(ent, cmpMeshIds, meshToRes, rCmpMeshGl, rRenderGl);
+            sync_drawent_mesh(ent, cmpMeshIds, lodMeshIds, meshToRes, rScnRenderGl, rRenderGl);
         });
     }
 
     /**
      * @brief Synchronize entities with a TexId component to an ACompTexGl
      *
+     * Textures that aren't resident yet are set as the m_pendingGlId, and the entity is added to
+     * m_texPending.
+     *
+     * @param ent           [in] DrawEnt with texture to synchronize
      * @param cmpTexIds     [in] Scene Texture Id component
-     * @param meshToRes     [in] Scene's Texture Id to Resource Id
-     * @param entsDirty     [in] Entities to synchronize
-     * @param rCmpTexGl     [ref] Renderer-side ACompTexGl components
+     * @param texToRes      [in] Scene's Texture Id to Resource Id
+     * @param rScnRenderGl  [ref] Renderer-side ACompTexGl components and pending DrawEnts
      * @param rRenderGl     [ref] Renderer state
      */
     static void sync_drawent_texture(
             DrawEnt                                     ent,
             KeyedVec<DrawEnt, TexIdOwner_t> const&      cmpTexIds,
             IdMap_t<TexId, ResIdOwner_t> const&         texToRes,
-            TexGlEntStorage_t&                          rCmpTexGl,
+            ACtxSceneRenderGL&                          rScnRenderGl,
             RenderGL&                                   rRenderGl);
 
     template <typename ITA_T, typename ITB_T>
@@ -211,15 +362,25 @@ public:
             ITB_T const&                                last,
             KeyedVec<DrawEnt, TexIdOwner_t> const&      cmpTexIds,
             IdMap_t<TexId, ResIdOwner_t> const&         texToRes,
-            TexGlEntStorage_t&                          rCmpTexGl,
+            ACtxSceneRenderGL&                          rScnRenderGl,
             RenderGL&                                   rRenderGl)
     {
         std::for_each(first, last, [&] (DrawEnt const ent)
         {
-            sync_drawent_texture(ent, cmpTexIds, texToRes, rCmpTexGl, rRenderGl);
+            sync_drawent_texture(ent, cmpTexIds, texToRes, rScnRenderGl, rRenderGl);
         });
     }
 
+    /**
+     * @brief Switch pending DrawEnts over to meshes and textures that became resident
+     *
+     * Call after upload_pending.
+     *
+     * @param rScnRenderGl  [ref] Renderer-side components and pending DrawEnts
+     * @param renderGl      [in] Renderer state
+     */
+    static void sync_drawent_pending(ACtxSceneRenderGL& rScnRenderGl, RenderGL const& renderGl);
+
     /**
      * @brief Call draw functions of a RenderGroup of opaque objects
      *
@@ -232,10 +393,26 @@ public:
             DrawEntSet_t const& visible,
             ViewProjMatrix const& viewProj);
 
+    /**
+     * @brief Call draw functions of opaque objects in the order of a sorted RenderQueue
+     *
+     * Draws that share a shader, mesh, or texture are next to each other in the queue. Magnum
+     * tracks bound programs, meshes, and textures, so binding the same one again is skipped.
+     *
+     * @param group     [in] RenderGroup the queue was built from
+     * @param queue     [in] Sorted queue, see SysRenderQueue
+     * @param viewProj  [in] View and projection matrix
+     */
+    static void render_opaque(
+            RenderGroup const& group,
+            RenderQueue const& queue,
+            ViewProjMatrix const& viewProj);
+
     /**
      * @brief Call draw functions of a RenderGroup of transparent objects
      *
-     * Consider sorting the render group for correct transparency
+     * Objects are drawn in storage order and can blend incorrectly where they overlap. Prefer
+     * the overload with a RenderQueue, or render_transparent_oit.
      *
      * @param group     [in] RenderGroup to draw
      * @param visible   [in] Storage for visible components
@@ -246,11 +423,92 @@ public:
             DrawEntSet_t const& visible,
             ViewProjMatrix const& viewProj);
 
+    /**
+     * @brief Call draw functions of transparent objects in the order of a sorted RenderQueue
+     *
+     * Build the queue with ArgsForBuild::backToFront, so further objects are drawn first. Depth
+     * is tested but not written.
+     *
+     * @param group     [in] RenderGroup the queue was built from
+     * @param queue     [in] Queue sorted back to front, see SysRenderQueue
+     * @param viewProj  [in] View and projection matrix
+     */
+    static void render_transparent(
+            RenderGroup const& group,
+            RenderQueue const& queue,
+            ViewProjMatrix const& viewProj);
+
+    /**
+     * @brief Draw transparent objects with blended order-independent transparency, then
+     *        composite them over m_fbo
+     *
+     * No sorting is needed. The group is drawn twice: once adding up alpha-weighted color and
+     * alpha into an accumulation target, and once multiplying one minus alpha into a revealage
+     * target. Overlapping surfaces come out as their alpha-weighted average rather than exactly
+     * layered, which is hard to tell apart for effects like plumes.
+     *
+     * Requires OIT to be enabled with set_oit. Binds m_fbo when done.
+     *
+     * @param rRenderGl [ref] Renderer state
+     * @param group     [in] RenderGroup to draw
+     * @param visible   [in] Storage for visible components
+     * @param viewProj  [in] View and projection matrix
+     */
+    static void render_transparent_oit(
+            RenderGL& rRenderGl,
+            RenderGroup const& group,
+            DrawEntSet_t const& visible,
+            ViewProjMatrix const& viewProj);
+
     static void draw_group(
             RenderGroup const& group,
             DrawEntSet_t const& visible,
             ViewProjMatrix const& viewProj);
 
+    /**
+     * @brief Call draw functions in the order of a RenderQueue
+     *
+     * Runs of consecutive entities with the same draw state (key bits in RenderQueue::stateMask)
+     * and a drawBatch function are passed to drawBatch all at once, along with their DrawPackets
+     * if they were prepared.
+     */
+    static void draw_queue(
+            RenderGroup const& group,
+            RenderQueue const& queue,
+            ViewProjMatrix const& viewProj);
+
+    /**
+     * @brief Get the instance attribute buffer of a GL Mesh, creating and attaching it to the
+     *        mesh on first use
+     */
+    static Magnum::GL::Buffer& instance_buffer(RenderGL& rRenderGl, MeshGlId meshId);
+
+    /**
+     * @brief Draw many instances of a GL Mesh with a single draw call
+     *
+     * @param rRenderGl [ref] Renderer state
+     * @param meshId    [in] Mesh to draw
+     * @param instances [in] Per-instance attributes, uploaded to the mesh's instance buffer
+     * @param rShader   [ref] Shader with InstancedTransformation, uniforms already set
+     */
+    template <typename SHADER_T>
+    static void draw_instanced(
+            RenderGL&                       rRenderGl,
+            MeshGlId                        meshId,
+            ArrayView<InstanceGL const>     instances,
+            SHADER_T&                       rShader)
+    {
+        Magnum::GL::Buffer &rBuffer = instance_buffer(rRenderGl, meshId);
+        Magnum::GL::Mesh   &rMesh   = rRenderGl.m_meshGl.get(meshId);
+
+        rBuffer.setData(instances, Magnum::GL::BufferUsage::StreamDraw);
+        rMesh.setInstanceCount(Magnum::Int(instances.size()));
+        rShader.draw(rMesh);
+
+        // Leave the mesh as it was, for shaders that don't use instancing
+        rMesh.setInstanceCount(1);
+    }
+
 };
 
 } // namespace osp::draw
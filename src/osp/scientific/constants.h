@@ -29,4 +29,7 @@ namespace osp::phys::constants
 
 constexpr float g_0 = 9.80665f;
 
+// Gravitational constant, m^3 / (kg * s^2)
+constexpr double G = 6.67430e-11;
+
 } // namespace osp::phys
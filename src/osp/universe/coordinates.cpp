@@ -0,0 +1,373 @@
+/**
+ * Open Space Program
+ * Copyright © 2019-2024 Open Space Program Project
+ *
+ * MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include "coordinates.h"
+
+#include <algorithm>
+#include <cassert>
+
+namespace osp::universe
+{
+
+namespace
+{
+
+//-----------------------------------------------------------------------------
+
+// Batch transforms
+
+/**
+ * @brief CoordTransformer with rotations converted to row-major 3x3 matrices
+ */
+struct BatchTransformer
+{
+    std::array<double, 9>   m_rotIn;
+    std::array<double, 9>   m_rotOut;
+    Vector3g                m_cm;       // c * 2^m, already applied
+    spaceint_t              m_mulN;     // 2^n if n >= 0
+    int                     m_shiftN;   // -n if n < 0
+};
+
+std::array<double, 9> quat_to_matrix(Quaterniond const q) noexcept
+{
+    // Matches Quaternion::transformVector, which doesn't assume q is normalized
+    double const x = q.vector().x();
+    double const y = q.vector().y();
+    double const z = q.vector().z();
+    double const w = q.scalar();
+    double const s = 2.0 / q.dot();
+
+    return { 1.0 - s*(y*y + z*z),   s*(x*y - z*w),          s*(x*z + y*w),
+             s*(x*y + z*w),         1.0 - s*(x*x + z*z),    s*(y*z - x*w),
+             s*(x*z - y*w),         s*(y*z + x*w),          1.0 - s*(x*x + y*y) };
+}
+
+BatchTransformer make_batch_transformer(CoordTransformer const& tf) noexcept
+{
+    return {
+        .m_rotIn    = quat_to_matrix(tf.m_rotIn),
+        .m_rotOut   = quat_to_matrix(tf.m_rotOut),
+        .m_cm       = math::mul_2pow<Vector3g, spaceint_t>(tf.m_c, tf.m_m),
+        .m_mulN     = (tf.m_n >= 0) ? math::int_2pow<spaceint_t>(tf.m_n) : 1,
+        .m_shiftN   = (tf.m_n < 0)  ? -tf.m_n : 0
+    };
+}
+
+inline void rotate_in_place(std::array<double, 9> const& r, spaceint_t &rX, spaceint_t &rY, spaceint_t &rZ) noexcept
+{
+    double const x = double(rX);
+    double const y = double(rY);
+    double const z = double(rZ);
+    rX = spaceint_t(r[0]*x + r[1]*y + r[2]*z);
+    rY = spaceint_t(r[3]*x + r[4]*y + r[5]*z);
+    rZ = spaceint_t(r[6]*x + r[7]*y + r[8]*z);
+}
+
+/**
+ * @brief Integer division by 2^shift that rounds towards zero, same as operator/
+ */
+constexpr spaceint_t div_2pow(spaceint_t const value, int const shift) noexcept
+{
+    spaceint_t const bias = (value >> 63) & ((spaceint_t(1) << shift) - 1);
+    return (value + bias) >> shift;
+}
+
+/**
+ * @brief Apply a BatchTransformer to count positions
+ *
+ * Rotations and the sign of n are template parameters, so none of these checks happen per
+ * position. READ_T and WRITE_T are either raw pointer or strided accesses.
+ */
+template <bool ROT_IN_T, bool ROT_OUT_T, bool SHIFT_T, typename READ_T, typename WRITE_T>
+void transform_batch(BatchTransformer const& bt, std::size_t const count, READ_T const& read, WRITE_T const& write) noexcept
+{
+    Vector3g const      cm      = bt.m_cm;
+    spaceint_t const    mulN    = bt.m_mulN;
+    int const           shiftN  = bt.m_shiftN;
+
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        spaceint_t x, y, z;
+        read(i, x, y, z);
+
+        if constexpr (ROT_IN_T)
+        {
+            rotate_in_place(bt.m_rotIn, x, y, z);
+        }
+
+        if constexpr (SHIFT_T)
+        {
+            x = div_2pow(x, shiftN) + cm.x();
+            y = div_2pow(y, shiftN) + cm.y();
+            z = div_2pow(z, shiftN) + cm.z();
+        }
+        else
+        {
+            x = x * mulN + cm.x();
+            y = y * mulN + cm.y();
+            z = z * mulN + cm.z();
+        }
+
+        if constexpr (ROT_OUT_T)
+        {
+            rotate_in_place(bt.m_rotOut, x, y, z);
+        }
+
+        write(i, x, y, z);
+    }
+}
+
+template <bool ROT_IN_T, bool ROT_OUT_T, typename READ_T, typename WRITE_T>
+void transform_batch_shift(BatchTransformer const& bt, std::size_t const count, READ_T const& read, WRITE_T const& write) noexcept
+{
+    if (bt.m_shiftN != 0)
+    {
+        transform_batch<ROT_IN_T, ROT_OUT_T, true>(bt, count, read, write);
+    }
+    else
+    {
+        transform_batch<ROT_IN_T, ROT_OUT_T, false>(bt, count, read, write);
+    }
+}
+
+template <typename WRITE_T>
+void transform_batch_dispatch(CoordTransformer const& tf, SatPosViewsConst_t const& in, WRITE_T const& write) noexcept
+{
+    BatchTransformer const  bt      = make_batch_transformer(tf);
+    std::size_t const       count   = in[0].size();
+    bool const              rotIn   = quat_non_zero(tf.m_rotIn);
+    bool const              rotOut  = quat_non_zero(tf.m_rotOut);
+
+    auto const dispatch = [&bt, count, rotIn, rotOut, &write] (auto const& read)
+    {
+        if (rotIn && rotOut)    { transform_batch_shift<true,  true> (bt, count, read, write); }
+        else if (rotIn)         { transform_batch_shift<true,  false>(bt, count, read, write); }
+        else if (rotOut)        { transform_batch_shift<false, true> (bt, count, read, write); }
+        else                    { transform_batch_shift<false, false>(bt, count, read, write); }
+    };
+
+    if (in[0].isContiguous() && in[1].isContiguous() && in[2].isContiguous())
+    {
+        spaceint_t const *const pX = in[0].asContiguous().data();
+        spaceint_t const *const pY = in[1].asContiguous().data();
+        spaceint_t const *const pZ = in[2].asContiguous().data();
+
+        dispatch([pX, pY, pZ] (std::size_t const i, spaceint_t &rX, spaceint_t &rY, spaceint_t &rZ) noexcept
+        {
+            rX = pX[i];
+            rY = pY[i];
+            rZ = pZ[i];
+        });
+    }
+    else
+    {
+        dispatch([&in] (std::size_t const i, spaceint_t &rX, spaceint_t &rY, spaceint_t &rZ) noexcept
+        {
+            rX = in[0][i];
+            rY = in[1][i];
+            rZ = in[2][i];
+        });
+    }
+}
+
+//-----------------------------------------------------------------------------
+
+// Paths between CoSpaces
+
+void find_ancestors(Universe const& universe, CoSpaceId id, std::vector<CoSpaceId>& rOut)
+{
+    rOut.clear();
+    while (id != lgrn::id_null<CoSpaceId>() && universe.m_coordIds.exists(id))
+    {
+        rOut.push_back(id);
+        id = universe.m_coordCommon[id].m_parent;
+    }
+}
+
+/**
+ * @brief Path from src up to the common ancestor, then down to dst
+ */
+struct CoSpacePath
+{
+    std::size_t m_srcUp;    // src ancestors index of common ancestor
+    std::size_t m_dstDown;  // dst ancestors index of common ancestor
+};
+
+CoSpacePath find_common_ancestor(std::vector<CoSpaceId> const& srcAncestors, std::vector<CoSpaceId> const& dstAncestors)
+{
+    for (std::size_t srcUp = 0; srcUp < srcAncestors.size(); ++srcUp)
+    {
+        auto const found = std::find(dstAncestors.begin(), dstAncestors.end(), srcAncestors[srcUp]);
+        if (found != dstAncestors.end())
+        {
+            return { srcUp, std::size_t(std::distance(dstAncestors.begin(), found)) };
+        }
+    }
+
+    assert(false && "CoSpaces don't share a common root");
+    return { 0, 0 };
+}
+
+CoordTransformer build_transformer(
+        Universe const&                 universe,
+        std::vector<CoSpaceId> const&   srcAncestors,
+        std::vector<CoSpaceId> const&   dstAncestors,
+        CoSpacePath const               path)
+{
+    CoordTransformer out;
+    bool empty = true;
+
+    auto const append = [&out, &empty] (CoordTransformer const& next)
+    {
+        // Avoid compositing with an identity, which can round c for no reason
+        out   = empty ? next : coord_composite(next, out);
+        empty = false;
+    };
+
+    // Up from src to common ancestor
+    for (std::size_t i = 0; i < path.m_srcUp; ++i)
+    {
+        CoSpaceTransform const &child  = universe.m_coordCommon[srcAncestors[i]];
+        CoSpaceTransform const &parent = universe.m_coordCommon[srcAncestors[i + 1]];
+        append(coord_child_to_parent(parent, child));
+    }
+
+    // Down from common ancestor to dst
+    for (std::size_t i = path.m_dstDown; i != 0; --i)
+    {
+        CoSpaceTransform const &parent = universe.m_coordCommon[dstAncestors[i]];
+        CoSpaceTransform const &child  = universe.m_coordCommon[dstAncestors[i - 1]];
+        append(coord_parent_to_child(parent, child));
+    }
+
+    return out;
+}
+
+bool path_unchanged(Universe const& universe, std::vector<CoordTransformCache::PathNode> const& path) noexcept
+{
+    return std::all_of(path.begin(), path.end(), [&universe] (CoordTransformCache::PathNode const& node)
+    {
+        if ( ! universe.m_coordIds.exists(node.m_id) )
+        {
+            return false;
+        }
+        return universe.m_coordCommon[node.m_id].m_transformGen == node.m_transformGen;
+    });
+}
+
+constexpr uint64_t cache_key(CoSpaceId const src, CoSpaceId const dst) noexcept
+{
+    return (uint64_t(src) << 32) | uint64_t(dst);
+}
+
+} // namespace
+
+void coord_transform_positions(CoordTransformer const& tf, SatPosViewsConst_t const& in, SatPosViews_t const& out) noexcept
+{
+    assert(out[0].size() == in[0].size());
+
+    transform_batch_dispatch(tf, in, [&out] (std::size_t const i, spaceint_t const x, spaceint_t const y, spaceint_t const z) noexcept
+    {
+        out[0][i] = x;
+        out[1][i] = y;
+        out[2][i] = z;
+    });
+}
+
+void coord_transform_positions_meters(
+        CoordTransformer const&     tf,
+        SatPosViewsConst_t const&   in,
+        double const                metersPerUnit,
+        ArrayView<Vector3> const    out) noexcept
+{
+    assert(out.size() == in[0].size());
+
+    Vector3 *const pOut = out.data();
+
+    transform_batch_dispatch(tf, in, [pOut, metersPerUnit] (std::size_t const i, spaceint_t const x, spaceint_t const y, spaceint_t const z) noexcept
+    {
+        pOut[i] = Vector3{ float(double(x) * metersPerUnit),
+                           float(double(y) * metersPerUnit),
+                           float(double(z) * metersPerUnit) };
+    });
+}
+
+CoordTransformer coord_transformer_between(Universe const& universe, CoSpaceId const src, CoSpaceId const dst)
+{
+    std::vector<CoSpaceId> srcAncestors;
+    std::vector<CoSpaceId> dstAncestors;
+    find_ancestors(universe, src, srcAncestors);
+    find_ancestors(universe, dst, dstAncestors);
+
+    return build_transformer(universe, srcAncestors, dstAncestors, find_common_ancestor(srcAncestors, dstAncestors));
+}
+
+CoordTransformer const& coord_cached_transformer(
+        CoordTransformCache&    rCache,
+        Universe const&         universe,
+        CoSpaceId const         src,
+        CoSpaceId const         dst)
+{
+    CoordTransformCache::Entry &rEntry = rCache.m_entries[cache_key(src, dst)];
+
+    if ( ! rEntry.m_path.empty() && path_unchanged(universe, rEntry.m_path) )
+    {
+        return rEntry.m_transformer;
+    }
+
+    find_ancestors(universe, src, rCache.m_srcAncestors);
+    find_ancestors(universe, dst, rCache.m_dstAncestors);
+    CoSpacePath const path = find_common_ancestor(rCache.m_srcAncestors, rCache.m_dstAncestors);
+
+    rEntry.m_transformer = build_transformer(universe, rCache.m_srcAncestors, rCache.m_dstAncestors, path);
+
+    // Remember everything the transformer depends on: src up to and including the common
+    // ancestor, then everything below it towards dst
+    auto const record = [&rEntry, &universe] (CoSpaceId const id)
+    {
+        rEntry.m_path.push_back({ .m_id = id, .m_transformGen = universe.m_coordCommon[id].m_transformGen });
+    };
+
+    rEntry.m_path.clear();
+    std::for_each(rCache.m_srcAncestors.begin(), rCache.m_srcAncestors.begin() + path.m_srcUp + 1, record);
+    std::for_each(rCache.m_dstAncestors.begin(), rCache.m_dstAncestors.begin() + path.m_dstDown,   record);
+
+    return rEntry.m_transformer;
+}
+
+void coord_cache_invalidate(CoordTransformCache& rCache, CoSpaceId const coSpace)
+{
+    for (auto it = rCache.m_entries.begin(); it != rCache.m_entries.end(); )
+    {
+        auto const &path = it->second.m_path;
+        bool const passesThrough = std::any_of(path.begin(), path.end(), [coSpace] (CoordTransformCache::PathNode const& node)
+        {
+            return node.m_id == coSpace;
+        });
+
+        it = passesThrough ? rCache.m_entries.erase(it) : std::next(it);
+    }
+}
+
+} // namespace osp::universe
@@ -26,8 +26,12 @@
 
 #include "universe.h"
 
+#include "../core/array_view.h"
+#include "../core/id_map.h"
 #include "../core/math_2pow.h"
 
+#include <vector>
+
 namespace osp::universe
 {
 
@@ -307,4 +311,87 @@ inline CoordTransformer coord_child_to_parent(
     };
 }
 
-}
+/**
+ * @brief Transform many positions with the same CoordTransformer
+ *
+ * Rotations are converted to matrices once, and the per-position loop is branchless. Results
+ * may differ from CoordTransformer::transform_position by a unit due to rounding.
+ *
+ * @param tf    [in] Transformer to apply
+ * @param in    [in] Positions to transform
+ * @param out   [out] Transformed positions, same count as in. May alias in
+ */
+void coord_transform_positions(CoordTransformer const& tf, SatPosViewsConst_t const& in, SatPosViews_t const& out) noexcept;
+
+/**
+ * @brief Transform many positions with the same CoordTransformer, then convert them to meters
+ *
+ * Intended for converting satellite positions into scene space for rendering.
+ *
+ * @param tf            [in] Transformer to apply
+ * @param in            [in] Positions to transform
+ * @param metersPerUnit [in] Size of a destination position unit in meters, 2^(-precision)
+ * @param out           [out] Transformed positions in meters, same count as in
+ */
+void coord_transform_positions_meters(
+        CoordTransformer const&     tf,
+        SatPosViewsConst_t const&   in,
+        double                      metersPerUnit,
+        ArrayView<Vector3>          out) noexcept;
+
+/**
+ * @brief Cached CoordTransformers between pairs of CoSpaces within a Universe
+ *
+ * Each entry remembers CoSpaceCommon::m_transformGen of every CoSpace along its path, and is
+ * recalculated once any of them changes. Writes to a CoSpace's transform or hierarchy must be
+ * followed by coord_transform_changed.
+ */
+struct CoordTransformCache
+{
+    struct PathNode
+    {
+        CoSpaceId           m_id;
+        uint32_t            m_transformGen;
+    };
+
+    struct Entry
+    {
+        CoordTransformer        m_transformer;
+        std::vector<PathNode>   m_path;
+    };
+
+    // Key is (source << 32) | destination
+    IdMap_t<uint64_t, Entry> m_entries;
+
+    // Scratch space for finding a common ancestor
+    std::vector<CoSpaceId> m_srcAncestors;
+    std::vector<CoSpaceId> m_dstAncestors;
+};
+
+/**
+ * @brief Calculate a CoordTransformer from one CoSpace to another by finding their common
+ *        ancestor, without caching
+ *
+ * Both CoSpaces must share the same root. Child CoSpace transforms are expected to be up to date
+ * with their parent satellites, see coord_sync_parent_sat.
+ */
+CoordTransformer coord_transformer_between(Universe const& universe, CoSpaceId src, CoSpaceId dst);
+
+/**
+ * @brief Get a CoordTransformer from one CoSpace to another, only recalculating it if any
+ *        CoSpace along the path has changed since the last call
+ *
+ * @return Reference to cached transformer, valid until the next call that modifies rCache
+ */
+CoordTransformer const& coord_cached_transformer(
+        CoordTransformCache&    rCache,
+        Universe const&         universe,
+        CoSpaceId               src,
+        CoSpaceId               dst);
+
+/**
+ * @brief Remove all cached entries that pass through a CoSpace, such as when it is deleted
+ */
+void coord_cache_invalidate(CoordTransformCache& rCache, CoSpaceId coSpace);
+
+} // namespace osp::universe
@@ -0,0 +1,196 @@
+/**
+ * Open Space Program
+ * Copyright © 2019-2024 Open Space Program Project
+ *
+ * MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include "hierarchy.h"
+#include "coordinates.h"
+#include "integrators.h"
+#include "kepler.h"
+
+#include "../core/math_2pow.h"
+
+#include <algorithm>
+#include <cassert>
+
+namespace osp::universe
+{
+
+namespace
+{
+
+constexpr uint32_t gc_depthUnknown = lgrn::id_null<uint32_t>();
+
+uint32_t calc_depth(std::vector<uint32_t>& rDepths, Universe const& universe, CoSpaceId const id)
+{
+    uint32_t &rDepth = rDepths[id];
+    if (rDepth != gc_depthUnknown)
+    {
+        return rDepth;
+    }
+
+    CoSpaceId const parent = universe.m_coordCommon[id].m_parent;
+
+    if (parent == lgrn::id_null<CoSpaceId>() || ! universe.m_coordIds.exists(parent))
+    {
+        rDepth = 0;
+    }
+    else
+    {
+        // Recursion depth is limited by how deeply CoSpaces are nested, which is usually small
+        assert(parent != id && "CoSpace can't be its own parent");
+        rDepth = calc_depth(rDepths, universe, parent) + 1;
+    }
+
+    return rDepth;
+}
+
+} // namespace
+
+void coord_levels_build(CoSpaceLevels& rLevels, Universe const& universe)
+{
+    std::size_t const capacity = universe.m_coordIds.capacity();
+
+    rLevels.m_depths.assign(capacity, gc_depthUnknown);
+    rLevels.m_order.clear();
+    rLevels.m_levelFirst.clear();
+
+    uint32_t maxDepth = 0;
+    std::size_t count = 0;
+    for (CoSpaceId id = 0; id < capacity; ++id)
+    {
+        if (universe.m_coordIds.exists(id))
+        {
+            maxDepth = std::max(maxDepth, calc_depth(rLevels.m_depths, universe, id));
+            ++count;
+        }
+    }
+
+    if (count == 0)
+    {
+        return;
+    }
+
+    // Counting sort by depth. m_levelFirst starts off as counts per level, then is turned into
+    // offsets, then used as write cursors shifted by one level.
+    rLevels.m_levelFirst.assign(maxDepth + 2, 0);
+    for (CoSpaceId id = 0; id < capacity; ++id)
+    {
+        if (universe.m_coordIds.exists(id))
+        {
+            ++rLevels.m_levelFirst[rLevels.m_depths[id] + 1];
+        }
+    }
+
+    for (std::size_t i = 1; i < rLevels.m_levelFirst.size(); ++i)
+    {
+        rLevels.m_levelFirst[i] += rLevels.m_levelFirst[i - 1];
+    }
+
+    rLevels.m_order.resize(count);
+    std::vector<uint32_t> cursors(rLevels.m_levelFirst.begin(), rLevels.m_levelFirst.end() - 1);
+    for (CoSpaceId id = 0; id < capacity; ++id)
+    {
+        if (universe.m_coordIds.exists(id))
+        {
+            rLevels.m_order[cursors[rLevels.m_depths[id]]++] = id;
+        }
+    }
+}
+
+void coord_sync_parent_sat(CoSpaceCommon& rChild, CoSpaceCommon const& parent) noexcept
+{
+    if (   rChild.m_parentSat == lgrn::id_null<SatId>()
+        || parent.m_satPositions[0].not_used()
+        || parent.m_satRotations[0].not_used())
+    {
+        return;
+    }
+
+    assert(rChild.m_parentSat < parent.m_satCount);
+
+    auto const [x, y, z]        = sat_views(parent.m_satPositions, parent.m_data, parent.m_satCount);
+    auto const [qx, qy, qz, qw] = sat_views(parent.m_satRotations, parent.m_data, parent.m_satCount);
+
+    static_cast<CoSpaceTransform&>(rChild) = coord_get_transform(rChild, rChild, x, y, z, qx, qy, qz, qw);
+    coord_transform_changed(rChild);
+}
+
+void coord_step_sats(CoSpaceCommon& rCommon, double const deltaTime) noexcept
+{
+    if (   rCommon.m_satCount == 0
+        || rCommon.m_satPositions[0].not_used()
+        || rCommon.m_satVelocities[0].not_used())
+    {
+        return;
+    }
+
+    SatPosViews_t const pos = sat_views(rCommon.m_satPositions,  rCommon.m_data, rCommon.m_satCount);
+    SatVelViews_t const vel = sat_views(rCommon.m_satVelocities, rCommon.m_data, rCommon.m_satCount);
+
+    sat_integrate_positions(pos, vel, math::mul_2pow<double, int>(deltaTime, rCommon.m_precision));
+}
+
+void coord_step_range(
+        Universe&                       rUniverse,
+        ArrayView<CoSpaceId const> const spaces,
+        ArrayView<SatDynamics const> const dynamics,
+        SatIntegratorScratch&           rScratch,
+        double const                    deltaTime)
+{
+    for (CoSpaceId const id : spaces)
+    {
+        CoSpaceCommon &rCommon = rUniverse.m_coordCommon[id];
+
+        CoSpaceId const parent = rCommon.m_parent;
+        if (parent != lgrn::id_null<CoSpaceId>() && rUniverse.m_coordIds.exists(parent))
+        {
+            CoSpaceCommon const &rParent = rUniverse.m_coordCommon[parent];
+            coord_sync_parent_sat(rCommon, rParent);
+
+            // Parent satellite's position in m_data is stale if it's on rails. Other CoSpaces in
+            // this level may share the same parent, so calculate it without writing to it.
+            SatRails const *pParentRails = (parent < dynamics.size()) ? dynamics[parent].m_pRails : nullptr;
+            if (   pParentRails != nullptr
+                && ! rParent.m_satRotations[0].not_used()
+                && sat_rails_on_rails(*pParentRails, rCommon.m_parentSat))
+            {
+                rCommon.m_position = sat_rails_position(rParent, *pParentRails, rCommon.m_parentSat);
+            }
+        }
+
+        if (id < dynamics.size() && dynamics[id].m_pRails != nullptr)
+        {
+            sat_rails_integrate(rCommon, *dynamics[id].m_pRails, dynamics[id], rScratch, deltaTime);
+        }
+        else if (id < dynamics.size() && ! dynamics[id].m_models.empty())
+        {
+            sat_integrate(rCommon, dynamics[id], rScratch, deltaTime);
+        }
+        else
+        {
+            coord_step_sats(rCommon, deltaTime);
+        }
+    }
+}
+
+} // namespace osp::universe
@@ -0,0 +1,111 @@
+/**
+ * Open Space Program
+ * Copyright © 2019-2024 Open Space Program Project
+ *
+ * MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#pragma once
+
+#include "integrators.h"
+#include "universe.h"
+
+#include "../core/array_view.h"
+
+#include <vector>
+
+namespace osp::universe
+{
+
+/**
+ * @brief CoSpaces grouped by depth in the CoSpaceHierarchy tree
+ *
+ * CoSpaces within the same level never depend on each other, so each level can be updated in
+ * parallel once all levels before it are done.
+ */
+struct CoSpaceLevels
+{
+    std::size_t level_count() const noexcept
+    {
+        return m_levelFirst.empty() ? 0 : m_levelFirst.size() - 1;
+    }
+
+    ArrayView<CoSpaceId const> level(std::size_t const depth) const noexcept
+    {
+        return {m_order.data() + m_levelFirst[depth], m_levelFirst[depth + 1] - m_levelFirst[depth]};
+    }
+
+    // All existing CoSpaces, roots first, then their children, then grandchildren, etc...
+    std::vector<CoSpaceId>  m_order;
+
+    // m_order[m_levelFirst[depth]] to m_order[m_levelFirst[depth + 1]] are CoSpaces at depth
+    std::vector<uint32_t>   m_levelFirst;
+
+    // Scratch space, depth of each CoSpace by ID
+    std::vector<uint32_t>   m_depths;
+};
+
+/**
+ * @brief Sort all CoSpaces in a Universe by their depth in the hierarchy
+ *
+ * CoSpaces with a null or nonexistent parent are roots. The hierarchy must not contain cycles.
+ *
+ * @param rLevels   [out] Levels to overwrite, existing allocations are reused
+ * @param universe  [in] Universe to read hierarchy from
+ */
+void coord_levels_build(CoSpaceLevels& rLevels, Universe const& universe);
+
+/**
+ * @brief Overwrite a CoSpace's transform with its parent satellite's position and rotation
+ *
+ * Does nothing if the CoSpace has no parent satellite, or if the parent has no rotation data.
+ */
+void coord_sync_parent_sat(CoSpaceCommon& rChild, CoSpaceCommon const& parent) noexcept;
+
+/**
+ * @brief Move a CoSpace's satellites along their velocities
+ *
+ * @param rCommon   [ref] CoSpace to update
+ * @param deltaTime [in] Time step in seconds
+ */
+void coord_step_sats(CoSpaceCommon& rCommon, double deltaTime) noexcept;
+
+/**
+ * @brief Update a range of CoSpaces within the same level
+ *
+ * Each CoSpace first takes its transform from its parent satellite, then moves its own
+ * satellites. Only CoSpaces in the range are written to, and their parents are only read from.
+ *
+ * @param rUniverse [ref] Universe containing the CoSpaces
+ * @param spaces    [in] CoSpaces to update, all from the same level of CoSpaceLevels
+ * @param dynamics  [in] Acceleration models and integrators, indexed by CoSpaceId. CoSpaces past
+ *                       the end or without models only drift along their velocities. CoSpaces
+ *                       with SatRails only integrate their active satellites.
+ * @param rScratch  [ref] Temporary buffers for sat_integrate
+ * @param deltaTime [in] Time step in seconds
+ */
+void coord_step_range(
+        Universe&                   rUniverse,
+        ArrayView<CoSpaceId const>  spaces,
+        ArrayView<SatDynamics const> dynamics,
+        SatIntegratorScratch&       rScratch,
+        double                      deltaTime);
+
+} // namespace osp::universe
@@ -0,0 +1,399 @@
+/**
+ * Open Space Program
+ * Copyright © 2019-2024 Open Space Program Project
+ *
+ * MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include "integrators.h"
+
+#include "../core/math_2pow.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+namespace osp::universe
+{
+
+namespace
+{
+
+template <typename T>
+bool all_contiguous(std::array<T, 3> const& views) noexcept
+{
+    return views[0].isContiguous() && views[1].isContiguous() && views[2].isContiguous();
+}
+
+void integrate_column_scalar(
+        spaceint_t* const pPos, double const* const pVel, std::size_t first, std::size_t const last, double const posPerVel) noexcept
+{
+    for (; first != last; ++first)
+    {
+        pPos[first] += spaceint_t(pVel[first] * posPerVel);
+    }
+}
+
+void integrate_column(spaceint_t* const pPos, double const* const pVel, std::size_t const count, double const posPerVel) noexcept
+{
+    std::size_t i = 0;
+
+#if defined(__AVX2__)
+    // AVX2 has no double to int64 conversion. Whole-number doubles with a magnitude less than
+    // 2^51 can be converted by adding 2^52 + 2^51, which puts the integer directly into the
+    // mantissa bits. Lanes outside of this range (unlikely for a single step) use scalar.
+    __m256d const magic     = _mm256_set1_pd(6755399441055744.0); // 2^52 + 2^51
+    __m256d const limit     = _mm256_set1_pd(2251799813685248.0); // 2^51
+    __m256d const signMask  = _mm256_set1_pd(-0.0);
+    __m256d const scale     = _mm256_set1_pd(posPerVel);
+
+    for (; i + 4 <= count; i += 4)
+    {
+        __m256d const delta = _mm256_round_pd(_mm256_mul_pd(_mm256_loadu_pd(pVel + i), scale),
+                                              _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC);
+
+        __m256d const tooBig = _mm256_cmp_pd(_mm256_andnot_pd(signMask, delta), limit, _CMP_NLT_UQ);
+        if (_mm256_movemask_pd(tooBig) != 0)
+        {
+            integrate_column_scalar(pPos, pVel, i, i + 4, posPerVel);
+            continue;
+        }
+
+        __m256i const deltaInt = _mm256_sub_epi64(_mm256_castpd_si256(_mm256_add_pd(delta, magic)),
+                                                  _mm256_castpd_si256(magic));
+
+        auto *const pPosVec = reinterpret_cast<__m256i*>(pPos + i);
+        _mm256_storeu_si256(pPosVec, _mm256_add_epi64(_mm256_loadu_si256(pPosVec), deltaInt));
+    }
+#endif
+
+    integrate_column_scalar(pPos, pVel, i, count, posPerVel);
+}
+
+template <typename T>
+std::array<Corrade::Containers::StridedArrayView1D<T>, 3> scratch_views(std::array<std::vector<T>, 3>& rScratch, std::size_t const count)
+{
+    for (std::vector<T> &rVec : rScratch)
+    {
+        rVec.resize(count);
+    }
+    return { Corrade::Containers::arrayView(rScratch[0]),
+             Corrade::Containers::arrayView(rScratch[1]),
+             Corrade::Containers::arrayView(rScratch[2]) };
+}
+
+void evaluate(SatDynamics const& dynamics, CoSpaceCommon& rSpace, SatPosViews_t const& pos, SatAccelViews_t const& accel) noexcept
+{
+    for (auto const& column : accel)
+    {
+        for (std::size_t i = 0; i < column.size(); ++i)
+        {
+            column[i] = 0.0;
+        }
+    }
+
+    for (SatAccelModel const& model : dynamics.m_models)
+    {
+        model.m_func(model.m_pData, rSpace, pos, accel);
+    }
+}
+
+// Position updates round to nearest. Truncating biases every substep towards the origin of
+// the CoSpace, which shows up as energy drift when taking many substeps.
+spaceint_t round_units(double const units) noexcept
+{
+    return spaceint_t(std::nearbyint(units));
+}
+
+void kick(SatVelViews_t const& vel, SatAccelViews_t const& accel, double const deltaTime) noexcept
+{
+    for (int dim = 0; dim < 3; ++dim)
+    {
+        for (std::size_t i = 0; i < vel[dim].size(); ++i)
+        {
+            vel[dim][i] += accel[dim][i] * deltaTime;
+        }
+    }
+}
+
+void drift(SatPosViews_t const& pos, SatVelViews_t const& vel, double const posPerVel) noexcept
+{
+    for (int dim = 0; dim < 3; ++dim)
+    {
+        for (std::size_t i = 0; i < pos[dim].size(); ++i)
+        {
+            pos[dim][i] += round_units(vel[dim][i] * posPerVel);
+        }
+    }
+}
+
+/**
+ * @brief Pick a number of equal substeps to split deltaTime into
+ *
+ * @param accel [in] Accelerations at the start of the step, only used if adaptive
+ */
+uint32_t substep_count(
+        SatIntegratorParams const&  params,
+        SatPosViews_t const&        pos,
+        SatAccelViews_t const&      accel,
+        double const                metersPerUnit,
+        double const                deltaTime) noexcept
+{
+    double substep = params.m_maxSubstep;
+
+    if (params.m_adaptiveEta > 0.0)
+    {
+        // Track the smallest r / |a| squared to avoid square roots in the loop
+        double minRatioSq = std::numeric_limits<double>::infinity();
+        for (std::size_t i = 0; i < pos[0].size(); ++i)
+        {
+            double const rSq = (  double(pos[0][i]) * double(pos[0][i])
+                                + double(pos[1][i]) * double(pos[1][i])
+                                + double(pos[2][i]) * double(pos[2][i])) * metersPerUnit * metersPerUnit;
+            double const aSq =    accel[0][i] * accel[0][i]
+                                + accel[1][i] * accel[1][i]
+                                + accel[2][i] * accel[2][i];
+            if (aSq != 0.0)
+            {
+                minRatioSq = std::min(minRatioSq, rSq / aSq);
+            }
+        }
+
+        // sqrt(r / |a|) = (r^2 / |a|^2)^(1/4)
+        substep = std::min(substep, params.m_adaptiveEta * std::sqrt(std::sqrt(minRatioSq)));
+    }
+
+    if ( ! (substep < deltaTime) )
+    {
+        return 1;
+    }
+
+    double const count = std::ceil(deltaTime / substep);
+    return (count >= double(params.m_maxSubsteps)) ? params.m_maxSubsteps : std::max(uint32_t(count), uint32_t(1));
+}
+
+} // namespace
+
+void sat_integrate_positions(SatPosViews_t const& pos, SatVelViews_t const& vel, double const posPerVel) noexcept
+{
+    std::size_t const count = pos[0].size();
+
+    if (all_contiguous(pos) && all_contiguous(vel))
+    {
+        for (int dim = 0; dim < 3; ++dim)
+        {
+            assert(vel[dim].size() == count);
+            integrate_column(pos[dim].asContiguous().data(), vel[dim].asContiguous().data(), count, posPerVel);
+        }
+        return;
+    }
+
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        pos[0][i] += spaceint_t(vel[0][i] * posPerVel);
+        pos[1][i] += spaceint_t(vel[1][i] * posPerVel);
+        pos[2][i] += spaceint_t(vel[2][i] * posPerVel);
+    }
+}
+
+void sat_accel_central_gravity(
+        SatPosViews_t const&    pos,
+        SatVelViews_t const&    vel,
+        double const            metersPerUnit,
+        double const            gm,
+        double const            deltaTime) noexcept
+{
+    std::size_t const count = pos[0].size();
+    double const gmDt = gm * deltaTime;
+
+    // Same math for both paths. Kept branchless so the contiguous loop auto-vectorizes.
+    auto const accelerate = [metersPerUnit, gmDt] (
+            spaceint_t const x, spaceint_t const y, spaceint_t const z,
+            double &rVx, double &rVy, double &rVz) noexcept
+    {
+        double const px     = double(x) * metersPerUnit;
+        double const py     = double(y) * metersPerUnit;
+        double const pz     = double(z) * metersPerUnit;
+        double const rSq    = px*px + py*py + pz*pz;
+        double const factor = -gmDt / (rSq * std::sqrt(rSq));
+
+        rVx += px * factor;
+        rVy += py * factor;
+        rVz += pz * factor;
+    };
+
+    if (all_contiguous(pos) && all_contiguous(vel))
+    {
+        spaceint_t const *const pX  = pos[0].asContiguous().data();
+        spaceint_t const *const pY  = pos[1].asContiguous().data();
+        spaceint_t const *const pZ  = pos[2].asContiguous().data();
+        double           *const pVx = vel[0].asContiguous().data();
+        double           *const pVy = vel[1].asContiguous().data();
+        double           *const pVz = vel[2].asContiguous().data();
+
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            accelerate(pX[i], pY[i], pZ[i], pVx[i], pVy[i], pVz[i]);
+        }
+        return;
+    }
+
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        accelerate(pos[0][i], pos[1][i], pos[2][i], vel[0][i], vel[1][i], vel[2][i]);
+    }
+}
+
+void sat_accel_model_central(void* pData, CoSpaceCommon& rSpace, SatPosViews_t const& pos, SatAccelViews_t const& accel) noexcept
+{
+    // Same as sat_accel_central_gravity with a time step of 1 second, adding to accel instead of
+    // velocities
+    auto const &gravity = *static_cast<SatCentralGravity const*>(pData);
+    sat_accel_central_gravity(pos, accel, math::mul_2pow<double, int>(1.0, -rSpace.m_precision), gravity.m_gm, 1.0);
+}
+
+uint32_t sat_integrate(CoSpaceCommon& rSpace, SatDynamics const& dynamics, SatIntegratorScratch& rScratch, double const deltaTime)
+{
+    std::size_t const count = rSpace.m_satCount;
+
+    if (count == 0 || rSpace.m_satPositions[0].not_used() || rSpace.m_satVelocities[0].not_used())
+    {
+        return 0;
+    }
+
+    double const unitsPerMeter = math::mul_2pow<double, int>(1.0, rSpace.m_precision);
+    double const metersPerUnit = 1.0 / unitsPerMeter;
+
+    SatPosViews_t const pos = sat_views(rSpace.m_satPositions,  rSpace.m_data, count);
+    SatVelViews_t const vel = sat_views(rSpace.m_satVelocities, rSpace.m_data, count);
+
+    if (dynamics.m_models.empty())
+    {
+        sat_integrate_positions(pos, vel, deltaTime * unitsPerMeter);
+        return 1;
+    }
+
+    SatAccelViews_t const accel = scratch_views(rScratch.m_accel, count);
+
+    // All methods start with accelerations at the current positions
+    evaluate(dynamics, rSpace, pos, accel);
+
+    uint32_t const substeps = substep_count(dynamics.m_integrator, pos, accel, metersPerUnit, deltaTime);
+    double const   h        = deltaTime / substeps;
+
+    switch (dynamics.m_integrator.m_method)
+    {
+    case ESatIntegrator::SymplecticEuler:
+        for (uint32_t step = 0; step < substeps; ++step)
+        {
+            if (step != 0)
+            {
+                evaluate(dynamics, rSpace, pos, accel);
+            }
+            kick(vel, accel, h);
+            drift(pos, vel, h * unitsPerMeter);
+        }
+        break;
+
+    case ESatIntegrator::Leapfrog:
+        for (uint32_t step = 0; step < substeps; ++step)
+        {
+            kick(vel, accel, 0.5 * h);
+            drift(pos, vel, h * unitsPerMeter);
+            evaluate(dynamics, rSpace, pos, accel);
+            kick(vel, accel, 0.5 * h);
+        }
+        break;
+
+    case ESatIntegrator::RK4:
+    {
+        SatPosViews_t const posTemp = scratch_views(rScratch.m_posTemp, count);
+        SatVelViews_t const velTemp = scratch_views(rScratch.m_velTemp, count);
+        SatVelViews_t const posSum  = scratch_views(rScratch.m_posSum,  count);
+        SatVelViews_t const velSum  = scratch_views(rScratch.m_velSum,  count);
+
+        // x' = v, v' = a(x). Stage k's derivatives are (velTemp, accel), where velTemp is the
+        // velocity at the stage and accel is evaluated at posTemp.
+        //
+        // posSum and velSum accumulate k1 + 2*k2 + 2*k3 + k4 in meters per second and meters per
+        // second squared, positions are only converted to units when added to posTemp or pos.
+
+        for (uint32_t step = 0; step < substeps; ++step)
+        {
+            if (step != 0)
+            {
+                evaluate(dynamics, rSpace, pos, accel);
+            }
+
+            // k1, at the start of the substep
+            for (int dim = 0; dim < 3; ++dim)
+            {
+                for (std::size_t i = 0; i < count; ++i)
+                {
+                    posSum[dim][i]  = vel[dim][i];
+                    velSum[dim][i]  = accel[dim][i];
+                    posTemp[dim][i] = pos[dim][i] + round_units(vel[dim][i] * 0.5 * h * unitsPerMeter);
+                    velTemp[dim][i] = vel[dim][i] + accel[dim][i] * 0.5 * h;
+                }
+            }
+
+            // k2 and k3, both at the midpoint
+            for (double const fraction : {0.5, 1.0})
+            {
+                evaluate(dynamics, rSpace, posTemp, accel);
+
+                for (int dim = 0; dim < 3; ++dim)
+                {
+                    for (std::size_t i = 0; i < count; ++i)
+                    {
+                        posSum[dim][i]  += 2.0 * velTemp[dim][i];
+                        velSum[dim][i]  += 2.0 * accel[dim][i];
+                        posTemp[dim][i] = pos[dim][i] + round_units(velTemp[dim][i] * fraction * h * unitsPerMeter);
+                        velTemp[dim][i] = vel[dim][i] + accel[dim][i] * fraction * h;
+                    }
+                }
+            }
+
+            // k4, at the end of the substep
+            evaluate(dynamics, rSpace, posTemp, accel);
+
+            for (int dim = 0; dim < 3; ++dim)
+            {
+                for (std::size_t i = 0; i < count; ++i)
+                {
+                    posSum[dim][i] += velTemp[dim][i];
+                    velSum[dim][i] += accel[dim][i];
+                    pos[dim][i]    += round_units(posSum[dim][i] * (h / 6.0) * unitsPerMeter);
+                    vel[dim][i]    += velSum[dim][i] * (h / 6.0);
+                }
+            }
+        }
+        break;
+    }
+    }
+
+    return substeps;
+}
+
+} // namespace osp::universe
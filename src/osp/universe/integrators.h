@@ -0,0 +1,180 @@
+/**
+ * Open Space Program
+ * Copyright © 2019-2024 Open Space Program Project
+ *
+ * MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#pragma once
+
+#include "universe.h"
+
+#include <limits>
+#include <vector>
+
+namespace osp::universe
+{
+
+struct SatRails;
+
+// Accelerations in meters per second squared
+using SatAccelViews_t = SatVelViews_t;
+
+/**
+ * @brief Adds accelerations of all satellites in a CoSpace, calculated from positions
+ *
+ * pos may differ from the CoSpace's own positions, such as intermediate positions within a
+ * substep. The CoSpace is still passed for its precision and other columns like masses.
+ *
+ * @param pData     [in] SatAccelModel::m_pData
+ * @param rSpace    [in] CoSpace being integrated, not to be modified
+ * @param pos       [in] Satellite positions to evaluate at
+ * @param accel     [ref] Accelerations to add to, same count as pos
+ */
+using SatAccelFunc_t = void(*)(void* pData, CoSpaceCommon& rSpace, SatPosViews_t const& pos, SatAccelViews_t const& accel) noexcept;
+
+struct SatAccelModel
+{
+    SatAccelFunc_t  m_func  {nullptr};
+    void*           m_pData {nullptr};
+};
+
+enum class ESatIntegrator : uint8_t
+{
+    // Kick then drift. First order and symplectic, one evaluation per substep
+    SymplecticEuler,
+
+    // Velocity Verlet: half kick, drift, half kick. Second order and symplectic, one evaluation
+    // per substep as the last half kick's accelerations are reused for the next substep.
+    // Energy error stays bounded, good for long-running orbits.
+    Leapfrog,
+
+    // Classic 4th order Runge-Kutta, four evaluations per substep. Very accurate over short
+    // spans, but not symplectic, so energy slowly drifts over many orbits.
+    RK4
+};
+
+struct SatIntegratorParams
+{
+    ESatIntegrator  m_method        {ESatIntegrator::Leapfrog};
+
+    // Steps longer than this are split into equal substeps, in seconds
+    double          m_maxSubstep    {std::numeric_limits<double>::infinity()};
+
+    // If non-zero, substeps are shortened to m_adaptiveEta * sqrt(r / |a|) of the satellite where
+    // this is smallest, r being distance to the CoSpace's origin. For a body orbiting something
+    // at the origin, this is a fraction of its orbital period / 2pi.
+    double          m_adaptiveEta   {0.0};
+
+    uint32_t        m_maxSubsteps   {64};
+};
+
+/**
+ * @brief How satellites of a CoSpace are accelerated and integrated
+ */
+struct SatDynamics
+{
+    // Accelerations from all models are added together
+    std::vector<SatAccelModel>  m_models;
+
+    SatIntegratorParams         m_integrator;
+
+    // Optional, only integrate satellites near the SceneFrame. See kepler.h
+    SatRails*                   m_pRails{nullptr};
+};
+
+/**
+ * @brief Reusable temporary buffers for sat_integrate, one per worker
+ */
+struct SatIntegratorScratch
+{
+    std::array<std::vector<double>, 3>      m_accel;
+
+    // RK4 only
+    std::array<std::vector<spaceint_t>, 3>  m_posTemp;
+    std::array<std::vector<double>, 3>      m_velTemp;
+    std::array<std::vector<double>, 3>      m_posSum;
+    std::array<std::vector<double>, 3>      m_velSum;
+
+    // Active satellites of a CoSpace with SatRails
+    CoSpaceCommon                           m_gathered;
+};
+
+/**
+ * @brief Inverse-square gravity towards the CoSpace's origin, for use as a SatAccelModel
+ */
+struct SatCentralGravity
+{
+    // Gravitational parameter (G * mass) of the body at the origin
+    double m_gm;
+};
+
+/**
+ * @brief SatAccelFunc_t for SatCentralGravity
+ */
+void sat_accel_model_central(void* pData, CoSpaceCommon& rSpace, SatPosViews_t const& pos, SatAccelViews_t const& accel) noexcept;
+
+/**
+ * @brief Move and accelerate satellites of a CoSpace over a time step
+ *
+ * Satellites only drift along their velocities if there are no acceleration models.
+ *
+ * Satellites within the CoSpace don't depend on each other except through acceleration models.
+ *
+ * @param rSpace    [ref] CoSpace to update, requires positions and velocities
+ * @param dynamics  [in] Acceleration models and integrator to use
+ * @param rScratch  [ref] Temporary buffers
+ * @param deltaTime [in] Time step in seconds
+ *
+ * @return Number of substeps taken
+ */
+uint32_t sat_integrate(CoSpaceCommon& rSpace, SatDynamics const& dynamics, SatIntegratorScratch& rScratch, double deltaTime);
+
+/**
+ * @brief Move satellites along their velocities
+ *
+ * position += velocity * posPerVel, where the added amount is truncated towards zero.
+ *
+ * Contiguous columns (XXXX... YYYY... ZZZZ...) take a SIMD path if available. Interleaved data
+ * falls back to a scalar loop.
+ *
+ * @param pos       [ref] Satellite positions to modify
+ * @param vel       [in] Satellite velocities, same count as pos
+ * @param posPerVel [in] Position units moved per unit of velocity, usually deltaTime * 2^precision
+ */
+void sat_integrate_positions(SatPosViews_t const& pos, SatVelViews_t const& vel, double posPerVel) noexcept;
+
+/**
+ * @brief Accelerate satellites towards the origin using inverse-square gravity
+ *
+ * @param pos           [in] Satellite positions
+ * @param vel           [ref] Satellite velocities to modify, in meters per second
+ * @param metersPerUnit [in] Size of a position unit in meters, 2^(-precision)
+ * @param gm            [in] Gravitational parameter (G * mass) of the body at the origin
+ * @param deltaTime     [in] Time step in seconds
+ */
+void sat_accel_central_gravity(
+        SatPosViews_t const&    pos,
+        SatVelViews_t const&    vel,
+        double                  metersPerUnit,
+        double                  gm,
+        double                  deltaTime) noexcept;
+
+} // namespace osp::universe
@@ -0,0 +1,593 @@
+/**
+ * Open Space Program
+ * Copyright © 2019-2024 Open Space Program Project
+ *
+ * MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include "kepler.h"
+
+#include "../core/math_2pow.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+namespace osp::universe
+{
+
+namespace
+{
+
+constexpr double gc_tau = 6.283185307179586;
+
+/**
+ * @brief Stumpff functions C(z) and S(z) used by universal variables
+ */
+void stumpff(double const z, double& rC, double& rS) noexcept
+{
+    if (z > 1e-6)
+    {
+        double const sqrtZ = std::sqrt(z);
+        rC = (1.0 - std::cos(sqrtZ)) / z;
+        rS = (sqrtZ - std::sin(sqrtZ)) / (z * sqrtZ);
+    }
+    else if (z < -1e-6)
+    {
+        double const sqrtZ = std::sqrt(-z);
+        rC = (std::cosh(sqrtZ) - 1.0) / -z;
+        rS = (std::sinh(sqrtZ) - sqrtZ) / (-z * sqrtZ);
+    }
+    else
+    {
+        // Series expansion, the closed forms above lose all precision near zero
+        rC = 1.0 / 2.0 - z / 24.0  + z * z / 720.0;
+        rS = 1.0 / 6.0 - z / 120.0 + z * z / 5040.0;
+    }
+}
+
+/**
+ * @brief Solve the universal Kepler equation for the universal anomaly after deltaTime
+ *
+ * Uses Laguerre-Conway iteration, which converges from poor initial guesses where Newton's method
+ * can diverge, such as for hyperbolic orbits far from periapsis.
+ */
+double solve_universal_anomaly(
+        KeplerOrbit const&  orbit,
+        double const        r0,
+        double const        sigma0,
+        double const        deltaTime) noexcept
+{
+    double const sqrtMu = std::sqrt(orbit.m_gm);
+    double const alpha  = orbit.m_alpha;
+
+    // Nearly parabolic orbits use the same guess as parabolic orbits. The other guesses are
+    // wildly off when the semi-major axis is huge.
+    double chi = sqrtMu * deltaTime / r0;
+    if (alpha * r0 > 1e-6)
+    {
+        chi = sqrtMu * alpha * deltaTime;
+    }
+    else if (alpha * r0 < -1e-6)
+    {
+        // Initial guess from Vallado, Fundamentals of Astrodynamics and Applications
+        double const a      = 1.0 / alpha;
+        double const sign   = (deltaTime < 0.0) ? -1.0 : 1.0;
+        double const denom  = sigma0 * sqrtMu + sign * std::sqrt(-orbit.m_gm * a) * (1.0 - r0 * alpha);
+        double const arg    = -2.0 * orbit.m_gm * alpha * deltaTime / denom;
+        if (arg > 0.0)
+        {
+            chi = sign * std::sqrt(-a) * std::log(arg);
+        }
+    }
+
+    constexpr int    n              = 5;
+    constexpr int    maxIterations  = 50;
+
+    for (int i = 0; i < maxIterations; ++i)
+    {
+        double const chiSq  = chi * chi;
+        double const z      = alpha * chiSq;
+        double c, s;
+        stumpff(z, c, s);
+
+        double const f   = sigma0 * chiSq * c + (1.0 - alpha * r0) * chiSq * chi * s + r0 * chi - sqrtMu * deltaTime;
+        double const df  = sigma0 * chi * (1.0 - z * s) + (1.0 - alpha * r0) * chiSq * c + r0;
+        double const ddf = sigma0 * (1.0 - z * c) + (1.0 - alpha * r0) * chi * (1.0 - z * s);
+
+        double const disc  = std::sqrt(std::abs(double((n - 1) * (n - 1)) * df * df - double(n * (n - 1)) * f * ddf));
+        double const delta = double(n) * f / (df + std::copysign(disc, df));
+
+        chi -= delta;
+
+        if (std::abs(delta) <= 1e-12 * std::max(std::abs(chi), 1.0))
+        {
+            break;
+        }
+    }
+
+    return chi;
+}
+
+void resize_sats(SatRails& rRails, std::size_t const count)
+{
+    std::size_t const oldCount = rRails.m_activeIdx.size();
+
+    // Removed satellites, remove any of them that were active
+    for (std::size_t sat = count; sat < oldCount; ++sat)
+    {
+        uint32_t const idx = rRails.m_activeIdx[sat];
+        if (idx != SatRails::smc_onRails)
+        {
+            SatId const moved = rRails.m_active.back();
+            rRails.m_active[idx] = moved;
+            rRails.m_activeIdx[moved] = idx;
+            rRails.m_active.pop_back();
+        }
+    }
+
+    rRails.m_activeIdx  .resize(count, SatRails::smc_onRails);
+    rRails.m_orbits     .resize(count);
+    rRails.m_evaluatedAt.resize(count, 0.0);
+    rRails.m_nextCheck  .resize(count, 0.0);
+
+    // New satellites start active
+    for (std::size_t sat = oldCount; sat < count; ++sat)
+    {
+        rRails.m_activeIdx[sat] = uint32_t(rRails.m_active.size());
+        rRails.m_active.push_back(SatId(sat));
+    }
+}
+
+constexpr bool check_later(SatRails::Check const& lhs, SatRails::Check const& rhs) noexcept
+{
+    return lhs.m_time > rhs.m_time;
+}
+
+bool check_stale(SatRails const& rails, SatRails::Check const& check) noexcept
+{
+    return ! sat_rails_on_rails(rails, check.m_sat) || rails.m_nextCheck[check.m_sat] != check.m_time;
+}
+
+void schedule_check(SatRails& rRails, SatId const sat, double const distance)
+{
+    // Closest the satellite and SceneFrame can get is if they head straight for each other at
+    // full speed
+    double const closingSpeed = rRails.m_orbits[sat].m_maxSpeed + rRails.m_frameSpeedLimit;
+    double const wait         = (distance - rRails.m_activeDistance) / closingSpeed;
+
+    // Always leave it for at least the next update
+    double const time = std::max(rRails.m_time + wait, std::nextafter(rRails.m_time, std::numeric_limits<double>::infinity()));
+
+    rRails.m_nextCheck[sat] = time;
+    rRails.m_checks.push_back({time, sat});
+    std::push_heap(rRails.m_checks.begin(), rRails.m_checks.end(), check_later);
+}
+
+void rebuild_checks(SatRails& rRails)
+{
+    rRails.m_checks.clear();
+    for (SatId sat = 0; sat < rRails.m_activeIdx.size(); ++sat)
+    {
+        if (rRails.m_activeIdx[sat] == SatRails::smc_onRails)
+        {
+            rRails.m_checks.push_back({rRails.m_nextCheck[sat], sat});
+        }
+    }
+    std::make_heap(rRails.m_checks.begin(), rRails.m_checks.end(), check_later);
+}
+
+void activate(SatRails& rRails, SatId const sat)
+{
+    rRails.m_activeIdx[sat] = uint32_t(rRails.m_active.size());
+    rRails.m_active.push_back(sat);
+}
+
+void deactivate(SatRails& rRails, SatId const sat)
+{
+    uint32_t const idx   = rRails.m_activeIdx[sat];
+    SatId    const moved = rRails.m_active.back();
+    rRails.m_active[idx]        = moved;
+    rRails.m_activeIdx[moved]   = idx;
+    rRails.m_active.pop_back();
+    rRails.m_activeIdx[sat]     = SatRails::smc_onRails;
+}
+
+Vector3g to_units(Vector3d const meters, double const unitsPerMeter) noexcept
+{
+    return { spaceint_t(std::llround(meters.x() * unitsPerMeter)),
+             spaceint_t(std::llround(meters.y() * unitsPerMeter)),
+             spaceint_t(std::llround(meters.z() * unitsPerMeter)) };
+}
+
+void evaluate_sat(CoSpaceCommon& rSpace, SatRails& rRails, SatId const sat, double const unitsPerMeter) noexcept
+{
+    if (rRails.m_evaluatedAt[sat] == rRails.m_time)
+    {
+        return;
+    }
+
+    Vector3d pos;
+    Vector3d vel;
+    kepler_state_at(rRails.m_orbits[sat], rRails.m_time, pos, vel);
+
+    auto const [x, y, z]    = sat_views(rSpace.m_satPositions,  rSpace.m_data, rSpace.m_satCount);
+    auto const [vx, vy, vz] = sat_views(rSpace.m_satVelocities, rSpace.m_data, rSpace.m_satCount);
+
+    Vector3g const units = to_units(pos, unitsPerMeter);
+    x[sat]  = units.x();
+    y[sat]  = units.y();
+    z[sat]  = units.z();
+    vx[sat] = vel.x();
+    vy[sat] = vel.y();
+    vz[sat] = vel.z();
+
+    rRails.m_evaluatedAt[sat] = rRails.m_time;
+}
+
+} // namespace
+
+KeplerOrbit kepler_from_state(Vector3d const position, Vector3d const velocity, double const gm, double const epoch) noexcept
+{
+    assert(gm > 0.0);
+
+    double const r      = position.length();
+    double const vSq    = Magnum::Math::dot(velocity, velocity);
+    double const rDotV  = Magnum::Math::dot(position, velocity);
+    double const alpha  = 2.0 / r - vSq / gm;
+
+    double const h      = Magnum::Math::cross(position, velocity).length();
+    double const ecc    = ((vSq - gm / r) * position - rDotV * velocity).length() / gm;
+
+    return {
+        .m_position = position,
+        .m_velocity = velocity,
+        .m_epoch    = epoch,
+        .m_gm       = gm,
+        .m_alpha    = alpha,
+        .m_period   = (alpha > 0.0) ? gc_tau / std::sqrt(gm * alpha * alpha * alpha)
+                                    : std::numeric_limits<double>::infinity(),
+        .m_maxSpeed = (h > 0.0) ? gm * (1.0 + ecc) / h
+                                : std::numeric_limits<double>::infinity() };
+}
+
+void kepler_state_at(KeplerOrbit const& orbit, double const time, Vector3d& rPosition, Vector3d& rVelocity) noexcept
+{
+    double deltaTime = time - orbit.m_epoch;
+
+    // Elliptic orbits repeat, keep the anomaly small for precision
+    if (std::isfinite(orbit.m_period))
+    {
+        deltaTime = std::fmod(deltaTime, orbit.m_period);
+    }
+
+    double const sqrtMu = std::sqrt(orbit.m_gm);
+    double const r0     = orbit.m_position.length();
+    double const sigma0 = Magnum::Math::dot(orbit.m_position, orbit.m_velocity) / sqrtMu;
+
+    double const chi    = solve_universal_anomaly(orbit, r0, sigma0, deltaTime);
+    double const chiSq  = chi * chi;
+    double c, s;
+    stumpff(orbit.m_alpha * chiSq, c, s);
+
+    // Lagrange coefficients
+    double const f = 1.0 - chiSq / r0 * c;
+    double const g = deltaTime - chiSq * chi / sqrtMu * s;
+
+    rPosition = f * orbit.m_position + g * orbit.m_velocity;
+
+    double const r    = rPosition.length();
+    double const fDot = sqrtMu / (r * r0) * (orbit.m_alpha * chiSq * chi * s - chi);
+    double const gDot = 1.0 - chiSq / r * c;
+
+    rVelocity = fDot * orbit.m_position + gDot * orbit.m_velocity;
+}
+
+void sat_rails_integrate(
+        CoSpaceCommon&          rSpace,
+        SatRails&               rRails,
+        SatDynamics const&      dynamics,
+        SatIntegratorScratch&   rScratch,
+        double const            deltaTime)
+{
+    rRails.m_time += deltaTime;
+
+    std::size_t const count = rSpace.m_satCount;
+
+    if (count == 0 || rSpace.m_satPositions[0].not_used() || rSpace.m_satVelocities[0].not_used())
+    {
+        return;
+    }
+
+    resize_sats(rRails, count);
+
+    std::size_t const activeCount = rRails.m_active.size();
+
+    if (activeCount == count)
+    {
+        sat_integrate(rSpace, dynamics, rScratch, deltaTime);
+        return;
+    }
+
+    if (activeCount == 0)
+    {
+        return;
+    }
+
+    // Gather active satellites into their own CoSpace. Columns are laid out fresh each time, only
+    // reallocating when it doesn't fit.
+
+    CoSpaceCommon &rGathered = rScratch.m_gathered;
+    bool const hasMass = ! rSpace.m_satMasses.not_used();
+
+    std::size_t bytesUsed = 0;
+    partition(bytesUsed, activeCount, rGathered.m_satPositions[0]);
+    partition(bytesUsed, activeCount, rGathered.m_satPositions[1]);
+    partition(bytesUsed, activeCount, rGathered.m_satPositions[2]);
+    partition(bytesUsed, activeCount, rGathered.m_satVelocities[0]);
+    partition(bytesUsed, activeCount, rGathered.m_satVelocities[1]);
+    partition(bytesUsed, activeCount, rGathered.m_satVelocities[2]);
+    if (hasMass)
+    {
+        partition(bytesUsed, activeCount, rGathered.m_satMasses);
+    }
+    else
+    {
+        rGathered.m_satMasses = {};
+    }
+
+    if (rGathered.m_data.size() < bytesUsed)
+    {
+        rGathered.m_data = sat_data_alloc(bytesUsed);
+    }
+
+    rGathered.m_precision   = rSpace.m_precision;
+    rGathered.m_satCount    = uint32_t(activeCount);
+    rGathered.m_satCapacity = uint32_t(activeCount);
+
+    SatPosViews_t const pos     = sat_views(rSpace.m_satPositions,      rSpace.m_data,      count);
+    SatVelViews_t const vel     = sat_views(rSpace.m_satVelocities,     rSpace.m_data,      count);
+    SatPosViews_t const posOut  = sat_views(rGathered.m_satPositions,   rGathered.m_data,   activeCount);
+    SatVelViews_t const velOut  = sat_views(rGathered.m_satVelocities,  rGathered.m_data,   activeCount);
+
+    for (int dim = 0; dim < 3; ++dim)
+    {
+        for (std::size_t i = 0; i < activeCount; ++i)
+        {
+            posOut[dim][i] = pos[dim][rRails.m_active[i]];
+            velOut[dim][i] = vel[dim][rRails.m_active[i]];
+        }
+    }
+
+    if (hasMass)
+    {
+        auto const mass     = rSpace.m_satMasses.view(Corrade::Containers::arrayView(rSpace.m_data), count);
+        auto const massOut  = rGathered.m_satMasses.view(Corrade::Containers::arrayView(rGathered.m_data), activeCount);
+        for (std::size_t i = 0; i < activeCount; ++i)
+        {
+            massOut[i] = mass[rRails.m_active[i]];
+        }
+    }
+
+    sat_integrate(rGathered, dynamics, rScratch, deltaTime);
+
+    for (int dim = 0; dim < 3; ++dim)
+    {
+        for (std::size_t i = 0; i < activeCount; ++i)
+        {
+            pos[dim][rRails.m_active[i]] = posOut[dim][i];
+            vel[dim][rRails.m_active[i]] = velOut[dim][i];
+        }
+    }
+}
+
+void sat_rails_update(CoSpaceCommon& rSpace, SatRails& rRails, Vector3g const framePos)
+{
+    std::size_t const count = rSpace.m_satCount;
+
+    if (rSpace.m_satPositions[0].not_used() || rSpace.m_satVelocities[0].not_used())
+    {
+        return;
+    }
+
+    resize_sats(rRails, count);
+
+    double const unitsPerMeter = math::mul_2pow<double, int>(1.0, rSpace.m_precision);
+    double const metersPerUnit = 1.0 / unitsPerMeter;
+
+    auto const distance_to_frame = [framePos, metersPerUnit] (Vector3g const pos) noexcept
+    {
+        return (Vector3d(pos - framePos) * metersPerUnit).length();
+    };
+
+    // A SceneFrame that moved faster than expected invalidates every scheduled check
+    if (rRails.m_hasLastFramePos)
+    {
+        double const moved   = distance_to_frame(rRails.m_lastFramePos);
+        double const elapsed = rRails.m_time - rRails.m_lastFrameTime;
+        if (moved > rRails.m_frameSpeedLimit * elapsed)
+        {
+            for (SatId sat = 0; sat < count; ++sat)
+            {
+                rRails.m_nextCheck[sat] = rRails.m_time;
+            }
+            rebuild_checks(rRails);
+        }
+    }
+    rRails.m_lastFramePos       = framePos;
+    rRails.m_lastFrameTime      = rRails.m_time;
+    rRails.m_hasLastFramePos    = true;
+
+    auto const [x, y, z]    = sat_views(rSpace.m_satPositions,  rSpace.m_data, count);
+    auto const [vx, vy, vz] = sat_views(rSpace.m_satVelocities, rSpace.m_data, count);
+
+    // Put distant active satellites on rails. Iterate backwards, as deactivating moves the last
+    // active satellite into the gap.
+    for (std::size_t i = rRails.m_active.size(); i-- != 0; )
+    {
+        SatId const    sat  = rRails.m_active[i];
+        Vector3g const pos  = {x[sat], y[sat], z[sat]};
+        double const   dist = distance_to_frame(pos);
+
+        if (dist > rRails.m_railsDistance)
+        {
+            rRails.m_orbits[sat]      = kepler_from_state(Vector3d(pos) * metersPerUnit, {vx[sat], vy[sat], vz[sat]}, rRails.m_gm, rRails.m_time);
+            rRails.m_evaluatedAt[sat] = rRails.m_time;
+            deactivate(rRails, sat);
+            schedule_check(rRails, sat, dist);
+        }
+    }
+
+    // Check satellites on rails that are due
+    while ( ! rRails.m_checks.empty() && rRails.m_checks.front().m_time <= rRails.m_time )
+    {
+        std::pop_heap(rRails.m_checks.begin(), rRails.m_checks.end(), check_later);
+        SatRails::Check const check = rRails.m_checks.back();
+        rRails.m_checks.pop_back();
+
+        if (check_stale(rRails, check))
+        {
+            continue;
+        }
+
+        SatId const    sat  = check.m_sat;
+        double const   dist = distance_to_frame(sat_rails_position(rSpace, rRails, sat));
+
+        if (dist < rRails.m_activeDistance)
+        {
+            evaluate_sat(rSpace, rRails, sat, unitsPerMeter);
+            activate(rRails, sat);
+        }
+        else
+        {
+            schedule_check(rRails, sat, dist);
+        }
+    }
+
+    // Satellites going on and off rails leave stale entries behind
+    std::size_t const railsCount = count - rRails.m_active.size();
+    if (rRails.m_checks.size() > 2 * railsCount + 64)
+    {
+        rebuild_checks(rRails);
+    }
+}
+
+void sat_rails_evaluate(CoSpaceCommon& rSpace, SatRails& rRails, ArrayView<SatId const> const sats) noexcept
+{
+    double const unitsPerMeter = math::mul_2pow<double, int>(1.0, rSpace.m_precision);
+
+    for (SatId const sat : sats)
+    {
+        if (sat_rails_on_rails(rRails, sat))
+        {
+            evaluate_sat(rSpace, rRails, sat, unitsPerMeter);
+        }
+    }
+}
+
+void sat_rails_evaluate_all(CoSpaceCommon& rSpace, SatRails& rRails) noexcept
+{
+    double const unitsPerMeter = math::mul_2pow<double, int>(1.0, rSpace.m_precision);
+
+    std::size_t const count = std::min<std::size_t>(rSpace.m_satCount, rRails.m_activeIdx.size());
+    for (SatId sat = 0; sat < count; ++sat)
+    {
+        if (rRails.m_activeIdx[sat] == SatRails::smc_onRails)
+        {
+            evaluate_sat(rSpace, rRails, sat, unitsPerMeter);
+        }
+    }
+}
+
+Vector3g sat_rails_position(CoSpaceCommon const& space, SatRails const& rails, SatId const sat) noexcept
+{
+    if (sat_rails_on_rails(rails, sat) && rails.m_evaluatedAt[sat] != rails.m_time)
+    {
+        Vector3d pos;
+        Vector3d vel;
+        kepler_state_at(rails.m_orbits[sat], rails.m_time, pos, vel);
+        return to_units(pos, math::mul_2pow<double, int>(1.0, space.m_precision));
+    }
+
+    auto const [x, y, z] = sat_views(space.m_satPositions, space.m_data, space.m_satCount);
+    return {x[sat], y[sat], z[sat]};
+}
+
+void sat_rails_remap(SatRails& rRails, CoSpaceId const id, uint32_t const satCount, ArrayView<SatRemap const> const remaps)
+{
+    bool const touched = std::any_of(remaps.begin(), remaps.end(), [id] (SatRemap const& remap)
+    {
+        return remap.m_oldCoSpace == id || remap.m_newCoSpace == id;
+    });
+
+    if ( ! touched )
+    {
+        return;
+    }
+
+    // Remaps aren't in any particular order, and a remap's new SatId may be another's old SatId.
+    // Read everything from copies of the old state.
+    std::vector<uint32_t>    const oldActiveIdx   = rRails.m_activeIdx;
+    std::vector<KeplerOrbit> const oldOrbits      = rRails.m_orbits;
+    std::vector<double>      const oldEvaluatedAt = rRails.m_evaluatedAt;
+    std::vector<double>      const oldNextCheck   = rRails.m_nextCheck;
+
+    // Satellites that weren't remapped keep their SatId. Any new ones start active, which is
+    // any value other than smc_onRails until m_active is rebuilt below.
+    rRails.m_activeIdx  .resize(satCount, 0);
+    rRails.m_orbits     .resize(satCount);
+    rRails.m_evaluatedAt.resize(satCount, 0.0);
+    rRails.m_nextCheck  .resize(satCount, 0.0);
+
+    for (SatRemap const& remap : remaps)
+    {
+        if (remap.m_newCoSpace != id)
+        {
+            continue;
+        }
+
+        SatId const sat = remap.m_newSat;
+        if (remap.m_oldCoSpace == id && remap.m_oldSat < oldActiveIdx.size())
+        {
+            rRails.m_activeIdx[sat]     = oldActiveIdx[remap.m_oldSat];
+            rRails.m_orbits[sat]        = oldOrbits[remap.m_oldSat];
+            rRails.m_evaluatedAt[sat]   = oldEvaluatedAt[remap.m_oldSat];
+            rRails.m_nextCheck[sat]     = oldNextCheck[remap.m_oldSat];
+        }
+        else
+        {
+            rRails.m_activeIdx[sat]     = 0;
+        }
+    }
+
+    // Rebuild m_active to match
+    rRails.m_active.clear();
+    for (SatId sat = 0; sat < satCount; ++sat)
+    {
+        if (rRails.m_activeIdx[sat] != SatRails::smc_onRails)
+        {
+            activate(rRails, sat);
+        }
+    }
+
+    rebuild_checks(rRails);
+}
+
+} // namespace osp::universe
@@ -0,0 +1,231 @@
+/**
+ * Open Space Program
+ * Copyright © 2019-2024 Open Space Program Project
+ *
+ * MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#pragma once
+
+#include "integrators.h"
+#include "transfer.h"
+#include "universe.h"
+
+#include "../core/array_view.h"
+
+#include <limits>
+#include <vector>
+
+/**
+ * On-rails satellites
+ *
+ * Satellites far away from the SceneFrame don't need to be integrated every step. A CoSpace with
+ * SatRails moves these "on rails" along Keplerian orbits around its origin, which can be
+ * evaluated for any point in time without stepping through everything in between.
+ *
+ * Only satellites in SatRails::m_active are integrated. Positions and velocities of the rest are
+ * left stale in CoSpaceSatData::m_data until asked for with sat_rails_evaluate. Anything reading
+ * satellite data of a CoSpace with SatRails (drawing, transfers, snapshots) must evaluate the
+ * satellites it needs first.
+ *
+ * SatIds never change when going on or off rails.
+ */
+
+namespace osp::universe
+{
+
+/**
+ * @brief Two-body orbit around a CoSpace's origin, stored as the state at an epoch
+ *
+ * Propagated using universal variables, which handles circular, elliptic, parabolic, hyperbolic,
+ * and radial orbits alike.
+ */
+struct KeplerOrbit
+{
+    Vector3d    m_position;         // at m_epoch, in meters
+    Vector3d    m_velocity;         // at m_epoch, in meters per second
+    double      m_epoch         {0.0};
+    double      m_gm            {0.0};
+
+    // 1 / semi-major axis, negative for hyperbolic and zero for parabolic orbits
+    double      m_alpha         {0.0};
+
+    // Infinite if not elliptic
+    double      m_period        {std::numeric_limits<double>::infinity()};
+
+    // Fastest speed anywhere along the orbit, reached at periapsis. Infinite for radial orbits.
+    double      m_maxSpeed      {std::numeric_limits<double>::infinity()};
+};
+
+/**
+ * @brief Make a KeplerOrbit from position and velocity at a point in time
+ *
+ * @param position  [in] Position relative to the central body, in meters
+ * @param velocity  [in] Velocity relative to the central body, in meters per second
+ * @param gm        [in] Gravitational parameter (G * mass) of the central body
+ * @param epoch     [in] Time of position and velocity, in seconds
+ */
+KeplerOrbit kepler_from_state(Vector3d position, Vector3d velocity, double gm, double epoch) noexcept;
+
+/**
+ * @brief Get position and velocity along an orbit at any point in time, before or after epoch
+ *
+ * @param orbit     [in] Orbit to evaluate
+ * @param time      [in] Time in seconds, same clock as KeplerOrbit::m_epoch
+ * @param rPosition [out] Position in meters
+ * @param rVelocity [out] Velocity in meters per second
+ */
+void kepler_state_at(KeplerOrbit const& orbit, double time, Vector3d& rPosition, Vector3d& rVelocity) noexcept;
+
+/**
+ * @brief Tracks which satellites of a CoSpace are on rails
+ *
+ * Each satellite goes on rails once further than m_railsDistance from the SceneFrame, and comes
+ * off rails once closer than m_activeDistance. These should be far enough apart that satellites
+ * don't flip back and forth.
+ *
+ * Satellites on rails aren't checked every step. Each is given a time before which it can't
+ * possibly reach m_activeDistance, from its fastest speed along its orbit plus m_frameSpeedLimit.
+ * If the SceneFrame moves faster than m_frameSpeedLimit, all satellites are rechecked.
+ */
+struct SatRails
+{
+    static constexpr uint32_t smc_onRails = std::numeric_limits<uint32_t>::max();
+
+    struct Check
+    {
+        double      m_time;
+        SatId       m_sat;
+    };
+
+    // Gravitational parameter (G * mass) of the body at the CoSpace's origin
+    double                      m_gm                {0.0};
+
+    // In meters
+    double                      m_railsDistance     {std::numeric_limits<double>::infinity()};
+    double                      m_activeDistance    {std::numeric_limits<double>::infinity()};
+
+    // Fastest the SceneFrame is expected to move within the CoSpace, in meters per second
+    double                      m_frameSpeedLimit   {10000.0};
+
+    // Time that satellites have been stepped to, in seconds
+    double                      m_time              {0.0};
+
+    // Satellites to integrate each step, in no particular order
+    std::vector<SatId>          m_active;
+
+    // Indexed by SatId. Index into m_active, or smc_onRails
+    std::vector<uint32_t>       m_activeIdx;
+
+    // Indexed by SatId, only valid for satellites on rails
+    std::vector<KeplerOrbit>    m_orbits;
+    std::vector<double>         m_evaluatedAt;
+    std::vector<double>         m_nextCheck;
+
+    // Min-heap by time. Entries that don't match m_nextCheck or are no longer on rails are stale.
+    std::vector<Check>          m_checks;
+
+    // SceneFrame position and m_time as of the last sat_rails_update, to detect teleports
+    Vector3g                    m_lastFramePos;
+    double                      m_lastFrameTime     {0.0};
+    bool                        m_hasLastFramePos   {false};
+};
+
+/**
+ * @brief Check if a satellite is on rails, and its position in m_data may be stale
+ */
+inline bool sat_rails_on_rails(SatRails const& rails, SatId const sat) noexcept
+{
+    return sat < rails.m_activeIdx.size() && rails.m_activeIdx[sat] == SatRails::smc_onRails;
+}
+
+/**
+ * @brief Advance rails time and integrate only active satellites
+ *
+ * Active satellites are gathered into SatIntegratorScratch::m_gathered, integrated with
+ * sat_integrate, then written back. Satellites on rails don't contribute to acceleration models
+ * such as N-body gravity.
+ *
+ * Satellites that aren't known by rRails yet, such as ones that were just added, are treated as
+ * active.
+ *
+ * @param rSpace    [ref] CoSpace to update, requires positions and velocities
+ * @param rRails    [ref] On-rails state of rSpace
+ * @param dynamics  [in] Acceleration models and integrator to use for active satellites
+ * @param rScratch  [ref] Temporary buffers
+ * @param deltaTime [in] Time step in seconds
+ */
+void sat_rails_integrate(
+        CoSpaceCommon&          rSpace,
+        SatRails&               rRails,
+        SatDynamics const&      dynamics,
+        SatIntegratorScratch&   rScratch,
+        double                  deltaTime);
+
+/**
+ * @brief Move satellites on or off rails depending on distance to the SceneFrame
+ *
+ * Call after satellites are stepped. Cost scales with the number of active satellites, plus the
+ * few satellites on rails that are due to be checked.
+ *
+ * @param rSpace    [ref] CoSpace to update
+ * @param rRails    [ref] On-rails state of rSpace
+ * @param framePos  [in] Position of the SceneFrame within rSpace
+ */
+void sat_rails_update(CoSpaceCommon& rSpace, SatRails& rRails, Vector3g framePos);
+
+/**
+ * @brief Write current positions and velocities of satellites on rails into m_data
+ *
+ * Active satellites and satellites already evaluated at the current time are skipped.
+ *
+ * @param rSpace    [ref] CoSpace to write to
+ * @param rRails    [ref] On-rails state of rSpace
+ * @param sats      [in] Satellites to evaluate
+ */
+void sat_rails_evaluate(CoSpaceCommon& rSpace, SatRails& rRails, ArrayView<SatId const> sats) noexcept;
+
+/**
+ * @brief Write current positions and velocities of all satellites on rails into m_data
+ */
+void sat_rails_evaluate_all(CoSpaceCommon& rSpace, SatRails& rRails) noexcept;
+
+/**
+ * @brief Get the current position of a satellite without writing to m_data
+ *
+ * Safe to call from many workers at once, such as for child CoSpaces following a parent
+ * satellite on rails.
+ */
+Vector3g sat_rails_position(CoSpaceCommon const& space, SatRails const& rails, SatId sat) noexcept;
+
+/**
+ * @brief Follow satellites that were moved by sat_transfer
+ *
+ * Satellites swapped into a different SatId within the CoSpace keep their rails state.
+ * Satellites transferred in from other CoSpaces start active.
+ *
+ * @param rRails    [ref] On-rails state of a CoSpace
+ * @param id        [in] CoSpace rRails belongs to
+ * @param satCount  [in] Satellite count of the CoSpace after the transfers
+ * @param remaps    [in] Remaps from sat_transfer
+ */
+void sat_rails_remap(SatRails& rRails, CoSpaceId id, uint32_t satCount, ArrayView<SatRemap const> remaps);
+
+} // namespace osp::universe
@@ -0,0 +1,379 @@
+/**
+ * Open Space Program
+ * Copyright © 2019-2024 Open Space Program Project
+ *
+ * MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include "nbody.h"
+
+#include "../core/math_2pow.h"
+
+#include <Magnum/Math/Functions.h>
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <limits>
+#include <numeric>
+
+namespace osp::universe
+{
+
+namespace
+{
+
+struct BuildArgs
+{
+    NBodyOctree&            rTree;
+    SatPosViews_t const&    pos;
+    SatMassView_t const&    mass;
+    NBodyParams const&      params;
+};
+
+Vector3g sat_pos(SatPosViews_t const& pos, uint32_t const sat) noexcept
+{
+    return {pos[0][sat], pos[1][sat], pos[2][sat]};
+}
+
+/**
+ * @brief Calculate mass and center of mass of a node, assuming its children are up to date
+ */
+void calc_mass_moments(NBodyOctree& rTree, SatPosViews_t const& pos, SatMassView_t const& mass, uint32_t const nodeIdx) noexcept
+{
+    NBodyNode &rNode = rTree.m_nodes[nodeIdx];
+
+    double   totalMass = 0.0;
+    Vector3d weighted{0.0};
+
+    if (rNode.m_descendants == 0)
+    {
+        for (uint32_t i = rNode.m_bodyFirst; i < rNode.m_bodyFirst + rNode.m_bodyCount; ++i)
+        {
+            uint32_t const sat = rTree.m_bodies[i];
+            Vector3d const relative = Vector3d(sat_pos(pos, sat) - rTree.m_origin) * rTree.m_metersPerUnit;
+            totalMass += mass[sat];
+            weighted  += relative * mass[sat];
+        }
+    }
+    else
+    {
+        uint32_t const childLast = nodeIdx + 1 + rNode.m_descendants;
+        for (uint32_t child = nodeIdx + 1; child < childLast; child += 1 + rTree.m_nodes[child].m_descendants)
+        {
+            NBodyNode const &rChild = rTree.m_nodes[child];
+            totalMass += rChild.m_mass;
+            weighted  += rChild.m_centerOfMass * rChild.m_mass;
+        }
+    }
+
+    rNode.m_mass         = totalMass;
+    rNode.m_centerOfMass = (totalMass > 0.0) ? (weighted / totalMass) : Vector3d{0.0};
+}
+
+void build_recurse(BuildArgs const& args, Vector3g const nodeMin, int const sizeExp, uint32_t const first, uint32_t const last, int const depth)
+{
+    NBodyOctree &rTree = args.rTree;
+
+    auto const nodeIdx = uint32_t(rTree.m_nodes.size());
+    rTree.m_nodes.push_back({
+        .m_min          = nodeMin,
+        .m_sizeExp      = sizeExp,
+        .m_bodyFirst    = first,
+        .m_bodyCount    = last - first });
+
+    bool const isLeaf =    (last - first <= args.params.m_leafSize)
+                        || (depth >= args.params.m_maxDepth)
+                        || (sizeExp == 0);
+
+    if ( ! isLeaf )
+    {
+        spaceint_t const half = math::int_2pow<spaceint_t>(sizeExp - 1);
+
+        // Predicate for std::partition, true if a satellite is in the lower half along dim
+        auto const lower = [&args, &nodeMin, half] (int const dim)
+        {
+            return [&args, &nodeMin, half, dim] (uint32_t const sat) noexcept
+            {
+                return args.pos[dim][sat] - nodeMin[dim] < half;
+            };
+        };
+
+        // Split into 8 octants by partitioning along X, then Y, then Z.
+        // split[octant] is the first body of each octant
+        std::array<uint32_t, 9> split;
+        auto const bodies = rTree.m_bodies.begin();
+        auto const part = [&bodies] (uint32_t a, uint32_t b, auto&& pred) -> uint32_t
+        {
+            return uint32_t(std::partition(bodies + a, bodies + b, pred) - bodies);
+        };
+
+        split[0] = first;
+        split[8] = last;
+        split[4] = part(split[0], split[8], lower(0));
+        split[2] = part(split[0], split[4], lower(1));
+        split[6] = part(split[4], split[8], lower(1));
+        split[1] = part(split[0], split[2], lower(2));
+        split[3] = part(split[2], split[4], lower(2));
+        split[5] = part(split[4], split[6], lower(2));
+        split[7] = part(split[6], split[8], lower(2));
+
+        for (int octant = 0; octant < 8; ++octant)
+        {
+            if (split[octant] == split[octant + 1])
+            {
+                continue; // Empty octant
+            }
+
+            // Octant index was built as X in bit 2, Y in bit 1, Z in bit 0
+            Vector3g const childMin = nodeMin + Vector3g{ (octant & 4) ? half : 0,
+                                                          (octant & 2) ? half : 0,
+                                                          (octant & 1) ? half : 0 };
+
+            build_recurse(args, childMin, sizeExp - 1, split[octant], split[octant + 1], depth + 1);
+        }
+
+        rTree.m_nodes[nodeIdx].m_descendants = uint32_t(rTree.m_nodes.size()) - nodeIdx - 1;
+    }
+
+    calc_mass_moments(rTree, args.pos, args.mass, nodeIdx);
+}
+
+bool node_contains(NBodyNode const& node, Vector3g const pos) noexcept
+{
+    spaceint_t const size = math::int_2pow<spaceint_t>(node.m_sizeExp);
+    for (int dim = 0; dim < 3; ++dim)
+    {
+        spaceint_t const offset = pos[dim] - node.m_min[dim];
+        if (offset < 0 || offset >= size)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @return Acceleration caused by a point mass, in m/s^2
+ */
+inline Vector3d point_accel(Vector3d const diff, double const gm, double const softeningSq) noexcept
+{
+    double const distSq = diff.dot() + softeningSq;
+    return diff * (gm / (distSq * std::sqrt(distSq)));
+}
+
+} // namespace
+
+void nbody_build(
+        NBodyOctree&            rTree,
+        SatPosViews_t const&    pos,
+        SatMassView_t const&    mass,
+        double const            metersPerUnit,
+        NBodyParams const&      params)
+{
+    auto const count = uint32_t(pos[0].size());
+    assert(mass.size() == count);
+
+    rTree.m_nodes.clear();
+    rTree.m_bodies.resize(count);
+    std::iota(rTree.m_bodies.begin(), rTree.m_bodies.end(), 0u);
+    rTree.m_metersPerUnit = metersPerUnit;
+
+    if (count == 0)
+    {
+        rTree.m_bodySlots.clear();
+        return;
+    }
+
+    // Find bounding cube, with power-of-two size so children can be split exactly
+    Vector3g minPos{std::numeric_limits<spaceint_t>::max()};
+    Vector3g maxPos{std::numeric_limits<spaceint_t>::min()};
+    for (uint32_t sat = 0; sat < count; ++sat)
+    {
+        Vector3g const satPos = sat_pos(pos, sat);
+        minPos = Magnum::Math::min(minPos, satPos);
+        maxPos = Magnum::Math::max(maxPos, satPos);
+    }
+
+    spaceint_t const extent = (maxPos - minPos).max() + 1;
+    int sizeExp = 0;
+    while (math::int_2pow<spaceint_t>(sizeExp) < extent && sizeExp < 62)
+    {
+        ++sizeExp;
+    }
+
+    rTree.m_origin = minPos;
+
+    build_recurse({rTree, pos, mass, params}, minPos, sizeExp, 0, count, 0);
+
+    rTree.m_bodySlots.resize(count);
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        rTree.m_bodySlots[rTree.m_bodies[i]] = i;
+    }
+}
+
+void nbody_refit(NBodyOctree& rTree, SatPosViews_t const& pos, SatMassView_t const& mass) noexcept
+{
+    // Reverse pre-order visits all children before their parents
+    for (auto nodeIdx = uint32_t(rTree.m_nodes.size()); nodeIdx != 0; --nodeIdx)
+    {
+        calc_mass_moments(rTree, pos, mass, nodeIdx - 1);
+    }
+}
+
+void nbody_accelerate(
+        NBodyOctree const&      tree,
+        SatPosViews_t const&    pos,
+        SatMassView_t const&    mass,
+        SatVelViews_t const&    vel,
+        std::size_t const       first,
+        std::size_t const       last,
+        NBodyParams const&      params,
+        double const            deltaTime) noexcept
+{
+    auto const      nodeCount   = uint32_t(tree.m_nodes.size());
+    double const    thetaSq     = params.m_theta * params.m_theta;
+    double const    softeningSq = params.m_softening * params.m_softening;
+    double const    G           = params.m_gravConst;
+
+    for (std::size_t sat = first; sat < last; ++sat)
+    {
+        Vector3g const satPos   = sat_pos(pos, uint32_t(sat));
+        Vector3d const relative = Vector3d(satPos - tree.m_origin) * tree.m_metersPerUnit;
+        uint32_t const slot     = tree.m_bodySlots[sat];
+        Vector3d accel{0.0};
+
+        uint32_t nodeIdx = 0;
+        while (nodeIdx < nodeCount)
+        {
+            NBodyNode const &rNode = tree.m_nodes[nodeIdx];
+
+            if (rNode.m_descendants == 0)
+            {
+                // Leaf, sum individual bodies
+                for (uint32_t i = rNode.m_bodyFirst; i < rNode.m_bodyFirst + rNode.m_bodyCount; ++i)
+                {
+                    uint32_t const other = tree.m_bodies[i];
+                    if (other != sat)
+                    {
+                        Vector3d const diff = Vector3d(sat_pos(pos, other) - satPos) * tree.m_metersPerUnit;
+                        accel += point_accel(diff, G * mass[other], softeningSq);
+                    }
+                }
+                ++nodeIdx;
+                continue;
+            }
+
+            Vector3d const  diff    = rNode.m_centerOfMass - relative;
+            double const    size    = math::mul_2pow<double, spaceint_t>(tree.m_metersPerUnit, rNode.m_sizeExp);
+
+            // Nodes holding this satellite are never approximated, even if it drifted outside of
+            // the node's bounds since the last nbody_build. Otherwise it would attract itself.
+            bool const holdsSat = slot - rNode.m_bodyFirst < rNode.m_bodyCount;
+
+            if (size * size < thetaSq * diff.dot() && ! holdsSat && ! node_contains(rNode, satPos))
+            {
+                // Far enough away, approximate whole subtree as a point mass and skip it
+                accel += point_accel(diff, G * rNode.m_mass, softeningSq);
+                nodeIdx += 1 + rNode.m_descendants;
+            }
+            else
+            {
+                ++nodeIdx; // Open node, visit children
+            }
+        }
+
+        vel[0][sat] += accel.x() * deltaTime;
+        vel[1][sat] += accel.y() * deltaTime;
+        vel[2][sat] += accel.z() * deltaTime;
+    }
+}
+
+void nbody_accelerate_direct(
+        SatPosViews_t const&    pos,
+        SatMassView_t const&    mass,
+        SatVelViews_t const&    vel,
+        std::size_t const       first,
+        std::size_t const       last,
+        double const            metersPerUnit,
+        NBodyParams const&      params,
+        double const            deltaTime) noexcept
+{
+    auto const      count       = uint32_t(pos[0].size());
+    double const    softeningSq = params.m_softening * params.m_softening;
+
+    for (std::size_t sat = first; sat < last; ++sat)
+    {
+        Vector3g const satPos = sat_pos(pos, uint32_t(sat));
+        Vector3d accel{0.0};
+
+        for (uint32_t other = 0; other < count; ++other)
+        {
+            if (other != sat)
+            {
+                Vector3d const diff = Vector3d(sat_pos(pos, other) - satPos) * metersPerUnit;
+                accel += point_accel(diff, params.m_gravConst * mass[other], softeningSq);
+            }
+        }
+
+        vel[0][sat] += accel.x() * deltaTime;
+        vel[1][sat] += accel.y() * deltaTime;
+        vel[2][sat] += accel.z() * deltaTime;
+    }
+}
+
+void nbody_accel_model(void* pData, CoSpaceCommon& rSpace, SatPosViews_t const& pos, SatAccelViews_t const& accel) noexcept
+{
+    auto &rGravity = *static_cast<NBodyGravity*>(pData);
+
+    if (rSpace.m_satMasses.not_used())
+    {
+        return;
+    }
+
+    std::size_t const   count   = pos[0].size();
+    SatMassView_t const mass    = rSpace.m_satMasses.view(Corrade::Containers::arrayView(rSpace.m_data), count);
+
+    // Satellites may have been added or removed, which invalidates the tree's structure
+    bool const rebuild = rGravity.m_sinceRebuild == 0 || rGravity.m_tree.m_bodies.size() != count;
+    rGravity.m_sinceRebuild = (rGravity.m_sinceRebuild + 1) % std::max(rGravity.m_rebuildInterval, 1u);
+
+    if (rebuild)
+    {
+        nbody_build(rGravity.m_tree, pos, mass, math::mul_2pow<double, int>(1.0, -rSpace.m_precision), rGravity.m_params);
+    }
+    else
+    {
+        nbody_refit(rGravity.m_tree, pos, mass);
+    }
+
+    constexpr std::size_t chunkSize = 256;
+
+    for (std::size_t first = 0; first < count; first += chunkSize)
+    {
+        std::size_t const last = std::min(first + chunkSize, count);
+
+        // Accelerating over 1 second adds exactly the acceleration
+        nbody_accelerate(rGravity.m_tree, pos, mass, accel, first, last, rGravity.m_params, 1.0);
+    }
+}
+
+} // namespace osp::universe
@@ -0,0 +1,184 @@
+/**
+ * Open Space Program
+ * Copyright © 2019-2024 Open Space Program Project
+ *
+ * MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#pragma once
+
+#include "integrators.h"
+
+#include "../scientific/constants.h"
+
+#include <vector>
+
+namespace osp::universe
+{
+
+using SatMassView_t = TypedStrideDesc<double>::View_t;
+
+struct NBodyParams
+{
+    // Opening angle. Nodes with (size / distance) less than this are approximated by their
+    // center of mass. 0 is equivalent to a direct sum, larger values are faster but less accurate
+    double      m_theta         {0.5};
+
+    // Added to distances to avoid singularities for close encounters, in meters
+    double      m_softening     {1.0};
+
+    double      m_gravConst     {phys::constants::G};
+
+    // Nodes with this many bodies or fewer are not subdivided further
+    uint32_t    m_leafSize      {8};
+
+    int         m_maxDepth      {40};
+};
+
+/**
+ * @brief Cube-shaped node of an NBodyOctree
+ */
+struct NBodyNode
+{
+    // Cube over integer CoSpace positions. Edge length = 2^m_sizeExp position units
+    Vector3g    m_min;
+    int         m_sizeExp       {0};
+
+    // Descendant nodes are positioned directly after this one, same as ACtxSceneGraph
+    uint32_t    m_descendants   {0};
+
+    // Range of bodies contained in this node's subtree, see NBodyOctree::m_bodies
+    uint32_t    m_bodyFirst     {0};
+    uint32_t    m_bodyCount     {0};
+
+    double      m_mass          {0.0};
+
+    // In meters, relative to NBodyOctree::m_origin
+    Vector3d    m_centerOfMass;
+};
+
+/**
+ * @brief Barnes-Hut octree for mutual gravity between satellites of a CoSpace
+ *
+ * Nodes are stored in pre-order. Traversal is a single forward sweep that skips over subtrees
+ * that are far enough away to approximate, so no stack is needed.
+ */
+struct NBodyOctree
+{
+    std::vector<NBodyNode>  m_nodes;
+
+    // Satellite indices, ordered such that each node's bodies are contiguous
+    std::vector<uint32_t>   m_bodies;
+
+    // Inverse of m_bodies, position of each satellite within m_bodies
+    std::vector<uint32_t>   m_bodySlots;
+
+    Vector3g                m_origin;
+    double                  m_metersPerUnit {1.0};
+};
+
+/**
+ * @brief Mutual gravity between satellites of a CoSpace, for use as a SatAccelModel
+ *
+ * The octree is rebuilt or refit each time accelerations are evaluated.
+ */
+struct NBodyGravity
+{
+    NBodyParams         m_params;
+
+    NBodyOctree         m_tree;
+
+    // Octree is fully rebuilt every this many evaluations, and only refit in between.
+    // 0 rebuilds every time, same as 1.
+    uint32_t            m_rebuildInterval   {8};
+    uint32_t            m_sinceRebuild      {0};
+};
+
+/**
+ * @brief Rebuild an octree from scratch over satellite positions
+ *
+ * @param rTree         [out] Octree to rebuild, existing allocations are reused
+ * @param pos           [in] Satellite positions
+ * @param mass          [in] Satellite masses in kg, same count as pos
+ * @param metersPerUnit [in] Size of a position unit in meters, 2^(-precision)
+ * @param params        [in] Build parameters
+ */
+void nbody_build(
+        NBodyOctree&            rTree,
+        SatPosViews_t const&    pos,
+        SatMassView_t const&    mass,
+        double                  metersPerUnit,
+        NBodyParams const&      params);
+
+/**
+ * @brief Recalculate masses and centers of mass without changing the tree's structure
+ *
+ * Much cheaper than nbody_build. Bodies may drift outside of their nodes, which reduces accuracy
+ * as nodes get larger than their bounds suggest. nbody_accelerate never approximates a node
+ * that holds the body being accelerated, so bodies still never attract themselves. Intended for
+ * steps in between full rebuilds.
+ */
+void nbody_refit(NBodyOctree& rTree, SatPosViews_t const& pos, SatMassView_t const& mass) noexcept;
+
+/**
+ * @brief Accelerate a range of satellites using forces approximated by an octree
+ *
+ * Writes only to velocities within [first, last).
+ *
+ * @param tree      [in] Octree built or refit from pos and mass
+ * @param pos       [in] Satellite positions
+ * @param mass      [in] Satellite masses in kg
+ * @param vel       [ref] Satellite velocities to modify, in meters per second
+ * @param first     [in] First satellite to accelerate
+ * @param last      [in] One past the last satellite to accelerate
+ * @param params    [in] Uses m_theta, m_softening, and m_gravConst
+ * @param deltaTime [in] Time step in seconds
+ */
+void nbody_accelerate(
+        NBodyOctree const&      tree,
+        SatPosViews_t const&    pos,
+        SatMassView_t const&    mass,
+        SatVelViews_t const&    vel,
+        std::size_t             first,
+        std::size_t             last,
+        NBodyParams const&      params,
+        double                  deltaTime) noexcept;
+
+/**
+ * @brief Accelerate a range of satellites using an exact O(N^2) direct sum
+ *
+ * Reference for nbody_accelerate, and faster for very small numbers of bodies.
+ */
+void nbody_accelerate_direct(
+        SatPosViews_t const&    pos,
+        SatMassView_t const&    mass,
+        SatVelViews_t const&    vel,
+        std::size_t             first,
+        std::size_t             last,
+        double                  metersPerUnit,
+        NBodyParams const&      params,
+        double                  deltaTime) noexcept;
+
+/**
+ * @brief SatAccelFunc_t for NBodyGravity, requires satellite masses
+ */
+void nbody_accel_model(void* pData, CoSpaceCommon& rSpace, SatPosViews_t const& pos, SatAccelViews_t const& accel) noexcept;
+
+} // namespace osp::universe
@@ -0,0 +1,674 @@
+/**
+ * Open Space Program
+ * Copyright © 2019-2024 Open Space Program Project
+ *
+ * MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include "snapshot.h"
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <type_traits>
+
+#if defined(_WIN32)
+    #define WIN32_LEAN_AND_MEAN
+    #define NOMINMAX
+    #include <windows.h>
+#else
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+namespace osp::universe
+{
+
+namespace
+{
+
+constexpr std::array<char, 8>   gc_snapshotMagic    {'O', 'S', 'P', 'U', 'N', 'I', 'V', '\0'};
+constexpr uint32_t              gc_snapshotEndian   = 0x01020304;
+constexpr std::size_t           gc_snapshotColumns  = 11;
+
+// Loading rejects CoSpaceIds at or past this, as the registry is filled up to the largest ID
+constexpr uint32_t              gc_snapshotMaxIds   = 1u << 20;
+
+struct SnapshotHeader
+{
+    std::array<char, 8> m_magic;
+    uint32_t            m_version;
+    uint32_t            m_endian;
+    uint32_t            m_pageSize;
+    uint32_t            m_directoryCount;
+    uint64_t            m_generation;
+    uint64_t            m_directoryOffset;
+
+    // Bytes in use. Anything past this was appended by an interrupted save and is ignored.
+    uint64_t            m_fileSize;
+};
+
+struct SnapshotColumn
+{
+    uint64_t            m_offset;
+    int64_t             m_stride;
+};
+
+struct SnapshotCoSpace
+{
+    uint32_t            m_id;
+    uint32_t            m_parent;
+    uint32_t            m_parentSat;
+    int32_t             m_precision;
+    std::array<double, 4>   m_rotation;
+    std::array<int64_t, 3>  m_position;
+    uint32_t            m_satCount;
+    uint32_t            m_satCapacity;
+    uint64_t            m_dataOffset;
+    uint64_t            m_dataSize;
+    uint64_t            m_dataHash;
+    std::array<SnapshotColumn, gc_snapshotColumns> m_columns;
+};
+
+static_assert(std::is_trivially_copyable_v<SnapshotHeader> && sizeof(SnapshotHeader) == 48);
+static_assert(std::is_trivially_copyable_v<SnapshotCoSpace> && sizeof(SnapshotCoSpace) == 280);
+static_assert(sizeof(spaceint_t) == sizeof(int64_t));
+
+std::array<StrideDesc const*, gc_snapshotColumns> columns_of(CoSpaceSatData const& data) noexcept
+{
+    return { &data.m_satPositions[0],  &data.m_satPositions[1],  &data.m_satPositions[2],
+             &data.m_satVelocities[0], &data.m_satVelocities[1], &data.m_satVelocities[2],
+             &data.m_satRotations[0],  &data.m_satRotations[1],  &data.m_satRotations[2],
+             &data.m_satRotations[3],  &data.m_satMasses };
+}
+
+std::array<StrideDesc*, gc_snapshotColumns> columns_of(CoSpaceSatData& rData) noexcept
+{
+    return { &rData.m_satPositions[0],  &rData.m_satPositions[1],  &rData.m_satPositions[2],
+             &rData.m_satVelocities[0], &rData.m_satVelocities[1], &rData.m_satVelocities[2],
+             &rData.m_satRotations[0],  &rData.m_satRotations[1],  &rData.m_satRotations[2],
+             &rData.m_satRotations[3],  &rData.m_satMasses };
+}
+
+constexpr std::array<std::size_t, gc_snapshotColumns> gc_columnSizes
+{
+    sizeof(spaceint_t), sizeof(spaceint_t), sizeof(spaceint_t),
+    sizeof(double), sizeof(double), sizeof(double),
+    sizeof(double), sizeof(double), sizeof(double), sizeof(double),
+    sizeof(double)
+};
+
+constexpr uint64_t rotl(uint64_t const x, int const r) noexcept
+{
+    return (x << r) | (x >> (64 - r));
+}
+
+/**
+ * @brief Fast non-cryptographic hash, only used to detect which CoSpaces changed between saves
+ *
+ * Four independent lanes keep the multipliers busy; this runs at memory bandwidth.
+ */
+uint64_t hash_bytes(unsigned char const* pData, std::size_t const size) noexcept
+{
+    constexpr uint64_t p1 = 0x9E3779B185EBCA87ull;
+    constexpr uint64_t p2 = 0xC2B2AE3D27D4EB4Full;
+
+    std::array<uint64_t, 4> lanes{p1 + p2, p2, 0, 0ull - p1};
+
+    std::size_t i = 0;
+    for (; i + 32 <= size; i += 32)
+    {
+        for (std::size_t lane = 0; lane < 4; ++lane)
+        {
+            uint64_t word;
+            std::memcpy(&word, pData + i + lane * 8, 8);
+            lanes[lane] = rotl(lanes[lane] + word * p2, 31) * p1;
+        }
+    }
+
+    uint64_t hash = rotl(lanes[0], 1) + rotl(lanes[1], 7) + rotl(lanes[2], 12) + rotl(lanes[3], 18) + size;
+    for (; i < size; ++i)
+    {
+        hash = rotl(hash ^ (pData[i] * p1), 11) * p2;
+    }
+
+    hash ^= hash >> 33;
+    hash *= p2;
+    hash ^= hash >> 29;
+    return hash;
+}
+
+bool write_zeros(std::ostream& rOut, std::size_t count)
+{
+    static constexpr std::array<char, gc_snapshotPageSize> zeros{};
+    while (count != 0)
+    {
+        std::size_t const chunk = std::min(count, zeros.size());
+        rOut.write(zeros.data(), std::streamsize(chunk));
+        count -= chunk;
+    }
+    return bool(rOut);
+}
+
+/**
+ * @brief Map a whole file into memory, copy-on-write
+ */
+Corrade::Containers::Array<unsigned char> map_file(std::string const& path)
+{
+    using Corrade::Containers::Array;
+
+#if defined(_WIN32)
+    HANDLE const file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                                    nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        return {};
+    }
+
+    LARGE_INTEGER size;
+    if ( ! GetFileSizeEx(file, &size) || size.QuadPart == 0 )
+    {
+        CloseHandle(file);
+        return {};
+    }
+
+    HANDLE const mapping = CreateFileMappingA(file, nullptr, PAGE_WRITECOPY, 0, 0, nullptr);
+    CloseHandle(file);
+    if (mapping == nullptr)
+    {
+        return {};
+    }
+
+    // The view keeps the mapping object alive
+    void *const pView = MapViewOfFile(mapping, FILE_MAP_COPY, 0, 0, 0);
+    CloseHandle(mapping);
+    if (pView == nullptr)
+    {
+        return {};
+    }
+
+    return Array<unsigned char>{static_cast<unsigned char*>(pView), std::size_t(size.QuadPart),
+                                [] (unsigned char* pData, std::size_t) { UnmapViewOfFile(pData); }};
+#else
+    int const fd = ::open(path.c_str(), O_RDONLY);
+    if (fd == -1)
+    {
+        return {};
+    }
+
+    struct stat info;
+    if (::fstat(fd, &info) != 0 || info.st_size == 0)
+    {
+        ::close(fd);
+        return {};
+    }
+
+    auto const size = std::size_t(info.st_size);
+
+    // Private mapping: satellites can be modified in memory without touching the file, and
+    // pages are only copied once written to
+    void *const pMap = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (pMap == MAP_FAILED)
+    {
+        return {};
+    }
+
+    return Array<unsigned char>{static_cast<unsigned char*>(pMap), size,
+                                [] (unsigned char* pData, std::size_t size) { ::munmap(pData, size); }};
+#endif
+}
+
+/**
+ * @return True if [offset, offset + size) is within [0, limit), without overflowing
+ */
+constexpr bool range_within(uint64_t const offset, uint64_t const size, uint64_t const limit) noexcept
+{
+    return size <= limit && offset <= limit - size;
+}
+
+/**
+ * @brief Flush a file's contents to disk, so it survives a crash or power loss
+ */
+bool sync_file(std::string const& path)
+{
+#if defined(_WIN32)
+    HANDLE const file = CreateFileA(path.c_str(), GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                                    nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        return false;
+    }
+    bool const synced = FlushFileBuffers(file) != 0;
+    CloseHandle(file);
+    return synced;
+#else
+    int const fd = ::open(path.c_str(), O_RDONLY);
+    if (fd == -1)
+    {
+        return false;
+    }
+    bool const synced = ::fsync(fd) == 0;
+    ::close(fd);
+    return synced;
+#endif
+}
+
+/**
+ * @brief Flush a directory entry, such as after renaming a file into it
+ *
+ * Does nothing on Windows, where directories can't be opened to be flushed.
+ */
+bool sync_parent_directory([[maybe_unused]] std::string const& path)
+{
+#if defined(_WIN32)
+    return true;
+#else
+    std::filesystem::path parent = std::filesystem::path(path).parent_path();
+    if (parent.empty())
+    {
+        parent = ".";
+    }
+    int const fd = ::open(parent.c_str(), O_RDONLY | O_DIRECTORY);
+    if (fd == -1)
+    {
+        return false;
+    }
+    bool const synced = ::fsync(fd) == 0;
+    ::close(fd);
+    return synced;
+#endif
+}
+
+bool read_header(std::istream& rIn, SnapshotHeader& rHeader)
+{
+    rIn.read(reinterpret_cast<char*>(&rHeader), sizeof(SnapshotHeader));
+    return bool(rIn) && rHeader.m_magic == gc_snapshotMagic;
+}
+
+/**
+ * @brief Append blobs of changed CoSpaces and a new directory, then commit by rewriting the header
+ *
+ * @param rFile     [ref] File open for writing, positioned anywhere
+ * @param filePath  [in] Path of rFile, to sync it to disk
+ * @param fileSize  [in] Bytes of the file already in use, blobs from rSnapshot are kept
+ */
+ESnapshotResult write_snapshot(
+        Universe const&     universe,
+        std::ostream&       rFile,
+        std::string const&  filePath,
+        uint64_t const      fileSize,
+        UniverseSnapshot&   rSnapshot)
+{
+    std::size_t const capacity = universe.m_coordIds.capacity();
+
+    // Only committed to rSnapshot once the header is written
+    std::vector<UniverseSnapshot::SavedCoSpace> saved = rSnapshot.m_saved;
+    saved.resize(capacity);
+    uint32_t blobsWritten = 0;
+
+    std::vector<SnapshotCoSpace> directory;
+    directory.reserve(capacity);
+
+    uint64_t pos = fileSize;
+    rFile.seekp(std::streamoff(pos));
+
+    for (CoSpaceId id = 0; id < capacity; ++id)
+    {
+        UniverseSnapshot::SavedCoSpace &rSaved = saved[id];
+
+        if ( ! universe.m_coordIds.exists(id) )
+        {
+            rSaved = {};
+            continue;
+        }
+
+        CoSpaceCommon const &common = universe.m_coordCommon[id];
+
+        uint64_t const dataSize = common.m_data.size();
+        uint64_t const dataHash = hash_bytes(common.m_data.data(), common.m_data.size());
+
+        bool const unchanged = rSaved.m_saved && rSaved.m_dataSize == dataSize && rSaved.m_dataHash == dataHash;
+        if ( ! unchanged )
+        {
+            uint64_t const dataOffset = (dataSize == 0) ? 0 : align_up(pos, gc_snapshotPageSize);
+            if (dataSize != 0)
+            {
+                write_zeros(rFile, dataOffset - pos);
+                rFile.write(reinterpret_cast<char const*>(common.m_data.data()), std::streamsize(dataSize));
+                pos = dataOffset + dataSize;
+                ++ blobsWritten;
+            }
+
+            rSaved = { .m_dataOffset = dataOffset, .m_dataSize = dataSize, .m_dataHash = dataHash, .m_saved = true };
+        }
+
+        SnapshotCoSpace &rRecord = directory.emplace_back();
+        rRecord.m_id            = id;
+        rRecord.m_parent        = common.m_parent;
+        rRecord.m_parentSat     = common.m_parentSat;
+        rRecord.m_precision     = common.m_precision;
+        rRecord.m_rotation      = { common.m_rotation.vector().x(), common.m_rotation.vector().y(),
+                                    common.m_rotation.vector().z(), common.m_rotation.scalar() };
+        rRecord.m_position      = { common.m_position.x(), common.m_position.y(), common.m_position.z() };
+        rRecord.m_satCount      = common.m_satCount;
+        rRecord.m_satCapacity   = common.m_satCapacity;
+        rRecord.m_dataOffset    = rSaved.m_dataOffset;
+        rRecord.m_dataSize      = rSaved.m_dataSize;
+        rRecord.m_dataHash      = rSaved.m_dataHash;
+
+        auto const columns = columns_of(static_cast<CoSpaceSatData const&>(common));
+        for (std::size_t i = 0; i < gc_snapshotColumns; ++i)
+        {
+            rRecord.m_columns[i] = { columns[i]->m_offset, columns[i]->m_stride };
+        }
+    }
+
+    uint64_t const directoryOffset = align_up(pos, alignof(SnapshotCoSpace));
+    write_zeros(rFile, directoryOffset - pos);
+    rFile.write(reinterpret_cast<char const*>(directory.data()), std::streamsize(directory.size() * sizeof(SnapshotCoSpace)));
+    pos = directoryOffset + directory.size() * sizeof(SnapshotCoSpace);
+
+    // Everything the header points to must be on disk before the header itself
+    rFile.flush();
+    if ( ! rFile || ! sync_file(filePath) )
+    {
+        return ESnapshotResult::WriteFailed;
+    }
+
+    SnapshotHeader const header
+    {
+        .m_magic            = gc_snapshotMagic,
+        .m_version          = gc_snapshotVersion,
+        .m_endian           = gc_snapshotEndian,
+        .m_pageSize         = gc_snapshotPageSize,
+        .m_directoryCount   = uint32_t(directory.size()),
+        .m_generation       = rSnapshot.m_generation + 1,
+        .m_directoryOffset  = directoryOffset,
+        .m_fileSize         = pos
+    };
+
+    rFile.seekp(0);
+    rFile.write(reinterpret_cast<char const*>(&header), sizeof(SnapshotHeader));
+    rFile.flush();
+    if ( ! rFile || ! sync_file(filePath) )
+    {
+        return ESnapshotResult::WriteFailed;
+    }
+
+    rSnapshot.m_generation      = header.m_generation;
+    rSnapshot.m_fileSize        = pos;
+    rSnapshot.m_saved           = std::move(saved);
+    rSnapshot.m_blobsWritten    = blobsWritten;
+
+    return ESnapshotResult::Success;
+}
+
+} // namespace
+
+ESnapshotResult snapshot_save(Universe const& universe, std::string const& path, UniverseSnapshot& rSnapshot)
+{
+    // Incremental save, if the file is still exactly as rSnapshot left it
+    if (rSnapshot.m_path == path && rSnapshot.m_generation != 0)
+    {
+        std::fstream file(path, std::ios::in | std::ios::out | std::ios::binary);
+        SnapshotHeader header;
+        if (   file.is_open()
+            && read_header(file, header)
+            && header.m_generation == rSnapshot.m_generation
+            && header.m_fileSize   == rSnapshot.m_fileSize)
+        {
+            return write_snapshot(universe, file, path, header.m_fileSize, rSnapshot);
+        }
+    }
+
+    // Full save. Write to a separate file then replace, so a Universe memory-mapped from the
+    // same path keeps its pages, and so an interrupted save doesn't destroy the old snapshot.
+    std::string const tempPath = path + ".tmp";
+
+    // Generations keep counting up from whatever was there before. Otherwise, another
+    // UniverseSnapshot that last saw the old file could mistake this one for it.
+    UniverseSnapshot fresh;
+    fresh.m_generation = rSnapshot.m_generation;
+    {
+        std::ifstream existing(path, std::ios::in | std::ios::binary);
+        SnapshotHeader header;
+        if (existing.is_open() && read_header(existing, header))
+        {
+            fresh.m_generation = std::max(fresh.m_generation, header.m_generation);
+        }
+    }
+
+    {
+        std::ofstream file(tempPath, std::ios::out | std::ios::trunc | std::ios::binary);
+        if ( ! file.is_open() )
+        {
+            return ESnapshotResult::CantOpenFile;
+        }
+
+        // Header is written last, reserve its page for now
+        write_zeros(file, gc_snapshotPageSize);
+
+        ESnapshotResult const result = write_snapshot(universe, file, tempPath, gc_snapshotPageSize, fresh);
+        if (result != ESnapshotResult::Success)
+        {
+            return result;
+        }
+    }
+
+    std::error_code error;
+    std::filesystem::rename(tempPath, path, error);
+    if (error || ! sync_parent_directory(path))
+    {
+        return ESnapshotResult::WriteFailed;
+    }
+
+    fresh.m_path = path;
+    rSnapshot = std::move(fresh);
+    return ESnapshotResult::Success;
+}
+
+ESnapshotResult snapshot_load(Universe& rUniverse, std::string const& path, UniverseSnapshot& rSnapshot)
+{
+    assert(rUniverse.m_coordCommon.empty() && "Can only load into an empty Universe");
+
+    Corrade::Containers::Array<unsigned char> mapping = map_file(path);
+    if (mapping.data() == nullptr)
+    {
+        return ESnapshotResult::CantOpenFile;
+    }
+
+    if (mapping.size() < sizeof(SnapshotHeader))
+    {
+        return ESnapshotResult::NotASnapshot;
+    }
+
+    SnapshotHeader header;
+    std::memcpy(&header, mapping.data(), sizeof(SnapshotHeader));
+
+    if (header.m_magic != gc_snapshotMagic)
+    {
+        return ESnapshotResult::NotASnapshot;
+    }
+    if (header.m_version != gc_snapshotVersion || header.m_endian != gc_snapshotEndian)
+    {
+        return ESnapshotResult::UnsupportedVersion;
+    }
+
+    uint64_t const directoryBytes = uint64_t(header.m_directoryCount) * sizeof(SnapshotCoSpace);
+    if (   header.m_fileSize > mapping.size()
+        || header.m_directoryCount > gc_snapshotMaxIds
+        || header.m_directoryOffset % alignof(SnapshotCoSpace) != 0
+        || ! range_within(header.m_directoryOffset, directoryBytes, header.m_fileSize))
+    {
+        return ESnapshotResult::Corrupt;
+    }
+
+    auto const *pDirectory = reinterpret_cast<SnapshotCoSpace const*>(mapping.data() + header.m_directoryOffset);
+    Corrade::Containers::ArrayView<SnapshotCoSpace const> const directory{pDirectory, header.m_directoryCount};
+
+    // Validate everything before touching rUniverse
+    CoSpaceId maxId = 0;
+    for (SnapshotCoSpace const& record : directory)
+    {
+        if (   record.m_id >= gc_snapshotMaxIds
+            || record.m_satCount > record.m_satCapacity
+            || record.m_dataOffset % gc_snapshotPageSize != 0
+            || ! range_within(record.m_dataOffset, record.m_dataSize, header.m_fileSize))
+        {
+            return ESnapshotResult::Corrupt;
+        }
+
+        for (std::size_t i = 0; i < gc_snapshotColumns; ++i)
+        {
+            SnapshotColumn const &column = record.m_columns[i];
+            if (column.m_stride == 0 || record.m_satCapacity == 0)
+            {
+                continue; // Unused
+            }
+
+            // Last element must end within the blob. Dividing first avoids overflow.
+            uint64_t const lastRow = record.m_satCapacity - 1;
+            if (   column.m_stride < 0
+                || (lastRow != 0 && uint64_t(column.m_stride) > record.m_dataSize / lastRow)
+                || ! range_within(column.m_offset, uint64_t(column.m_stride) * lastRow + gc_columnSizes[i], record.m_dataSize))
+            {
+                return ESnapshotResult::Corrupt;
+            }
+        }
+
+        maxId = std::max(maxId, record.m_id);
+    }
+
+    // Each CoSpaceId must appear once
+    constexpr uint32_t nullRecord = lgrn::id_null<uint32_t>();
+    std::vector<uint32_t> recordOf(std::size_t(maxId) + 1, nullRecord);
+    for (uint32_t i = 0; i < directory.size(); ++i)
+    {
+        uint32_t &rRecord = recordOf[directory[i].m_id];
+        if (rRecord != nullRecord)
+        {
+            return ESnapshotResult::Corrupt;
+        }
+        rRecord = i;
+    }
+
+    // Parents must exist, have the parent satellite, and never loop back
+    for (SnapshotCoSpace const& record : directory)
+    {
+        if (record.m_parent == lgrn::id_null<CoSpaceId>())
+        {
+            continue;
+        }
+        if (record.m_parent > maxId || recordOf[record.m_parent] == nullRecord)
+        {
+            return ESnapshotResult::Corrupt;
+        }
+        if (   record.m_parentSat != lgrn::id_null<SatId>()
+            && record.m_parentSat >= directory[recordOf[record.m_parent]].m_satCount)
+        {
+            return ESnapshotResult::Corrupt;
+        }
+
+        // A chain longer than the number of CoSpaces must contain a cycle
+        CoSpaceId ancestor = record.m_parent;
+        for (std::size_t depth = 0; ancestor != lgrn::id_null<CoSpaceId>(); ++depth)
+        {
+            if (depth == directory.size())
+            {
+                return ESnapshotResult::Corrupt;
+            }
+            ancestor = directory[recordOf[ancestor]].m_parent;
+        }
+    }
+
+    // Recreate the same CoSpaceIds; a fresh registry hands out IDs in order
+    if ( ! directory.isEmpty() )
+    {
+        for (CoSpaceId id = 0; id <= maxId; ++id)
+        {
+            [[maybe_unused]] CoSpaceId const created = rUniverse.m_coordIds.create();
+            assert(created == id);
+        }
+    }
+
+    for (CoSpaceId id = 0; id < recordOf.size(); ++id)
+    {
+        if (recordOf[id] == nullRecord && rUniverse.m_coordIds.exists(id))
+        {
+            rUniverse.m_coordIds.remove(id);
+        }
+    }
+
+    rUniverse.m_coordCommon.clear();
+    rUniverse.m_coordCommon.resize(rUniverse.m_coordIds.capacity());
+
+    rSnapshot = {};
+    rSnapshot.m_path        = path;
+    rSnapshot.m_generation  = header.m_generation;
+    rSnapshot.m_fileSize    = header.m_fileSize;
+    rSnapshot.m_saved.resize(rUniverse.m_coordIds.capacity());
+
+    for (SnapshotCoSpace const& record : directory)
+    {
+        CoSpaceCommon &rCommon = rUniverse.m_coordCommon[record.m_id];
+
+        rCommon.m_parent        = record.m_parent;
+        rCommon.m_parentSat     = record.m_parentSat;
+        rCommon.m_precision     = record.m_precision;
+        rCommon.m_rotation      = Quaterniond{{record.m_rotation[0], record.m_rotation[1], record.m_rotation[2]}, record.m_rotation[3]};
+        rCommon.m_position      = Vector3g{record.m_position[0], record.m_position[1], record.m_position[2]};
+        coord_transform_changed(rCommon);
+        rCommon.m_satCount      = record.m_satCount;
+        rCommon.m_satCapacity   = record.m_satCapacity;
+
+        auto const columns = columns_of(static_cast<CoSpaceSatData&>(rCommon));
+        for (std::size_t i = 0; i < gc_snapshotColumns; ++i)
+        {
+            columns[i]->m_offset = std::size_t(record.m_columns[i].m_offset);
+            columns[i]->m_stride = std::ptrdiff_t(record.m_columns[i].m_stride);
+        }
+
+        // Point straight into the mapping. The mapping is owned by the Universe, so m_data
+        // doesn't free anything.
+        if (record.m_dataSize != 0)
+        {
+            rCommon.m_data = Corrade::Containers::Array<unsigned char>{
+                    mapping.data() + record.m_dataOffset, std::size_t(record.m_dataSize),
+                    [] (unsigned char*, std::size_t) { }};
+        }
+
+        rSnapshot.m_saved[record.m_id] = { .m_dataOffset    = record.m_dataOffset,
+                                           .m_dataSize      = record.m_dataSize,
+                                           .m_dataHash      = record.m_dataHash,
+                                           .m_saved         = true };
+    }
+
+    rUniverse.m_snapshotMapping = std::move(mapping);
+
+    return ESnapshotResult::Success;
+}
+
+} // namespace osp::universe
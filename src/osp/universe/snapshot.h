@@ -0,0 +1,117 @@
+/**
+ * Open Space Program
+ * Copyright © 2019-2024 Open Space Program Project
+ *
+ * MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#pragma once
+
+#include "universe.h"
+
+#include <string>
+#include <vector>
+
+/**
+ * Universe snapshot file format
+ *
+ * [Header, padded to a page]
+ * [CoSpace m_data blob, page aligned]
+ * [CoSpace m_data blob, page aligned]
+ * ...
+ * [Directory: one record per CoSpace, pointing at its blob]
+ *
+ * Files are append-only. An incremental save appends blobs of CoSpaces that changed, then a new
+ * directory that also points at the unchanged blobs written by earlier saves, and finally
+ * rewrites the header to point at the new directory. Everything is synced to disk before the
+ * header is written, so a save interrupted before then leaves the previous snapshot intact.
+ * The header's generation counts up with every save, including full ones.
+ *
+ * Loading maps the whole file copy-on-write, and points each CoSpace's m_data directly at its
+ * blob. Satellite data is only read from disk as it's touched, and only copied once modified.
+ */
+
+namespace osp::universe
+{
+
+constexpr uint32_t gc_snapshotVersion   = 1;
+constexpr uint32_t gc_snapshotPageSize  = 4096;
+
+enum class ESnapshotResult : uint8_t
+{
+    Success,
+    CantOpenFile,
+    NotASnapshot,
+    UnsupportedVersion,
+    Corrupt,
+    WriteFailed
+};
+
+/**
+ * @brief Keeps track of previous saves to the same file, allowing incremental saves
+ */
+struct UniverseSnapshot
+{
+    struct SavedCoSpace
+    {
+        uint64_t    m_dataOffset{0};
+        uint64_t    m_dataSize{0};
+        uint64_t    m_dataHash{0};
+        bool        m_saved{false};
+    };
+
+    std::string                 m_path;
+    uint64_t                    m_generation{0};
+    uint64_t                    m_fileSize{0};
+
+    // Indexed by CoSpaceId
+    std::vector<SavedCoSpace>   m_saved;
+
+    // Number of CoSpace blobs written by the most recent save
+    uint32_t                    m_blobsWritten{0};
+};
+
+/**
+ * @brief Save a Universe to a snapshot file
+ *
+ * If rSnapshot last saved to or loaded from the same path, and the file wasn't modified since,
+ * then only CoSpaces with different satellite data are written. Otherwise, the file is
+ * overwritten with a full snapshot. Use a default-constructed UniverseSnapshot to force a full
+ * snapshot, which also discards blobs no longer referenced by incremental saves.
+ *
+ * @param universe  [in] Universe to save
+ * @param path      [in] File to write to
+ * @param rSnapshot [ref] State of previous saves, updated on success
+ */
+ESnapshotResult snapshot_save(Universe const& universe, std::string const& path, UniverseSnapshot& rSnapshot);
+
+/**
+ * @brief Load a Universe from a snapshot file
+ *
+ * The file is memory-mapped into Universe::m_snapshotMapping. Changes to satellite data are
+ * private to the process and never written back to the file.
+ *
+ * @param rUniverse [out] Default-constructed Universe to load into
+ * @param path      [in] File to load from
+ * @param rSnapshot [out] Set up for incremental saves to the same file
+ */
+ESnapshotResult snapshot_load(Universe& rUniverse, std::string const& path, UniverseSnapshot& rSnapshot);
+
+} // namespace osp::universe
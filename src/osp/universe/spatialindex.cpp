@@ -0,0 +1,407 @@
+/**
+ * Open Space Program
+ * Copyright © 2019-2024 Open Space Program Project
+ *
+ * MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include "spatialindex.h"
+#include "kepler.h"
+
+#include "../core/math_2pow.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace osp::universe
+{
+
+namespace
+{
+
+constexpr int       gc_cellKeyBits  = 21;
+constexpr uint64_t  gc_cellKeyMask  = (uint64_t(1) << gc_cellKeyBits) - 1;
+
+uint64_t cell_key(Vector3g const cell) noexcept
+{
+    return   (uint64_t(cell.x()) & gc_cellKeyMask)
+           | (uint64_t(cell.y()) & gc_cellKeyMask) << gc_cellKeyBits
+           | (uint64_t(cell.z()) & gc_cellKeyMask) << (2 * gc_cellKeyBits);
+}
+
+Vector3g cell_of(Vector3g const pos, int const cellShift) noexcept
+{
+    // Arithmetic shift rounds towards negative infinity, so cells don't double up around zero
+    return {pos.x() >> cellShift, pos.y() >> cellShift, pos.z() >> cellShift};
+}
+
+/**
+ * @brief Reads current positions and speeds of satellites, including ones on rails
+ */
+struct SatReader
+{
+    SatReader(CoSpaceCommon const& space, SatRails const* pRails)
+     : m_space      {space}
+     , m_pRails     {pRails}
+     , m_pos        {sat_views(space.m_satPositions, space.m_data, space.m_satCount)}
+     , m_hasVel     {! space.m_satVelocities[0].not_used()}
+    {
+        if (m_hasVel)
+        {
+            m_vel = sat_views(space.m_satVelocities, space.m_data, space.m_satCount);
+        }
+    }
+
+    Vector3g position(SatId const sat) const noexcept
+    {
+        if (m_pRails != nullptr && sat_rails_on_rails(*m_pRails, sat))
+        {
+            return sat_rails_position(m_space, *m_pRails, sat);
+        }
+        return to_vec<Vector3g>(sat, m_pos[0], m_pos[1], m_pos[2]);
+    }
+
+    // In meters per second
+    double speed(SatId const sat) const noexcept
+    {
+        if (m_pRails != nullptr && sat_rails_on_rails(*m_pRails, sat))
+        {
+            return m_pRails->m_orbits[sat].m_maxSpeed;
+        }
+        return m_hasVel ? to_vec<Vector3d>(sat, m_vel[0], m_vel[1], m_vel[2]).length() : 0.0;
+    }
+
+    CoSpaceCommon const&    m_space;
+    SatRails const*         m_pRails;
+    SatPosViewsConst_t      m_pos;
+    std::array<TypedStrideDesc<double>::ViewConst_t, 3> m_vel;
+    bool                    m_hasVel;
+};
+
+void schedule(SatGridIndex& rIndex, SatId const sat, Vector3g const pos, double const unitsPerUpdate)
+{
+    // Distance to the nearest face of the loose cell: the cell grown by half a cell on each side
+    spaceint_t const cellSize   = spaceint_t(1) << rIndex.m_cellShift;
+    spaceint_t const half       = cellSize / 2;
+    Vector3g const   cell       = rIndex.m_satCell[sat];
+
+    spaceint_t slack = std::numeric_limits<spaceint_t>::max();
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        spaceint_t const lo = cell[axis] * cellSize - half;
+        spaceint_t const hi = (cell[axis] + 1) * cellSize + half;
+        slack = std::min({slack, pos[axis] - lo, hi - pos[axis]});
+    }
+
+    double const updates = (unitsPerUpdate > 0.0) ? std::floor(double(slack) / unitsPerUpdate)
+                                                   : std::numeric_limits<double>::infinity();
+
+    uint64_t const interval = (updates >= double(SatGridIndex::smc_maxInterval - 1))
+                            ? SatGridIndex::smc_maxInterval - 1
+                            : std::max<uint64_t>(uint64_t(updates), 1);
+
+    uint64_t const due = rIndex.m_update + interval;
+    rIndex.m_satDue[sat] = due;
+    rIndex.m_due[due % SatGridIndex::smc_maxInterval].push_back(sat);
+}
+
+double units_per_update(SatGridIndex const& index, CoSpaceCommon const& space, double const speed, double const deltaTime) noexcept
+{
+    return speed * index.m_speedMargin * deltaTime * math::mul_2pow<double, int>(1.0, space.m_precision);
+}
+
+void file_sat(SatGridIndex& rIndex, SatReader const& reader, SatId const sat, double const deltaTime)
+{
+    Vector3g const pos  = reader.position(sat);
+    Vector3g const cell = cell_of(pos, rIndex.m_cellShift);
+
+    std::vector<SatId> &rBucket = rIndex.m_cells[cell_key(cell)];
+    rIndex.m_satCell[sat] = cell;
+    rIndex.m_satSlot[sat] = uint32_t(rBucket.size());
+    rBucket.push_back(sat);
+
+    schedule(rIndex, sat, pos, units_per_update(rIndex, reader.m_space, reader.speed(sat), deltaTime));
+}
+
+void unfile_sat(SatGridIndex& rIndex, SatId const sat)
+{
+    auto const found = rIndex.m_cells.find(cell_key(rIndex.m_satCell[sat]));
+    std::vector<SatId> &rBucket = found->second;
+
+    uint32_t const slot  = rIndex.m_satSlot[sat];
+    SatId const    moved = rBucket.back();
+    rBucket[slot]           = moved;
+    rIndex.m_satSlot[moved] = slot;
+    rBucket.pop_back();
+
+    if (rBucket.empty())
+    {
+        rIndex.m_cells.erase(found);
+    }
+
+    // Any pending check is now stale
+    rIndex.m_satDue[sat] = 0;
+}
+
+void resize_sats(SatGridIndex& rIndex, SatReader const& reader, uint32_t const count, double const deltaTime)
+{
+    uint32_t const oldCount = rIndex.m_satCount;
+
+    for (SatId sat = count; sat < oldCount; ++sat)
+    {
+        unfile_sat(rIndex, sat);
+    }
+
+    rIndex.m_satCell.resize(count);
+    rIndex.m_satSlot.resize(count);
+    rIndex.m_satDue .resize(count, 0);
+    rIndex.m_satCount = count;
+
+    for (SatId sat = oldCount; sat < count; ++sat)
+    {
+        file_sat(rIndex, reader, sat, deltaTime);
+    }
+}
+
+double distance_sq(Vector3g const a, Vector3g const b) noexcept
+{
+    Vector3d const diff{Vector3g{a - b}};
+    return Magnum::Math::dot(diff, diff);
+}
+
+} // namespace
+
+void sat_index_build(SatGridIndex& rIndex, CoSpaceCommon const& space, SatRails const* const pRails, double const deltaTime)
+{
+    rIndex.m_cells.clear();
+    rIndex.m_satCell.clear();
+    rIndex.m_satSlot.clear();
+    rIndex.m_satDue .clear();
+    rIndex.m_due    .resize(SatGridIndex::smc_maxInterval);
+    for (std::vector<SatId> &rDue : rIndex.m_due)
+    {
+        rDue.clear();
+    }
+    rIndex.m_update     = 0;
+    rIndex.m_satCount   = 0;
+    rIndex.m_built      = true;
+
+    if (space.m_satPositions[0].not_used())
+    {
+        return;
+    }
+
+    resize_sats(rIndex, SatReader{space, pRails}, space.m_satCount, deltaTime);
+}
+
+void sat_index_update(SatGridIndex& rIndex, CoSpaceCommon const& space, SatRails const* const pRails, double const deltaTime)
+{
+    if ( ! rIndex.m_built )
+    {
+        sat_index_build(rIndex, space, pRails, deltaTime);
+        return;
+    }
+
+    if (space.m_satPositions[0].not_used())
+    {
+        return;
+    }
+
+    ++ rIndex.m_update;
+
+    SatReader const reader{space, pRails};
+    resize_sats(rIndex, reader, space.m_satCount, deltaTime);
+
+    // Checks only ever get scheduled 1 to smc_maxInterval - 1 updates ahead, so nothing gets
+    // pushed onto this slot while iterating it
+    std::vector<SatId> &rDue = rIndex.m_due[rIndex.m_update % SatGridIndex::smc_maxInterval];
+    for (SatId const sat : rDue)
+    {
+        if (sat >= rIndex.m_satCount || rIndex.m_satDue[sat] != rIndex.m_update)
+        {
+            continue;
+        }
+
+        Vector3g const pos  = reader.position(sat);
+        Vector3g const cell = cell_of(pos, rIndex.m_cellShift);
+        if (cell != rIndex.m_satCell[sat])
+        {
+            unfile_sat(rIndex, sat);
+            file_sat(rIndex, reader, sat, deltaTime);
+        }
+        else
+        {
+            schedule(rIndex, sat, pos, units_per_update(rIndex, space, reader.speed(sat), deltaTime));
+        }
+    }
+    rDue.clear();
+}
+
+void sat_index_remap(
+        SatGridIndex&                   rIndex,
+        CoSpaceCommon const&            space,
+        SatRails const* const           pRails,
+        CoSpaceId const                 id,
+        ArrayView<SatRemap const> const remaps,
+        double const                    deltaTime)
+{
+    if ( ! rIndex.m_built || space.m_satPositions[0].not_used() )
+    {
+        return;
+    }
+
+    SatReader const reader{space, pRails};
+    uint32_t const  oldCount = rIndex.m_satCount;
+
+    resize_sats(rIndex, reader, space.m_satCount, deltaTime);
+
+    // Satellites that landed on existing SatIds are filed under whatever used to be there
+    for (SatRemap const& remap : remaps)
+    {
+        if (remap.m_newCoSpace == id && remap.m_newSat < oldCount && remap.m_newSat < rIndex.m_satCount)
+        {
+            unfile_sat(rIndex, remap.m_newSat);
+            file_sat(rIndex, reader, remap.m_newSat, deltaTime);
+        }
+    }
+}
+
+void sat_index_radius(
+        SatGridIndex const&     index,
+        CoSpaceCommon const&    space,
+        SatRails const* const   pRails,
+        Vector3g const          center,
+        spaceint_t const        radius,
+        std::vector<SatId>&     rOut)
+{
+    rOut.clear();
+
+    if (index.m_satCount == 0)
+    {
+        return;
+    }
+
+    SatReader const reader{space, pRails};
+    double const    radiusSq = double(radius) * double(radius);
+
+    auto const check_bucket = [&] (std::vector<SatId> const& bucket)
+    {
+        for (SatId const sat : bucket)
+        {
+            if (distance_sq(reader.position(sat), center) <= radiusSq)
+            {
+                rOut.push_back(sat);
+            }
+        }
+    };
+
+    // Satellites may be up to half a cell outside of the cell they're filed under
+    spaceint_t const reach  = radius + (spaceint_t(1) << index.m_cellShift) / 2;
+    Vector3g const   lo     = cell_of(center - Vector3g{reach, reach, reach}, index.m_cellShift);
+    Vector3g const   hi     = cell_of(center + Vector3g{reach, reach, reach}, index.m_cellShift);
+    Vector3d const   extent = Vector3d(Vector3g{hi - lo}) + Vector3d{1.0, 1.0, 1.0};
+
+    // Visiting every cell in range is pointless if there are fewer buckets than that. Wrapped
+    // keys would also visit the same bucket twice.
+    if (   extent.x() * extent.y() * extent.z() > double(index.m_cells.size())
+        || extent.max() > double(gc_cellKeyMask))
+    {
+        for (auto const& [key, bucket] : index.m_cells)
+        {
+            check_bucket(bucket);
+        }
+        return;
+    }
+
+    for (spaceint_t z = lo.z(); z <= hi.z(); ++z)
+    {
+        for (spaceint_t y = lo.y(); y <= hi.y(); ++y)
+        {
+            for (spaceint_t x = lo.x(); x <= hi.x(); ++x)
+            {
+                auto const found = index.m_cells.find(cell_key({x, y, z}));
+                if (found != index.m_cells.end())
+                {
+                    check_bucket(found->second);
+                }
+            }
+        }
+    }
+}
+
+void sat_index_nearest(
+        SatGridIndex const&     index,
+        CoSpaceCommon const&    space,
+        SatRails const* const   pRails,
+        Vector3g const          center,
+        std::size_t const       k,
+        std::vector<SatId>&     rOut)
+{
+    rOut.clear();
+
+    if (k == 0 || index.m_satCount == 0)
+    {
+        return;
+    }
+
+    // Search increasingly large spheres. Once one has at least k satellites, the k closest
+    // satellites are all inside of it.
+    if (index.m_satCount <= k)
+    {
+        rOut.resize(index.m_satCount);
+        for (SatId sat = 0; sat < index.m_satCount; ++sat)
+        {
+            rOut[sat] = sat;
+        }
+    }
+    else
+    {
+        spaceint_t radius = spaceint_t(1) << index.m_cellShift;
+        while (true)
+        {
+            sat_index_radius(index, space, pRails, center, radius, rOut);
+            if (rOut.size() >= k || radius > std::numeric_limits<spaceint_t>::max() / 4)
+            {
+                break;
+            }
+            radius *= 2;
+        }
+    }
+
+    SatReader const reader{space, pRails};
+
+    std::vector<std::pair<double, SatId>> byDistance(rOut.size());
+    for (std::size_t i = 0; i < rOut.size(); ++i)
+    {
+        byDistance[i] = {distance_sq(reader.position(rOut[i]), center), rOut[i]};
+    }
+
+    std::size_t const found = std::min(k, byDistance.size());
+    std::partial_sort(byDistance.begin(), byDistance.begin() + std::ptrdiff_t(found), byDistance.end());
+
+    rOut.resize(found);
+    for (std::size_t i = 0; i < found; ++i)
+    {
+        rOut[i] = byDistance[i].second;
+    }
+}
+
+} // namespace osp::universe
@@ -0,0 +1,160 @@
+/**
+ * Open Space Program
+ * Copyright © 2019-2024 Open Space Program Project
+ *
+ * MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#pragma once
+
+#include "transfer.h"
+#include "universe.h"
+
+#include "../core/array_view.h"
+#include "../core/id_map.h"
+
+#include <vector>
+
+namespace osp::universe
+{
+
+struct SatRails;
+
+/**
+ * @brief Loose hashed grid over the satellites of a CoSpace
+ *
+ * Satellites are bucketed into cubic cells of 2^m_cellShift position units, hashed by their
+ * integer cell coordinates. Cells are loose: a satellite is allowed to wander up to half a cell
+ * outside of the cell it's filed under before it's moved.
+ *
+ * Satellites aren't looked at every update. When filed, each is given a number of updates before
+ * it could possibly leave its loose cell, from its speed times m_speedMargin, and is only checked
+ * again once that many updates have passed (or smc_maxInterval, whichever is sooner). Slow and
+ * stationary satellites cost nothing while they stay put.
+ *
+ * Cell coordinates wrap around past 2^21 cells along each axis. Cells that wrap onto each other
+ * share a bucket, which only costs extra distance checks.
+ */
+struct SatGridIndex
+{
+    static constexpr uint32_t smc_maxInterval = 64;
+
+    // Cells are 2^m_cellShift position units wide. Change with sat_index_build.
+    int                                     m_cellShift     {20};
+
+    // Speeds are multiplied by this when scheduling checks, to leave room for satellites that
+    // speed up in the meantime
+    double                                  m_speedMargin   {2.0};
+
+    // Buckets of satellites, by cell key
+    IdMap_t<uint64_t, std::vector<SatId>>   m_cells;
+
+    // Indexed by SatId
+    std::vector<Vector3g>                   m_satCell;
+    std::vector<uint32_t>                   m_satSlot;      // Index within its bucket
+    std::vector<uint64_t>                   m_satDue;       // Update to check it again
+
+    // Satellites due for a check, by update number modulo smc_maxInterval. Entries that don't
+    // match m_satDue are stale.
+    std::vector<std::vector<SatId>>         m_due;
+
+    uint64_t                                m_update        {0};
+    uint32_t                                m_satCount      {0};
+    bool                                    m_built         {false};
+};
+
+/**
+ * @brief File all satellites of a CoSpace into an index from scratch
+ *
+ * @param rIndex    [out] Index to overwrite, m_cellShift and m_speedMargin are kept
+ * @param space     [in] CoSpace to index, requires positions
+ * @param pRails    [in] Optional, on-rails state of space, for positions that aren't in m_data
+ * @param deltaTime [in] Time between calls to sat_index_update, in seconds
+ */
+void sat_index_build(SatGridIndex& rIndex, CoSpaceCommon const& space, SatRails const* pRails, double deltaTime);
+
+/**
+ * @brief Move satellites that may have changed cells since the last update
+ *
+ * Builds the index if it isn't yet. Satellites added to or removed from the end of the CoSpace
+ * are filed and unfiled. For satellites that were moved by sat_transfer, use sat_index_remap.
+ *
+ * @param rIndex    [ref] Index to update
+ * @param space     [in] CoSpace to index, after its satellites were moved
+ * @param pRails    [in] Optional, on-rails state of space
+ * @param deltaTime [in] Time since the last update, in seconds
+ */
+void sat_index_update(SatGridIndex& rIndex, CoSpaceCommon const& space, SatRails const* pRails, double deltaTime);
+
+/**
+ * @brief Refile satellites that were moved by sat_transfer
+ *
+ * @param rIndex    [ref] Index of a CoSpace
+ * @param space     [in] CoSpace after the transfers
+ * @param pRails    [in] Optional, on-rails state of space
+ * @param id        [in] CoSpaceId of space
+ * @param remaps    [in] Remaps from sat_transfer
+ * @param deltaTime [in] Time between calls to sat_index_update, in seconds
+ */
+void sat_index_remap(
+        SatGridIndex&               rIndex,
+        CoSpaceCommon const&        space,
+        SatRails const*             pRails,
+        CoSpaceId                   id,
+        ArrayView<SatRemap const>   remaps,
+        double                      deltaTime);
+
+/**
+ * @brief Find all satellites within a distance of a point
+ *
+ * @param index     [in] Index of space
+ * @param space     [in] CoSpace to search
+ * @param pRails    [in] Optional, on-rails state of space
+ * @param center    [in] Point to search around, in space's position units
+ * @param radius    [in] Search radius, in space's position units
+ * @param rOut      [out] Cleared, then filled with satellites found, in no particular order
+ */
+void sat_index_radius(
+        SatGridIndex const&         index,
+        CoSpaceCommon const&        space,
+        SatRails const*             pRails,
+        Vector3g                    center,
+        spaceint_t                  radius,
+        std::vector<SatId>&         rOut);
+
+/**
+ * @brief Find the k satellites closest to a point
+ *
+ * @param index     [in] Index of space
+ * @param space     [in] CoSpace to search
+ * @param pRails    [in] Optional, on-rails state of space
+ * @param center    [in] Point to search around, in space's position units
+ * @param k         [in] Number of satellites to find, fewer are found if the CoSpace has fewer
+ * @param rOut      [out] Cleared, then filled with satellites found, closest first
+ */
+void sat_index_nearest(
+        SatGridIndex const&         index,
+        CoSpaceCommon const&        space,
+        SatRails const*             pRails,
+        Vector3g                    center,
+        std::size_t                 k,
+        std::vector<SatId>&         rOut);
+
+} // namespace osp::universe
@@ -0,0 +1,544 @@
+/**
+ * Open Space Program
+ * Copyright © 2019-2024 Open Space Program Project
+ *
+ * MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include "transfer.h"
+#include "coordinates.h"
+#include "hierarchy.h"
+
+#include "../core/id_map.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <numeric>
+
+namespace osp::universe
+{
+
+namespace
+{
+
+/**
+ * @brief Interleaved columns that share rows within CoSpaceSatData::m_data
+ *
+ * Separate columns (XXXX... YYYY...) are each their own group, with a stride of one element.
+ * Interleaved columns (XYZWXYZW...) form a single group with a stride of the whole row.
+ */
+struct SatDataGroup
+{
+    std::size_t     m_offset;
+    std::ptrdiff_t  m_stride;
+    std::size_t     m_lastMember;
+};
+
+constexpr std::size_t gc_satDataColumnCount = 11;
+
+using SatDataColumns_t  = std::array<StrideDesc*, gc_satDataColumnCount>;
+using SatColumnGroups_t = std::array<std::size_t, gc_satDataColumnCount>;
+
+SatDataColumns_t sat_data_columns(CoSpaceSatData& rData) noexcept
+{
+    return { &rData.m_satPositions[0],  &rData.m_satPositions[1],  &rData.m_satPositions[2],
+             &rData.m_satVelocities[0], &rData.m_satVelocities[1], &rData.m_satVelocities[2],
+             &rData.m_satRotations[0],  &rData.m_satRotations[1],  &rData.m_satRotations[2],
+             &rData.m_satRotations[3],  &rData.m_satMasses };
+}
+
+/**
+ * @brief Find groups of columns
+ *
+ * @param rData         [in] Satellite data to read the layout of
+ * @param rGroups       [out] Groups, in order of offset
+ * @param rColumnGroup  [out] Group index of each column from sat_data_columns, if used
+ */
+void sat_data_groups(CoSpaceSatData& rData, std::vector<SatDataGroup>& rGroups, SatColumnGroups_t& rColumnGroup)
+{
+    SatDataColumns_t const columns = sat_data_columns(rData);
+
+    std::array<std::size_t, gc_satDataColumnCount> order;
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&columns] (std::size_t const lhs, std::size_t const rhs)
+    {
+        return columns[lhs]->m_offset < columns[rhs]->m_offset;
+    });
+
+    rGroups.clear();
+    for (std::size_t const columnIdx : order)
+    {
+        StrideDesc const &column = *columns[columnIdx];
+        if (column.not_used())
+        {
+            continue;
+        }
+
+        // Columns share a row if they land within the same stride as an existing group. Two
+        // columns at the same offset can't share a row; this happens if capacity is zero.
+        auto const sameRow = std::find_if(rGroups.begin(), rGroups.end(), [&column] (SatDataGroup const& group)
+        {
+            return    group.m_stride     == column.m_stride
+                   && group.m_lastMember <  column.m_offset
+                   && column.m_offset    <  group.m_offset + std::size_t(group.m_stride);
+        });
+
+        if (sameRow != rGroups.end())
+        {
+            sameRow->m_lastMember    = column.m_offset;
+            rColumnGroup[columnIdx]  = std::size_t(std::distance(rGroups.begin(), sameRow));
+        }
+        else
+        {
+            rColumnGroup[columnIdx] = rGroups.size();
+            rGroups.push_back({column.m_offset, column.m_stride, column.m_offset});
+        }
+    }
+}
+
+void sat_data_copy_row(CoSpaceSatData& rData, std::vector<SatDataGroup> const& groups, SatId const from, SatId const to) noexcept
+{
+    unsigned char *const pData = rData.m_data.data();
+    for (SatDataGroup const& group : groups)
+    {
+        std::memcpy(pData + group.m_offset + std::size_t(group.m_stride) * to,
+                    pData + group.m_offset + std::size_t(group.m_stride) * from,
+                    std::size_t(group.m_stride));
+    }
+}
+
+/**
+ * @brief Orientation and velocity of a CoSpace's origin, relative to the root of its hierarchy
+ */
+struct FrameMotion
+{
+    Quaterniond m_rotation;
+    Vector3d    m_velocity{0.0};
+};
+
+FrameMotion frame_motion(Universe const& universe, CoSpaceId id) noexcept
+{
+    FrameMotion out;
+
+    while (true)
+    {
+        CoSpaceCommon const &common = universe.m_coordCommon[id];
+        CoSpaceId const      parent = common.m_parent;
+
+        if (parent == lgrn::id_null<CoSpaceId>() || ! universe.m_coordIds.exists(parent))
+        {
+            return out;
+        }
+
+        // Bring velocity from this CoSpace's orientation into the parent's, then add velocity of
+        // the parent satellite this CoSpace is attached to
+        out.m_velocity = common.m_rotation.transformVector(out.m_velocity);
+        out.m_rotation = common.m_rotation * out.m_rotation;
+
+        CoSpaceCommon const &parentCommon = universe.m_coordCommon[parent];
+        if (common.m_parentSat != lgrn::id_null<SatId>() && ! parentCommon.m_satVelocities[0].not_used())
+        {
+            auto const [vx, vy, vz] = sat_views(parentCommon.m_satVelocities, parentCommon.m_data, parentCommon.m_satCount);
+            out.m_velocity += to_vec<Vector3d>(common.m_parentSat, vx, vy, vz);
+        }
+
+        id = parent;
+    }
+}
+
+/**
+ * @brief Satellite state copied out of the source CoSpace, before any are removed
+ */
+struct Outgoing
+{
+    std::vector<spaceint_t>     m_x;
+    std::vector<spaceint_t>     m_y;
+    std::vector<spaceint_t>     m_z;
+    std::vector<Vector3d>       m_velocities;
+    std::vector<Quaterniond>    m_rotations;
+    std::vector<double>         m_masses;
+
+    void resize(std::size_t const size)
+    {
+        m_x         .resize(size);
+        m_y         .resize(size);
+        m_z         .resize(size);
+        m_velocities.resize(size);
+        m_rotations .resize(size);
+        m_masses    .resize(size);
+    }
+};
+
+constexpr bool order_by_dst(SatTransfer const& lhs, SatTransfer const& rhs) noexcept
+{
+    return   (lhs.m_dst != rhs.m_dst) ? (lhs.m_dst < rhs.m_dst)
+           : (lhs.m_src != rhs.m_src) ? (lhs.m_src < rhs.m_src)
+           : (lhs.m_sat <  rhs.m_sat);
+}
+
+constexpr bool order_by_src_descending(SatTransfer const& lhs, SatTransfer const& rhs) noexcept
+{
+    return   (lhs.m_src != rhs.m_src) ? (lhs.m_src < rhs.m_src)
+           : (lhs.m_sat >  rhs.m_sat);
+}
+
+constexpr uint64_t sat_key(CoSpaceId const coSpace, SatId const sat) noexcept
+{
+    return (uint64_t(coSpace) << 32) | uint64_t(sat);
+}
+
+/**
+ * @brief Call func(first, last) for each run of elements where same(a, b) is true
+ */
+template <typename IT_T, typename SAME_T, typename FUNC_T>
+void for_each_run(IT_T first, IT_T const last, SAME_T&& same, FUNC_T&& func)
+{
+    while (first != last)
+    {
+        IT_T runLast = std::next(first);
+        while (runLast != last && same(*first, *runLast))
+        {
+            ++runLast;
+        }
+        func(first, runLast);
+        first = runLast;
+    }
+}
+
+/**
+ * @brief Point CoSpaces parented to remapped satellites at their new CoSpace and SatId
+ *
+ * CoSpaces that changed parent CoSpace take their transform from the satellite's new position.
+ *
+ * @param rUniverse [ref] Universe to modify
+ * @param remaps    [in] Remaps to follow
+ * @param rFollowed [ref] CoSpaces already moved by a previous call, skipped and then added to.
+ *                        A previous remap's new SatId may equal the old SatId of a later one.
+ */
+void follow_remaps(Universe& rUniverse, ArrayView<SatRemap const> const remaps, std::vector<bool>& rFollowed)
+{
+    if (remaps.isEmpty())
+    {
+        return;
+    }
+
+    IdMap_t<uint64_t, SatRemap const*> remapOf;
+    for (SatRemap const& remap : remaps)
+    {
+        remapOf.emplace(sat_key(remap.m_oldCoSpace, remap.m_oldSat), &remap);
+    }
+
+    for (CoSpaceId id = 0; id < rUniverse.m_coordIds.capacity(); ++id)
+    {
+        if ( ! rUniverse.m_coordIds.exists(id) || rFollowed[id] )
+        {
+            continue;
+        }
+
+        CoSpaceCommon &rCommon = rUniverse.m_coordCommon[id];
+        if (rCommon.m_parentSat == lgrn::id_null<SatId>())
+        {
+            continue;
+        }
+
+        auto const found = remapOf.find(sat_key(rCommon.m_parent, rCommon.m_parentSat));
+        if (found == remapOf.end())
+        {
+            continue;
+        }
+
+        SatRemap const &remap = *found->second;
+        rCommon.m_parentSat = remap.m_newSat;
+        rFollowed[id]       = true;
+        coord_transform_changed(rCommon);
+
+        if (remap.m_newCoSpace != remap.m_oldCoSpace)
+        {
+            rCommon.m_parent = remap.m_newCoSpace;
+            coord_sync_parent_sat(rCommon, rUniverse.m_coordCommon[remap.m_newCoSpace]);
+        }
+    }
+}
+
+} // namespace
+
+void sat_data_reserve(CoSpaceSatData& rData, uint32_t const capacity)
+{
+    if (capacity <= rData.m_satCapacity)
+    {
+        return;
+    }
+
+    // Positions are required. A CoSpace that was never partitioned gets separate X, Y, and Z
+    // columns, which are laid out below the same as any other group with no rows yet.
+    if (rData.m_satPositions[0].not_used())
+    {
+        assert(rData.m_satCount == 0);
+        for (TypedStrideDesc<spaceint_t> &rColumn : rData.m_satPositions)
+        {
+            rColumn.m_offset = 0;
+            rColumn.m_stride = sizeof(spaceint_t);
+        }
+    }
+
+    std::vector<SatDataGroup>   groups;
+    SatColumnGroups_t           columnGroup;
+    sat_data_groups(rData, groups, columnGroup);
+
+    // Lay out the same groups again with more rows each, then shift every column by however much
+    // its group moved
+    std::vector<std::size_t> newOffsets(groups.size());
+    std::size_t bytesUsed = 0;
+    for (std::size_t i = 0; i < groups.size(); ++i)
+    {
+        bytesUsed = align_up(bytesUsed, gc_satDataAlign);
+        newOffsets[i] = bytesUsed;
+        bytesUsed += std::size_t(groups[i].m_stride) * capacity;
+    }
+
+    Corrade::Containers::Array<unsigned char> newData = sat_data_alloc(bytesUsed);
+
+    for (std::size_t i = 0; i < groups.size() && rData.m_satCount != 0; ++i)
+    {
+        std::memcpy(newData.data() + newOffsets[i],
+                    rData.m_data.data() + groups[i].m_offset,
+                    std::size_t(groups[i].m_stride) * rData.m_satCount);
+    }
+
+    SatDataColumns_t const columns = sat_data_columns(rData);
+    for (std::size_t i = 0; i < gc_satDataColumnCount; ++i)
+    {
+        if ( ! columns[i]->not_used() )
+        {
+            SatDataGroup const &group = groups[columnGroup[i]];
+            columns[i]->m_offset = newOffsets[columnGroup[i]] + (columns[i]->m_offset - group.m_offset);
+        }
+    }
+
+    rData.m_data        = std::move(newData);
+    rData.m_satCapacity = capacity;
+}
+
+void sat_transfer(Universe& rUniverse, ArrayView<SatTransfer const> const transfers, std::vector<SatRemap>& rRemaps)
+{
+    std::vector<SatTransfer> sorted;
+    sorted.reserve(transfers.size());
+    std::copy_if(transfers.begin(), transfers.end(), std::back_inserter(sorted), [] (SatTransfer const& transfer)
+    {
+        return transfer.m_src != transfer.m_dst;
+    });
+
+    if (sorted.empty())
+    {
+        return;
+    }
+
+    std::size_t const remapsFirst = rRemaps.size();
+
+    // Phase 1: Copy out everything being transferred, grouped by destination then source
+
+    std::sort(sorted.begin(), sorted.end(), order_by_dst);
+
+    Outgoing outgoing;
+    outgoing.resize(sorted.size());
+
+    for (std::size_t i = 0; i < sorted.size(); ++i)
+    {
+        SatTransfer const   &transfer   = sorted[i];
+        CoSpaceCommon const &src        = rUniverse.m_coordCommon[transfer.m_src];
+        SatId const          sat        = transfer.m_sat;
+
+        assert(sat < src.m_satCount);
+        assert( ! src.m_satPositions[0].not_used() );
+        assert((i == 0 || sorted[i - 1].m_src != transfer.m_src || sorted[i - 1].m_sat != sat)
+               && "Satellite transferred twice");
+
+        auto const [x, y, z] = sat_views(src.m_satPositions, src.m_data, src.m_satCount);
+        outgoing.m_x[i] = x[sat];
+        outgoing.m_y[i] = y[sat];
+        outgoing.m_z[i] = z[sat];
+
+        if ( ! src.m_satVelocities[0].not_used() )
+        {
+            auto const [vx, vy, vz] = sat_views(src.m_satVelocities, src.m_data, src.m_satCount);
+            outgoing.m_velocities[i] = to_vec<Vector3d>(sat, vx, vy, vz);
+        }
+        if ( ! src.m_satRotations[0].not_used() )
+        {
+            auto const [qx, qy, qz, qw] = sat_views(src.m_satRotations, src.m_data, src.m_satCount);
+            outgoing.m_rotations[i] = {to_vec<Vector3d>(sat, qx, qy, qz), qw[sat]};
+        }
+        if ( ! src.m_satMasses.not_used() )
+        {
+            outgoing.m_masses[i] = src.m_satMasses.view(Corrade::Containers::arrayView(src.m_data), src.m_satCount)[sat];
+        }
+    }
+
+    // Phase 2: Swap-remove from sources, highest SatId first so the satellite swapped into a gap
+    //          is never one that is also being removed
+
+    std::vector<SatTransfer> bySrc = sorted;
+    std::sort(bySrc.begin(), bySrc.end(), order_by_src_descending);
+
+    std::vector<SatDataGroup>   groups;
+    SatColumnGroups_t           columnGroup;
+    IdMap_t<SatId, SatId>       currentToOriginal;
+
+    auto const same_src = [] (SatTransfer const& lhs, SatTransfer const& rhs) { return lhs.m_src == rhs.m_src; };
+    for_each_run(bySrc.begin(), bySrc.end(), same_src, [&] (auto first, auto const last)
+    {
+        CoSpaceId const  srcId = first->m_src;
+        CoSpaceCommon   &rSrc  = rUniverse.m_coordCommon[srcId];
+
+        sat_data_groups(rSrc, groups, columnGroup);
+        currentToOriginal.clear();
+
+        for (; first != last; ++first)
+        {
+            SatId const hole     = first->m_sat;
+            SatId const lastSat  = rSrc.m_satCount - 1;
+
+            if (hole != lastSat)
+            {
+                sat_data_copy_row(rSrc, groups, lastSat, hole);
+
+                auto const found = currentToOriginal.find(lastSat);
+                SatId const original = (found != currentToOriginal.end()) ? found->second : lastSat;
+                if (found != currentToOriginal.end())
+                {
+                    currentToOriginal.erase(found);
+                }
+                currentToOriginal[hole] = original;
+            }
+
+            -- rSrc.m_satCount;
+        }
+
+        for (auto const& [current, original] : currentToOriginal)
+        {
+            rRemaps.push_back({srcId, original, srcId, current});
+        }
+    });
+
+    // Child CoSpaces must point at their parent satellites' new SatIds before any transforms or
+    // parent velocities are read below
+    std::vector<bool> followed(rUniverse.m_coordIds.capacity(), false);
+    follow_remaps(rUniverse, ArrayView<SatRemap const>{rRemaps.data() + remapsFirst, rRemaps.size() - remapsFirst}, followed);
+
+
+    // Phase 3: Append to destinations in bulk
+
+    std::size_t const transferRemapsFirst = rRemaps.size();
+
+    std::vector<SatTransfer>::const_iterator const begin = sorted.begin();
+
+    auto const same_dst = [] (SatTransfer const& lhs, SatTransfer const& rhs) { return lhs.m_dst == rhs.m_dst; };
+    for_each_run(sorted.cbegin(), sorted.cend(), same_dst, [&] (auto const dstFirst, auto const dstLast)
+    {
+        CoSpaceId const  dstId = dstFirst->m_dst;
+        CoSpaceCommon   &rDst  = rUniverse.m_coordCommon[dstId];
+
+        // Grow geometrically so a steady trickle of arrivals doesn't reallocate every time
+        auto const required = uint32_t(rDst.m_satCount + std::distance(dstFirst, dstLast));
+        if (required > rDst.m_satCapacity)
+        {
+            sat_data_reserve(rDst, std::max(required, rDst.m_satCapacity * 2));
+        }
+        assert( ! rDst.m_satPositions[0].not_used() );
+
+        auto const same_src_in_dst = [] (SatTransfer const& lhs, SatTransfer const& rhs) { return lhs.m_src == rhs.m_src; };
+        for_each_run(dstFirst, dstLast, same_src_in_dst, [&] (auto const first, auto const last)
+        {
+            CoSpaceId const     srcId   = first->m_src;
+            auto const          count   = std::size_t(std::distance(first, last));
+            auto const          outIdx  = std::size_t(std::distance(begin, first));
+            SatId const         newFirst = rDst.m_satCount;
+
+            rDst.m_satCount += uint32_t(count);
+
+            // Positions, batched. One CoordTransformer for everything from the same source
+            CoordTransformer const tf = coord_transformer_between(rUniverse, srcId, dstId);
+
+            SatPosViewsConst_t const in{
+                Corrade::Containers::ArrayView<spaceint_t const>{outgoing.m_x.data() + outIdx, count},
+                Corrade::Containers::ArrayView<spaceint_t const>{outgoing.m_y.data() + outIdx, count},
+                Corrade::Containers::ArrayView<spaceint_t const>{outgoing.m_z.data() + outIdx, count}};
+
+            SatPosViews_t const dstPos = sat_views(rDst.m_satPositions, rDst.m_data, rDst.m_satCount);
+            SatPosViews_t const out{ dstPos[0].exceptPrefix(newFirst),
+                                     dstPos[1].exceptPrefix(newFirst),
+                                     dstPos[2].exceptPrefix(newFirst) };
+            coord_transform_positions(tf, in, out);
+
+            // Velocities and rotations are relative to moving, rotating parent satellites
+            FrameMotion const srcMotion = frame_motion(rUniverse, srcId);
+            FrameMotion const dstMotion = frame_motion(rUniverse, dstId);
+            Quaterniond const dstInv    = dstMotion.m_rotation.inverted();
+            Quaterniond const rotation  = dstInv * srcMotion.m_rotation;
+            Vector3d const    velOffset = dstInv.transformVector(srcMotion.m_velocity - dstMotion.m_velocity);
+
+            // Optional columns the destination doesn't have are dropped. Views are only made for
+            // columns that are used, unused ones have no bytes in m_data to point into.
+            if ( ! rDst.m_satVelocities[0].not_used() )
+            {
+                auto const [vx, vy, vz] = sat_views(rDst.m_satVelocities, rDst.m_data, rDst.m_satCount);
+                for (std::size_t i = 0; i < count; ++i)
+                {
+                    Vector3d const vel = rotation.transformVector(outgoing.m_velocities[outIdx + i]) + velOffset;
+                    vx[newFirst + i] = vel.x();
+                    vy[newFirst + i] = vel.y();
+                    vz[newFirst + i] = vel.z();
+                }
+            }
+            if ( ! rDst.m_satRotations[0].not_used() )
+            {
+                auto const [qx, qy, qz, qw] = sat_views(rDst.m_satRotations, rDst.m_data, rDst.m_satCount);
+                for (std::size_t i = 0; i < count; ++i)
+                {
+                    Quaterniond const rot = rotation * outgoing.m_rotations[outIdx + i];
+                    qx[newFirst + i] = rot.vector().x();
+                    qy[newFirst + i] = rot.vector().y();
+                    qz[newFirst + i] = rot.vector().z();
+                    qw[newFirst + i] = rot.scalar();
+                }
+            }
+            if ( ! rDst.m_satMasses.not_used() )
+            {
+                auto const mass = rDst.m_satMasses.view(Corrade::Containers::arrayView(rDst.m_data), rDst.m_satCount);
+                for (std::size_t i = 0; i < count; ++i)
+                {
+                    mass[newFirst + i] = outgoing.m_masses[outIdx + i];
+                }
+            }
+
+            for (std::size_t i = 0; i < count; ++i)
+            {
+                rRemaps.push_back({srcId, first[std::ptrdiff_t(i)].m_sat, dstId, newFirst + SatId(i)});
+            }
+        });
+    });
+
+    // Phase 4: CoSpaces attached to transferred satellites follow them to their new CoSpace
+
+    follow_remaps(rUniverse, ArrayView<SatRemap const>{rRemaps.data() + transferRemapsFirst, rRemaps.size() - transferRemapsFirst}, followed);
+}
+
+} // namespace osp::universe
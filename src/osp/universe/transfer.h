@@ -0,0 +1,89 @@
+/**
+ * Open Space Program
+ * Copyright © 2019-2024 Open Space Program Project
+ *
+ * MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#pragma once
+
+#include "universe.h"
+
+#include "../core/array_view.h"
+
+#include <vector>
+
+namespace osp::universe
+{
+
+/**
+ * @brief Request to move a satellite from one CoSpace to another
+ */
+struct SatTransfer
+{
+    CoSpaceId   m_src;
+    SatId       m_sat;
+    CoSpaceId   m_dst;
+};
+
+/**
+ * @brief Records where a satellite ended up after sat_transfer
+ *
+ * Satellites that were transferred change CoSpace. Satellites that were swapped into the gaps
+ * left behind stay in the same CoSpace with a different SatId.
+ */
+struct SatRemap
+{
+    CoSpaceId   m_oldCoSpace;
+    SatId       m_oldSat;
+    CoSpaceId   m_newCoSpace;
+    SatId       m_newSat;
+};
+
+/**
+ * @brief Grow the satellite capacity of a CoSpace, keeping existing satellites
+ *
+ * The existing partitioning of m_data is kept, including interleaved columns such as XYZW
+ * rotations, and columns that are not used stay unused. Positions are required, so they are
+ * given separate columns if the CoSpace was never partitioned. Does nothing if capacity is
+ * already large enough.
+ *
+ * @param rData     [ref] Satellite data to grow
+ * @param capacity  [in] Minimum number of satellites to fit
+ */
+void sat_data_reserve(CoSpaceSatData& rData, uint32_t capacity);
+
+/**
+ * @brief Move satellites between CoSpaces in bulk
+ *
+ * Positions, velocities, and rotations are converted to the destination CoSpace, including the
+ * velocity of moving parent satellites. Satellites are swap-removed from their source CoSpace,
+ * and appended to the destination, which grows geometrically if more capacity is needed.
+ * Optional columns (velocities, rotations, masses) that the destination doesn't use are dropped.
+ *
+ * CoSpaces parented to a transferred satellite follow it to its new CoSpace.
+ *
+ * @param rUniverse [ref] Universe to modify
+ * @param transfers [in] Transfers to carry out, each satellite may only be transferred once
+ * @param rRemaps   [out] Appended with every satellite that changed CoSpace or SatId
+ */
+void sat_transfer(Universe& rUniverse, ArrayView<SatTransfer const> transfers, std::vector<SatRemap>& rRemaps);
+
+} // namespace osp::universe
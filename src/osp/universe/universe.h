@@ -31,6 +31,7 @@
 
 #include <Corrade/Containers/Array.h>
 #include <Corrade/Containers/StridedArrayView.h>
+#include <Corrade/Utility/Memory.h>
 
 #include <array>
 #include <cstdint>
@@ -64,7 +65,7 @@ struct TypedStrideDesc : StrideDesc
 
     constexpr ViewConst_t view(DataConst_t data, std::size_t count) const noexcept
     {
-        return stridedArrayView<T>(data, reinterpret_cast<T const*>(&data[m_offset]), count, m_stride);
+        return stridedArrayView<T const>(data, reinterpret_cast<T const*>(&data[m_offset]), count, m_stride);
     }
 };
 
@@ -89,8 +90,8 @@ struct CoSpaceTransform
 
 struct CoSpaceSatData
 {
-    uint32_t        m_satCount;
-    uint32_t        m_satCapacity;
+    uint32_t        m_satCount{0};
+    uint32_t        m_satCapacity{0};
 
     Corrade::Containers::Array<unsigned char>   m_data;
 
@@ -98,10 +99,27 @@ struct CoSpaceSatData
     StrideDescArray_t<spaceint_t, 3>            m_satPositions;
     StrideDescArray_t<double, 3>                m_satVelocities;
     StrideDescArray_t<double, 4>                m_satRotations;
+
+    // Optional, in kilograms. Check not_used()
+    TypedStrideDesc<double>                     m_satMasses;
 };
 
 
-struct CoSpaceCommon : CoSpaceTransform, CoSpaceHierarchy, CoSpaceSatData { };
+struct CoSpaceCommon : CoSpaceTransform, CoSpaceHierarchy, CoSpaceSatData
+{
+    // Incremented by coord_transform_changed. Lets CoordTransformCache tell if the transform or
+    // hierarchy changed without comparing them.
+    uint32_t        m_transformGen{0};
+};
+
+/**
+ * @brief Call after writing to a CoSpace's transform (CoSpaceTransform) or hierarchy
+ *        (CoSpaceHierarchy)
+ */
+constexpr void coord_transform_changed(CoSpaceCommon& rCommon) noexcept
+{
+    ++rCommon.m_transformGen;
+}
 
 struct Universe
 {
@@ -112,6 +130,10 @@ struct Universe
     lgrn::IdRegistryStl<CoSpaceId>   m_coordIds;
 
     std::vector<CoSpaceCommon>       m_coordCommon;
+
+    // Memory-mapped snapshot file, if loaded from one. CoSpaceSatData::m_data may point into
+    // this instead of owning its own allocation. See snapshot.h
+    Corrade::Containers::Array<unsigned char> m_snapshotMapping;
 };
 
 struct SceneFrame : CoSpaceTransform, CoSpaceHierarchy
@@ -119,6 +141,18 @@ struct SceneFrame : CoSpaceTransform, CoSpaceHierarchy
     Vector3g m_scenePosition;
 };
 
+/**
+ * @brief Alignment of each partition within CoSpaceSatData::m_data
+ *
+ * 64 bytes fits a full cache line, and the widest SIMD registers (AVX-512)
+ */
+constexpr std::size_t gc_satDataAlign = 64;
+
+constexpr std::size_t align_up(std::size_t const pos, std::size_t const alignment) noexcept
+{
+    return (pos + alignment - 1) & ~(alignment - 1);
+}
+
 template <typename FIRST_T, typename ... T>
 constexpr void aux_partition(std::size_t const pos, TypedStrideDesc<FIRST_T>& rInterleveFirst, TypedStrideDesc<T>& ... rInterleve)
 {
@@ -130,6 +164,16 @@ constexpr void aux_partition(std::size_t const pos, TypedStrideDesc<FIRST_T>& rI
     }
 }
 
+/**
+ * @brief Reserve space for count interleaved elements within a buffer
+ *
+ * The partition's first byte is padded to gc_satDataAlign. When used with a buffer allocated by
+ * sat_data_alloc, each non-interleaved XXXX... YYYY... ZZZZ... column starts on a cache line.
+ *
+ * @param rPos          [ref] Position of the first unused byte, advanced past the new partition
+ * @param count         [in] Number of elements
+ * @param rInterleve    [out] Stride descriptions to assign
+ */
 template <typename ... T>
 constexpr void partition(std::size_t& rPos, std::size_t count, TypedStrideDesc<T>& ... rInterleve)
 {
@@ -137,11 +181,23 @@ constexpr void partition(std::size_t& rPos, std::size_t count, TypedStrideDesc<T
 
     (rInterleve.m_stride = ... = stride);
 
+    rPos = align_up(rPos, gc_satDataAlign);
+
     aux_partition(rPos, rInterleve ...);
 
     rPos += stride * count;
 }
 
+/**
+ * @brief Allocate uninitialized satellite data aligned to gc_satDataAlign
+ *
+ * @param bytes [in] Size in bytes, from partition's rPos
+ */
+inline Corrade::Containers::Array<unsigned char> sat_data_alloc(std::size_t const bytes)
+{
+    return Corrade::Utility::allocateAligned<unsigned char, gc_satDataAlign>(Corrade::NoInit, bytes);
+}
+
 // INDEX_T is a template parameter to allow passing in "strong typedef" types,
 // like enum classes and having them converted without warning to size_t.
 // This is a limitation of the enum class feature in C++, in that
@@ -181,6 +237,10 @@ constexpr auto sat_views(
     }
 }
 
+using SatPosViews_t       = std::array<TypedStrideDesc<spaceint_t>::View_t, 3>;
+using SatPosViewsConst_t  = std::array<TypedStrideDesc<spaceint_t>::ViewConst_t, 3>;
+using SatVelViews_t       = std::array<TypedStrideDesc<double>::View_t, 3>;
+
 /**
  * @brief Get transform of a coordinate space, but if a parent satellite exists,
  *        use parent satellite's transform instead.
@@ -59,6 +59,13 @@ struct ImporterData
     std::vector<ResIdOwner_t>               m_textures;
     std::vector<ResIdOwner_t>               m_meshes;
 
+    // Next simpler LOD of each mesh, matched by "<name>_LOD<n>" mesh names. -1 if none.
+    std::vector<int>                        m_meshNextLod;
+
+    // True for meshes that are the next LOD of another mesh. They're only drawn in place of
+    // that mesh, so objects using them aren't drawn on their own.
+    std::vector<bool>                       m_meshIsLod;
+
     std::vector<OptMaterialData_t>          m_materials;
 
     // Object data
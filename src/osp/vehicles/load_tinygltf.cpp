@@ -25,6 +25,7 @@
 
 #include "load_tinygltf.h"
 #include "ImporterData.h"
+#include "mesh_lods.h"
 
 #include "../core/Resources.h"
 #include "../drawing/own_restypes.h"
@@ -39,10 +40,14 @@
 #include <Magnum/Trade/SceneData.h>
 
 #include <Corrade/PluginManager/Manager.h>
+#include <Corrade/Containers/ArrayViewStl.h>
 #include <Corrade/Containers/StringStlView.h>
 #include <Corrade/Containers/Pair.h>
 #include <Corrade/Containers/PairStl.h>
 
+#include <algorithm>
+#include <utility>
+
 using namespace osp;
 
 using Magnum::Trade::TinyGltfImporter;
@@ -178,6 +183,21 @@ static void load_gltf(TinyGltfImporter &rImporter, ResId res, std::string_view n
         rImportData.m_meshes[i] = rResources.owner_create(gc_mesh, meshRes);
     }
 
+    {
+        // Names of meshes that failed to load are left empty, so they aren't linked
+        std::vector<Corrade::Containers::String> names(rImporter.meshCount());
+        std::vector<std::string_view> nameViews(rImporter.meshCount());
+        for (UnsignedInt i = 0; i < rImporter.meshCount(); i ++)
+        {
+            if (rImportData.m_meshes[i].has_value())
+            {
+                names[i]        = rImporter.meshName(i);
+                nameViews[i]    = names[i];
+            }
+        }
+        link_mesh_lods(nameViews, rImportData);
+    }
+
     // Store materials
     for (UnsignedInt i = 0; i < rImporter.materialCount(); i ++)
     {
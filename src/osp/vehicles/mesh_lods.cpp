@@ -0,0 +1,98 @@
+/**
+ * Open Space Program
+ * Copyright © 2019-2024 Open Space Program Project
+ *
+ * MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include "mesh_lods.h"
+#include "ImporterData.h"
+
+#include <algorithm>
+#include <cctype>
+#include <vector>
+
+namespace osp
+{
+
+std::pair<std::string_view, int> split_lod_name(std::string_view name) noexcept
+{
+    std::size_t digits = 0;
+    while (digits < name.size() && std::isdigit(static_cast<unsigned char>(name[name.size() - 1 - digits])))
+    {
+        ++digits;
+    }
+
+    constexpr std::string_view suffix = "_LOD";
+    std::size_t const baseSize = name.size() - digits;
+    if (   digits == 0 || digits > 3 || baseSize <= suffix.size()
+        || name.substr(baseSize - suffix.size(), suffix.size()) != suffix)
+    {
+        return {name, 0};
+    }
+
+    int level = 0;
+    for (char const c : name.substr(baseSize))
+    {
+        level = level * 10 + (c - '0');
+    }
+    return {name.substr(0, baseSize - suffix.size()), level};
+}
+
+void link_mesh_lods(ArrayView<std::string_view const> names, ImporterData &rImportData)
+{
+    struct LodMesh
+    {
+        std::string_view    name;
+        int                 level;
+        int                 mesh;
+    };
+
+    rImportData.m_meshNextLod   .assign(names.size(), -1);
+    rImportData.m_meshIsLod     .assign(names.size(), false);
+
+    std::vector<LodMesh> lodMeshes;
+    lodMeshes.reserve(names.size());
+    for (std::size_t i = 0; i < names.size(); ++i)
+    {
+        if ( ! names[i].empty() )
+        {
+            auto const [baseName, level] = split_lod_name(names[i]);
+            lodMeshes.push_back({baseName, level, int(i)});
+        }
+    }
+
+    std::sort(lodMeshes.begin(), lodMeshes.end(), [] (LodMesh const& lhs, LodMesh const& rhs)
+    {
+        return (lhs.name != rhs.name) ? (lhs.name < rhs.name) : (lhs.level < rhs.level);
+    });
+
+    for (std::size_t i = 0; i + 1 < lodMeshes.size(); ++i)
+    {
+        if (   ! lodMeshes[i].name.empty() && lodMeshes[i].name == lodMeshes[i + 1].name
+            && lodMeshes[i].level != lodMeshes[i + 1].level)
+        {
+            rImportData.m_meshNextLod[lodMeshes[i].mesh]    = lodMeshes[i + 1].mesh;
+            rImportData.m_meshIsLod[lodMeshes[i + 1].mesh]  = true;
+        }
+    }
+}
+
+} // namespace osp
@@ -0,0 +1,55 @@
+/**
+ * Open Space Program
+ * Copyright © 2019-2024 Open Space Program Project
+ *
+ * MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#pragma once
+
+#include "../core/array_view.h"
+
+#include <string_view>
+#include <utility>
+
+namespace osp
+{
+
+struct ImporterData;
+
+/**
+ * @brief Split a mesh name following the "<name>_LOD<n>" convention into name and LOD number
+ *
+ * Names without the suffix are LOD 0.
+ */
+std::pair<std::string_view, int> split_lod_name(std::string_view name) noexcept;
+
+/**
+ * @brief Link each mesh to its next simpler LOD, by mesh name
+ *
+ * Meshes sharing a name are chained from the lowest LOD number to the highest. Fills
+ * m_meshNextLod and m_meshIsLod, sized to the number of names.
+ *
+ * @param names         [in] Name of each mesh, empty for meshes that aren't loaded
+ * @param rImportData   [ref] Importer data to link meshes of
+ */
+void link_mesh_lods(ArrayView<std::string_view const> names, ImporterData &rImportData);
+
+} // namespace osp
@@ -103,6 +103,9 @@ struct ACtxNwtWorld
     ColliderStorage_t                               m_colliders;
 
     osp::active::ACompTransformStorage_t            *m_pTransform;
+
+    // Entities of bodies whose transforms were written by the last update_world
+    std::vector<osp::active::ActiveEnt>             m_entMoved;
 };
 
 
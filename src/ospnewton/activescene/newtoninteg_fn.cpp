@@ -82,6 +82,7 @@ void SysNewton::cb_set_transform(
     ActiveEnt const ent = rWorldCtx.m_bodyToEnt[bodyId];
 
     NewtonBodyGetMatrix(pBody, rWorldCtx.m_pTransform->get(ent).m_transform.data());
+    rWorldCtx.m_entMoved.push_back(ent);
 } // cb_set_transform()
 
 
@@ -148,21 +149,32 @@ void SysNewton::orient_collision(
 
 void SysNewton::update_translate(ACtxPhysics& rCtxPhys, ACtxNwtWorld& rCtxWorld) noexcept
 {
-    NewtonWorld const* pNwtWorld = rCtxWorld.m_world.get();
-
     // Origin translation
     if (Vector3 const translate = std::exchange(rCtxPhys.m_originTranslate, {});
         ! translate.isZero())
     {
-        // Translate every newton body
-        for (NewtonBody const* pBody = NewtonWorldGetFirstBody(pNwtWorld);
-             pBody != nullptr; pBody = NewtonWorldGetNextBody(pNwtWorld, pBody))
+        translate_bodies(rCtxWorld, translate, 0, BodyId(rCtxWorld.m_bodyPtrs.size()));
+    }
+}
+
+void SysNewton::translate_bodies(
+        ACtxNwtWorld&   rCtxWorld,
+        Vector3 const   translate,
+        BodyId const    first,
+        BodyId const    last) noexcept
+{
+    Matrix4 matrix;
+    for (BodyId bodyId = first; bodyId < last; ++bodyId)
+    {
+        NewtonBody const *pBody = rCtxWorld.m_bodyPtrs[bodyId].get();
+        if (pBody == nullptr)
         {
-            Matrix4 matrix;
-            NewtonBodyGetMatrix(pBody, matrix.data());
-            matrix.translation() += translate;
-            NewtonBodySetMatrix(pBody, matrix.data());
+            continue; // Deleted or never created
         }
+
+        NewtonBodyGetMatrix(pBody, matrix.data());
+        matrix.translation() += translate;
+        NewtonBodySetMatrix(pBody, matrix.data());
     }
 }
 
@@ -187,6 +199,7 @@ void SysNewton::update_world(
     }
 
     rCtxWorld.m_pTransform = std::addressof(rTf);
+    rCtxWorld.m_entMoved.clear();
 
     // Update the world
     NewtonUpdate(pNwtWorld, timestep);
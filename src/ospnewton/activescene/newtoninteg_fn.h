@@ -72,6 +72,8 @@ public:
     /**
      * @brief Respond to scene origin shifts by translating all rigid bodies
      *
+     * Consumes m_originTranslate. Call before stepping the world.
+     *
      * @param rCtxPhys      [ref] Generic physics context with m_originTranslate
      * @param rCtxWorld     [ref] Newton World
      */
@@ -79,6 +81,23 @@ public:
             ACtxPhysics& rCtxPhys,
             ACtxNwtWorld& rCtxWorld) noexcept;
 
+    /**
+     * @brief Translate a range of rigid bodies by BodyId
+     *
+     * Bodies are visited through ACtxNwtWorld::m_bodyPtrs rather than Newton's linked list of
+     * bodies.
+     *
+     * @param rCtxWorld     [ref] Newton World
+     * @param translate     [in] Translation to add
+     * @param first         [in] First BodyId to translate
+     * @param last          [in] One past the last BodyId to translate
+     */
+    static void translate_bodies(
+            ACtxNwtWorld&       rCtxWorld,
+            osp::Vector3        translate,
+            BodyId              first,
+            BodyId              last) noexcept;
+
     /**
      * @brief Synchronize generic physics colliders with Newton colliders
      *
@@ -95,7 +114,7 @@ public:
      * @brief Step the entire Newton World forward in time
      *
      * @param rCtxPhys      [ref] Generic Physics context. Updates linear and angular velocity.
-     * @param rCtxWorld     [ref] Newton world to update
+     * @param rCtxWorld     [ref] Newton world to update, m_entMoved lists bodies that moved
      * @param timestep      [in] Time to step world, passed to Newton update
      * @param inputs        [ref] Physics inputs (from different threads)
      * @param rHier         [in] Storage for Hierarchy components
@@ -78,6 +78,10 @@ struct EngineTestScene
     // to ActiveEnts
     osp::active::ACtxBasic          m_basic;
 
+    // Position, rotation, and scale of each entity, with world matrices cached. The cube's
+    // rotation is kept as a quaternion so it doesn't drift from being multiplied every frame.
+    osp::active::ACtxTransformTRS   m_transformTRS;
+
     // The rotating cube
     ActiveEnt                       m_cube{lgrn::id_null<ActiveEnt>()};
 
@@ -101,6 +105,9 @@ struct EngineTestScene
     std::vector<osp::draw::DrawEnt> m_matPhongDirty;
 
     osp::draw::ACtxSceneRender      m_scnRdr;
+
+    // Entities with world matrices recalculated by the last sync, to copy to draw transforms
+    osp::active::ActiveEntVec_t     m_worldUpdated;
 };
 
 EngineTestScene::~EngineTestScene()
@@ -114,7 +121,7 @@ EngineTestScene::~EngineTestScene()
     // Cleanup must be manual, but this has the advantage of having no side
     // effects, and practically zero runtime overhead.
     osp::draw::SysRender::clear_owners(m_scnRdr, m_drawing);
-    osp::draw::SysRender::clear_resource_owners(m_drawingRes, *m_pResources);
+    osp::draw::SysRender::clear_resource_owners(m_drawing, m_drawingRes, *m_pResources);
 }
 
 entt::any setup_scene(osp::Resources& rResources, osp::PkgId const pkg)
@@ -135,6 +142,7 @@ entt::any setup_scene(osp::Resources& rResources, osp::PkgId const pkg)
     std::size_t const maxEnts = rScene.m_activeIds.vec().capacity();
     rScene.m_matPhong.resize(maxEnts);
     rScene.m_basic.m_scnGraph.resize(maxEnts);
+    rScene.m_transformTRS.resize(maxEnts);
     rScene.m_scnRdr.resize_active(maxEnts);
     rScene.m_scnRdr.resize_draw();
 
@@ -146,13 +154,12 @@ entt::any setup_scene(osp::Resources& rResources, osp::PkgId const pkg)
 
     // Add cube mesh to cube
 
-    rScene.m_scnRdr.m_needDrawTf.insert(cubeEnt);
     rScene.m_scnRdr.m_activeToDraw[cubeEnt] = cubeDraw;
     rScene.m_scnRdr.m_mesh[cubeDraw] = rScene.m_drawing.m_meshRefCounts.ref_add(meshCube);
     rScene.m_scnRdr.m_meshDirty.push_back(cubeDraw);
 
     // Add transform
-    rScene.m_basic.m_transform.emplace(cubeEnt);
+    SysTransformTRS::set(rScene.m_transformTRS, cubeEnt, {}, {});
 
     // Add phong material to cube
     rScene.m_matPhong.insert(cubeDraw);
@@ -183,10 +190,16 @@ void update_test_scene(EngineTestScene& rScene, float const delta)
     rScene.m_scnRdr.m_diffuseDirty.clear();
     rScene.m_matPhongDirty.clear();
 
+    using osp::active::SysTransformTRS;
+
     // Rotate the cube
-    osp::Matrix4 &rCubeTf = rScene.m_basic.m_transform.get(rScene.m_cube).m_transform;
+    osp::active::ACtxTransformTRS &rTRS = rScene.m_transformTRS;
+    ActiveEnt const cube = rScene.m_cube;
 
-    rCubeTf = Magnum::Matrix4::rotationZ(90.0_degf * delta) * rCubeTf;
+    osp::Quaternion const rotation
+            = osp::Quaternion::rotation(90.0_degf * delta, osp::Vector3::zAxis()) * rTRS.m_rotation[cube];
+
+    SysTransformTRS::set(rTRS, cube, rTRS.m_position[cube], rotation.normalized(), rTRS.m_scale[cube]);
 }
 
 //-----------------------------------------------------------------------------
@@ -253,14 +266,16 @@ void sync_test_scene(
     // Load required meshes and textures into OpenGL
     SysRenderGL::compile_resource_meshes  (rScene.m_drawingRes, *rScene.m_pResources, rRenderGl);
     SysRenderGL::compile_resource_textures(rScene.m_drawingRes, *rScene.m_pResources, rRenderGl);
+    SysRenderGL::upload_pending(rRenderGl, *rScene.m_pResources, rRenderGl.m_uploadBudget);
 
     // Assign GL meshes to entities with a mesh component
     SysRenderGL::sync_drawent_mesh(
             rScene.m_scnRdr.m_meshDirty.begin(),
             rScene.m_scnRdr.m_meshDirty.end(),
             rScene.m_scnRdr.m_mesh,
+            rScene.m_scnRdr.m_meshLod,
             rScene.m_drawingRes.m_meshToRes,
-            rRenderer.m_sceneRenderGL.m_meshId,
+            rRenderer.m_sceneRenderGL,
             rRenderGl);
 
     // Assign GL textures to entities with a texture component
@@ -269,23 +284,32 @@ void sync_test_scene(
             rScene.m_scnRdr.m_meshDirty.end(),
             rScene.m_scnRdr.m_diffuseTex,
             rScene.m_drawingRes.m_texToRes,
-            rRenderer.m_sceneRenderGL.m_diffuseTexId,
+            rRenderer.m_sceneRenderGL,
             rRenderGl);
 
-    // Calculate hierarchy transforms
+    // Entities switch over to meshes and textures once they're uploaded
+    SysRenderGL::sync_drawent_pending(rRenderer.m_sceneRenderGL, rRenderGl);
+
+    // Recalculate world matrices that changed, and copy them to draw transforms. There is no
+    // floating origin here, so render space is the same as the scene's space.
+    osp::active::ACtxSceneGraph const &scnGraph = rScene.m_basic.m_scnGraph;
 
-    auto drawTfDirty = {rScene.m_cube};
+    rScene.m_worldUpdated.clear();
+    osp::active::SysTransformTRS::update_world_range(
+            rScene.m_transformTRS,
+            scnGraph,
+            1, // skip the tree root
+            osp::active::TreePos_t(scnGraph.m_treeToEnt.size()),
+            rScene.m_worldUpdated);
 
-    SysRender::update_draw_transforms(
-            {
-                .scnGraph     = rScene.m_basic .m_scnGraph,
-                .transforms   = rScene.m_basic .m_transform,
-                .activeToDraw = rScene.m_scnRdr.m_activeToDraw,
-                .needDrawTf   = rScene.m_scnRdr.m_needDrawTf,
-                .rDrawTf      = rScene.m_scnRdr.m_drawTransform
-            },
-            drawTfDirty.begin(),
-            drawTfDirty.end());
+    for (ActiveEnt const ent : rScene.m_worldUpdated)
+    {
+        DrawEnt const drawEnt = rScene.m_scnRdr.m_activeToDraw[ent];
+        if (drawEnt != lgrn::id_null<DrawEnt>())
+        {
+            rScene.m_scnRdr.m_drawTransform[drawEnt] = rScene.m_transformTRS.m_world[ent];
+        }
+    }
 }
 
 /**
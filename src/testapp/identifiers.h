@@ -182,6 +182,15 @@ struct PlPhysics
 
 
 
+#define TESTAPP_DATA_FLOATING_ORIGIN 2, \
+    idFloatOrigin, idFloatOriginRoots
+struct PlFloatingOrigin
+{
+    PipelineDef<EStgCont> originShift       {"originShift       - ACtxFloatingOrigin::m_request/m_applied"};
+};
+
+
+
 #define TESTAPP_DATA_PHYS_SHAPES 1, \
     idPhysShapes
 struct PlPhysShapes
@@ -208,11 +217,12 @@ struct PlPrefabs
 
 
 
-#define TESTAPP_DATA_BOUNDS 2, \
-    idBounds, idOutOfBounds
+#define TESTAPP_DATA_BOUNDS 4, \
+    idBounds, idBoundsBvh, idBoundsTf, idOutOfBounds
 struct PlBounds
 {
     PipelineDef<EStgCont> boundsSet         {"boundsSet"};
+    PipelineDef<EStgCont> boundsBvh         {"boundsBvh"};
     PipelineDef<EStgRevd> outOfBounds       {"outOfBounds"};
 };
 
@@ -325,12 +335,15 @@ struct PlTerrain
 
 // Universe sessions
 
-#define TESTAPP_DATA_UNI_CORE 2, \
-    idUniverse,         tgUniDeltaTimeIn
+#define TESTAPP_DATA_UNI_CORE 8, \
+    idUniverse,         tgUniDeltaTimeIn,   idCoSpaceLevels,    idSatTransfers,     idSatRemaps, \
+    idSatDynamics,      idSatIntegScratch,  idSatIndices
 struct PlUniCore
 {
     PipelineDef<EStgOptn> update            {"update            - Universe update"};
-    PipelineDef<EStgIntr> transfer          {"transfer"};
+    PipelineDef<EStgIntr> transfer          {"transfer          - Queued satellite transfers between CoSpaces"};
+    PipelineDef<EStgIntr> satRemap          {"satRemap          - Satellites that changed CoSpace or SatId"};
+    PipelineDef<EStgCont> satPositions      {"satPositions      - Satellite positions and CoSpace transforms"};
 };
 
 #define TESTAPP_DATA_UNI_SCENEFRAME 1, \
@@ -340,8 +353,11 @@ struct PlUniSceneFrame
     PipelineDef<EStgCont> sceneFrame        {"sceneFrame"};
 };
 
-#define TESTAPP_DATA_UNI_PLANETS 2, \
-    idPlanetMainSpace, idSatSurfaceSpaces
+#define TESTAPP_DATA_UNI_PLANETS 4, \
+    idPlanetMainSpace, idSatSurfaceSpaces, idPlanetGravity, idPlanetRails
+
+#define TESTAPP_DATA_UNI_NBODY 1, \
+    idNBody
 
 //-----------------------------------------------------------------------------
 
@@ -378,6 +394,7 @@ struct PlSceneRenderer
     PipelineDef<EStgIntr> materialDirty     {"materialDirty"};
 
     PipelineDef<EStgIntr> drawTransforms    {"drawTransforms"};
+    PipelineDef<EStgCont> onScreen          {"onScreen          - DrawEnts that passed frustum culling"};
 
     PipelineDef<EStgCont> group             {"group"};
     PipelineDef<EStgCont> groupEnts         {"groupEnts"};
@@ -393,8 +410,8 @@ struct PlSceneRenderer
 
 
 
-#define TESTAPP_DATA_MAGNUM 2, \
-    idActiveApp, idRenderGl
+#define TESTAPP_DATA_MAGNUM 3, \
+    idActiveApp, idRenderGl, idBtnToggleOit
 struct PlMagnum
 {
     PipelineDef<EStgCont> meshGL            {"meshGL"};
@@ -406,14 +423,16 @@ struct PlMagnum
 
 
 
-#define TESTAPP_DATA_MAGNUM_SCENE 3, \
-    idScnRenderGl, idGroupFwd, idCamera
+#define TESTAPP_DATA_MAGNUM_SCENE 6, \
+    idScnRenderGl, idGroupFwd, idQueueFwd, idCamera, idGroupTransparent, idQueueTransparent
 struct PlMagnumScene
 {
     PipelineDef<EStgFBO>  fbo               {"fboRender"};
 
     PipelineDef<EStgCont> camera            {"camera"};
 
+    PipelineDef<EStgCont> queueFwd          {"queueFwd"};
+    PipelineDef<EStgCont> queueTransparent  {"queueTransparent"};
 };
 
 
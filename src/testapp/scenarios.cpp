@@ -376,8 +376,8 @@ static ScenarioMap_t make_scenarios()
     add_scenario("universe", "Universe test scenario with very unrealistic planets",
                  [] (TestApp& rTestApp) -> RendererSetupFunc_t
     {
-        #define SCENE_SESSIONS      scene, commonScene, physics, physShapes, droppers, bounds, newton, nwtGravSet, nwtGrav, physShapesNwt, uniCore, uniScnFrame, uniTestPlanets
-        #define RENDERER_SESSIONS   sceneRenderer, magnumScene, cameraCtrl, cameraFree, shVisual, shFlat, shPhong, camThrow, shapeDraw, cursor, planetsDraw
+        #define SCENE_SESSIONS      scene, commonScene, physics, physShapes, droppers, bounds, newton, nwtGravSet, nwtGrav, physShapesNwt, floatOrigin, uniCore, uniScnFrame, uniTestPlanets, uniNBody
+        #define RENDERER_SESSIONS   sceneRenderer, magnumScene, cameraCtrl, cameraFree, cameraOrigin, shVisual, shFlat, shPhong, camThrow, shapeDraw, cursor, planetsDraw
 
         using namespace testapp::scenes;
 
@@ -387,7 +387,7 @@ static ScenarioMap_t make_scenarios()
 
         TopTaskBuilder builder{rTestApp.m_tasks, rTestApp.m_scene.m_edges, rTestApp.m_taskData};
 
-        auto & [SCENE_SESSIONS] = resize_then_unpack<13>(rTestApp.m_scene.m_sessions);
+        auto & [SCENE_SESSIONS] = resize_then_unpack<15>(rTestApp.m_scene.m_sessions);
 
         // Compose together lots of Sessions
         scene           = setup_scene               (builder, rTopData, application);
@@ -401,12 +401,14 @@ static ScenarioMap_t make_scenarios()
         nwtGravSet      = setup_newton_factors      (builder, rTopData);
         nwtGrav         = setup_newton_force_accel  (builder, rTopData, newton, nwtGravSet, Vector3{0.0f, 0.0f, -9.81f});
         physShapesNwt   = setup_phys_shapes_newton  (builder, rTopData, commonScene, physics, physShapes, newton, nwtGravSet);
+        floatOrigin     = setup_floating_origin     (builder, rTopData, scene, commonScene, physics);
 
         auto const tgApp = application.get_pipelines< PlApplication >();
 
         uniCore         = setup_uni_core            (builder, rTopData, tgApp.mainLoop);
         uniScnFrame     = setup_uni_sceneframe      (builder, rTopData, uniCore);
         uniTestPlanets  = setup_uni_testplanets     (builder, rTopData, uniCore, uniScnFrame);
+        uniNBody        = setup_uni_nbody           (builder, rTopData, uniCore, uniTestPlanets);
 
         add_floor(rTopData, physShapes, sc_matVisualizer, defaultPkg, 0);
 
@@ -420,8 +422,8 @@ static ScenarioMap_t make_scenarios()
 
             TopTaskBuilder builder{rTestApp.m_tasks, rTestApp.m_renderer.m_edges, rTestApp.m_taskData};
 
-            auto & [SCENE_SESSIONS] = unpack<13>(rTestApp.m_scene.m_sessions);
-            auto & [RENDERER_SESSIONS] = resize_then_unpack<11>(rTestApp.m_renderer.m_sessions);
+            auto & [SCENE_SESSIONS] = unpack<15>(rTestApp.m_scene.m_sessions);
+            auto & [RENDERER_SESSIONS] = resize_then_unpack<12>(rTestApp.m_renderer.m_sessions);
 
             sceneRenderer   = setup_scene_renderer      (builder, rTopData, application, windowApp, commonScene);
             create_materials(rTopData, sceneRenderer, sc_materialCount);
@@ -429,13 +431,14 @@ static ScenarioMap_t make_scenarios()
             magnumScene     = setup_magnum_scene        (builder, rTopData, application, windowApp, sceneRenderer, magnum, scene, commonScene);
             cameraCtrl      = setup_camera_ctrl         (builder, rTopData, windowApp, sceneRenderer, magnumScene);
             cameraFree      = setup_camera_free         (builder, rTopData, windowApp, scene, cameraCtrl);
+            cameraOrigin    = setup_camera_floating_origin(builder, rTopData, windowApp, sceneRenderer, cameraCtrl, floatOrigin);
             shVisual        = setup_shader_visualizer   (builder, rTopData, windowApp, sceneRenderer, magnum, magnumScene, sc_matVisualizer);
             shFlat          = setup_shader_flat         (builder, rTopData, windowApp, sceneRenderer, magnum, magnumScene, sc_matFlat);
             shPhong         = setup_shader_phong        (builder, rTopData, windowApp, sceneRenderer, magnum, magnumScene, sc_matPhong);
             camThrow        = setup_thrower             (builder, rTopData, windowApp, cameraCtrl, physShapes);
             shapeDraw       = setup_phys_shapes_draw    (builder, rTopData, windowApp, sceneRenderer, commonScene, physics, physShapes);
             cursor          = setup_cursor              (builder, rTopData, application, sceneRenderer, cameraCtrl, commonScene, sc_matFlat, rTestApp.m_defaultPkg);
-            planetsDraw     = setup_testplanets_draw    (builder, rTopData, windowApp, sceneRenderer, cameraCtrl, commonScene, uniCore, uniScnFrame, uniTestPlanets, sc_matVisualizer, sc_matFlat);
+            planetsDraw     = setup_testplanets_draw    (builder, rTopData, windowApp, sceneRenderer, cameraCtrl, commonScene, floatOrigin, uniCore, uniScnFrame, uniTestPlanets, sc_matVisualizer, sc_matFlat);
 
             setup_magnum_draw(rTestApp, scene, sceneRenderer, magnumScene);
         };
@@ -106,6 +106,19 @@ Session setup_common_scene(
 
 
 
+    rBuilder.task()
+        .name       ("Reorder transforms to match scene graph")
+        .run_on     ({tgScn.update(Run)})
+        .sync_with  ({tgCS.hierarchy(Ready), tgCS.transform(Modify)})
+        .push_to    (out.m_tasks)
+        .args       ({      idBasic })
+        .func([] (ACtxBasic& rBasic) noexcept
+    {
+        // A few thousand per update keeps this cheap, while still catching up after spawning
+        // and deleting lots of entities within a few frames
+        SysSceneGraph::defrag_storage(rBasic.m_scnGraph, rBasic.m_transform, rBasic.m_transformDefrag, 4096);
+    });
+
     rBuilder.task()
         .name       ("Cancel entity delete tasks stuff if no entities were deleted")
         .run_on     ({tgCS.activeEntDelete(Schedule_)})
@@ -164,7 +177,7 @@ Session setup_common_scene(
         .args       ({        idDrawing,                idDrawingRes,           idResources})
         .func([] (ACtxDrawing& rDrawing, ACtxDrawingRes& rDrawingRes, Resources& rResources) noexcept
     {
-        SysRender::clear_resource_owners(rDrawingRes, rResources);
+        SysRender::clear_resource_owners(rDrawing, rDrawingRes, rResources);
     });
 
     rBuilder.task()
@@ -253,6 +266,7 @@ Session setup_scene_renderer(
         Session const&                  windowApp,
         Session const&                  commonScene)
 {
+    OSP_DECLARE_GET_DATA_IDS(application, TESTAPP_DATA_APPLICATION);
     OSP_DECLARE_GET_DATA_IDS(windowApp,   TESTAPP_DATA_WINDOW_APP);
     OSP_DECLARE_GET_DATA_IDS(commonScene, TESTAPP_DATA_COMMON_SCENE);
     auto const tgApp    = application   .get_pipelines< PlApplication >();
@@ -274,6 +288,7 @@ Session setup_scene_renderer(
     rBuilder.pipeline(tgScnRdr.entTextureDirty) .parent(tgWin.sync);
     rBuilder.pipeline(tgScnRdr.entMeshDirty)    .parent(tgWin.sync);
     rBuilder.pipeline(tgScnRdr.drawTransforms)  .parent(tgScnRdr.render);
+    rBuilder.pipeline(tgScnRdr.onScreen)        .parent(tgScnRdr.render);
     rBuilder.pipeline(tgScnRdr.material)        .parent(tgWin.sync);
     rBuilder.pipeline(tgScnRdr.materialDirty)   .parent(tgWin.sync);
     rBuilder.pipeline(tgScnRdr.group)           .parent(tgWin.sync);
@@ -352,18 +367,18 @@ Session setup_scene_renderer(
         .args       ({            idBasic,                   idDrawing,                 idScnRender,                 idDrawTfObservers })
         .func([] (ACtxBasic const& rBasic, ACtxDrawing const& rDrawing, ACtxSceneRender& rScnRender, DrawTfObservers &rDrawTfObservers) noexcept
     {
-        auto rootChildren = SysSceneGraph::children(rBasic.m_scnGraph);
-        SysRender::update_draw_transforms(
-                {
-                    .scnGraph     = rBasic    .m_scnGraph,
-                    .transforms   = rBasic    .m_transform,
-                    .activeToDraw = rScnRender.m_activeToDraw,
-                    .needDrawTf   = rScnRender.m_needDrawTf,
-                    .rDrawTf      = rScnRender.m_drawTransform
-                },
-                rootChildren.begin(),
-                rootChildren.end(),
-                [&rDrawTfObservers, &rScnRender] (Matrix4 const& transform, active::ActiveEnt ent, int depth)
+        SysRender::ArgsForUpdDrawTransform const args
+        {
+            .scnGraph     = rBasic    .m_scnGraph,
+            .transforms   = rBasic    .m_transform,
+            .transformGen = rBasic    .m_transformGen,
+            .activeToDraw = rScnRender.m_activeToDraw,
+            .needDrawTf   = rScnRender.m_needDrawTf,
+            .rDrawTfGen   = rScnRender.m_drawTfGen,
+            .rDrawTf      = rScnRender.m_drawTransform
+        };
+
+        auto const notifyObservers = [&rDrawTfObservers, &rScnRender] (Matrix4 const& transform, active::ActiveEnt ent, int depth)
         {
             auto const enableInt  = std::array{rScnRender.drawTfObserverEnable[ent]};
             auto const enableBits = lgrn::bit_view(enableInt);
@@ -373,7 +388,33 @@ Session setup_scene_renderer(
                 DrawTfObservers::Observer const &rObserver = rDrawTfObservers.observers[idx];
                 rObserver.func(rScnRender, transform, ent, depth, rObserver.data);
             }
-        });
+        };
+
+        // Sweep over the whole tree in chunks of whole root subtrees
+        constexpr TreePos_t chunkSize = 4096;
+
+        ACtxSceneGraph const &scnGraph  = rBasic.m_scnGraph;
+        TreePos_t const treeLast        = TreePos_t(scnGraph.m_treeToEnt.size());
+        TreePos_t chunkFirst            = 1; // skip tree root, which isn't an entity
+
+        SysRender::DrawTfStack_t stack;
+
+        for (ActiveEnt const root : SysSceneGraph::children(scnGraph))
+        {
+            TreePos_t const rootPos  = scnGraph.m_entToTreePos[root];
+            TreePos_t const rootLast = rootPos + 1 + scnGraph.m_treeDescendants[rootPos];
+
+            if (rootLast - chunkFirst >= chunkSize)
+            {
+                SysRender::update_draw_transforms_range(args, stack, chunkFirst, rootLast, notifyObservers);
+                chunkFirst = rootLast;
+            }
+        }
+
+        if (chunkFirst < treeLast)
+        {
+            SysRender::update_draw_transforms_range(args, stack, chunkFirst, treeLast, notifyObservers);
+        }
     });
 
     rBuilder.task()
@@ -386,10 +427,15 @@ Session setup_scene_renderer(
     {
         for (ActiveEnt const ent : rActiveEntDel)
         {
-            if (rScnRender.m_activeToDraw.size() < std::size_t(ent))
+            if (rScnRender.m_activeToDraw.size() <= std::size_t(ent))
             {
                 continue;
             }
+
+            // The ActiveEnt may be reused with an unrelated transform of the same generation
+            rScnRender.m_drawTfGen.m_transform[ent] = gc_transformGenUnseen;
+            rScnRender.m_drawTfGen.m_subtree[ent]   = gc_transformGenUnseen;
+
             DrawEnt const drawEnt = std::exchange(rScnRender.m_activeToDraw[ent], lgrn::id_null<DrawEnt>());
             if (drawEnt != lgrn::id_null<DrawEnt>())
             {
@@ -401,12 +447,12 @@ Session setup_scene_renderer(
     rBuilder.task()
         .name       ("Delete drawing components")
         .run_on     ({tgScnRdr.drawEntDelete(UseOrRun)})
-        .sync_with  ({tgScnRdr.entTexture(Delete), tgScnRdr.entMesh(Delete)})
+        .sync_with  ({tgScnRdr.entTexture(Delete), tgScnRdr.entMesh(Delete), tgScnRdr.meshResDirty(Modify_), tgScnRdr.textureResDirty(Modify_)})
         .push_to    (out.m_tasks)
-        .args       ({        idDrawing,                 idScnRender,                    idDrawEntDel })
-        .func([] (ACtxDrawing& rDrawing, ACtxSceneRender& rScnRender, DrawEntVec_t const& rDrawEntDel) noexcept
+        .args       ({        idDrawing,                idDrawingRes,           idResources,                 idScnRender,                    idDrawEntDel })
+        .func([] (ACtxDrawing& rDrawing, ACtxDrawingRes& rDrawingRes, Resources& rResources, ACtxSceneRender& rScnRender, DrawEntVec_t const& rDrawEntDel) noexcept
     {
-        SysRender::update_delete_drawing(rScnRender, rDrawing, rDrawEntDel.cbegin(), rDrawEntDel.cend());
+        SysRender::update_delete_drawing(rScnRender, rDrawing, rDrawingRes, rResources, rDrawEntDel.cbegin(), rDrawEntDel.cend());
     });
 
     rBuilder.task()
@@ -476,6 +522,28 @@ Session setup_scene_renderer(
         rScnRender.m_diffuseDirty.clear();
     });
 
+    rBuilder.task()
+        .name       ("Clear new and removed mesh resources once we're done with them")
+        .run_on     ({tgScnRdr.meshResDirty(Clear)})
+        .push_to    (out.m_tasks)
+        .args       ({            idDrawingRes})
+        .func([] (ACtxDrawingRes& rDrawingRes) noexcept
+    {
+        rDrawingRes.m_meshNew    .clear();
+        rDrawingRes.m_meshRemoved.clear();
+    });
+
+    rBuilder.task()
+        .name       ("Clear new and removed texture resources once we're done with them")
+        .run_on     ({tgScnRdr.textureResDirty(Clear)})
+        .push_to    (out.m_tasks)
+        .args       ({            idDrawingRes})
+        .func([] (ACtxDrawingRes& rDrawingRes) noexcept
+    {
+        rDrawingRes.m_texNew     .clear();
+        rDrawingRes.m_texRemoved .clear();
+    });
+
     rBuilder.task()
         .name       ("Clear dirty materials once we're done with it")
         .run_on     ({tgScnRdr.materialDirty(Clear)})
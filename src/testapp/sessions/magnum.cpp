@@ -27,7 +27,9 @@
 
 #include "../MagnumApplication.h"
 
+#include <Magnum/GL/Context.h>
 #include <Magnum/GL/DefaultFramebuffer.h>
+#include <Magnum/GL/Extensions.h>
 #include <Magnum/GL/Renderer.h>
 
 #include <adera/drawing/CameraController.h>
@@ -53,6 +55,7 @@ using namespace osp::draw;
 using namespace osp::universe;
 using namespace osp;
 
+using osp::input::EButtonControlIndex;
 using osp::input::UserInputHandler;
 
 using Magnum::GL::Mesh;
@@ -90,6 +93,32 @@ Session setup_magnum(
 
     SysRenderGL::setup_context(rRenderGl);
 
+    top_emplace< EButtonControlIndex > (topData, idBtnToggleOit, rUserInput.button_subscribe("debug_toggle_oit"));
+
+    rBuilder.task()
+        .name       ("Toggle order-independent transparency")
+        .run_on     ({tgWin.inputs(Run)})
+        .push_to    (out.m_tasks)
+        .args       ({                   idUserInput,          idRenderGl,                   idBtnToggleOit })
+        .func([] (UserInputHandler const& rUserInput, RenderGL& rRenderGl, EButtonControlIndex btnToggleOit) noexcept
+    {
+        if (rUserInput.button_triggered(btnToggleOit))
+        {
+            SysRenderGL::set_oit(rRenderGl, ! rRenderGl.m_useOit);
+        }
+    });
+
+    rBuilder.task()
+        .name       ("Upload pending meshes and textures to GL")
+        .run_on     ({tgWin.sync(Run)})
+        .sync_with  ({tgMgn.meshGL(Modify), tgMgn.textureGL(Modify)})
+        .push_to    (out.m_tasks)
+        .args       ({      idResources,          idRenderGl})
+        .func([] (Resources& rResources, RenderGL& rRenderGl) noexcept
+    {
+        SysRenderGL::upload_pending(rRenderGl, rResources, rRenderGl.m_uploadBudget);
+    });
+
     rBuilder.task()
         .name       ("Clean up Magnum renderer")
         .run_on     ({tgWin.cleanup(Run_)})
@@ -126,6 +155,7 @@ Session setup_magnum_scene(
     auto const tgWin    = windowApp     .get_pipelines< PlWindowApp >();
     auto const tgMgn    = magnum        .get_pipelines< PlMagnum >();
     auto const tgScnRdr = sceneRenderer .get_pipelines< PlSceneRenderer >();
+    auto const tgCS     = commonScene   .get_pipelines< PlCommonScene >();
 
     Session out;
     OSP_DECLARE_CREATE_DATA_IDS(out, topData, TESTAPP_DATA_MAGNUM_SCENE);
@@ -133,9 +163,14 @@ Session setup_magnum_scene(
 
     rBuilder.pipeline(tgMgnScn.fbo)             .parent(tgScnRdr.render);
     rBuilder.pipeline(tgMgnScn.camera)          .parent(tgScnRdr.render);
+    rBuilder.pipeline(tgMgnScn.queueFwd)        .parent(tgScnRdr.render);
+    rBuilder.pipeline(tgMgnScn.queueTransparent).parent(tgScnRdr.render);
 
     top_emplace< ACtxSceneRenderGL >    (topData, idScnRenderGl);
     top_emplace< RenderGroup >          (topData, idGroupFwd);
+    top_emplace< RenderQueue >          (topData, idQueueFwd);
+    top_emplace< RenderGroup >          (topData, idGroupTransparent);
+    top_emplace< RenderQueue >          (topData, idQueueTransparent);
 
     auto &rCamera = top_emplace< Camera >(topData, idCamera);
 
@@ -156,6 +191,20 @@ Session setup_magnum_scene(
         rScnRenderGl.m_meshId         .resize(capacity);
     });
 
+    rBuilder.task()
+        .name       ("Reorder render group entities to match scene graph")
+        .run_on     ({tgWin.sync(Run)})
+        .sync_with  ({tgCS.hierarchy(Ready), tgScnRdr.drawEnt(Ready), tgScnRdr.group(Modify), tgScnRdr.groupEnts(Modify)})
+        .push_to    (out.m_tasks)
+        .args       ({        idBasic,                   idScnRender,             idGroupFwd,             idGroupTransparent })
+        .func([] (ACtxBasic const& rBasic, ACtxSceneRender const& rScnRender, RenderGroup& rGroupFwd, RenderGroup& rGroupTransparent) noexcept
+    {
+        // Render queues are built by iterating groups, so keeping them in tree order keeps
+        // reads of draw transforms and materials close together
+        SysSceneGraph::defrag_storage(rBasic.m_scnGraph, rScnRender.m_activeToDraw, rGroupFwd.entities,         rGroupFwd.defrag,         4096);
+        SysSceneGraph::defrag_storage(rBasic.m_scnGraph, rScnRender.m_activeToDraw, rGroupTransparent.entities, rGroupTransparent.defrag, 4096);
+    });
+
     rBuilder.task()
         .name       ("Compile Resource Meshes to GL")
         .run_on     ({tgScnRdr.meshResDirty(UseOrRun)})
@@ -178,6 +227,28 @@ Session setup_magnum_scene(
         SysRenderGL::compile_resource_textures(rDrawingRes, rResources, rRenderGl);
     });
 
+    rBuilder.task()
+        .name       ("Compile all Resource Meshes to GL")
+        .run_on     ({tgWin.resync(Run)})
+        .sync_with  ({tgScnRdr.mesh(Ready), tgMgn.meshGL(New)})
+        .push_to    (out.m_tasks)
+        .args       ({                 idDrawingRes,                idResources,          idRenderGl })
+        .func([] (ACtxDrawingRes const& rDrawingRes, osp::Resources& rResources, RenderGL& rRenderGl) noexcept
+    {
+        SysRenderGL::compile_all_resource_meshes(rDrawingRes, rResources, rRenderGl);
+    });
+
+    rBuilder.task()
+        .name       ("Compile all Resource Textures to GL")
+        .run_on     ({tgWin.resync(Run)})
+        .sync_with  ({tgScnRdr.texture(Ready), tgMgn.textureGL(New)})
+        .push_to    (out.m_tasks)
+        .args       ({                 idDrawingRes,                idResources,          idRenderGl })
+        .func([] (ACtxDrawingRes const& rDrawingRes, osp::Resources& rResources, RenderGL& rRenderGl) noexcept
+    {
+        SysRenderGL::compile_all_resource_textures(rDrawingRes, rResources, rRenderGl);
+    });
+
     rBuilder.task()
         .name       ("Sync GL textures to entities with scene textures")
         .run_on     ({tgScnRdr.entTextureDirty(UseOrRun)})
@@ -191,7 +262,7 @@ Session setup_magnum_scene(
                 rScnRender.m_diffuseDirty.end(),
                 rScnRender.m_diffuseTex,
                 rDrawingRes.m_texToRes,
-                rScnRenderGl.m_diffuseTexId,
+                rScnRenderGl,
                 rRenderGl);
     });
 
@@ -209,11 +280,23 @@ Session setup_magnum_scene(
                     drawEnt,
                     rScnRender.m_diffuseTex,
                     rDrawingRes.m_texToRes,
-                    rScnRenderGl.m_diffuseTexId,
+                    rScnRenderGl,
                     rRenderGl);
         }
     });
 
+    rBuilder.task()
+        .name       ("Select mesh LODs by screen size")
+        .run_on     ({tgWin.sync(Run)})
+        .sync_with  ({tgScnRdr.drawEnt(Ready), tgScnRdr.entMesh(Ready), tgScnRdr.entMeshDirty(Modify_), tgScnRdr.drawEntResized(Done)})
+        .push_to    (out.m_tasks)
+        .args       ({            idScnRender,                 idDrawing,              idCamera })
+        .func([] (ACtxSceneRender& rScnRender, ACtxDrawing const& rDrawing, Camera const& rCamera) noexcept
+    {
+        // Uses the previous frame's camera and draw transforms, which is close enough
+        SysRender::select_lods(rScnRender, rDrawing, rCamera, 0.1f, 0, rScnRender.m_drawIds.capacity());
+    });
+
     rBuilder.task()
         .name       ("Sync GL meshes to entities with scene meshes")
         .run_on     ({tgScnRdr.entMeshDirty(UseOrRun)})
@@ -226,8 +309,9 @@ Session setup_magnum_scene(
                 rScnRender.m_meshDirty.begin(),
                 rScnRender.m_meshDirty.end(),
                 rScnRender.m_mesh,
+                rScnRender.m_meshLod,
                 rDrawingRes.m_meshToRes,
-                rScnRenderGl.m_meshId,
+                rScnRenderGl,
                 rRenderGl);
     });
 
@@ -244,12 +328,24 @@ Session setup_magnum_scene(
             SysRenderGL::sync_drawent_mesh(
                     drawEnt,
                     rScnRender.m_mesh,
+                    rScnRender.m_meshLod,
                     rDrawingRes.m_meshToRes,
-                    rScnRenderGl.m_meshId,
+                    rScnRenderGl,
                     rRenderGl);
         }
     });
 
+    rBuilder.task()
+        .name       ("Swap in GL meshes and textures that finished uploading")
+        .run_on     ({tgWin.sync(Run)})
+        .sync_with  ({tgMgn.meshGL(Ready), tgMgn.textureGL(Ready), tgMgn.entMeshGL(Modify), tgMgn.entTextureGL(Modify)})
+        .push_to    (out.m_tasks)
+        .args       ({                  idScnRenderGl,                idRenderGl })
+        .func([] (ACtxSceneRenderGL& rScnRenderGl, RenderGL const& rRenderGl) noexcept
+    {
+        SysRenderGL::sync_drawent_pending(rScnRenderGl, rRenderGl);
+    });
+
     rBuilder.task()
         .name       ("Bind and display off-screen FBO")
         .run_on     ({tgScnRdr.render(Run)})
@@ -272,19 +368,128 @@ Session setup_magnum_scene(
     });
 
     rBuilder.task()
-        .name       ("Render Entities")
+        .name       ("Cull DrawEnts outside of the camera's view")
+        .run_on     ({tgScnRdr.render(Run)})
+        .sync_with  ({tgMgnScn.camera(Ready), tgScnRdr.drawTransforms(UseOrRun), tgScnRdr.entMesh(Ready), tgScnRdr.drawEnt(Ready), tgScnRdr.onScreen(Modify)})
+        .push_to    (out.m_tasks)
+        .args       ({            idScnRender,                 idDrawing,              idCamera })
+        .func([] (ACtxSceneRender& rScnRender, ACtxDrawing const& rDrawing, Camera const& rCamera) noexcept
+    {
+        Matrix4 const viewProj = rCamera.perspective() * rCamera.m_transform.inverted();
+
+        constexpr std::size_t chunkSize = 4096;
+        std::size_t const drawEntCount = rScnRender.m_drawIds.capacity();
+        for (std::size_t first = 0; first < drawEntCount; first += chunkSize)
+        {
+            SysRender::cull_frustum(rScnRender, rDrawing, viewProj, first, std::min(first + chunkSize, drawEntCount));
+        }
+    });
+
+    rBuilder.task()
+        .name       ("Build and sort forward render queue")
         .run_on     ({tgScnRdr.render(Run)})
         .sync_with  ({tgScnRdr.group(Ready), tgScnRdr.groupEnts(Ready), tgMgnScn.camera(Ready), tgScnRdr.drawTransforms(UseOrRun), tgScnRdr.entMesh(Ready), tgScnRdr.entTexture(Ready),
-                      tgMgn.entMeshGL(Ready), tgMgn.entTextureGL(Ready),
-                      tgScnRdr.drawEnt(Ready)})
+                      tgScnRdr.drawEnt(Ready), tgScnRdr.onScreen(Ready), tgMgnScn.queueFwd(New)})
+        .push_to    (out.m_tasks)
+        .args       ({            idScnRender,                   idGroupFwd,              idQueueFwd,              idCamera })
+        .func([] (ACtxSceneRender const& rScnRender, RenderGroup const& rGroupFwd, RenderQueue& rQueueFwd, Camera const& rCamera) noexcept
+    {
+        SysRenderQueue::build(rQueueFwd, {
+                .group      = rGroupFwd,
+                .visible    = rScnRender.m_onScreen,
+                .scnRender  = rScnRender,
+                .view       = rCamera.m_transform.inverted(),
+                .farPlane   = rCamera.m_far,
+                .pass       = 0 });
+        SysRenderQueue::sort(rQueueFwd);
+    });
+
+    rBuilder.task()
+        .name       ("Prepare forward draw packets")
+        .run_on     ({tgScnRdr.render(Run)})
+        .sync_with  ({tgMgnScn.camera(Ready), tgScnRdr.drawTransforms(UseOrRun), tgMgnScn.queueFwd(Modify)})
+        .push_to    (out.m_tasks)
+        .args       ({            idScnRender,              idQueueFwd,              idCamera })
+        .func([] (ACtxSceneRender const& rScnRender, RenderQueue& rQueueFwd, Camera const& rCamera) noexcept
+    {
+        ViewProjMatrix const viewProj{rCamera.m_transform.inverted(), rCamera.perspective()};
+
+        constexpr std::size_t chunkSize = 1024;
+        std::size_t const count = rQueueFwd.ents.size();
+        for (std::size_t first = 0; first < count; first += chunkSize)
+        {
+            SysRenderQueue::prepare_packets(rQueueFwd, rScnRender, viewProj, first, std::min(first + chunkSize, count));
+        }
+    });
+
+    rBuilder.task()
+        .name       ("Build and sort transparent render queue back to front")
+        .run_on     ({tgScnRdr.render(Run)})
+        .sync_with  ({tgScnRdr.group(Ready), tgScnRdr.groupEnts(Ready), tgMgnScn.camera(Ready), tgScnRdr.drawTransforms(UseOrRun), tgScnRdr.drawEnt(Ready),
+                      tgScnRdr.onScreen(Ready), tgMgnScn.queueTransparent(New)})
+        .push_to    (out.m_tasks)
+        .args       ({            idScnRender,                   idGroupTransparent,              idQueueTransparent,              idCamera,                idRenderGl })
+        .func([] (ACtxSceneRender const& rScnRender, RenderGroup const& rGroupTransparent, RenderQueue& rQueueTransparent, Camera const& rCamera, RenderGL const& rRenderGl) noexcept
+    {
+        if (rRenderGl.m_useOit)
+        {
+            rQueueTransparent.ents.clear();
+            rQueueTransparent.keys.clear();
+            return; // Order-independent, nothing to sort
+        }
+
+        SysRenderQueue::build(rQueueTransparent, {
+                .group          = rGroupTransparent,
+                .visible        = rScnRender.m_onScreen,
+                .scnRender      = rScnRender,
+                .view           = rCamera.m_transform.inverted(),
+                .farPlane       = rCamera.m_far,
+                .pass           = 1,
+                .backToFront    = true });
+        SysRenderQueue::sort(rQueueTransparent);
+    });
+
+    rBuilder.task()
+        .name       ("Prepare transparent draw packets")
+        .run_on     ({tgScnRdr.render(Run)})
+        .sync_with  ({tgMgnScn.camera(Ready), tgScnRdr.drawTransforms(UseOrRun), tgMgnScn.queueTransparent(Modify)})
+        .push_to    (out.m_tasks)
+        .args       ({            idScnRender,              idQueueTransparent,              idCamera })
+        .func([] (ACtxSceneRender const& rScnRender, RenderQueue& rQueueTransparent, Camera const& rCamera) noexcept
+    {
+        ViewProjMatrix const viewProj{rCamera.m_transform.inverted(), rCamera.perspective()};
+
+        constexpr std::size_t chunkSize = 1024;
+        std::size_t const count = rQueueTransparent.ents.size();
+        for (std::size_t first = 0; first < count; first += chunkSize)
+        {
+            SysRenderQueue::prepare_packets(rQueueTransparent, rScnRender, viewProj, first, std::min(first + chunkSize, count));
+        }
+    });
+
+    rBuilder.task()
+        .name       ("Render Entities")
+        .run_on     ({tgScnRdr.render(Run)})
+        .sync_with  ({tgScnRdr.group(Ready), tgMgnScn.camera(Ready), tgScnRdr.drawTransforms(UseOrRun), tgMgn.entMeshGL(Ready), tgMgn.entTextureGL(Ready), tgMgnScn.queueFwd(Ready),
+                      tgMgnScn.queueTransparent(Ready), tgScnRdr.onScreen(Ready)})
         .push_to    (out.m_tasks)
-        .args       ({            idScnRender,          idRenderGl,                   idGroupFwd,              idCamera })
-        .func([] (ACtxSceneRender& rScnRender, RenderGL& rRenderGl, RenderGroup const& rGroupFwd, Camera const& rCamera, WorkerContext ctx) noexcept
+        .args       ({            idScnRender,                  idGroupFwd,                    idQueueFwd,                  idGroupTransparent,                    idQueueTransparent,              idCamera,          idRenderGl })
+        .func([] (ACtxSceneRender const& rScnRender, RenderGroup const& rGroupFwd, RenderQueue const& rQueueFwd, RenderGroup const& rGroupTransparent, RenderQueue const& rQueueTransparent, Camera const& rCamera, RenderGL& rRenderGl) noexcept
     {
-        ViewProjMatrix viewProj{rCamera.m_transform.inverted(), rCamera.perspective()};
+        ViewProjMatrix const viewProj{rCamera.m_transform.inverted(), rCamera.perspective()};
 
         // Forward Render fwd_opaque group to FBO
-        SysRenderGL::render_opaque(rGroupFwd, rScnRender.m_visible, viewProj);
+        SysRenderGL::render_opaque(rGroupFwd, rQueueFwd, viewProj);
+
+        // Transparent objects go over everything opaque
+        if (rRenderGl.m_useOit)
+        {
+            SysRenderGL::render_transparent_oit(rRenderGl, rGroupTransparent, rScnRender.m_onScreen, viewProj);
+        }
+        else
+        {
+            SysRenderGL::render_transparent(rGroupTransparent, rQueueTransparent, viewProj);
+        }
     });
 
     rBuilder.task()
@@ -292,12 +497,13 @@ Session setup_magnum_scene(
         .run_on     ({tgScnRdr.drawEntDelete(UseOrRun)})
         .sync_with  ({tgScnRdr.groupEnts(Delete)})
         .push_to    (out.m_tasks)
-        .args       ({              idDrawing,             idGroupFwd,                 idDrawEntDel })
-        .func([] (ACtxDrawing const& rDrawing, RenderGroup& rGroup, DrawEntVec_t const& rDrawEntDel) noexcept
+        .args       ({              idDrawing,             idGroupFwd,                   idGroupTransparent,                 idDrawEntDel })
+        .func([] (ACtxDrawing const& rDrawing, RenderGroup& rGroup, RenderGroup& rGroupTransparent, DrawEntVec_t const& rDrawEntDel) noexcept
     {
         for (DrawEnt const drawEnt : rDrawEntDel)
         {
             rGroup.entities.remove(drawEnt);
+            rGroupTransparent.entities.remove(drawEnt);
         }
     });
 
@@ -404,6 +610,12 @@ Session setup_shader_flat(
 
     rDrawFlat.shaderDiffuse       = FlatGL3D{FlatGL3D::Configuration{}.setFlags(FlatGL3D::Flag::Textured)};
     rDrawFlat.shaderUntextured    = FlatGL3D{FlatGL3D::Configuration{}};
+    if (Magnum::GL::Context::current().isExtensionSupported<Magnum::GL::Extensions::ARB::instanced_arrays>())
+    {
+        auto const instFlags = FlatGL3D::Flag::InstancedTransformation;
+        rDrawFlat.shaderDiffuseInstanced    = FlatGL3D{FlatGL3D::Configuration{}.setFlags(instFlags | FlatGL3D::Flag::Textured)};
+        rDrawFlat.shaderUntexturedInstanced = FlatGL3D{FlatGL3D::Configuration{}.setFlags(instFlags)};
+    }
     rDrawFlat.materialId          = materialId;
     rDrawFlat.assign_pointers(rScnRender, rScnRenderGl, rRenderGl);
 
@@ -417,15 +629,15 @@ Session setup_shader_flat(
         .run_on     ({tgWin.sync(Run)})
         .sync_with  ({tgScnRdr.groupEnts(Modify), tgScnRdr.group(Modify), tgScnRdr.materialDirty(UseOrRun)})
         .push_to    (out.m_tasks)
-        .args       ({            idScnRender,             idGroupFwd,                         idScnRenderGl,              idDrawShFlat})
-        .func([] (ACtxSceneRender& rScnRender, RenderGroup& rGroupFwd, ACtxSceneRenderGL const& rScnRenderGl, ACtxDrawFlat& rDrawShFlat) noexcept
+        .args       ({            idScnRender,             idGroupFwd,             idGroupTransparent,                         idScnRenderGl,              idDrawShFlat})
+        .func([] (ACtxSceneRender& rScnRender, RenderGroup& rGroupFwd, RenderGroup& rGroupTransparent, ACtxSceneRenderGL const& rScnRenderGl, ACtxDrawFlat& rDrawShFlat) noexcept
     {
         Material const &rMat = rScnRender.m_materials[rDrawShFlat.materialId];
         sync_drawent_flat(rMat.m_dirty.begin(), rMat.m_dirty.end(),
         {
             .hasMaterial    = rMat.m_ents,
             .pStorageOpaque = &rGroupFwd.entities,
-            /* TODO: set .pStorageTransparent */
+            .pStorageTransparent = &rGroupTransparent.entities,
             .opaque         = rScnRender.m_opaque,
             .transparent    = rScnRender.m_transparent,
             .diffuse        = rScnRenderGl.m_diffuseTexId,
@@ -438,8 +650,8 @@ Session setup_shader_flat(
         .run_on     ({tgWin.resync(Run)})
         .sync_with  ({tgScnRdr.materialDirty(UseOrRun), tgMgn.textureGL(Ready), tgScnRdr.groupEnts(Modify), tgScnRdr.group(Modify)})
         .push_to    (out.m_tasks)
-        .args       ({            idScnRender,             idGroupFwd,                         idScnRenderGl,              idDrawShFlat})
-        .func([] (ACtxSceneRender& rScnRender, RenderGroup& rGroupFwd, ACtxSceneRenderGL const& rScnRenderGl, ACtxDrawFlat& rDrawShFlat) noexcept
+        .args       ({            idScnRender,             idGroupFwd,             idGroupTransparent,                         idScnRenderGl,              idDrawShFlat})
+        .func([] (ACtxSceneRender& rScnRender, RenderGroup& rGroupFwd, RenderGroup& rGroupTransparent, ACtxSceneRenderGL const& rScnRenderGl, ACtxDrawFlat& rDrawShFlat) noexcept
     {
         Material const &rMat = rScnRender.m_materials[rDrawShFlat.materialId];
         for (DrawEnt const drawEnt : rMat.m_ents)
@@ -448,7 +660,7 @@ Session setup_shader_flat(
             {
                 .hasMaterial    = rMat.m_ents,
                 .pStorageOpaque = &rGroupFwd.entities,
-                /* TODO: set .pStorageTransparent */
+                .pStorageTransparent = &rGroupTransparent.entities,
                 .opaque         = rScnRender.m_opaque,
                 .transparent    = rScnRender.m_transparent,
                 .diffuse        = rScnRenderGl.m_diffuseTexId,
@@ -490,6 +702,12 @@ Session setup_shader_phong(
     auto const texturedFlags    = PhongGL::Flag::DiffuseTexture | PhongGL::Flag::AlphaMask | PhongGL::Flag::AmbientTexture;
     rDrawPhong.shaderDiffuse    = PhongGL{PhongGL::Configuration{}.setFlags(texturedFlags).setLightCount(2)};
     rDrawPhong.shaderUntextured = PhongGL{PhongGL::Configuration{}.setLightCount(2)};
+    if (Magnum::GL::Context::current().isExtensionSupported<Magnum::GL::Extensions::ARB::instanced_arrays>())
+    {
+        auto const instFlags = PhongGL::Flag::InstancedTransformation;
+        rDrawPhong.shaderDiffuseInstanced    = PhongGL{PhongGL::Configuration{}.setFlags(instFlags | texturedFlags).setLightCount(2)};
+        rDrawPhong.shaderUntexturedInstanced = PhongGL{PhongGL::Configuration{}.setFlags(instFlags).setLightCount(2)};
+    }
     rDrawPhong.materialId       = materialId;
     rDrawPhong.assign_pointers(rScnRender, rScnRenderGl, rRenderGl);
 
@@ -503,15 +721,15 @@ Session setup_shader_phong(
         .run_on     ({tgWin.sync(Run)})
         .sync_with  ({tgScnRdr.materialDirty(UseOrRun), tgMgn.entTextureGL(Ready), tgScnRdr.groupEnts(Modify), tgScnRdr.group(Modify)})
         .push_to    (out.m_tasks)
-        .args       ({            idScnRender,             idGroupFwd,                         idScnRenderGl,               idDrawShPhong})
-        .func([] (ACtxSceneRender& rScnRender, RenderGroup& rGroupFwd, ACtxSceneRenderGL const& rScnRenderGl, ACtxDrawPhong& rDrawShPhong) noexcept
+        .args       ({            idScnRender,             idGroupFwd,             idGroupTransparent,                         idScnRenderGl,               idDrawShPhong})
+        .func([] (ACtxSceneRender& rScnRender, RenderGroup& rGroupFwd, RenderGroup& rGroupTransparent, ACtxSceneRenderGL const& rScnRenderGl, ACtxDrawPhong& rDrawShPhong) noexcept
     {
         Material const &rMat = rScnRender.m_materials[rDrawShPhong.materialId];
         sync_drawent_phong(rMat.m_dirty.begin(), rMat.m_dirty.end(),
         {
             .hasMaterial    = rMat.m_ents,
             .pStorageOpaque = &rGroupFwd.entities,
-            /* TODO: set .pStorageTransparent */
+            .pStorageTransparent = &rGroupTransparent.entities,
             .opaque         = rScnRender.m_opaque,
             .transparent    = rScnRender.m_transparent,
             .diffuse        = rScnRenderGl.m_diffuseTexId,
@@ -524,8 +742,8 @@ Session setup_shader_phong(
         .run_on     ({tgWin.resync(Run)})
         .sync_with  ({tgScnRdr.materialDirty(UseOrRun), tgMgn.entTextureGL(Ready), tgScnRdr.groupEnts(Modify), tgScnRdr.group(Modify)})
         .push_to    (out.m_tasks)
-        .args       ({            idScnRender,             idGroupFwd,                         idScnRenderGl,               idDrawShPhong})
-        .func([] (ACtxSceneRender& rScnRender, RenderGroup& rGroupFwd, ACtxSceneRenderGL const& rScnRenderGl, ACtxDrawPhong& rDrawShPhong) noexcept
+        .args       ({            idScnRender,             idGroupFwd,             idGroupTransparent,                         idScnRenderGl,               idDrawShPhong})
+        .func([] (ACtxSceneRender& rScnRender, RenderGroup& rGroupFwd, RenderGroup& rGroupTransparent, ACtxSceneRenderGL const& rScnRenderGl, ACtxDrawPhong& rDrawShPhong) noexcept
     {
         Material const &rMat = rScnRender.m_materials[rDrawShPhong.materialId];
         for (DrawEnt const drawEnt : rMat.m_ents)
@@ -534,6 +752,7 @@ Session setup_shader_phong(
             {
                 .hasMaterial    = rMat.m_ents,
                 .pStorageOpaque = &rGroupFwd.entities,
+                .pStorageTransparent = &rGroupTransparent.entities,
                 .opaque         = rScnRender.m_opaque,
                 .transparent    = rScnRender.m_transparent,
                 .diffuse        = rScnRenderGl.m_diffuseTexId,
@@ -137,6 +137,72 @@ Session setup_camera_free(
 
 
 
+Session setup_camera_floating_origin(
+        TopTaskBuilder&             rBuilder,
+        ArrayView<entt::any> const  topData,
+        Session const&              windowApp,
+        Session const&              sceneRenderer,
+        Session const&              cameraCtrl,
+        Session const&              floatingOrigin)
+{
+    OSP_DECLARE_GET_DATA_IDS(sceneRenderer,     TESTAPP_DATA_SCENE_RENDERER);
+    OSP_DECLARE_GET_DATA_IDS(cameraCtrl,        TESTAPP_DATA_CAMERA_CTRL);
+    OSP_DECLARE_GET_DATA_IDS(floatingOrigin,    TESTAPP_DATA_FLOATING_ORIGIN);
+
+    auto const tgWin    = windowApp         .get_pipelines<PlWindowApp>();
+    auto const tgScnRdr = sceneRenderer     .get_pipelines<PlSceneRenderer>();
+    auto const tgCmCt   = cameraCtrl        .get_pipelines<PlCameraCtrl>();
+    auto const tgFO     = floatingOrigin    .get_pipelines<PlFloatingOrigin>();
+
+    Session out;
+
+    rBuilder.task()
+        .name       ("Request origin shift if Camera Controller target is too far from origin")
+        .run_on     ({tgWin.inputs(Run)})
+        .sync_with  ({tgCmCt.camCtrl(Modify), tgFO.originShift(New)})
+        .push_to    (out.m_tasks)
+        .args       ({                 idCamCtrl,                     idFloatOrigin })
+        .func([] (ACtxCameraController& rCamCtrl, ACtxFloatingOrigin& rFloatOrigin) noexcept
+    {
+        if ( ! rCamCtrl.m_target.has_value())
+        {
+            return;
+        }
+
+        Vector3 const translate = SysFloatingOrigin::rebase_translation(rCamCtrl.m_target.value(), rFloatOrigin.m_threshold);
+
+        if ( ! translate.isZero())
+        {
+            rCamCtrl.m_transform.translation()  += translate;
+            rCamCtrl.m_target.value()           += translate;
+            rFloatOrigin.m_request              += translate;
+        }
+    });
+
+    rBuilder.task()
+        .name       ("Translate draw transforms after origin shift")
+        .run_on     ({tgScnRdr.render(Run)})
+        .sync_with  ({tgFO.originShift(Ready), tgScnRdr.drawTransforms(Resize), tgScnRdr.drawEntResized(Done)})
+        .push_to    (out.m_tasks)
+        .args       ({           idScnRender,                     idFloatOrigin })
+        .func([] (ACtxSceneRender& rScnRender, ACtxFloatingOrigin& rFloatOrigin) noexcept
+    {
+        Vector3 const translate = std::exchange(rFloatOrigin.m_applied, {});
+
+        if ( ! translate.isZero())
+        {
+            // Draw transforms calculated from the scene graph are overwritten right after, but
+            // ones set by other means (only when changed) need to follow along too.
+            SysRender::translate_draw_transforms(rScnRender.m_drawTransform, translate, 0, rScnRender.m_drawTransform.size());
+        }
+    });
+
+    return out;
+} // setup_camera_floating_origin
+
+
+
+
 Session setup_cursor(
         TopTaskBuilder&             rBuilder,
         ArrayView<entt::any> const  topData,
@@ -57,6 +57,19 @@ osp::Session setup_camera_free(
         osp::Session const&         scene,
         osp::Session const&         camera);
 
+/**
+ * @brief Request floating origin shifts when the camera controller's target strays too far
+ *
+ * The camera follows each shift right away, and draw transforms follow once the scene is shifted.
+ */
+osp::Session setup_camera_floating_origin(
+        osp::TopTaskBuilder&        rBuilder,
+        osp::ArrayView<entt::any>   topData,
+        osp::Session const&         windowApp,
+        osp::Session const&         sceneRenderer,
+        osp::Session const&         cameraCtrl,
+        osp::Session const&         floatingOrigin);
+
 /**
  * @brief Wireframe cube over the camera controller's target
  */
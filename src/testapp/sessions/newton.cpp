@@ -94,7 +94,13 @@ Session setup_newton(
         .args({             idBasic,             idPhys,              idNwt,           idDeltaTimeIn })
         .func([] (ACtxBasic& rBasic, ACtxPhysics& rPhys, ACtxNwtWorld& rNwt, float const deltaTimeIn, WorkerContext ctx) noexcept
     {
+        SysNewton::update_translate(rPhys, rNwt);
         SysNewton::update_world(rPhys, rNwt, deltaTimeIn, rBasic.m_scnGraph, rBasic.m_transform);
+
+        for (ActiveEnt const ent : rNwt.m_entMoved)
+        {
+            transform_changed(rBasic, ent);
+        }
     });
 
     top_emplace< ACtxNwtWorld >(topData, idNwt, 2);
@@ -341,15 +347,17 @@ Session setup_vehicle_spawn_newton(
     {
         LGRN_ASSERT(rVehicleSpawn.new_vehicle_count() != 0);
 
-        // ActiveEnts created for welds + ActiveEnts created for vehicle prefabs
-        std::size_t const totalEnts = rVehicleSpawn.rootEnts.size() + rPrefabs.newEnts.size();
-
         auto const& itWeldsFirst        = rVehicleSpawn.spawnedWelds.begin();
         auto const& itWeldOffsetsLast   = rVehicleSpawn.spawnedWeldOffsets.end();
         auto itWeldOffsets              = rVehicleSpawn.spawnedWeldOffsets.begin();
 
         rBasic.m_scnGraph.resize(rBasic.m_activeIds.capacity());
 
+        // Count entities of each weld first, so all of their subtrees can be reserved at once.
+        // Requests are in the same order as spawnedWelds.
+        std::vector<SubtreeRequest> requests;
+        requests.reserve(rVehicleSpawn.spawnedWelds.size());
+
         for (ACtxVehicleSpawn::TmpToInit const& toInit : rVehicleSpawn.spawnRequest)
         {
             auto const itWeldOffsetsNext = std::next(itWeldOffsets);
@@ -359,37 +367,49 @@ Session setup_vehicle_spawn_newton(
 
             std::for_each(itWeldsFirst + std::ptrdiff_t{*itWeldOffsets},
                           itWeldsFirst + std::ptrdiff_t{weldOffsetNext},
-                          [&rBasic, &rScnParts, &rVehicleSpawn, &rPrefabs, &rResources, &toInit] (WeldId const weld)
+                          [&rBasic, &rScnParts, &rVehicleSpawn, &rPrefabs, &requests, &toInit] (WeldId const weld)
             {
-                // Count parts in this weld first
-                std::size_t entCount = 0;
+                uint32_t entCount = 0;
                 for (PartId const part : rScnParts.weldToParts[weld])
                 {
                     SpPartId const newPart = rVehicleSpawn.partToSpawned[part];
                     uint32_t const prefabInit = rVehicleSpawn.spawnedPrefabs[newPart];
-                    entCount += rPrefabs.spawnedEntsOffset[prefabInit].size();
+                    entCount += uint32_t(rPrefabs.spawnedEntsOffset[prefabInit].size());
                 }
 
                 ActiveEnt const weldEnt = rScnParts.weldToActive[weld];
 
                 rBasic.m_transform.emplace(weldEnt, Matrix4::from(toInit.rotation.toMatrix(), toInit.position));
+                transform_changed(rBasic, weldEnt);
 
-                SubtreeBuilder bldRoot = SysSceneGraph::add_descendants(rBasic.m_scnGraph, entCount + 1);
-                SubtreeBuilder bldWeld = bldRoot.add_child(weldEnt, entCount);
-
-                for (PartId const part : rScnParts.weldToParts[weld])
-                {
-                    SpPartId const newPart      = rVehicleSpawn.partToSpawned[part];
-                    uint32_t const prefabInit   = rVehicleSpawn.spawnedPrefabs[newPart];
-                    auto const& basic           = rPrefabs.spawnRequest[prefabInit];
-                    auto const& ents            = rPrefabs.spawnedEntsOffset[prefabInit];
-
-                    SysPrefabInit::add_to_subtree(basic, ents, rResources, bldWeld);
-                }
+                // Weld entity, and part prefabs under it
+                requests.push_back({lgrn::id_null<ActiveEnt>(), entCount + 1});
             });
 
             itWeldOffsets = itWeldOffsetsNext;
         }
+
+        std::vector<SubtreeBuilder> builders;
+        SysSceneGraph::add_descendants_batch(rBasic.m_scnGraph, arrayView(requests.data(), requests.size()), builders);
+
+        auto itBuilder = builders.begin();
+        for (WeldId const weld : rVehicleSpawn.spawnedWelds)
+        {
+            ActiveEnt const weldEnt = rScnParts.weldToActive[weld];
+            SubtreeBuilder bldWeld  = itBuilder->add_child(weldEnt, uint32_t(itBuilder->remaining() - 1));
+
+            for (PartId const part : rScnParts.weldToParts[weld])
+            {
+                SpPartId const newPart      = rVehicleSpawn.partToSpawned[part];
+                uint32_t const prefabInit   = rVehicleSpawn.spawnedPrefabs[newPart];
+                auto const& tmpl            = rPrefabs.templates[rPrefabs.spawnTemplate[prefabInit]];
+                auto const& ents            = rPrefabs.spawnedEntsOffset[prefabInit];
+
+                SysPrefabInit::add_to_subtree(tmpl, ents, bldWeld);
+            }
+
+            ++itBuilder;
+        }
     });
 
     rBuilder.task()
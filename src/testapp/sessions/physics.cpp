@@ -26,6 +26,7 @@
 #include "common.h"
 
 #include <osp/activescene/basic.h>
+#include <osp/activescene/basic_fn.h>
 #include <osp/activescene/physics_fn.h>
 #include <osp/activescene/prefab_fn.h>
 #include <osp/core/Resources.h>
@@ -33,6 +34,7 @@
 #include <osp/drawing/prefab_draw.h>
 #include <osp/vehicles/ImporterData.h>
 
+#include <Corrade/Containers/ArrayViewStl.h>
 #include <Magnum/Trade/Trade.h>
 #include <Magnum/Trade/PbrMetallicRoughnessMaterialData.h>
 
@@ -82,6 +84,67 @@ Session setup_physics(
 } // setup_physics
 
 
+
+
+Session setup_floating_origin(
+        TopTaskBuilder&             rBuilder,
+        ArrayView<entt::any> const  topData,
+        Session const&              scene,
+        Session const&              commonScene,
+        Session const&              physics)
+{
+    OSP_DECLARE_GET_DATA_IDS(commonScene,  TESTAPP_DATA_COMMON_SCENE);
+    OSP_DECLARE_GET_DATA_IDS(physics,      TESTAPP_DATA_PHYSICS);
+    auto const tgScn = scene      .get_pipelines<PlScene>();
+    auto const tgCS  = commonScene.get_pipelines<PlCommonScene>();
+
+    Session out;
+    OSP_DECLARE_CREATE_DATA_IDS(out, topData, TESTAPP_DATA_FLOATING_ORIGIN);
+    auto const tgFO = out.create_pipelines<PlFloatingOrigin>(rBuilder);
+
+    rBuilder.pipeline(tgFO.originShift).parent(tgScn.update);
+
+    top_emplace< ACtxFloatingOrigin >   (topData, idFloatOrigin);
+    top_emplace< ActiveEntVec_t >       (topData, idFloatOriginRoots);
+
+    rBuilder.task()
+        .name       ("Shift root transforms and physics bodies towards the origin")
+        .run_on     ({tgScn.update(Run)})
+        .sync_with  ({tgFO.originShift(Modify), tgCS.hierarchy(Ready), tgCS.transform(Modify)})
+        .push_to    (out.m_tasks)
+        .args       ({      idBasic,             idPhys,                     idFloatOrigin,                idFloatOriginRoots })
+        .func([] (ACtxBasic& rBasic, ACtxPhysics& rPhys, ACtxFloatingOrigin& rFloatOrigin, ActiveEntVec_t& rRoots) noexcept
+    {
+        Vector3 const translate = SysFloatingOrigin::take_request(rFloatOrigin);
+
+        if (translate.isZero())
+        {
+            return;
+        }
+
+        // Only roots are relative to the origin
+        SysFloatingOrigin::collect_roots(rBasic.m_scnGraph, rRoots);
+
+        constexpr std::size_t chunkSize = 1024;
+        for (std::size_t first = 0; first < rRoots.size(); first += chunkSize)
+        {
+            std::size_t const last = std::min(first + chunkSize, rRoots.size());
+            SysFloatingOrigin::translate_roots(rBasic.m_transform, arrayView(rRoots).slice(first, last), translate);
+        }
+
+        for (ActiveEnt const root : rRoots)
+        {
+            transform_changed(rBasic, root);
+        }
+
+        // Physics engines follow along before their next step
+        rPhys.m_originTranslate += translate;
+    });
+
+    return out;
+} // setup_floating_origin
+
+
 //-----------------------------------------------------------------------------
 
 
@@ -139,10 +202,17 @@ Session setup_prefabs(
         .run_on     ({tgPf.spawnRequest(UseOrRun)})
         .sync_with  ({tgPf.spawnedEnts(UseOrRun), tgCS.transform(New)})
         .push_to    (out.m_tasks)
-        .args       ({      idBasic,           idResources,             idPrefabs})
-        .func([] (ACtxBasic& rBasic, Resources& rResources, ACtxPrefabs& rPrefabs) noexcept
+        .args       ({      idBasic,                   idPrefabs})
+        .func([] (ACtxBasic& rBasic, ACtxPrefabs const& rPrefabs) noexcept
     {
-        SysPrefabInit::init_transforms(rPrefabs, rResources, rBasic.m_transform);
+        SysPrefabInit::init_transforms(rPrefabs, rBasic.m_transform);
+
+        // Prefab roots are placed in the scene graph after this, either as roots or under new
+        // entities that are marked themselves
+        for (std::size_t i = 0; i < rPrefabs.spawnRequest.size(); ++i)
+        {
+            transform_changed(rBasic, rPrefabs.spawnedEntsOffset[i][0]);
+        }
     });
 
     rBuilder.task()
@@ -150,12 +220,12 @@ Session setup_prefabs(
         .run_on     ({tgPf.spawnRequest(UseOrRun)})
         .sync_with  ({tgPf.spawnedEnts(UseOrRun), tgPf.instanceInfo(Modify)})
         .push_to    (out.m_tasks)
-        .args       ({      idBasic,           idResources,             idPrefabs})
-        .func([] (ACtxBasic& rBasic, Resources& rResources, ACtxPrefabs& rPrefabs) noexcept
+        .args       ({            idBasic,             idPrefabs})
+        .func([] (ACtxBasic const& rBasic, ACtxPrefabs& rPrefabs) noexcept
     {
         rPrefabs.instanceInfo.resize(rBasic.m_activeIds.capacity(), PrefabInstanceInfo{.prefab = lgrn::id_null<PrefabId>()});
         rPrefabs.roots.resize(rBasic.m_activeIds.capacity());
-        SysPrefabInit::init_info(rPrefabs, rResources);
+        SysPrefabInit::init_info(rPrefabs);
     });
 
     rBuilder.task()
@@ -163,13 +233,13 @@ Session setup_prefabs(
         .run_on     ({tgPf.spawnRequest(UseOrRun)})
         .sync_with  ({tgPf.spawnedEnts(UseOrRun), tgPhy.physBody(Modify), tgPhy.physUpdate(Done)})
         .push_to    (out.m_tasks)
-        .args       ({      idBasic,           idResources,             idPhys,             idPrefabs})
-        .func([] (ACtxBasic& rBasic, Resources& rResources, ACtxPhysics& rPhys, ACtxPrefabs& rPrefabs) noexcept
+        .args       ({            idBasic,             idPhys,                   idPrefabs})
+        .func([] (ACtxBasic const& rBasic, ACtxPhysics& rPhys, ACtxPrefabs const& rPrefabs) noexcept
     {
         rPhys.m_hasColliders.resize(rBasic.m_activeIds.capacity());
         //rPhys.m_massDirty.resize(rActiveIds.capacity());
         rPhys.m_shape.resize(rBasic.m_activeIds.capacity());
-        SysPrefabInit::init_physics(rPrefabs, rResources, rPhys);
+        SysPrefabInit::init_physics(rPrefabs, rPhys);
     });
 
     rBuilder.task()
@@ -182,6 +252,16 @@ Session setup_prefabs(
         rPrefabs.spawnRequest.clear();
     });
 
+    rBuilder.task()
+        .name       ("Clean up prefab templates")
+        .run_on     ({tgScn.cleanup(Run_)})
+        .push_to    (out.m_tasks)
+        .args       ({        idPrefabs,           idResources})
+        .func([] (ACtxPrefabs& rPrefabs, Resources& rResources) noexcept
+    {
+        SysPrefabInit::clear_templates(rPrefabs, rResources);
+    });
+
     return out;
 } // setup_prefabs
 
@@ -217,10 +297,10 @@ Session setup_prefab_draw(
         .run_on     ({tgPf.spawnRequest(UseOrRun)})
         .sync_with  ({tgPf.spawnedEnts(UseOrRun), tgCS.activeEntResized(Done), tgScnRdr.drawEntResized(ModifyOrSignal)})
         .push_to    (out.m_tasks)
-        .args       ({           idPrefabs,           idResources,                 idBasic,             idDrawing,                 idScnRender})
-        .func([]    (ACtxPrefabs& rPrefabs, Resources& rResources, ACtxBasic const& rBasic, ACtxDrawing& rDrawing, ACtxSceneRender& rScnRender) noexcept
+        .args       ({                 idPrefabs,                 idScnRender})
+        .func([]    (ACtxPrefabs const& rPrefabs, ACtxSceneRender& rScnRender) noexcept
     {
-        SysPrefabDraw::init_drawents(rPrefabs, rResources, rBasic, rDrawing, rScnRender);
+        SysPrefabDraw::init_drawents(rPrefabs, rScnRender);
     });
 
     rBuilder.task()
@@ -49,6 +49,19 @@ osp::Session setup_physics(
         osp::Session const&         scene,
         osp::Session const&         commonScene);
 
+/**
+ * @brief Floating origin, shifts all root transforms and physics bodies at once
+ *
+ * Shifts are requested through ACtxFloatingOrigin::m_request, such as by
+ * setup_camera_floating_origin.
+ */
+osp::Session setup_floating_origin(
+        osp::TopTaskBuilder&        rBuilder,
+        osp::ArrayView<entt::any>   topData,
+        osp::Session const&         scene,
+        osp::Session const&         commonScene,
+        osp::Session const&         physics);
+
 /**
  * @brief Queues and logic for spawning Prefab resources
  */
@@ -28,10 +28,12 @@
 #include <adera/drawing/CameraController.h>
 
 #include <osp/activescene/basic.h>
+#include <osp/activescene/bvh_fn.h>
 #include <osp/activescene/physics_fn.h>
 #include <osp/drawing/drawing_fn.h>
 #include <osp/drawing/prefab_draw.h>
 
+#include <limits>
 #include <random>
 
 using namespace adera;
@@ -154,6 +156,8 @@ Session setup_phys_shapes(
             rBasic.m_transform.emplace(child, ACompTransform{Matrix4::scaling(spawn.m_size)});
             SubtreeBuilder bldRoot = bldScnRoot.add_child(root, 1);
             bldRoot.add_child(child);
+
+            transform_changed(rBasic, root);
         }
     });
 
@@ -504,27 +508,70 @@ Session setup_bounds(
     auto const tgBnds = out.create_pipelines<PlBounds>(rBuilder);
 
     rBuilder.pipeline(tgBnds.boundsSet)     .parent(tgScn.update);
+    rBuilder.pipeline(tgBnds.boundsBvh)     .parent(tgScn.update);
     rBuilder.pipeline(tgBnds.outOfBounds)   .parent(tgScn.update);
 
     top_emplace< ActiveEntSet_t >       (topData, idBounds);
+    top_emplace< ACtxEntBvh >           (topData, idBoundsBvh);
+    top_emplace< KeyedVec<ActiveEnt, Matrix4> > (topData, idBoundsTf);
     top_emplace< ActiveEntVec_t >       (topData, idOutOfBounds);
 
     rBuilder.task()
-        .name       ("Check for out-of-bounds entities")
+        .name       ("Update bounds BVH from transforms")
         .run_on     ({tgScn.update(Run)})
-        .sync_with  ({tgCS.transform(Ready), tgBnds.boundsSet(Ready), tgBnds.outOfBounds(Modify__)})
+        .sync_with  ({tgCS.hierarchy(Ready), tgCS.transform(Ready), tgBnds.boundsSet(Ready), tgBnds.boundsBvh(Modify)})
         .push_to    (out.m_tasks)
-        .args       ({            idBasic,                      idBounds,                idOutOfBounds })
-        .func([] (ACtxBasic const& rBasic, ActiveEntSet_t const& rBounds, ActiveEntVec_t& rOutOfBounds) noexcept
+        .args       ({            idBasic,                      idBounds,            idBoundsBvh,                               idBoundsTf })
+        .func([] (ACtxBasic const& rBasic, ActiveEntSet_t const& rBounds, ACtxEntBvh& rBvh, KeyedVec<ActiveEnt, Matrix4>& rBoundsTf) noexcept
     {
+        // Shapes are scaled from a 2x2x2 cube, see osp::shape_volume
+        Aabb const unitBox{Vector3{-1.0f}, Vector3{1.0f}};
+
+        rBoundsTf.resize(rBasic.m_activeIds.capacity());
+
         for (ActiveEnt const ent : rBounds)
+        {
+            Matrix4 const &rootTf = rBasic.m_transform.get(ent).m_transform;
+
+            // Shapes don't move relative to their root, so the box only changes when the root
+            // moves. Most of them are resting most of the time.
+            if (SysEntBvh::contains(rBvh, ent) && rBoundsTf[ent] == rootTf)
+            {
+                continue;
+            }
+            rBoundsTf[ent] = rootTf;
+
+            Aabb box{rootTf.translation(), rootTf.translation()};
+            for (ActiveEnt const child : SysSceneGraph::children(rBasic.m_scnGraph, ent))
+            {
+                Matrix4 const childTf = rootTf * rBasic.m_transform.get(child).m_transform;
+                box = SysEntBvh::box_union(box, SysEntBvh::transform_aabb(unitBox, childTf));
+            }
+
+            SysEntBvh::update(rBvh, ent, box);
+        }
+    });
+
+    rBuilder.task()
+        .name       ("Check for out-of-bounds entities")
+        .run_on     ({tgScn.update(Run)})
+        .sync_with  ({tgCS.transform(Ready), tgBnds.boundsBvh(Ready), tgBnds.outOfBounds(Modify__)})
+        .push_to    (out.m_tasks)
+        .args       ({            idBasic,                  idBoundsBvh,                idOutOfBounds })
+        .func([] (ACtxBasic const& rBasic, ACtxEntBvh const& rBvh, ActiveEntVec_t& rOutOfBounds) noexcept
+    {
+        constexpr float inf = std::numeric_limits<float>::infinity();
+        Aabb const below{Vector3{-inf}, Vector3{inf, inf, -10.0f}};
+
+        // Only entities with fat boxes reaching below the limit are checked
+        SysEntBvh::query_box(rBvh, below, [&rBasic, &rOutOfBounds] (ActiveEnt const ent)
         {
             ACompTransform const &entTf = rBasic.m_transform.get(ent);
             if (entTf.m_transform.translation().z() < -10)
             {
                 rOutOfBounds.push_back(ent);
             }
-        }
+        });
     });
 
     rBuilder.task()
@@ -575,14 +622,15 @@ Session setup_bounds(
     rBuilder.task()
         .name       ("Delete bounds components")
         .run_on     ({tgCS.activeEntDelete(UseOrRun)})
-        .sync_with  ({tgBnds.boundsSet(Delete)})
+        .sync_with  ({tgBnds.boundsSet(Delete), tgBnds.boundsBvh(Delete)})
         .push_to    (out.m_tasks)
-        .args       ({                 idActiveEntDel,                idBounds })
-        .func([] (ActiveEntVec_t const& rActiveEntDel, ActiveEntSet_t& rBounds) noexcept
+        .args       ({                 idActiveEntDel,                idBounds,            idBoundsBvh })
+        .func([] (ActiveEntVec_t const& rActiveEntDel, ActiveEntSet_t& rBounds, ACtxEntBvh& rBvh) noexcept
     {
         for (osp::active::ActiveEnt const ent : rActiveEntDel)
         {
             rBounds.erase(ent);
+            SysEntBvh::remove(rBvh, ent);
         }
     });
 
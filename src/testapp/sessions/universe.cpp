@@ -27,14 +27,24 @@
 #include "common.h"
 
 #include <adera/drawing/CameraController.h>
+#include <osp/activescene/basic.h>
 
 #include <osp/core/math_2pow.h>
 #include <osp/drawing/drawing.h>
 #include <osp/universe/coordinates.h>
+#include <osp/universe/hierarchy.h>
+#include <osp/universe/integrators.h>
+#include <osp/universe/kepler.h>
+#include <osp/universe/nbody.h>
+#include <osp/universe/spatialindex.h>
+#include <osp/universe/transfer.h>
 #include <osp/universe/universe.h>
 #include <osp/util/logging.h>
 
+#include <Corrade/Containers/ArrayViewStl.h>
+
 #include <random>
+#include <utility>
 
 using namespace adera;
 using namespace osp::draw;
@@ -52,13 +62,136 @@ Session setup_uni_core(
     Session out;
     OSP_DECLARE_CREATE_DATA_IDS(out, topData, TESTAPP_DATA_UNI_CORE);
 
-    top_emplace< Universe > (topData, idUniverse);
+    top_emplace< Universe >         (topData, idUniverse);
+    top_emplace< float >            (topData, tgUniDeltaTimeIn, 1.0f / 60.0f);
+    top_emplace< CoSpaceLevels >    (topData, idCoSpaceLevels);
+    top_emplace< std::vector<SatTransfer> > (topData, idSatTransfers);
+    top_emplace< std::vector<SatRemap> >    (topData, idSatRemaps);
+    top_emplace< std::vector<SatDynamics> > (topData, idSatDynamics);
+    top_emplace< SatIntegratorScratch >     (topData, idSatIntegScratch);
+    top_emplace< std::vector<SatGridIndex> >(topData, idSatIndices);
 
     auto const tgUCore = out.create_pipelines<PlUniCore>(rBuilder);
 
     rBuilder.pipeline(tgUCore.update).parent(updateOn);//.wait_for_signal(EStgOptn::ModifyOrSignal);
 
     rBuilder.pipeline(tgUCore.transfer).parent(tgUCore.update);
+    rBuilder.pipeline(tgUCore.satRemap).parent(tgUCore.update);
+    rBuilder.pipeline(tgUCore.satPositions).parent(tgUCore.update);
+
+    // Anything can queue transfers by pushing to idSatTransfers, synced with transfer(Modify_).
+    // All of them are carried out together in a single batch before satellites are stepped.
+
+    rBuilder.task()
+        .name       ("Schedule satellite transfers")
+        .schedules  ({tgUCore.transfer(Schedule_)})
+        .sync_with  ({tgUCore.update(Run)})
+        .push_to    (out.m_tasks)
+        .args       ({                   idSatTransfers })
+        .func([] (std::vector<SatTransfer> const& rSatTransfers) noexcept -> TaskActions
+    {
+        return rSatTransfers.empty() ? TaskAction::Cancel : TaskActions{};
+    });
+
+    rBuilder.task()
+        .name       ("Transfer satellites between CoSpaces")
+        .run_on     ({tgUCore.transfer(UseOrRun)})
+        .sync_with  ({tgUCore.satPositions(Delete), tgUCore.satRemap(Modify_)})
+        .push_to    (out.m_tasks)
+        .args       ({     idUniverse,                          idSatTransfers,                    idSatRemaps,                                idSatDynamics,                            idSatIndices,                    tgUniDeltaTimeIn })
+        .func([] (Universe& rUniverse, std::vector<SatTransfer> const& rSatTransfers, std::vector<SatRemap>& rSatRemaps, std::vector<SatDynamics> const& rSatDynamics, std::vector<SatGridIndex>& rSatIndices, float const uniDeltaTimeIn) noexcept
+    {
+        auto const rails_of = [&rSatDynamics] (CoSpaceId const id) -> SatRails*
+        {
+            return (id < rSatDynamics.size()) ? rSatDynamics[id].m_pRails : nullptr;
+        };
+
+        // Satellites on rails need their current positions and velocities to be converted
+        for (SatTransfer const& transfer : rSatTransfers)
+        {
+            if (SatRails *pRails = rails_of(transfer.m_src); pRails != nullptr)
+            {
+                sat_rails_evaluate(rUniverse.m_coordCommon[transfer.m_src], *pRails, {&transfer.m_sat, 1});
+            }
+        }
+
+        std::size_t const remapsFirst = rSatRemaps.size();
+        sat_transfer(rUniverse, rSatTransfers, rSatRemaps);
+
+        ArrayView<SatRemap const> const remaps = ArrayView<SatRemap const>{rSatRemaps}.exceptPrefix(remapsFirst);
+        for (CoSpaceId id = 0; id < rSatDynamics.size(); ++id)
+        {
+            if (SatRails *pRails = rails_of(id); pRails != nullptr && rUniverse.m_coordIds.exists(id))
+            {
+                sat_rails_remap(*pRails, id, rUniverse.m_coordCommon[id].m_satCount, remaps);
+            }
+        }
+
+        for (CoSpaceId id = 0; id < rSatIndices.size(); ++id)
+        {
+            if (rUniverse.m_coordIds.exists(id))
+            {
+                sat_index_remap(rSatIndices[id], rUniverse.m_coordCommon[id], rails_of(id), id, remaps, uniDeltaTimeIn);
+            }
+        }
+    });
+
+    rBuilder.task()
+        .name       ("Clear satellite transfer queue")
+        .run_on     ({tgUCore.transfer(Clear)})
+        .push_to    (out.m_tasks)
+        .args       ({             idSatTransfers })
+        .func([] (std::vector<SatTransfer>& rSatTransfers) noexcept
+    {
+        rSatTransfers.clear();
+    });
+
+    rBuilder.task()
+        .name       ("Clear satellite remaps")
+        .run_on     ({tgUCore.satRemap(Clear)})
+        .push_to    (out.m_tasks)
+        .args       ({          idSatRemaps })
+        .func([] (std::vector<SatRemap>& rSatRemaps) noexcept
+    {
+        rSatRemaps.clear();
+    });
+
+    rBuilder.task()
+        .name       ("Step all CoSpaces, parents before children")
+        .run_on     (tgUCore.update(Run))
+        .sync_with  ({tgUCore.satPositions(Modify)})
+        .push_to    (out.m_tasks)
+        .args       ({     idUniverse,               idCoSpaceLevels,                                idSatDynamics,                       idSatIntegScratch,                            idSatIndices,             tgUniDeltaTimeIn })
+        .func([] (Universe& rUniverse, CoSpaceLevels& rCoSpaceLevels, std::vector<SatDynamics> const& rSatDynamics, SatIntegratorScratch& rSatIntegScratch, std::vector<SatGridIndex>& rSatIndices, float const uniDeltaTimeIn) noexcept
+    {
+        // Rebuilding levels is cheap compared to stepping satellites, and saves having to track
+        // when the hierarchy changes
+        coord_levels_build(rCoSpaceLevels, rUniverse);
+
+        // Each level only depends on the one before it
+        constexpr std::size_t chunkSize = 64;
+
+        for (std::size_t depth = 0; depth < rCoSpaceLevels.level_count(); ++depth)
+        {
+            ArrayView<CoSpaceId const> const level = rCoSpaceLevels.level(depth);
+            for (std::size_t first = 0; first < level.size(); first += chunkSize)
+            {
+                std::size_t const last = std::min(first + chunkSize, level.size());
+                coord_step_range(rUniverse, level.slice(first, last), rSatDynamics, rSatIntegScratch, uniDeltaTimeIn);
+            }
+        }
+
+        // Spatial indices only look at satellites that may have changed cells. Indices are
+        // independent of each other.
+        for (CoSpaceId id = 0; id < rSatIndices.size(); ++id)
+        {
+            if (rSatIndices[id].m_built && rUniverse.m_coordIds.exists(id))
+            {
+                SatRails const *pRails = (id < rSatDynamics.size()) ? rSatDynamics[id].m_pRails : nullptr;
+                sat_index_update(rSatIndices[id], rUniverse.m_coordCommon[id], pRails, uniDeltaTimeIn);
+            }
+        }
+    });
 
     return out;
 } // setup_uni_core
@@ -95,7 +228,6 @@ Session setup_uni_testplanets(
         Session const&              uniScnFrame)
 {
     using CoSpaceIdVec_t = std::vector<CoSpaceId>;
-    using Corrade::Containers::Array;
 
     OSP_DECLARE_GET_DATA_IDS(uniCore, TESTAPP_DATA_UNI_CORE);
     OSP_DECLARE_GET_DATA_IDS(uniScnFrame, TESTAPP_DATA_UNI_SCENEFRAME);
@@ -110,6 +242,8 @@ Session setup_uni_testplanets(
     constexpr int           seed            = 1337;
     constexpr spaceint_t    maxDist         = math::mul_2pow<spaceint_t, int>(20000ul, precision);
     constexpr float         maxVel          = 800.0f;
+    constexpr double        minMass         = 1.0e17;
+    constexpr double        maxMass         = 1.0e18;
 
     // Create coordinate spaces
     CoSpaceId const mainSpace = rUniverse.m_coordIds.create();
@@ -129,11 +263,11 @@ Session setup_uni_testplanets(
         CoSpaceCommon &rCommon = rUniverse.m_coordCommon[surfaceSpaceId];
         rCommon.m_parent    = mainSpace;
         rCommon.m_parentSat = satId;
+        coord_transform_changed(rCommon);
     }
 
-    // Coordinate space data is a single allocation partitioned to hold positions, velocities, and
-    // rotations.
-    // TODO: Alignment is needed for SIMD (not yet implemented). see Corrade alignedAlloc
+    // Coordinate space data is a single allocation partitioned to hold positions, velocities,
+    // rotations, and masses. Each partition is aligned to gc_satDataAlign for SIMD.
 
     std::size_t bytesUsed = 0;
 
@@ -151,17 +285,21 @@ Session setup_uni_testplanets(
                                       rMainSpaceCommon.m_satRotations[2],
                                       rMainSpaceCommon.m_satRotations[3]);
 
+    partition(bytesUsed, planetCount, rMainSpaceCommon.m_satMasses);
+
     // Allocate data for all planets
-    rMainSpaceCommon.m_data = Array<unsigned char>{Corrade::NoInit, bytesUsed};
+    rMainSpaceCommon.m_data = sat_data_alloc(bytesUsed);
 
     // Create easily accessible array views for each component
     auto const [x, y, z]        = sat_views(rMainSpaceCommon.m_satPositions,  rMainSpaceCommon.m_data, planetCount);
     auto const [vx, vy, vz]     = sat_views(rMainSpaceCommon.m_satVelocities, rMainSpaceCommon.m_data, planetCount);
     auto const [qx, qy, qz, qw] = sat_views(rMainSpaceCommon.m_satRotations,  rMainSpaceCommon.m_data, planetCount);
+    auto const mass             = rMainSpaceCommon.m_satMasses.view(Corrade::Containers::arrayView(rMainSpaceCommon.m_data), planetCount);
 
     std::mt19937 gen(seed);
     std::uniform_int_distribution<spaceint_t> posDist(-maxDist, maxDist);
     std::uniform_real_distribution<double> velDist(-maxVel, maxVel);
+    std::uniform_real_distribution<double> massDist(minMass, maxMass);
 
     for (std::size_t i = 0; i < planetCount; ++i)
     {
@@ -178,6 +316,8 @@ Session setup_uni_testplanets(
         qy[i] = 0.0;
         qz[i] = 0.0;
         qw[i] = 1.0;
+
+        mass[i] = massDist(gen);
     }
 
     // Set initial scene frame
@@ -190,44 +330,60 @@ Session setup_uni_testplanets(
     OSP_DECLARE_CREATE_DATA_IDS(out, topData, TESTAPP_DATA_UNI_PLANETS);
 
     top_emplace< CoSpaceId >        (topData, idPlanetMainSpace, mainSpace);
-    top_emplace< float >            (topData, tgUniDeltaTimeIn, 1.0f / 60.0f);
     top_emplace< CoSpaceIdVec_t >   (topData, idSatSurfaceSpaces, std::move(satSurfaceSpaces));
 
+    // Apply arbitrary inverse-square gravity towards origin. Leapfrog keeps orbits stable even
+    // with long time steps; each step is split so no planet moves more than a small fraction of
+    // its orbit at once.
+    auto &rPlanetGravity = top_emplace< SatCentralGravity > (topData, idPlanetGravity, SatCentralGravity{ .m_gm = 10000000000.0 });
+
+    auto &rSatDynamics = top_get< std::vector<SatDynamics> >(topData, idSatDynamics);
+    rSatDynamics.resize(std::max<std::size_t>(rSatDynamics.size(), mainSpace + 1));
+    rSatDynamics[mainSpace].m_models.push_back({ .m_func = &sat_accel_model_central, .m_pData = &rPlanetGravity });
+    rSatDynamics[mainSpace].m_integrator = { .m_method = ESatIntegrator::Leapfrog, .m_adaptiveEta = 0.05 };
+
+    // Only planets near the SceneFrame are integrated, the rest follow Keplerian orbits around the
+    // origin until they come close
+    auto &rPlanetRails = top_emplace< SatRails > (topData, idPlanetRails);
+    rPlanetRails.m_gm               = rPlanetGravity.m_gm;
+    rPlanetRails.m_railsDistance    = 8000.0;
+    rPlanetRails.m_activeDistance   = 6000.0;
+    rPlanetRails.m_frameSpeedLimit  = 2000.0;
+    rSatDynamics[mainSpace].m_pRails = &rPlanetRails;
+
+    // Index planets into ~2km cells, for finding planets near the SceneFrame
+    auto &rSatIndices = top_get< std::vector<SatGridIndex> >(topData, idSatIndices);
+    rSatIndices.resize(std::max<std::size_t>(rSatIndices.size(), mainSpace + 1));
+    rSatIndices[mainSpace].m_cellShift = precision + 11;
+    sat_index_build(rSatIndices[mainSpace], rMainSpaceCommon, &rPlanetRails, top_get<float>(topData, tgUniDeltaTimeIn));
+
     rBuilder.task()
         .name       ("Update planets")
         .run_on     (tgUCore.update(Run))
-        .sync_with  ({tgUSFrm.sceneFrame(Modify)})
+        .sync_with  ({tgUSFrm.sceneFrame(Prev), tgUCore.satPositions(Modify)})
         .push_to    (out.m_tasks)
-        .args       ({     idUniverse,               idPlanetMainSpace,            idScnFrame,                      idSatSurfaceSpaces,           tgUniDeltaTimeIn })
-        .func([] (Universe& rUniverse, CoSpaceId const planetMainSpace, SceneFrame &rScnFrame, CoSpaceIdVec_t const& rSatSurfaceSpaces, float const uniDeltaTimeIn) noexcept
+        .args       ({     idUniverse,               idPlanetMainSpace,                  idScnFrame,                      idSatSurfaceSpaces,          idPlanetRails,           tgUniDeltaTimeIn })
+        .func([] (Universe& rUniverse, CoSpaceId const planetMainSpace, SceneFrame const &rScnFrame, CoSpaceIdVec_t const& rSatSurfaceSpaces, SatRails& rPlanetRails, float const uniDeltaTimeIn) noexcept
     {
         CoSpaceCommon &rMainSpaceCommon = rUniverse.m_coordCommon[planetMainSpace];
 
+        // Phase 0: Move planets on and off rails. Within a planet, the SceneFrame is roughly at the
+        //          planet's position.
+
+        Vector3g const framePos = (rScnFrame.m_parent == planetMainSpace)
+                                ? rScnFrame.m_position
+                                : rUniverse.m_coordCommon[rScnFrame.m_parent].m_position;
+        sat_rails_update(rMainSpaceCommon, rPlanetRails, framePos);
+
         auto const scale = osp::math::mul_2pow<double, int>(1.0, -rMainSpaceCommon.m_precision);
-        double const scaleDelta = uniDeltaTimeIn / scale;
 
-        auto const [x, y, z]        = sat_views(rMainSpaceCommon.m_satPositions,  rMainSpaceCommon.m_data, rMainSpaceCommon.m_satCount);
-        auto const [vx, vy, vz]     = sat_views(rMainSpaceCommon.m_satVelocities, rMainSpaceCommon.m_data, rMainSpaceCommon.m_satCount);
         auto const [qx, qy, qz, qw] = sat_views(rMainSpaceCommon.m_satRotations,  rMainSpaceCommon.m_data, rMainSpaceCommon.m_satCount);
 
-        // Phase 1: Move satellites
+        // Phase 1: Rotate satellites. Positions and velocities are integrated by the
+        //          "Step all CoSpaces" task
 
         for (std::size_t i = 0; i < rMainSpaceCommon.m_satCount; ++i)
         {
-            x[i] += vx[i] * scaleDelta;
-            y[i] += vy[i] * scaleDelta;
-            z[i] += vz[i] * scaleDelta;
-
-            // Apply arbitrary inverse-square gravity towards origin
-            Vector3d const pos       = Vector3d( Vector3g( x[i], y[i], z[i] ) ) * scale;
-            double const r           = pos.length();
-            double const c_gm        = 10000000000.0;
-            Vector3d const accel     = -pos * uniDeltaTimeIn * c_gm / (r * r * r);
-
-            vx[i] += accel.x();
-            vy[i] += accel.y();
-            vz[i] += accel.z();
-
             // Rotate based on i, semi-random
             Vector3d const axis = Vector3d{std::sin(i), std::cos(i), double(i % 8 - 4)}.normalized();
             Radd const speed{(i % 16) / 16.0};
@@ -240,7 +396,31 @@ Session setup_uni_testplanets(
             qw[i] = rot.scalar();
         }
 
-        // Phase 2: Transfers and stuff
+        // Surface CoSpaces follow their planet's new rotation. Positions in m_data are stale for
+        // planets on rails.
+        for (CoSpaceId const surface : rSatSurfaceSpaces)
+        {
+            CoSpaceCommon &rSurfaceCommon = rUniverse.m_coordCommon[surface];
+            coord_sync_parent_sat(rSurfaceCommon, rMainSpaceCommon);
+            rSurfaceCommon.m_position = sat_rails_position(rMainSpaceCommon, rPlanetRails, rSurfaceCommon.m_parentSat);
+        }
+    });
+
+    rBuilder.task()
+        .name       ("Transfer SceneFrame between planets")
+        .run_on     (tgUCore.update(Run))
+        .sync_with  ({tgUSFrm.sceneFrame(Modify), tgUCore.satPositions(Ready)})
+        .push_to    (out.m_tasks)
+        .args       ({     idUniverse,               idPlanetMainSpace,            idScnFrame,                      idSatSurfaceSpaces,                idPlanetRails,                                idSatIndices })
+        .func([] (Universe& rUniverse, CoSpaceId const planetMainSpace, SceneFrame &rScnFrame, CoSpaceIdVec_t const& rSatSurfaceSpaces, SatRails const& rPlanetRails, std::vector<SatGridIndex> const& rSatIndices) noexcept
+    {
+        CoSpaceCommon &rMainSpaceCommon = rUniverse.m_coordCommon[planetMainSpace];
+
+        auto const scale = osp::math::mul_2pow<double, int>(1.0, -rMainSpaceCommon.m_precision);
+
+        SatPosViews_t const pos     = sat_views(rMainSpaceCommon.m_satPositions,  rMainSpaceCommon.m_data, rMainSpaceCommon.m_satCount);
+        auto const& [x, y, z]       = pos;
+        auto const [qx, qy, qz, qw] = sat_views(rMainSpaceCommon.m_satRotations,  rMainSpaceCommon.m_data, rMainSpaceCommon.m_satCount);
 
         constexpr float captureDist = 500.0f;
 
@@ -252,26 +432,24 @@ Session setup_uni_testplanets(
         if (notInPlanet)
         {
             // Find a planet to enter
-            std::size_t nearbyPlanet = rMainSpaceCommon.m_satCount;
-            for (std::size_t i = 0; i < rMainSpaceCommon.m_satCount; ++i)
-            {
-                Vector3 const diff = (Vector3( x[i], y[i], z[i] ) - Vector3(areaPos)) * scale;
-                if (diff.length() < captureDist)
-                {
-                    nearbyPlanet = i;
-                    break;
-                }
-            }
+            std::vector<SatId> nearby;
+            sat_index_radius(rSatIndices[planetMainSpace], rMainSpaceCommon, &rPlanetRails, areaPos,
+                             spaceint_t(captureDist / scale), nearby);
 
-            if (nearbyPlanet < rMainSpaceCommon.m_satCount)
+            if ( ! nearby.empty() )
             {
+                SatId const nearbyPlanet = nearby.front();
+
                 OSP_LOG_INFO("Captured into Satellite {} under CoordSpace {}",
                              nearbyPlanet, int(rSatSurfaceSpaces[nearbyPlanet]));
 
                 CoSpaceId const surface         = rSatSurfaceSpaces[nearbyPlanet];
                 CoSpaceCommon  &rSurfaceCommon  = rUniverse.m_coordCommon[surface];
 
-                CoSpaceTransform const surfaceTf     = coord_get_transform(rSurfaceCommon, rSurfaceCommon, x, y, z, qx, qy, qz, qw);
+                // Should already be off rails this close to the SceneFrame. If not, positions are
+                // only read here, so evaluate the orbit without writing it back.
+                CoSpaceTransform surfaceTf = coord_get_transform(rSurfaceCommon, rSurfaceCommon, x, y, z, qx, qy, qz, qw);
+                surfaceTf.m_position = sat_rails_position(rMainSpaceCommon, rPlanetRails, nearbyPlanet);
                 CoordTransformer const mainToSurface = coord_parent_to_child(rMainSpaceCommon, surfaceTf);
 
                 // Transfer scene frame from Main to Surface coordinate space
@@ -292,7 +470,9 @@ Session setup_uni_testplanets(
                 CoSpaceId const surface       = rScnFrame.m_parent;
                 CoSpaceCommon &rSurfaceCommon = rUniverse.m_coordCommon[surface];
 
-                CoSpaceTransform const surfaceTf     = coord_get_transform(rSurfaceCommon, rSurfaceCommon, x, y, z, qx, qy, qz, qw);
+                CoSpaceTransform surfaceTf = coord_get_transform(rSurfaceCommon, rSurfaceCommon, x, y, z, qx, qy, qz, qw);
+                surfaceTf.m_position = sat_rails_position(rMainSpaceCommon, rPlanetRails, rSurfaceCommon.m_parentSat);
+
                 CoordTransformer const surfaceToMain = coord_child_to_parent(rMainSpaceCommon, surfaceTf);
 
                 // Transfer scene frame from Surface to Main coordinate space
@@ -309,8 +489,41 @@ Session setup_uni_testplanets(
 
 
 
+Session setup_uni_nbody(
+        TopTaskBuilder&             rBuilder,
+        ArrayView<entt::any>        topData,
+        Session const&              uniCore,
+        Session const&              uniTestPlanets)
+{
+    OSP_DECLARE_GET_DATA_IDS(uniCore,        TESTAPP_DATA_UNI_CORE);
+    OSP_DECLARE_GET_DATA_IDS(uniTestPlanets, TESTAPP_DATA_UNI_PLANETS);
+
+    Session out;
+    OSP_DECLARE_CREATE_DATA_IDS(out, topData, TESTAPP_DATA_UNI_NBODY);
+
+    auto &rNBody = top_emplace< NBodyGravity >(topData, idNBody);
+
+    // Planets are only ~500m in radius, don't let them slingshot each other through their cores
+    rNBody.m_params.m_softening = 500.0;
+
+    // Octrees are built and evaluated by the "Step all CoSpaces" task, alongside any other
+    // acceleration models of the same CoSpace. Only planets off rails pull on each other.
+    CoSpaceId const mainSpace = top_get<CoSpaceId>(topData, idPlanetMainSpace);
+
+    auto &rSatDynamics = top_get< std::vector<SatDynamics> >(topData, idSatDynamics);
+    rSatDynamics.resize(std::max<std::size_t>(rSatDynamics.size(), mainSpace + 1));
+    rSatDynamics[mainSpace].m_models.push_back({ .m_func = &nbody_accel_model, .m_pData = &rNBody });
+
+    return out;
+} // setup_uni_nbody
+
+
+
+
 struct PlanetDraw
 {
+    CoordTransformCache     coordCache;
+    std::vector<Vector3>    satScenePos;
     DrawEntVec_t            drawEnts;
     std::array<DrawEnt, 3>  axis;
     DrawEnt                 attractor;
@@ -325,6 +538,7 @@ Session setup_testplanets_draw(
         Session const&              sceneRenderer,
         Session const&              cameraCtrl,
         Session const&              commonScene,
+        Session const&              floatingOrigin,
         Session const&              uniCore,
         Session const&              uniScnFrame,
         Session const&              uniTestPlanets,
@@ -334,6 +548,7 @@ Session setup_testplanets_draw(
     OSP_DECLARE_GET_DATA_IDS(commonScene,    TESTAPP_DATA_COMMON_SCENE);
     OSP_DECLARE_GET_DATA_IDS(sceneRenderer,  TESTAPP_DATA_SCENE_RENDERER);
     OSP_DECLARE_GET_DATA_IDS(cameraCtrl,     TESTAPP_DATA_CAMERA_CTRL);
+    OSP_DECLARE_GET_DATA_IDS(floatingOrigin, TESTAPP_DATA_FLOATING_ORIGIN);
     OSP_DECLARE_GET_DATA_IDS(uniCore,        TESTAPP_DATA_UNI_CORE);
     OSP_DECLARE_GET_DATA_IDS(uniScnFrame,    TESTAPP_DATA_UNI_SCENEFRAME);
     OSP_DECLARE_GET_DATA_IDS(uniTestPlanets, TESTAPP_DATA_UNI_PLANETS);
@@ -341,6 +556,8 @@ Session setup_testplanets_draw(
     auto const tgWin    = windowApp     .get_pipelines<PlWindowApp>();
     auto const tgScnRdr = sceneRenderer .get_pipelines<PlSceneRenderer>();
     auto const tgCmCt   = cameraCtrl    .get_pipelines<PlCameraCtrl>();
+    auto const tgFO     = floatingOrigin.get_pipelines<PlFloatingOrigin>();
+    auto const tgUCore  = uniCore       .get_pipelines<PlUniCore>();
     auto const tgUSFrm  = uniScnFrame   .get_pipelines<PlUniSceneFrame>();
 
     Session out;
@@ -355,34 +572,25 @@ Session setup_testplanets_draw(
     rBuilder.task()
         .name       ("Position SceneFrame center to Camera Controller target")
         .run_on     ({tgWin.inputs(Run)})
-        .sync_with  ({tgCmCt.camCtrl(Ready), tgUSFrm.sceneFrame(Modify)})
+        .sync_with  ({tgCmCt.camCtrl(Ready), tgFO.originShift(New), tgUSFrm.sceneFrame(Modify)})
         .push_to    (out.m_tasks)
-        .args       ({                 idCamCtrl,            idScnFrame })
-        .func([] (ACtxCameraController& rCamCtrl, SceneFrame& rScnFrame) noexcept
+        .args       ({                 idCamCtrl,                           idFloatOrigin,            idScnFrame })
+        .func([] (ACtxCameraController& rCamCtrl, ACtxFloatingOrigin const& rFloatOrigin, SceneFrame& rScnFrame) noexcept
     {
         if ( ! rCamCtrl.m_target.has_value())
         {
             return;
         }
-        Vector3 &rCamPl = rCamCtrl.m_target.value();
-
-        // check origin translation
-        // ADL used for Magnum::Math::sign/floor/abs
-        float const maxDist = 512.0f;
-        Vector3 const translate = sign(rCamPl) * floor(abs(rCamPl) / maxDist) * maxDist;
 
-        if ( ! translate.isZero())
+        // Scene is about to be shifted by the requested translation. Move the SceneFrame the
+        // opposite way so everything stays in the same place within the Universe.
+        if ( ! rFloatOrigin.m_request.isZero())
         {
-            rCamCtrl.m_transform.translation() -= translate;
-            rCamPl -= translate;
-
-            // a bit janky to modify universe stuff directly here, but it works lol
-            Vector3 const rotated = Quaternion(rScnFrame.m_rotation).transformVector(translate);
-            rScnFrame.m_position += Vector3g(math::mul_2pow<Vector3, int>(rotated, rScnFrame.m_precision));
+            Vector3 const rotated = Quaternion(rScnFrame.m_rotation).transformVector(rFloatOrigin.m_request);
+            rScnFrame.m_position -= Vector3g(math::mul_2pow<Vector3, int>(rotated, rScnFrame.m_precision));
         }
 
         rScnFrame.m_scenePosition = Vector3g(math::mul_2pow<Vector3, int>(rCamCtrl.m_target.value(), rScnFrame.m_precision));
-
     });
 
     rBuilder.task()
@@ -452,39 +660,40 @@ Session setup_testplanets_draw(
         rScnRender.m_color[rPlanetDraw.axis[2]] = {0.0f, 0.0f, 1.0f, 1.0f};
     });
 
+    rBuilder.task()
+        .name       ("Evaluate positions of drawn planets on rails")
+        .run_on     (tgUCore.update(Run))
+        .sync_with  ({tgUCore.satPositions(Modify)})
+        .push_to    (out.m_tasks)
+        .args       ({     idUniverse,               idPlanetMainSpace,           idPlanetRails})
+        .func([] (Universe& rUniverse, CoSpaceId const planetMainSpace, SatRails& rPlanetRails) noexcept
+    {
+        // Every planet is drawn, so all of them need their current positions. Satellites already
+        // evaluated at the current time are skipped.
+        sat_rails_evaluate_all(rUniverse.m_coordCommon[planetMainSpace], rPlanetRails);
+    });
+
     rBuilder.task()
         .name       ("Reposition test planet DrawEnts")
         .run_on     ({tgScnRdr.render(Run)})
-        .sync_with  ({tgScnRdr.drawTransforms(Modify_), tgScnRdr.drawEntResized(Done), tgCmCt.camCtrl(Ready), tgUSFrm.sceneFrame(Modify)})
+        .sync_with  ({tgScnRdr.drawTransforms(Modify_), tgScnRdr.drawEntResized(Done), tgCmCt.camCtrl(Ready), tgUSFrm.sceneFrame(Modify), tgUCore.satPositions(Ready)})
         .push_to    (out.m_tasks)
         .args       ({        idDrawing,                 idScnRender,            idPlanetDraw,          idUniverse,                  idScnFrame,               idPlanetMainSpace})
-        .func([] (ACtxDrawing& rDrawing, ACtxSceneRender& rScnRender, PlanetDraw& rPlanetDraw, Universe& rUniverse, SceneFrame const& rScnFrame, CoSpaceId const planetMainSpace) noexcept
+        .func([] (ACtxDrawing& rDrawing, ACtxSceneRender& rScnRender, PlanetDraw& rPlanetDraw, Universe const& rUniverse, SceneFrame const& rScnFrame, CoSpaceId const planetMainSpace) noexcept
     {
+        CoSpaceCommon const &rMainSpace = rUniverse.m_coordCommon[planetMainSpace];
 
-        CoSpaceCommon &rMainSpace = rUniverse.m_coordCommon[planetMainSpace];
-        auto const [x, y, z]        = sat_views(rMainSpace.m_satPositions, rMainSpace.m_data, rMainSpace.m_satCount);
         auto const [qx, qy, qz, qw] = sat_views(rMainSpace.m_satRotations, rMainSpace.m_data, rMainSpace.m_satCount);
 
-        // Calculate transform from universe to area/local-space for rendering.
-        // This can be generalized by finding a common ancestor within the tree
-        // of coordinate spaces. Since there's only two possibilities, an if
-        // statement works.
-        CoordTransformer mainToArea;
-        if (rScnFrame.m_parent == planetMainSpace)
-        {
-            mainToArea = coord_parent_to_child(rMainSpace, rScnFrame);
-        }
-        else
-        {
-            CoSpaceId const landedId = rScnFrame.m_parent;
-            CoSpaceCommon &rLanded = rUniverse.m_coordCommon[landedId];
-
-            CoSpaceTransform const landedTf     = coord_get_transform(rLanded, rLanded, x, y, z, qx, qy, qz, qw);
-            CoordTransformer const mainToLanded = coord_parent_to_child(rMainSpace, landedTf);
-            CoordTransformer const landedToArea = coord_parent_to_child(landedTf, rScnFrame);
+        // Calculate transform from universe to area/local-space for rendering. The transform from
+        // the main space to the SceneFrame's parent only changes when CoSpaces along the way move,
+        // so it's cached.
+        CoSpaceCommon const    &rScnParent   = rUniverse.m_coordCommon[rScnFrame.m_parent];
+        CoordTransformer const  parentToArea = coord_parent_to_child(rScnParent, rScnFrame);
+        CoordTransformer const  mainToArea   = (rScnFrame.m_parent == planetMainSpace)
+                ? parentToArea
+                : coord_composite(parentToArea, coord_cached_transformer(rPlanetDraw.coordCache, rUniverse, planetMainSpace, rScnFrame.m_parent));
 
-            mainToArea = coord_composite(landedToArea, mainToLanded);
-        }
         Quaternion const mainToAreaRot{mainToArea.rotation()};
 
         float const scale = math::mul_2pow<float, int>(1.0f, -rMainSpace.m_precision);
@@ -510,17 +719,18 @@ Session setup_testplanets_draw(
             * Matrix4{mainToAreaRot.toMatrix()}
             * Matrix4::scaling({10, 10, 500000});
 
+        rPlanetDraw.satScenePos.resize(rMainSpace.m_satCount);
+        SatPosViewsConst_t const pos = sat_views(rMainSpace.m_satPositions, rMainSpace.m_data, rMainSpace.m_satCount);
+        coord_transform_positions_meters(mainToArea, pos, scale, Corrade::Containers::arrayView(rPlanetDraw.satScenePos));
+
         for (std::size_t i = 0; i < rMainSpace.m_satCount; ++i)
         {
-            Vector3g const relative = mainToArea.transform_position({x[i], y[i], z[i]});
-            Vector3 const relativeMeters = Vector3(relative) * scale;
-
             Quaterniond const rot{{qx[i], qy[i], qz[i]}, qw[i]};
 
             DrawEnt const drawEnt = rPlanetDraw.drawEnts[i];
 
             rScnRender.m_drawTransform[drawEnt]
-                = Matrix4::translation(relativeMeters)
+                = Matrix4::translation(rPlanetDraw.satScenePos[i])
                 * Matrix4::scaling({200, 200, 200})
                 * Matrix4{(mainToAreaRot * Quaternion{rot}).toMatrix()};
         }
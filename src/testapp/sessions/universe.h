@@ -56,6 +56,15 @@ osp::Session setup_uni_testplanets(
         osp::Session const&         uniCore,
         osp::Session const&         uniScnFrame);
 
+/**
+ * @brief Barnes-Hut N-body gravity between the test planets
+ */
+osp::Session setup_uni_nbody(
+        osp::TopTaskBuilder&        rBuilder,
+        osp::ArrayView<entt::any>   topData,
+        osp::Session const&         uniCore,
+        osp::Session const&         uniTestPlanets);
+
 
 /**
  * @brief Draw universe, specifically designed for setup_uni_test_planets
@@ -67,6 +76,7 @@ osp::Session setup_testplanets_draw(
         osp::Session const&         sceneRenderer,
         osp::Session const&         cameraCtrl,
         osp::Session const&         commonScene,
+        osp::Session const&         floatingOrigin,
         osp::Session const&         uniCore,
         osp::Session const&         uniScnFrame,
         osp::Session const&         uniTestPlanets,
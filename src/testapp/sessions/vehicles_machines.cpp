@@ -201,7 +201,8 @@ Session setup_thrust_indicators(
             rScnRender.m_color              [drawEnt] = rThrustIndicator.color;
             rScnRender.drawTfObserverEnable [partEnt] = 1;
 
-            SysRender::needs_draw_transforms(rBasic.m_scnGraph, rScnRender.m_needDrawTf, partEnt);
+            // Throttle changes the indicator without moving the part, have the observer called again
+            SysRender::needs_draw_transforms(rBasic.m_scnGraph, rScnRender.m_needDrawTf, rScnRender.m_drawTfGen, partEnt);
         }
     });
 
@@ -0,0 +1,899 @@
+/**
+ * Open Space Program
+ * Copyright © 2019-2024 Open Space Program Project
+ *
+ * MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include <osp/activescene/basic_fn.h>
+#include <osp/activescene/bvh_fn.h>
+#include <osp/activescene/prefab_fn.h>
+#include <osp/core/Resources.h>
+#include <osp/vehicles/ImporterData.h>
+
+#include <Corrade/Containers/ArrayViewStl.h>
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <limits>
+#include <random>
+#include <vector>
+
+using namespace osp;
+using namespace osp::active;
+
+// Test when the floating origin decides to shift, and by how much
+TEST(FloatingOrigin, RebaseThreshold)
+{
+    constexpr float threshold = 512.0f;
+
+    // Within the threshold along every axis, nothing to do
+    EXPECT_TRUE(SysFloatingOrigin::rebase_translation({0.0f, 0.0f, 0.0f},         threshold).isZero());
+    EXPECT_TRUE(SysFloatingOrigin::rebase_translation({511.0f, -511.0f, 100.0f},   threshold).isZero());
+
+    // Whole thresholds back towards the origin, only along axes that went too far
+    EXPECT_EQ(SysFloatingOrigin::rebase_translation({600.0f, 0.0f, 0.0f},          threshold), Vector3(-512.0f, 0.0f, 0.0f));
+    EXPECT_EQ(SysFloatingOrigin::rebase_translation({0.0f, -1100.0f, 30.0f},       threshold), Vector3(0.0f, 1024.0f, 0.0f));
+    EXPECT_EQ(SysFloatingOrigin::rebase_translation({2000.0f, 513.0f, -600.0f},    threshold), Vector3(-1536.0f, -512.0f, 512.0f));
+
+    // Focus ends up within the threshold afterwards
+    Vector3 const focus{5000.0f, -7777.0f, 12345.0f};
+    Vector3 const shifted = focus + SysFloatingOrigin::rebase_translation(focus, threshold);
+    EXPECT_LT(Magnum::Math::abs(shifted).max(), threshold);
+}
+
+// Test that applied translations accumulate until cleared, across multiple scene updates
+TEST(FloatingOrigin, AppliedAccumulates)
+{
+    ACtxFloatingOrigin floatOrigin;
+
+    floatOrigin.m_request = {512.0f, 0.0f, 0.0f};
+    EXPECT_EQ(SysFloatingOrigin::take_request(floatOrigin), Vector3(512.0f, 0.0f, 0.0f));
+    EXPECT_TRUE(floatOrigin.m_request.isZero());
+    EXPECT_EQ(floatOrigin.m_applied, Vector3(512.0f, 0.0f, 0.0f));
+
+    // Second update before anything read m_applied
+    floatOrigin.m_request = {0.0f, -1024.0f, 0.0f};
+    EXPECT_EQ(SysFloatingOrigin::take_request(floatOrigin), Vector3(0.0f, -1024.0f, 0.0f));
+    EXPECT_EQ(floatOrigin.m_applied, Vector3(512.0f, -1024.0f, 0.0f));
+
+    // Update with no request doesn't touch it
+    EXPECT_TRUE(SysFloatingOrigin::take_request(floatOrigin).isZero());
+    EXPECT_EQ(floatOrigin.m_applied, Vector3(512.0f, -1024.0f, 0.0f));
+
+    // Cleared once per frame by whatever follows along
+    floatOrigin.m_applied = {};
+    floatOrigin.m_request = {0.0f, 0.0f, 512.0f};
+    SysFloatingOrigin::take_request(floatOrigin);
+    EXPECT_EQ(floatOrigin.m_applied, Vector3(0.0f, 0.0f, 512.0f));
+}
+
+// Test that only roots of the scene graph are translated
+TEST(FloatingOrigin, TranslateRoots)
+{
+    ACtxBasic basic;
+
+    // rootA(child), rootB, rootC without a transform
+    std::array<ActiveEnt, 4> ents;
+    basic.m_activeIds.create(ents.begin(), ents.end());
+    basic.m_scnGraph.resize(basic.m_activeIds.capacity());
+    auto const [rootA, child, rootB, rootC] = ents;
+
+    {
+        SubtreeBuilder bldScnRoot = SysSceneGraph::add_descendants(basic.m_scnGraph, 4);
+        SubtreeBuilder bldRootA   = bldScnRoot.add_child(rootA, 1);
+        bldRootA.add_child(child);
+        bldScnRoot.add_child(rootB);
+        bldScnRoot.add_child(rootC);
+    }
+
+    basic.m_transform.emplace(rootA, ACompTransform{Matrix4::translation({1.0f, 2.0f, 3.0f})});
+    basic.m_transform.emplace(child, ACompTransform{Matrix4::translation({10.0f, 0.0f, 0.0f})});
+    basic.m_transform.emplace(rootB, ACompTransform{Matrix4::translation({-5.0f, 0.0f, 0.0f})});
+
+    ActiveEntVec_t roots;
+    SysFloatingOrigin::collect_roots(basic.m_scnGraph, roots);
+    ASSERT_EQ(roots, (ActiveEntVec_t{rootA, rootB, rootC}));
+
+    // Split into ranges
+    Vector3 const translate{-512.0f, 0.0f, 1024.0f};
+    SysFloatingOrigin::translate_roots(basic.m_transform, arrayView(roots).prefix(1), translate);
+    SysFloatingOrigin::translate_roots(basic.m_transform, arrayView(roots).exceptPrefix(1), translate);
+
+    EXPECT_EQ(basic.m_transform.get(rootA).m_transform.translation(), Vector3(-511.0f, 2.0f, 1027.0f));
+    EXPECT_EQ(basic.m_transform.get(rootB).m_transform.translation(), Vector3(-517.0f, 0.0f, 1024.0f));
+
+    // Relative to rootA, so it follows along without being touched
+    EXPECT_EQ(basic.m_transform.get(child).m_transform.translation(), Vector3(10.0f, 0.0f, 0.0f));
+    EXPECT_FALSE(basic.m_transform.contains(rootC));
+}
+
+namespace
+{
+
+// Check the structure of the whole tree, and return how many leaves it has
+std::size_t check_bvh(ACtxEntBvh const& bvh)
+{
+    using NodeId = ACtxEntBvh::NodeId;
+
+    if (bvh.m_root == ACtxEntBvh::smc_null)
+    {
+        return 0;
+    }
+    EXPECT_EQ(bvh.m_nodes[bvh.m_root].m_parent, ACtxEntBvh::smc_null);
+
+    std::size_t leaves = 0;
+    std::size_t nodes = 0;
+    std::vector<NodeId> stack{bvh.m_root};
+    while ( ! stack.empty() )
+    {
+        NodeId const node = stack.back();
+        stack.pop_back();
+        ++nodes;
+
+        ACtxEntBvh::Node const &rNode = bvh.m_nodes[node];
+        if (rNode.m_height == 0)
+        {
+            ++leaves;
+            EXPECT_EQ(bvh.m_entToLeaf[rNode.m_ent], node);
+            continue;
+        }
+
+        ACtxEntBvh::Node const &rChildA = bvh.m_nodes[rNode.m_childA];
+        ACtxEntBvh::Node const &rChildB = bvh.m_nodes[rNode.m_childB];
+        EXPECT_EQ(rChildA.m_parent, node);
+        EXPECT_EQ(rChildB.m_parent, node);
+
+        // Heights are exact and balanced like an AVL tree
+        EXPECT_EQ(rNode.m_height, 1 + std::max(rChildA.m_height, rChildB.m_height));
+        EXPECT_LE(std::abs(rChildA.m_height - rChildB.m_height), 1);
+
+        Aabb const fit = SysEntBvh::box_union(rChildA.m_box, rChildB.m_box);
+        EXPECT_EQ(rNode.m_box.m_min, fit.m_min);
+        EXPECT_EQ(rNode.m_box.m_max, fit.m_max);
+
+        stack.push_back(rNode.m_childA);
+        stack.push_back(rNode.m_childB);
+    }
+
+    // No nodes leaked or lost
+    EXPECT_EQ(nodes, 2 * leaves - 1);
+    EXPECT_EQ(nodes + bvh.m_freeNodes.size(), bvh.m_nodes.size());
+    for (NodeId const freeNode : bvh.m_freeNodes)
+    {
+        EXPECT_EQ(bvh.m_nodes[freeNode].m_height, -1);
+    }
+
+    return leaves;
+}
+
+// Slab test for a single box, to check SysEntBvh::query_ray's traversal against
+bool ray_hits(Aabb const& box, Vector3 const origin, Vector3 const direction, float const maxDistance)
+{
+    float enter = 0.0f;
+    float exit  = maxDistance;
+    for (int i = 0; i < 3; ++i)
+    {
+        if (direction[i] == 0.0f)
+        {
+            if (origin[i] < box.m_min[i] || origin[i] > box.m_max[i])
+            {
+                return false;
+            }
+            continue;
+        }
+        float const inv = 1.0f / direction[i];
+        float const a = (box.m_min[i] - origin[i]) * inv;
+        float const b = (box.m_max[i] - origin[i]) * inv;
+        enter   = std::max(enter, std::min(a, b));
+        exit    = std::min(exit,  std::max(a, b));
+    }
+    return enter <= exit;
+}
+
+} // namespace
+
+// Test that inserting picks the sibling that adds the least surface area
+TEST(EntBvh, InsertBySurfaceArea)
+{
+    ACtxEntBvh bvh;
+    bvh.m_margin = 0.0f;
+
+    ActiveEnt const nearA = ActiveEnt::from_index(0);
+    ActiveEnt const far   = ActiveEnt::from_index(1);
+    ActiveEnt const nearB = ActiveEnt::from_index(2);
+
+    EXPECT_TRUE(SysEntBvh::update(bvh, nearA, {{0.0f, 0.0f, 0.0f},      {1.0f, 1.0f, 1.0f}}));
+    EXPECT_TRUE(SysEntBvh::update(bvh, far,   {{100.0f, 0.0f, 0.0f},    {101.0f, 1.0f, 1.0f}}));
+    EXPECT_TRUE(SysEntBvh::update(bvh, nearB, {{2.0f, 0.0f, 0.0f},      {3.0f, 1.0f, 1.0f}}));
+    EXPECT_EQ(check_bvh(bvh), 3u);
+
+    // The two close together end up sharing a parent, instead of nearB pairing with the root
+    auto const parent_of = [&bvh] (ActiveEnt ent) { return bvh.m_nodes[bvh.m_entToLeaf[ent]].m_parent; };
+    EXPECT_EQ(parent_of(nearA), parent_of(nearB));
+    EXPECT_NE(parent_of(nearA), parent_of(far));
+
+    // Moving within the fat box leaves the tree alone
+    bvh.m_margin = 0.5f;
+    EXPECT_TRUE (SysEntBvh::update(bvh, far, {{100.0f, 0.0f, 0.0f}, {101.5f, 1.0f, 1.0f}}));
+    EXPECT_FALSE(SysEntBvh::update(bvh, far, {{100.2f, 0.1f, 0.0f}, {101.7f, 1.1f, 1.0f}}));
+    EXPECT_TRUE (SysEntBvh::update(bvh, far, {{101.0f, 0.0f, 0.0f}, {102.5f, 1.0f, 1.0f}}));
+    EXPECT_EQ(check_bvh(bvh), 3u);
+}
+
+// Test that rays along a face of a box still hit it, when 0 * inf would otherwise give NaN
+TEST(EntBvh, RayParallelToFace)
+{
+    ACtxEntBvh bvh;
+    bvh.m_margin = 0.0f;
+
+    ActiveEnt const ent = ActiveEnt::from_index(0);
+    SysEntBvh::update(bvh, ent, {{0.0f, 0.0f, 0.0f}, {1.0f, 1.0f, 1.0f}});
+
+    constexpr float inf = std::numeric_limits<float>::infinity();
+    auto const hits = [&bvh] (Vector3 origin, Vector3 direction) -> std::vector<float>
+    {
+        std::vector<float> out;
+        SysEntBvh::query_ray(bvh, origin, direction, inf, [&out] (ActiveEnt, float enter)
+        {
+            out.push_back(enter);
+            return inf;
+        });
+        return out;
+    };
+
+    // Origin on the x = 0 and y = 1 planes, moving along z
+    EXPECT_EQ(hits({0.0f, 1.0f, -5.0f}, {0.0f, 0.0f, 1.0f}),   std::vector<float>{5.0f});
+    EXPECT_EQ(hits({1.0f, 0.5f, -5.0f}, {0.0f, 0.0f, 2.0f}),   std::vector<float>{2.5f});
+
+    // Parallel, but outside
+    EXPECT_TRUE(hits({1.5f, 0.5f, -5.0f}, {0.0f, 0.0f, 1.0f}).empty());
+    EXPECT_TRUE(hits({0.5f, -0.1f, -5.0f}, {0.0f, 0.0f, 1.0f}).empty());
+
+    // Pointing away, and starting inside
+    EXPECT_TRUE(hits({0.5f, 0.5f, -5.0f}, {0.0f, 0.0f, -1.0f}).empty());
+    EXPECT_EQ(hits({0.5f, 0.5f, 0.5f}, {0.0f, 1.0f, 0.0f}),   std::vector<float>{0.0f});
+}
+
+// Test random inserts, moves, and removals, comparing queries against checking every entity
+TEST(EntBvh, RandomizedAgainstBruteForce)
+{
+    constexpr int           entCount    = 256;
+    constexpr int           rounds      = 40;
+    constexpr float         inf         = std::numeric_limits<float>::infinity();
+
+    std::mt19937 gen(1337);
+    std::uniform_real_distribution<float> posDist(-100.0f, 100.0f);
+    std::uniform_real_distribution<float> sizeDist(0.1f, 8.0f);
+    std::uniform_real_distribution<float> stepDist(-2.0f, 2.0f);
+    std::uniform_int_distribution<int>    actionDist(0, 9);
+
+    ACtxEntBvh bvh;
+    std::vector<bool> inTree(entCount, false);
+    std::vector<Aabb> boxes(entCount);
+
+    auto const random_box = [&] () -> Aabb
+    {
+        Vector3 const min{posDist(gen), posDist(gen), posDist(gen)};
+        return {min, min + Vector3{sizeDist(gen), sizeDist(gen), sizeDist(gen)}};
+    };
+
+    auto const sorted = [] (std::vector<ActiveEnt> ents)
+    {
+        std::sort(ents.begin(), ents.end());
+        return ents;
+    };
+
+    auto const brute_force = [&] (auto&& pred)
+    {
+        std::vector<ActiveEnt> out;
+        for (int i = 0; i < entCount; ++i)
+        {
+            ActiveEnt const ent = ActiveEnt::from_index(std::size_t(i));
+            if (inTree[i] && pred(SysEntBvh::fat_box(bvh, ent)))
+            {
+                out.push_back(ent);
+            }
+        }
+        return out;
+    };
+
+    for (int round = 0; round < rounds; ++round)
+    {
+        // Mostly small moves that stay within fat boxes, some teleports and removals
+        for (int i = 0; i < entCount; ++i)
+        {
+            ActiveEnt const ent = ActiveEnt::from_index(std::size_t(i));
+            int const action = actionDist(gen);
+
+            if ( ! inTree[i] )
+            {
+                if (action < 5)
+                {
+                    boxes[i] = random_box();
+                    SysEntBvh::update(bvh, ent, boxes[i]);
+                    inTree[i] = true;
+                }
+            }
+            else if (action == 0)
+            {
+                SysEntBvh::remove(bvh, ent);
+                inTree[i] = false;
+            }
+            else if (action == 1)
+            {
+                boxes[i] = random_box();
+                SysEntBvh::update(bvh, ent, boxes[i]);
+            }
+            else
+            {
+                Vector3 const step{stepDist(gen), stepDist(gen), stepDist(gen)};
+                boxes[i] = {boxes[i].m_min + step, boxes[i].m_max + step};
+                SysEntBvh::update(bvh, ent, boxes[i]);
+            }
+
+            EXPECT_EQ(SysEntBvh::contains(bvh, ent), bool(inTree[i]));
+            if (inTree[i])
+            {
+                EXPECT_TRUE(SysEntBvh::box_contains(SysEntBvh::fat_box(bvh, ent), boxes[i]));
+            }
+        }
+
+        std::size_t const expectLeaves = std::size_t(std::count(inTree.begin(), inTree.end(), true));
+        ASSERT_EQ(check_bvh(bvh), expectLeaves);
+
+        // Height stays logarithmic
+        if (expectLeaves > 1)
+        {
+            EXPECT_LE(bvh.m_nodes[bvh.m_root].m_height, int(2.0f * std::log2(float(expectLeaves))) + 1);
+        }
+
+        // Box
+        Aabb const queryBox = random_box();
+        {
+            std::vector<ActiveEnt> found;
+            SysEntBvh::query_box(bvh, queryBox, [&found] (ActiveEnt ent) { found.push_back(ent); });
+            EXPECT_EQ(sorted(found), brute_force([&] (Aabb const& box)
+            {
+                return SysEntBvh::box_overlaps(box, queryBox);
+            }));
+        }
+
+        // Sphere
+        Vector3 const center{posDist(gen), posDist(gen), posDist(gen)};
+        float const radius = sizeDist(gen) * 4.0f;
+        {
+            std::vector<ActiveEnt> found;
+            SysEntBvh::query_sphere(bvh, center, radius, [&found] (ActiveEnt ent) { found.push_back(ent); });
+            EXPECT_EQ(sorted(found), brute_force([&] (Aabb const& box)
+            {
+                Vector3 const closest = Magnum::Math::clamp(center, box.m_min, box.m_max);
+                return (closest - center).dot() <= radius * radius;
+            }));
+        }
+
+        // Ray, with some axis-aligned ones to hit the parallel cases
+        Vector3 const origin{posDist(gen), posDist(gen), posDist(gen)};
+        Vector3 direction{stepDist(gen), stepDist(gen), stepDist(gen)};
+        if (round % 4 == 0)
+        {
+            direction.x() = 0.0f;
+            direction.y() = 0.0f;
+        }
+        float const maxDistance = (round % 2 == 0) ? inf : 50.0f;
+        {
+            std::vector<ActiveEnt> found;
+            SysEntBvh::query_ray(bvh, origin, direction, maxDistance, [&found, maxDistance] (ActiveEnt ent, float)
+            {
+                found.push_back(ent);
+                return maxDistance;
+            });
+            EXPECT_EQ(sorted(found), brute_force([&] (Aabb const& box)
+            {
+                return ray_hits(box, origin, direction, maxDistance);
+            }));
+        }
+
+        // Frustum, no false negatives
+        {
+            Matrix4 const viewProj = Matrix4::perspectiveProjection(Magnum::Deg(60.0f), 1.0f, 1.0f, 80.0f)
+                                   * Matrix4::lookAt(origin, center, Vector3::zAxis()).inverted();
+            math::Frustum const frustum = math::frustum_from_matrix(viewProj);
+
+            std::vector<ActiveEnt> found;
+            SysEntBvh::query_frustum(bvh, frustum, [&found] (ActiveEnt ent) { found.push_back(ent); });
+            found = sorted(found);
+
+            std::vector<ActiveEnt> const expect = brute_force([&] (Aabb const& box)
+            {
+                // Box test against each plane, the same approximation query_frustum uses
+                Vector3 const boxCenter = (box.m_min + box.m_max) * 0.5f;
+                Vector3 const extent    = (box.m_max - box.m_min) * 0.5f;
+                return std::all_of(frustum.m_planes.begin(), frustum.m_planes.end(), [&] (Vector4 const& plane)
+                {
+                    float const dist  = Magnum::Math::dot(plane.xyz(), boxCenter) + plane.w();
+                    float const reach = Magnum::Math::dot(Magnum::Math::abs(plane.xyz()), extent);
+                    return dist + reach >= 0.0f;
+                });
+            });
+            EXPECT_EQ(found, expect);
+        }
+    }
+
+    // Remove everything
+    for (int i = 0; i < entCount; ++i)
+    {
+        SysEntBvh::remove(bvh, ActiveEnt::from_index(std::size_t(i)));
+    }
+    EXPECT_EQ(check_bvh(bvh), 0u);
+    EXPECT_EQ(bvh.m_root, ACtxEntBvh::smc_null);
+    EXPECT_EQ(bvh.m_freeNodes.size(), bvh.m_nodes.size());
+}
+
+// Test reserving subtrees under many parents at once, including parents whose subtrees end at
+// the same place, and multiple requests for the same parent
+TEST(SceneGraph, AddDescendantsBatch)
+{
+    ACtxBasic basic;
+
+    std::array<ActiveEnt, 15> ents;
+    basic.m_activeIds.create(ents.begin(), ents.end());
+    basic.m_scnGraph.resize(basic.m_activeIds.capacity());
+    auto const [A, a1, a11, a2, B, C, c1, x0, x1, y0, z0, z1, w0, v0, u0] = ents;
+
+    ACtxSceneGraph &rScnGraph = basic.m_scnGraph;
+
+    // A(a1(a11), a2), B, C(c1)
+    {
+        SubtreeBuilder bldScnRoot = SysSceneGraph::add_descendants(rScnGraph, 7);
+        SubtreeBuilder bldA       = bldScnRoot.add_child(A, 3);
+        SubtreeBuilder bldA1      = bldA.add_child(a1, 1);
+        bldA1.add_child(a11);
+        bldA.add_child(a2);
+        bldScnRoot.add_child(B);
+        SubtreeBuilder bldC       = bldScnRoot.add_child(C, 1);
+        bldC.add_child(c1);
+    }
+
+    std::array<SubtreeRequest, 6> const requests
+    {{
+        {a1,                            2}, // x0, x1
+        {A,                             1}, // y0
+        {lgrn::id_null<ActiveEnt>(),    2}, // z0(z1)
+        {B,                             1}, // w0
+        {a1,                            1}, // v0, after x0 and x1
+        {c1,                            1}  // u0, c1 C and the tree all end here
+    }};
+
+    std::vector<SubtreeBuilder> builders;
+    SysSceneGraph::add_descendants_batch(rScnGraph, requests, builders);
+    ASSERT_EQ(builders.size(), requests.size());
+    for (std::size_t i = 0; i < requests.size(); ++i)
+    {
+        EXPECT_EQ(builders[i].remaining(), requests[i].descendantCount);
+    }
+
+    builders[0].add_child(x0);
+    builders[0].add_child(x1);
+    builders[1].add_child(y0);
+    {
+        SubtreeBuilder bldZ0 = builders[2].add_child(z0, 1);
+        bldZ0.add_child(z1);
+    }
+    builders[3].add_child(w0);
+    builders[4].add_child(v0);
+    builders[5].add_child(u0);
+    builders.clear();
+
+    std::array<ActiveEnt, 15> const expectOrder{A, a1, a11, x0, x1, v0, a2, y0, B, w0, C, c1, u0, z0, z1};
+    std::array<uint32_t, 15>  const expectDescendants{7, 4, 0, 0, 0, 0, 0, 0, 1, 0, 2, 1, 0, 1, 0};
+
+    ASSERT_EQ(rScnGraph.m_treeToEnt.size(), 16u);
+    EXPECT_EQ(rScnGraph.m_treeDescendants[0], 15u);
+    for (std::size_t i = 0; i < expectOrder.size(); ++i)
+    {
+        TreePos_t const pos = TreePos_t(i + 1);
+        EXPECT_EQ(rScnGraph.m_treeToEnt[pos], expectOrder[i]);
+        EXPECT_EQ(rScnGraph.m_treeDescendants[pos], expectDescendants[i]);
+        EXPECT_EQ(rScnGraph.m_entToTreePos[expectOrder[i]], pos);
+    }
+
+    EXPECT_EQ(rScnGraph.m_entParent[x0], a1);
+    EXPECT_EQ(rScnGraph.m_entParent[v0], a1);
+    EXPECT_EQ(rScnGraph.m_entParent[y0], A);
+    EXPECT_EQ(rScnGraph.m_entParent[w0], B);
+    EXPECT_EQ(rScnGraph.m_entParent[u0], c1);
+    EXPECT_EQ(rScnGraph.m_entParent[z0], lgrn::id_null<ActiveEnt>());
+    EXPECT_EQ(rScnGraph.m_entParent[z1], z0);
+
+    // Children are still found by skipping over subtrees
+    std::vector<ActiveEnt> roots;
+    for (ActiveEnt const root : SysSceneGraph::children(rScnGraph))
+    {
+        roots.push_back(root);
+    }
+    EXPECT_EQ(roots, (std::vector<ActiveEnt>{A, B, C, z0}));
+}
+
+namespace
+{
+
+using TestKey = StrongId<std::uint32_t, struct DummyForTestKey>;
+
+// A(a1, a2), B(b1), C
+struct DefragScene
+{
+    DefragScene()
+    {
+        basic.m_activeIds.create(ents.begin(), ents.end());
+        basic.m_scnGraph.resize(basic.m_activeIds.capacity());
+
+        auto const [A, a1, a2, B, b1, C] = ents;
+        SubtreeBuilder bldScnRoot = SysSceneGraph::add_descendants(basic.m_scnGraph, 6);
+        SubtreeBuilder bldA       = bldScnRoot.add_child(A, 2);
+        bldA.add_child(a1);
+        bldA.add_child(a2);
+        SubtreeBuilder bldB       = bldScnRoot.add_child(B, 1);
+        bldB.add_child(b1);
+        bldScnRoot.add_child(C);
+    }
+
+    ACtxBasic                   basic;
+    std::array<ActiveEnt, 6>    ents;
+};
+
+template<typename FUNC_T>
+void defrag_until_done(FUNC_T&& defragStep)
+{
+    // maxVisit of 2 needs 3 calls to cover 6 tree positions
+    int calls = 0;
+    while ( ! defragStep() )
+    {
+        ++calls;
+        ASSERT_LT(calls, 3);
+    }
+}
+
+} // namespace
+
+TEST(SceneGraph, DefragStorage)
+{
+    DefragScene scene;
+    auto const [A, a1, a2, B, b1, C] = scene.ents;
+    ACtxSceneGraph const &scnGraph = scene.basic.m_scnGraph;
+
+    // Values are the entity's own index, to check they follow their entity around.
+    // B has no component.
+    Storage_t<ActiveEnt, int> storage;
+    for (ActiveEnt const ent : {C, b1, a2, A, a1})
+    {
+        storage.emplace(ent, int(ent.value));
+    }
+
+    TreeOrderDefrag defrag;
+    defrag_until_done([&] { return SysSceneGraph::defrag_storage(scnGraph, storage, defrag, 2); });
+
+    std::array<ActiveEnt, 5> const expectOrder{A, a1, a2, b1, C};
+    ASSERT_EQ(storage.size(), expectOrder.size());
+    for (std::size_t i = 0; i < expectOrder.size(); ++i)
+    {
+        EXPECT_EQ(storage.data()[i], expectOrder[i]);
+        EXPECT_EQ(storage.get(expectOrder[i]), int(expectOrder[i].value));
+    }
+    EXPECT_EQ(defrag.m_cursor, 1u);
+    EXPECT_EQ(defrag.m_packed, 0u);
+}
+
+TEST(SceneGraph, DefragStorageModifiedBetweenCalls)
+{
+    DefragScene scene;
+    auto const [A, a1, a2, B, b1, C] = scene.ents;
+    ACtxSceneGraph const &scnGraph = scene.basic.m_scnGraph;
+
+    Storage_t<ActiveEnt, int> storage;
+    for (ActiveEnt const ent : {C, b1, a2, A, a1})
+    {
+        storage.emplace(ent, int(ent.value));
+    }
+
+    TreeOrderDefrag defrag;
+    EXPECT_FALSE(SysSceneGraph::defrag_storage(scnGraph, storage, defrag, 2));
+
+    // Remove one that was already placed, and add one that wasn't there before
+    storage.erase(A);
+    storage.emplace(B, int(B.value));
+
+    // Finish the interrupted pass, then do a clean one
+    defrag_until_done([&] { return SysSceneGraph::defrag_storage(scnGraph, storage, defrag, 2); });
+    defrag_until_done([&] { return SysSceneGraph::defrag_storage(scnGraph, storage, defrag, 2); });
+
+    std::array<ActiveEnt, 5> const expectOrder{a1, a2, B, b1, C};
+    ASSERT_EQ(storage.size(), expectOrder.size());
+    for (std::size_t i = 0; i < expectOrder.size(); ++i)
+    {
+        EXPECT_EQ(storage.data()[i], expectOrder[i]);
+        EXPECT_EQ(storage.get(expectOrder[i]), int(expectOrder[i].value));
+    }
+}
+
+TEST(SceneGraph, DefragKeyedStorage)
+{
+    DefragScene scene;
+    auto const [A, a1, a2, B, b1, C] = scene.ents;
+    ACtxSceneGraph const &scnGraph = scene.basic.m_scnGraph;
+
+    // Keys are assigned in a different order than the tree. a2 has no key, and key 5 has no
+    // ActiveEnt at all.
+    KeyedVec<ActiveEnt, TestKey> activeToKey;
+    activeToKey.resize(scene.basic.m_activeIds.capacity(), lgrn::id_null<TestKey>());
+    activeToKey[C]  = TestKey{0};
+    activeToKey[b1] = TestKey{1};
+    activeToKey[B]  = TestKey{2};
+    activeToKey[a1] = TestKey{3};
+    activeToKey[A]  = TestKey{4};
+
+    Storage_t<TestKey, int> storage;
+    for (std::uint32_t key : {5u, 0u, 1u, 2u, 3u, 4u})
+    {
+        storage.emplace(TestKey{key}, int(key));
+    }
+
+    TreeOrderDefrag defrag;
+    defrag_until_done([&] { return SysSceneGraph::defrag_storage(scnGraph, activeToKey, storage, defrag, 2); });
+
+    std::array<TestKey, 6> const expectOrder{TestKey{4}, TestKey{3}, TestKey{2}, TestKey{1}, TestKey{0}, TestKey{5}};
+    ASSERT_EQ(storage.size(), expectOrder.size());
+    for (std::size_t i = 0; i < expectOrder.size(); ++i)
+    {
+        EXPECT_EQ(storage.data()[i], expectOrder[i]);
+        EXPECT_EQ(storage.get(expectOrder[i]), int(expectOrder[i].value));
+    }
+}
+
+namespace
+{
+
+// Transforms for DefragScene. B is left without one, so b1 is relative to the scene's origin.
+void set_trs_scene(ACtxTransformTRS& rTRS, DefragScene const& scene)
+{
+    using namespace Magnum::Math::Literals;
+    auto const [A, a1, a2, B, b1, C] = scene.ents;
+
+    rTRS.resize(scene.basic.m_activeIds.capacity());
+    SysTransformTRS::set(rTRS, A,  {10.0f, 0.0f, 0.0f}, Quaternion::rotation(90.0_degf, Vector3::zAxis()));
+    SysTransformTRS::set(rTRS, a1, {1.0f, 0.0f, 0.0f},  {});
+    SysTransformTRS::set(rTRS, a2, {0.0f, 1.0f, 0.0f},  {}, Vector3{2.0f});
+    SysTransformTRS::set(rTRS, b1, {0.0f, 0.0f, 5.0f},  {});
+    SysTransformTRS::set(rTRS, C,  {3.0f, 3.0f, 3.0f},  {});
+}
+
+ActiveEntVec_t update_trs_range(ACtxTransformTRS& rTRS, ACtxSceneGraph const& scnGraph, TreePos_t first, TreePos_t last)
+{
+    ActiveEntVec_t updated;
+    SysTransformTRS::update_world_range(rTRS, scnGraph, first, last, updated);
+    return updated;
+}
+
+} // namespace
+
+TEST(TransformTRS, WorldMatrix)
+{
+    using namespace Magnum::Math::Literals;
+
+    DefragScene scene;
+    auto const [A, a1, a2, B, b1, C] = scene.ents;
+    ACtxSceneGraph const &scnGraph = scene.basic.m_scnGraph;
+
+    ACtxTransformTRS trs;
+    set_trs_scene(trs, scene);
+
+    Matrix4 const aWorld = Matrix4::translation({10.0f, 0.0f, 0.0f}) * Matrix4::rotationZ(90.0_degf);
+
+    EXPECT_EQ(SysTransformTRS::world_matrix(trs, scnGraph, a2), aWorld * Matrix4::translation({0.0f, 1.0f, 0.0f}) * Matrix4::scaling(Vector3{2.0f}));
+    EXPECT_EQ(SysTransformTRS::world_matrix(trs, scnGraph, a1).translation(), Vector3(10.0f, 1.0f, 0.0f));
+    EXPECT_EQ(SysTransformTRS::world_matrix(trs, scnGraph, b1), Matrix4::translation({0.0f, 0.0f, 5.0f}));
+    EXPECT_EQ(SysTransformTRS::world_matrix(trs, scnGraph, B), Matrix4{});
+
+    // Descendants follow a parent that was set after they were last read
+    SysTransformTRS::set(trs, A, {0.0f, 0.0f, 0.0f}, {});
+    EXPECT_EQ(SysTransformTRS::world_matrix(trs, scnGraph, a1), Matrix4::translation({1.0f, 0.0f, 0.0f}));
+}
+
+// Test that ranges only recalculate stale world matrices, and only within the range
+TEST(TransformTRS, UpdateRangeOnlyStale)
+{
+    DefragScene scene;
+    auto const [A, a1, a2, B, b1, C] = scene.ents;
+    ACtxSceneGraph const &scnGraph = scene.basic.m_scnGraph;
+
+    // Tree positions: A:1, a1:2, a2:3, B:4, b1:5, C:6
+    ACtxTransformTRS trs;
+    set_trs_scene(trs, scene);
+
+    EXPECT_EQ(update_trs_range(trs, scnGraph, 1, 4), (ActiveEntVec_t{A, a1, a2}));
+    EXPECT_EQ(update_trs_range(trs, scnGraph, 4, 7), (ActiveEntVec_t{b1, C}));
+    EXPECT_EQ(update_trs_range(trs, scnGraph, 1, 7), ActiveEntVec_t{});
+
+    // Setting A leaves B and C's range alone
+    SysTransformTRS::set(trs, A, {20.0f, 0.0f, 0.0f}, {});
+    EXPECT_EQ(update_trs_range(trs, scnGraph, 4, 7), ActiveEntVec_t{});
+    EXPECT_EQ(update_trs_range(trs, scnGraph, 1, 4), (ActiveEntVec_t{A, a1, a2}));
+    EXPECT_EQ(trs.m_world[a1], Matrix4::translation({21.0f, 0.0f, 0.0f}));
+
+    // Leaves don't affect their siblings
+    SysTransformTRS::set(trs, a2, {0.0f, 2.0f, 0.0f}, {});
+    EXPECT_EQ(update_trs_range(trs, scnGraph, 1, 7), (ActiveEntVec_t{a2}));
+
+    // Matrices already brought up to date by world_matrix aren't recalculated again
+    SysTransformTRS::set(trs, A, {30.0f, 0.0f, 0.0f}, {});
+    SysTransformTRS::set(trs, a2, {0.0f, 3.0f, 0.0f}, {});
+    EXPECT_EQ(SysTransformTRS::world_matrix(trs, scnGraph, a1), Matrix4::translation({31.0f, 0.0f, 0.0f}));
+    EXPECT_EQ(update_trs_range(trs, scnGraph, 1, 7), (ActiveEntVec_t{a2}));
+    EXPECT_EQ(trs.m_world[a2], Matrix4::translation({30.0f, 3.0f, 0.0f}));
+
+    // Children of a removed transform become relative to the next ancestor with one
+    SysTransformTRS::remove(trs, A);
+    EXPECT_EQ(update_trs_range(trs, scnGraph, 1, 7), (ActiveEntVec_t{a1, a2}));
+    EXPECT_EQ(trs.m_world[a1], Matrix4::translation({1.0f, 0.0f, 0.0f}));
+}
+
+TEST(TransformTRS, SetMatrix)
+{
+    using namespace Magnum::Math::Literals;
+
+    ACtxTransformTRS trs;
+    trs.resize(1);
+    ActiveEnt const ent = ActiveEnt::from_index(0);
+
+    Matrix4 const matrix = Matrix4::translation({1.0f, 2.0f, 3.0f})
+                         * Matrix4::rotation(30.0_degf, Vector3{1.0f, 1.0f, 0.0f}.normalized())
+                         * Matrix4::scaling({1.0f, 2.0f, 3.0f});
+
+    SysTransformTRS::set_matrix(trs, ent, matrix);
+    EXPECT_EQ(SysTransformTRS::local_matrix(trs, ent), matrix);
+}
+
+// Test that spawning through a compiled template gives the same result as reading each object
+// from the importer directly
+TEST(PrefabTemplate, MatchesPerObjectSpawn)
+{
+    using restypes::gc_importer;
+
+    Resources resources;
+    resources.resize_types(ResTypeIdReg_t::size());
+    resources.data_register<ImporterData>(gc_importer);
+    resources.data_register<Prefabs>(gc_importer);
+    PkgId const pkg = resources.pkg_create();
+
+    ResId const importer = resources.create(gc_importer, pkg, SharedString::create_reference("Importer"));
+
+    // Objects: 0(1(2), 3), 4. The prefab is 0 and its descendants. 4 isn't part of it.
+    auto &rImportData = resources.data_add<ImporterData>(gc_importer, importer);
+    rImportData.m_objDescendants    = {3, 1, 0, 0, 0};
+    rImportData.m_objMeshes         = {-1, -1, -1, -1, -1};
+    rImportData.m_objMaterials      = {-1, -1, -1, -1, -1};
+    for (int i = 0; i < 5; ++i)
+    {
+        rImportData.m_objTransforms.push_back(Matrix4::translation({float(i), 0.0f, 0.0f})
+                                            * Matrix4::scaling(Vector3{1.0f + float(i)}));
+    }
+
+    auto &rPrefabData = resources.data_add<Prefabs>(gc_importer, importer);
+    rPrefabData.m_objMass   = {0.0f, 2.0f, 0.0f, 0.0f, 5.0f};
+    rPrefabData.m_objShape  = {EShape::None, EShape::None, EShape::Box, EShape::None, EShape::Sphere};
+
+    std::array<ObjId, 4>    const prefabObjs    {0, 1, 2, 3};
+    std::array<int32_t, 4>  const prefabParents {-1, 0, 1, 0};
+    rPrefabData.m_prefabs       .data_reserve(prefabObjs.size());
+    rPrefabData.m_prefabs       .ids_reserve(1);
+    rPrefabData.m_prefabParents .data_reserve(prefabParents.size());
+    rPrefabData.m_prefabParents .ids_reserve(1);
+    rPrefabData.m_prefabs       .emplace(0, prefabObjs.begin(),    prefabObjs.end());
+    rPrefabData.m_prefabParents .emplace(0, prefabParents.begin(), prefabParents.end());
+
+    // Spawn the same prefab twice, sharing one template
+    std::array<Matrix4, 2> const rootTf{Matrix4::translation({0.0f, 10.0f, 0.0f}),
+                                        Matrix4::translation({0.0f, 20.0f, 0.0f})};
+    ACtxBasic   basic;
+    ACtxPhysics phys;
+    ACtxPrefabs prefabs;
+    prefabs.spawnRequest.push_back({importer, 0, &rootTf[0]});
+    prefabs.spawnRequest.push_back({importer, 0, &rootTf[1]});
+
+    SysPrefabInit::create_activeents(prefabs, basic, resources);
+    ASSERT_EQ(prefabs.templates.size(), 1u);
+
+    std::size_t const capacity = basic.m_activeIds.capacity();
+    basic.m_scnGraph.resize(capacity);
+    prefabs.instanceInfo.resize(capacity);
+    prefabs.roots.resize(capacity);
+    phys.m_shape.resize(capacity);
+    phys.m_hasColliders.resize(capacity);
+
+    {
+        SubtreeBuilder bldScnRoot = SysSceneGraph::add_descendants(basic.m_scnGraph, uint32_t(prefabs.newEnts.size()));
+        for (std::size_t i = 0; i < prefabs.spawnRequest.size(); ++i)
+        {
+            SysPrefabInit::add_to_subtree(prefabs.templates[prefabs.spawnTemplate[i]], prefabs.spawnedEntsOffset[i], bldScnRoot);
+        }
+    }
+    SysPrefabInit::init_transforms(prefabs, basic.m_transform);
+    SysPrefabInit::init_info(prefabs);
+    SysPrefabInit::init_physics(prefabs, phys);
+
+    for (std::size_t i = 0; i < prefabs.spawnRequest.size(); ++i)
+    {
+        auto const ents = prefabs.spawnedEntsOffset[i];
+        ASSERT_EQ(ents.size(), prefabObjs.size());
+
+        EXPECT_TRUE(prefabs.roots.contains(ents[0]));
+
+        for (std::size_t j = 0; j < ents.size(); ++j)
+        {
+            ActiveEnt const ent = ents[j];
+            ObjId const     obj = prefabObjs[j];
+
+            Matrix4 const expectTf = (prefabParents[j] == -1) ? rootTf[i] : rImportData.m_objTransforms[obj];
+            EXPECT_EQ(basic.m_transform.get(ent).m_transform, expectTf);
+
+            ActiveEnt const expectParent = (prefabParents[j] == -1) ? lgrn::id_null<ActiveEnt>() : ents[prefabParents[j]];
+            TreePos_t const pos = basic.m_scnGraph.m_entToTreePos[ent];
+            EXPECT_EQ(basic.m_scnGraph.m_entParent[ent], expectParent);
+            EXPECT_EQ(basic.m_scnGraph.m_treeDescendants[pos], rImportData.m_objDescendants[obj]);
+
+            EXPECT_EQ(prefabs.instanceInfo[ent].importer,   importer);
+            EXPECT_EQ(prefabs.instanceInfo[ent].prefab,     0u);
+            EXPECT_EQ(prefabs.instanceInfo[ent].obj,        ObjId(j));
+
+            EXPECT_EQ(phys.m_shape[ent], rPrefabData.m_objShape[obj]);
+
+            float const mass = rPrefabData.m_objMass[obj];
+            ASSERT_EQ(phys.m_mass.contains(ent), mass != 0.0f);
+            if (mass != 0.0f)
+            {
+                ACompMass const &rMass = phys.m_mass.get(ent);
+                Vector3 const scale = rImportData.m_objTransforms[obj].scaling();
+                EXPECT_EQ(rMass.m_mass,     mass);
+                EXPECT_EQ(rMass.m_inertia,  collider_inertia_tensor(rPrefabData.m_objShape[obj], scale, mass));
+            }
+
+            // Has a collider if itself or any descendant has mass or a shape
+            bool expectCollider = false;
+            for (std::size_t k = 0; k < prefabObjs.size(); ++k)
+            {
+                ObjId const other = prefabObjs[k];
+                bool const isCollider = rPrefabData.m_objMass[other] != 0.0f || rPrefabData.m_objShape[other] != EShape::None;
+                for (int32_t up = int32_t(k); isCollider && up != -1; up = prefabParents[up])
+                {
+                    expectCollider |= (std::size_t(up) == j);
+                }
+            }
+            EXPECT_EQ(phys.m_hasColliders.contains(ent), expectCollider);
+        }
+    }
+
+    // Templates own their importer until cleared
+    SysPrefabInit::clear_templates(prefabs, resources);
+    EXPECT_TRUE(prefabs.templates.empty());
+    EXPECT_TRUE(prefabs.templateImporters.empty());
+}
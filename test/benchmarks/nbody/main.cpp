@@ -0,0 +1,170 @@
+/**
+ * Open Space Program
+ * Copyright © 2019-2024 Open Space Program Project
+ *
+ * MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include <osp/universe/universe.h>
+#include <osp/universe/nbody.h>
+#include <osp/core/math_2pow.h>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+using namespace osp;
+using namespace osp::universe;
+
+using osp::math::mul_2pow;
+
+using Clock = std::chrono::steady_clock;
+
+/**
+ * @brief Compare speed and accuracy of Barnes-Hut N-body gravity against a direct sum
+ *
+ * Usage: benchmark_nbody [max body count]
+ *
+ * Bodies are spread over a 100km cube, clustered in a few places like in the unit test.
+ * Body counts double from 1000 up to the maximum, 16000 by default.
+ */
+int main(int argc, char** argv)
+{
+    constexpr int           precision   = 10;
+    constexpr double        deltaTime   = 1.0;
+    constexpr int           repeats     = 3;
+
+    std::size_t const maxCount = (argc > 1) ? std::size_t(std::strtoull(argv[1], nullptr, 10)) : 16000;
+    double const metersPerUnit = mul_2pow<double, spaceint_t>(1.0, -precision);
+
+    std::printf("%10s %8s %14s %14s %14s %12s %12s\n",
+                "bodies", "theta", "direct (us)", "build (us)", "accel (us)", "mean error", "max error");
+
+    for (std::size_t satCount = 1000; satCount <= maxCount; satCount *= 2)
+    {
+        CoSpaceSatData data;
+        std::size_t bytesUsed = 0;
+        partition(bytesUsed, satCount, data.m_satPositions[0]);
+        partition(bytesUsed, satCount, data.m_satPositions[1]);
+        partition(bytesUsed, satCount, data.m_satPositions[2]);
+        partition(bytesUsed, satCount, data.m_satVelocities[0]);
+        partition(bytesUsed, satCount, data.m_satVelocities[1]);
+        partition(bytesUsed, satCount, data.m_satVelocities[2]);
+        partition(bytesUsed, satCount, data.m_satMasses);
+        data.m_data         = sat_data_alloc(bytesUsed);
+        data.m_satCapacity  = uint32_t(satCount);
+
+        SatPosViews_t const pos  = sat_views(data.m_satPositions,  data.m_data, satCount);
+        SatVelViews_t const vel  = sat_views(data.m_satVelocities, data.m_data, satCount);
+        SatMassView_t const mass = data.m_satMasses.view(Corrade::Containers::arrayView(data.m_data), satCount);
+
+        std::mt19937 gen(42);
+        std::uniform_real_distribution<double> massDist(1.0e12, 1.0e15);
+        std::normal_distribution<double> clusterDist(0.0, 5000.0);
+        std::uniform_real_distribution<double> centerDist(-50000.0, 50000.0);
+
+        std::array<Vector3d, 4> centers;
+        for (Vector3d &rCenter : centers)
+        {
+            rCenter = {centerDist(gen), centerDist(gen), centerDist(gen)};
+        }
+
+        for (std::size_t i = 0; i < satCount; ++i)
+        {
+            Vector3d const &center = centers[i % centers.size()];
+            for (int dim = 0; dim < 3; ++dim)
+            {
+                pos[dim][i] = spaceint_t(mul_2pow<double, spaceint_t>(center[dim] + clusterDist(gen), precision));
+            }
+            mass[i] = massDist(gen);
+        }
+
+        auto const clear_vel = [&vel, satCount] ()
+        {
+            for (std::size_t i = 0; i < satCount; ++i)
+            {
+                vel[0][i] = vel[1][i] = vel[2][i] = 0.0;
+            }
+        };
+
+        NBodyParams params;
+
+        // Direct sum, kept as the reference
+        clear_vel();
+        auto const directStart = Clock::now();
+        nbody_accelerate_direct(pos, mass, vel, 0, satCount, metersPerUnit, params, deltaTime);
+        auto const directTime = Clock::now() - directStart;
+
+        std::vector<Vector3d> expectAccel(satCount);
+        for (std::size_t i = 0; i < satCount; ++i)
+        {
+            expectAccel[i] = {vel[0][i], vel[1][i], vel[2][i]};
+        }
+
+        for (double const theta : {0.3, 0.5, 0.8})
+        {
+            params.m_theta = theta;
+
+            NBodyOctree tree;
+            Clock::duration buildTime = Clock::duration::max();
+            Clock::duration accelTime = Clock::duration::max();
+
+            // Best of a few runs, the first one also allocates the tree
+            for (int run = 0; run < repeats; ++run)
+            {
+                clear_vel();
+
+                auto const buildStart = Clock::now();
+                nbody_build(tree, pos, mass, metersPerUnit, params);
+                auto const accelStart = Clock::now();
+                nbody_accelerate(tree, pos, mass, vel, 0, satCount, params, deltaTime);
+                auto const accelEnd = Clock::now();
+
+                buildTime = std::min(buildTime, accelStart - buildStart);
+                accelTime = std::min(accelTime, accelEnd - accelStart);
+            }
+
+            double maxRelError = 0.0;
+            double sumRelError = 0.0;
+            for (std::size_t i = 0; i < satCount; ++i)
+            {
+                Vector3d const accel{vel[0][i], vel[1][i], vel[2][i]};
+                double const relError = (accel - expectAccel[i]).length() / expectAccel[i].length();
+                maxRelError = std::max(maxRelError, relError);
+                sumRelError += relError;
+            }
+
+            using std::chrono::duration_cast;
+            using std::chrono::microseconds;
+            std::printf("%10zu %8.2f %14lld %14lld %14lld %12.2e %12.2e\n",
+                        satCount, theta,
+                        (long long)duration_cast<microseconds>(directTime).count(),
+                        (long long)duration_cast<microseconds>(buildTime).count(),
+                        (long long)duration_cast<microseconds>(accelTime).count(),
+                        sumRelError / double(satCount), maxRelError);
+        }
+    }
+
+    return 0;
+}
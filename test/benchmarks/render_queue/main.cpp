@@ -0,0 +1,133 @@
+/**
+ * Open Space Program
+ * Copyright © 2019-2024 Open Space Program Project
+ *
+ * MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include <osp/drawing/render_queue.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+using namespace osp;
+using namespace osp::draw;
+
+using Clock = std::chrono::steady_clock;
+
+namespace
+{
+
+void draw_dummy_a(DrawEnt, ViewProjMatrix const&, EntityToDraw::UserData_t) noexcept { }
+void draw_dummy_b(DrawEnt, ViewProjMatrix const&, EntityToDraw::UserData_t) noexcept { }
+
+} // namespace
+
+/**
+ * @brief Time building, sorting, and preparing packets for render queues of increasing size
+ *
+ * Usage: benchmark_render_queue [max DrawEnt count]
+ *
+ * DrawEnts are spread over a 2km cube, using 2 draw functions and 2 materials in a random order,
+ * same as the RenderQueue unit test. Counts go up by 10x from 1000 up to the maximum, 1000000 by
+ * default.
+ */
+int main(int argc, char** argv)
+{
+    constexpr int repeats = 5;
+
+    std::size_t const maxCount = (argc > 1) ? std::size_t(std::strtoull(argv[1], nullptr, 10)) : 1000000;
+
+    std::printf("%10s %14s %14s %14s\n", "drawents", "build (us)", "sort (us)", "packets (us)");
+
+    for (std::size_t count = 1000; count <= maxCount; count *= 10)
+    {
+        std::mt19937 gen(5678);
+        std::uniform_real_distribution<float> posDist(-1000.0f, 1000.0f);
+
+        ACtxSceneRender scnRender;
+        std::vector<DrawEnt> ents(count);
+        scnRender.m_drawIds.create(ents.begin(), ents.end());
+        scnRender.resize_draw();
+
+        int dataA = 0;
+        int dataB = 0;
+
+        RenderGroup group;
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            DrawEnt const drawEnt = ents[i];
+            scnRender.m_drawTransform[drawEnt] = Matrix4::translation({posDist(gen), posDist(gen), posDist(gen)});
+            scnRender.m_onScreen.insert(drawEnt);
+
+            switch (gen() % 4)
+            {
+            case 0: group.entities.emplace(drawEnt, EntityToDraw{&draw_dummy_a, {&dataA}}); break;
+            case 1: group.entities.emplace(drawEnt, EntityToDraw{&draw_dummy_a, {&dataB}}); break;
+            case 2: group.entities.emplace(drawEnt, EntityToDraw{&draw_dummy_b, {&dataA}}); break;
+            case 3: group.entities.emplace(drawEnt, EntityToDraw{&draw_dummy_b, {&dataB}}); break;
+            }
+        }
+
+        Matrix4 const           view = Matrix4::translation({0.0f, 0.0f, -2000.0f});
+        ViewProjMatrix const    viewProj{view, Matrix4::perspectiveProjection(Deg(45.0f), 1.0f, 1.0f, 10000.0f)};
+
+        RenderQueue queue;
+        Clock::duration buildTime   = Clock::duration::max();
+        Clock::duration sortTime    = Clock::duration::max();
+        Clock::duration packetTime  = Clock::duration::max();
+
+        // Best of a few runs, the first one also allocates the queue
+        for (int run = 0; run < repeats; ++run)
+        {
+            auto const buildStart = Clock::now();
+            SysRenderQueue::build(queue, {
+                    .group      = group,
+                    .visible    = scnRender.m_onScreen,
+                    .scnRender  = scnRender,
+                    .view       = view,
+                    .farPlane   = 10000.0f,
+                    .pass       = 0 });
+            auto const sortStart = Clock::now();
+            SysRenderQueue::sort(queue);
+            auto const packetStart = Clock::now();
+            SysRenderQueue::prepare_packets(queue, scnRender, viewProj, 0, count);
+            auto const packetEnd = Clock::now();
+
+            buildTime   = std::min(buildTime,   sortStart - buildStart);
+            sortTime    = std::min(sortTime,    packetStart - sortStart);
+            packetTime  = std::min(packetTime,  packetEnd - packetStart);
+        }
+
+        using std::chrono::duration_cast;
+        using std::chrono::microseconds;
+        std::printf("%10zu %14lld %14lld %14lld\n",
+                    count,
+                    (long long)duration_cast<microseconds>(buildTime).count(),
+                    (long long)duration_cast<microseconds>(sortTime).count(),
+                    (long long)duration_cast<microseconds>(packetTime).count());
+    }
+
+    return 0;
+}
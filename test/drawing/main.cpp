@@ -0,0 +1,656 @@
+/**
+ * Open Space Program
+ * Copyright © 2019-2024 Open Space Program Project
+ *
+ * MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include <osp/core/Resources.h>
+#include <osp/drawing/drawing_fn.h>
+#include <osp/drawing/own_restypes.h>
+#include <osp/vehicles/ImporterData.h>
+#include <osp/vehicles/mesh_lods.h>
+
+#include <Magnum/Trade/MeshData.h>
+
+#include <Corrade/Containers/ArrayViewStl.h>
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <array>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+using namespace osp;
+using namespace osp::active;
+using namespace osp::draw;
+
+namespace
+{
+
+// Straightforward recursive version to compare against
+void draw_transforms_recurse(
+        ACtxBasic const&                    basic,
+        ActiveEnt                           ent,
+        Matrix4 const&                      parentTf,
+        int                                 depth,
+        KeyedVec<ActiveEnt, Matrix4>&       rOutTf,
+        KeyedVec<ActiveEnt, int>&           rOutDepth)
+{
+    Matrix4 const tf = parentTf * basic.m_transform.get(ent).m_transform;
+    rOutTf[ent]    = tf;
+    rOutDepth[ent] = depth;
+
+    for (ActiveEnt const child : SysSceneGraph::children(basic.m_scnGraph, ent))
+    {
+        draw_transforms_recurse(basic, child, tf, depth + 1, rOutTf, rOutDepth);
+    }
+}
+
+} // namespace
+
+// Test that per-root and ranged draw transform updates both match a recursive traversal, and
+// only write to entities that need draw transforms
+TEST(DrawTransforms, RangeMatchesPerRoot)
+{
+    ACtxBasic basic;
+
+    // rootA(a1(a11, a12), a2), rootB, rootC(c1(c11))
+    std::array<ActiveEnt, 9> ents;
+    basic.m_activeIds.create(ents.begin(), ents.end());
+    basic.m_scnGraph.resize(basic.m_activeIds.capacity());
+    auto const [rootA, a1, a11, a12, a2, rootB, rootC, c1, c11] = ents;
+
+    {
+        SubtreeBuilder bldScnRoot = SysSceneGraph::add_descendants(basic.m_scnGraph, 9);
+        SubtreeBuilder bldRootA   = bldScnRoot.add_child(rootA, 4);
+        SubtreeBuilder bldA1      = bldRootA.add_child(a1, 2);
+        bldA1.add_child(a11);
+        bldA1.add_child(a12);
+        bldRootA.add_child(a2);
+        bldScnRoot.add_child(rootB);
+        SubtreeBuilder bldRootC   = bldScnRoot.add_child(rootC, 2);
+        SubtreeBuilder bldC1      = bldRootC.add_child(c1, 1);
+        bldC1.add_child(c11);
+    }
+
+    for (std::size_t i = 0; i < ents.size(); ++i)
+    {
+        float const f = float(i + 1);
+        basic.m_transform.emplace(ents[i], ACompTransform{
+                Matrix4::translation({f, -2.0f * f, 0.5f * f})
+              * Matrix4::rotationY(Magnum::Deg(10.0f * f))
+              * Matrix4::scaling(Vector3{1.0f + 0.1f * f})});
+    }
+
+    // Every ActiveEnt gets a DrawEnt, but only some of them need draw transforms
+    std::size_t const capacity = basic.m_activeIds.capacity();
+    KeyedVec<ActiveEnt, DrawEnt> activeToDraw;
+    activeToDraw.resize(capacity, lgrn::id_null<DrawEnt>());
+    for (std::size_t i = 0; i < ents.size(); ++i)
+    {
+        activeToDraw[ents[i]] = DrawEnt(std::uint32_t(i));
+    }
+
+    ActiveEntSet_t needDrawTf;
+    needDrawTf.resize(capacity);
+    TransformGenerations drawTfGen;
+    drawTfGen.resize(capacity, gc_transformGenUnseen);
+    for (ActiveEnt const ent : {a11, a2, rootC})
+    {
+        SysRender::needs_draw_transforms(basic.m_scnGraph, needDrawTf, drawTfGen, ent);
+    }
+
+    KeyedVec<ActiveEnt, Matrix4> expected;
+    KeyedVec<ActiveEnt, int> expectedDepth;
+    expected.resize(capacity);
+    expectedDepth.resize(capacity);
+    for (ActiveEnt const root : SysSceneGraph::children(basic.m_scnGraph))
+    {
+        draw_transforms_recurse(basic, root, Matrix4{}, 1, expected, expectedDepth);
+    }
+
+    auto const check = [&] (DrawTransforms_t const& drawTf, std::array<int, 9> const& depths)
+    {
+        for (std::size_t i = 0; i < ents.size(); ++i)
+        {
+            ActiveEnt const ent = ents[i];
+            DrawEnt const drawEnt = activeToDraw[ent];
+            if (needDrawTf.contains(ent))
+            {
+                EXPECT_EQ(drawTf[drawEnt], expected[ent]);
+                EXPECT_EQ(depths[i], expectedDepth[ent]);
+            }
+            else
+            {
+                EXPECT_EQ(drawTf[drawEnt], Matrix4{Magnum::Math::ZeroInit});
+                EXPECT_EQ(depths[i], 0);
+            }
+        }
+    };
+
+    auto const make_record = [&ents] (std::array<int, 9>& rDepths)
+    {
+        return [&ents, &rDepths] (Matrix4 const& /* tf */, ActiveEnt ent, int depth)
+        {
+            auto const found = std::find(ents.begin(), ents.end(), ent);
+            ASSERT_NE(found, ents.end());
+            rDepths[std::size_t(found - ents.begin())] = depth;
+        };
+    };
+
+    // Per root
+    {
+        DrawTransforms_t drawTf;
+        drawTf.resize(ents.size(), Matrix4{Magnum::Math::ZeroInit});
+        std::array<int, 9> depths{};
+
+        // Nothing was seen yet, so everything is calculated
+        TransformGenerations gen = drawTfGen;
+
+        std::array<ActiveEnt, 3> const roots{rootA, rootB, rootC};
+        SysRender::update_draw_transforms(
+                {basic.m_scnGraph, basic.m_transform, basic.m_transformGen, activeToDraw, needDrawTf, gen, drawTf},
+                roots.begin(), roots.end(), make_record(depths));
+
+        check(drawTf, depths);
+    }
+
+    // Whole tree at once, then split into two chunks of whole root subtrees sharing a stack
+    TreePos_t const treeLast = TreePos_t(basic.m_scnGraph.m_treeToEnt.size());
+    for (TreePos_t const split : {treeLast, basic.m_scnGraph.m_entToTreePos[rootB]})
+    {
+        DrawTransforms_t drawTf;
+        drawTf.resize(ents.size(), Matrix4{Magnum::Math::ZeroInit});
+        std::array<int, 9> depths{};
+        SysRender::DrawTfStack_t stack;
+        TransformGenerations gen = drawTfGen;
+
+        SysRender::ArgsForUpdDrawTransform const args
+                {basic.m_scnGraph, basic.m_transform, basic.m_transformGen, activeToDraw, needDrawTf, gen, drawTf};
+        SysRender::update_draw_transforms_range(args, stack, 1, split, make_record(depths));
+        SysRender::update_draw_transforms_range(args, stack, split, treeLast, make_record(depths));
+
+        EXPECT_TRUE(stack.empty());
+        check(drawTf, depths);
+    }
+}
+
+// Test that only draw transforms of entities with changed transforms, or changed ancestors, are
+// calculated again
+TEST(DrawTransforms, SkipUnchanged)
+{
+    ACtxBasic basic;
+
+    // rootA(a1(a11), a2), rootB(b1)
+    std::array<ActiveEnt, 6> ents;
+    basic.m_activeIds.create(ents.begin(), ents.end());
+    basic.m_scnGraph.resize(basic.m_activeIds.capacity());
+    auto const [rootA, a1, a11, a2, rootB, b1] = ents;
+
+    {
+        SubtreeBuilder bldScnRoot = SysSceneGraph::add_descendants(basic.m_scnGraph, 6);
+        SubtreeBuilder bldRootA   = bldScnRoot.add_child(rootA, 3);
+        SubtreeBuilder bldA1      = bldRootA.add_child(a1, 1);
+        bldA1.add_child(a11);
+        bldRootA.add_child(a2);
+        SubtreeBuilder bldRootB   = bldScnRoot.add_child(rootB, 1);
+        bldRootB.add_child(b1);
+    }
+
+    for (std::size_t i = 0; i < ents.size(); ++i)
+    {
+        basic.m_transform.emplace(ents[i], ACompTransform{Matrix4::translation({float(i + 1), 0.0f, 0.0f})});
+    }
+
+    std::size_t const capacity = basic.m_activeIds.capacity();
+    KeyedVec<ActiveEnt, DrawEnt> activeToDraw;
+    activeToDraw.resize(capacity, lgrn::id_null<DrawEnt>());
+    for (std::size_t i = 0; i < ents.size(); ++i)
+    {
+        activeToDraw[ents[i]] = DrawEnt(std::uint32_t(i));
+    }
+
+    ActiveEntSet_t needDrawTf;
+    needDrawTf.resize(capacity);
+    TransformGenerations drawTfGen;
+    drawTfGen.resize(capacity, gc_transformGenUnseen);
+    for (ActiveEnt const ent : {a11, a2, b1})
+    {
+        SysRender::needs_draw_transforms(basic.m_scnGraph, needDrawTf, drawTfGen, ent);
+    }
+
+    DrawTransforms_t drawTf;
+    drawTf.resize(ents.size());
+
+    // Returns which entities were calculated
+    auto const update = [&] () -> std::vector<ActiveEnt>
+    {
+        std::vector<ActiveEnt> calculated;
+        SysRender::DrawTfStack_t stack;
+        SysRender::update_draw_transforms_range(
+                {basic.m_scnGraph, basic.m_transform, basic.m_transformGen, activeToDraw, needDrawTf, drawTfGen, drawTf},
+                stack, 1, TreePos_t(basic.m_scnGraph.m_treeToEnt.size()),
+                [&calculated] (Matrix4 const& /* tf */, ActiveEnt ent, int /* depth */)
+        {
+            calculated.push_back(ent);
+        });
+        return calculated;
+    };
+
+    EXPECT_EQ(update(), (std::vector<ActiveEnt>{rootA, a1, a11, a2, rootB, b1}));
+    EXPECT_TRUE(update().empty());
+
+    // Leaf moved, its ancestors are only multiplied through
+    basic.m_transform.get(a11).m_transform = Matrix4::translation({0.0f, 1.0f, 0.0f});
+    transform_changed(basic, a11);
+    EXPECT_EQ(update(), (std::vector<ActiveEnt>{a11}));
+    EXPECT_EQ(drawTf[activeToDraw[a11]], Matrix4::translation({3.0f, 1.0f, 0.0f}));
+
+    // Parent moved, everything under it follows
+    basic.m_transform.get(a1).m_transform = Matrix4::translation({0.0f, 0.0f, 5.0f});
+    transform_changed(basic, a1);
+    transform_changed(basic, b1);
+    EXPECT_EQ(update(), (std::vector<ActiveEnt>{a1, a11, b1}));
+    EXPECT_EQ(drawTf[activeToDraw[a11]], Matrix4::translation({1.0f, 1.0f, 5.0f}));
+    EXPECT_TRUE(update().empty());
+
+    // Needing draw transforms again recalculates them, even if nothing changed
+    SysRender::needs_draw_transforms(basic.m_scnGraph, needDrawTf, drawTfGen, a2);
+    EXPECT_EQ(update(), (std::vector<ActiveEnt>{a2}));
+}
+
+// Test which DrawEnts pass frustum culling, depending on their mesh bounds and draw transforms
+TEST(CullFrustum, Spheres)
+{
+    ACtxDrawing     drawing;
+    ACtxSceneRender scnRender;
+
+    // Unit sphere around the origin, one pushed off to the side, and one with unknown bounds
+    MeshId const meshCentered   = drawing.m_meshIds.create();
+    MeshId const meshOffset     = drawing.m_meshIds.create();
+    MeshId const meshUnknown    = drawing.m_meshIds.create();
+    drawing.m_meshBounds.resize(drawing.m_meshIds.capacity());
+    drawing.m_meshBounds[meshCentered]  = MeshBounds{{0.0f, 0.0f, 0.0f}, 1.0f};
+    drawing.m_meshBounds[meshOffset]    = MeshBounds{{5.0f, 0.0f, 0.0f}, 1.0f};
+
+    std::array<DrawEnt, 10> drawEnts;
+    scnRender.m_drawIds.create(drawEnts.begin(), drawEnts.end());
+    scnRender.resize_draw();
+
+    auto const add = [&] (DrawEnt drawEnt, MeshId mesh, Matrix4 const& drawTf)
+    {
+        if (mesh != lgrn::id_null<MeshId>())
+        {
+            scnRender.m_mesh[drawEnt] = drawing.m_meshRefCounts.ref_add(mesh);
+        }
+        scnRender.m_drawTransform[drawEnt] = drawTf;
+        scnRender.m_visible.insert(drawEnt);
+    };
+
+    // Camera at the origin looking down -Z. With a 90 degree FOV and square aspect ratio, the
+    // side planes are 10m from the center at 10m away.
+    Camera camera;
+    camera.m_fov         = Magnum::Deg(90.0f);
+    camera.m_aspectRatio = 1.0f;
+    Matrix4 const viewProj = camera.perspective() * camera.m_transform.inverted();
+
+    constexpr MeshId null = lgrn::id_null<MeshId>();
+
+    auto const [inFront, behind, touchingSide, pastSide, pastSideScaled,
+                offsetOut, noMesh, notVisible, unknownBounds, pastFar] = drawEnts;
+
+    add(inFront,        meshCentered,   Matrix4::translation({0.0f, 0.0f, -10.0f}));
+    add(behind,         meshCentered,   Matrix4::translation({0.0f, 0.0f, 10.0f}));
+    add(touchingSide,   meshCentered,   Matrix4::translation({10.5f, 0.0f, -10.0f}));
+    add(pastSide,       meshCentered,   Matrix4::translation({12.0f, 0.0f, -10.0f}));
+    add(pastSideScaled, meshCentered,   Matrix4::translation({12.0f, 0.0f, -10.0f}) * Matrix4::scaling({1.0f, 2.0f, 1.0f}));
+    add(offsetOut,      meshOffset,     Matrix4::translation({8.0f, 0.0f, -10.0f}));
+    add(noMesh,         null,           Matrix4::translation({0.0f, 0.0f, 100.0f}));
+    add(notVisible,     meshCentered,   Matrix4::translation({0.0f, 0.0f, -10.0f}));
+    add(unknownBounds,  meshUnknown,    Matrix4::translation({0.0f, 0.0f, 100.0f}));
+    add(pastFar,        meshCentered,   Matrix4::translation({0.0f, 0.0f, -2000.0f}));
+    scnRender.m_visible.erase(notVisible);
+
+    // Something left over from a previous frame that should be removed
+    scnRender.m_onScreen.insert(behind);
+
+    auto const check = [&] ()
+    {
+        EXPECT_TRUE (scnRender.m_onScreen.contains(inFront));
+        EXPECT_FALSE(scnRender.m_onScreen.contains(behind));
+        EXPECT_TRUE (scnRender.m_onScreen.contains(touchingSide));
+        EXPECT_FALSE(scnRender.m_onScreen.contains(pastSide));
+        EXPECT_TRUE (scnRender.m_onScreen.contains(pastSideScaled)); // largest scale is used
+        EXPECT_FALSE(scnRender.m_onScreen.contains(offsetOut));
+        EXPECT_TRUE (scnRender.m_onScreen.contains(noMesh));
+        EXPECT_FALSE(scnRender.m_onScreen.contains(notVisible));
+        EXPECT_TRUE (scnRender.m_onScreen.contains(unknownBounds));
+        EXPECT_FALSE(scnRender.m_onScreen.contains(pastFar));
+    };
+
+    std::size_t const drawEntCount = scnRender.m_drawIds.capacity();
+    SysRender::cull_frustum(scnRender, drawing, viewProj, 0, drawEntCount);
+    check();
+
+    // Same result when split into ranges
+    scnRender.m_onScreen.insert(behind);
+    scnRender.m_onScreen.insert(pastFar);
+    SysRender::cull_frustum(scnRender, drawing, viewProj, 0, 3);
+    SysRender::cull_frustum(scnRender, drawing, viewProj, 3, drawEntCount);
+    check();
+
+    SysRender::clear_owners(scnRender, drawing);
+}
+
+// Test that meshes and textures are dissociated from their resources once the last DrawEnt using
+// them is deleted, and what that leaves in the new and removed lists
+TEST(DrawingResources, ReleaseUnused)
+{
+    Resources resources;
+    resources.resize_types(ResTypeIdReg_t::size());
+    resources.data_register<Magnum::Trade::MeshData>(restypes::gc_mesh);
+    PkgId const pkg = resources.pkg_create();
+
+    ResId const resMeshA = resources.create(restypes::gc_mesh,    pkg, SharedString::create_reference("MeshA"));
+    ResId const resMeshB = resources.create(restypes::gc_mesh,    pkg, SharedString::create_reference("MeshB"));
+    ResId const resTex   = resources.create(restypes::gc_texture, pkg, SharedString::create_reference("Tex"));
+
+    ACtxDrawing     drawing;
+    ACtxDrawingRes  drawingRes;
+    ACtxSceneRender scnRender;
+
+    std::array<DrawEnt, 3> drawEnts;
+    scnRender.m_drawIds.create(drawEnts.begin(), drawEnts.end());
+    scnRender.resize_draw();
+    auto const [entA0, entA1, entB] = drawEnts;
+
+    // A is used twice, B and the texture once
+    MeshId const meshA = SysRender::own_mesh_resource(drawing, drawingRes, resources, resMeshA);
+    MeshId const meshB = SysRender::own_mesh_resource(drawing, drawingRes, resources, resMeshB);
+    TexId  const tex   = SysRender::own_texture_resource(drawing, drawingRes, resources, resTex);
+    scnRender.m_mesh[entA0]         = drawing.m_meshRefCounts.ref_add(meshA);
+    scnRender.m_mesh[entA1]         = drawing.m_meshRefCounts.ref_add(meshA);
+    scnRender.m_mesh[entB]          = drawing.m_meshRefCounts.ref_add(meshB);
+    scnRender.m_diffuseTex[entB]    = drawing.m_texRefCounts.ref_add(tex);
+
+    // No MeshData, so bounds are unknown
+    EXPECT_LT(drawing.m_meshBounds[meshB].m_radius, 0.0f);
+
+    // B and the texture were added then removed within the same frame; renderers must see both
+    std::array<DrawEnt, 2> const deleteFirst{entA0, entB};
+    SysRender::update_delete_drawing(scnRender, drawing, drawingRes, resources, deleteFirst.begin(), deleteFirst.end());
+
+    EXPECT_EQ(drawingRes.m_meshNew,     (std::vector<ResId>{resMeshA, resMeshB}));
+    EXPECT_EQ(drawingRes.m_meshRemoved, (std::vector<ResId>{resMeshB}));
+    EXPECT_EQ(drawingRes.m_texNew,      (std::vector<ResId>{resTex}));
+    EXPECT_EQ(drawingRes.m_texRemoved,  (std::vector<ResId>{resTex}));
+
+    EXPECT_TRUE (drawing.m_meshIds.exists(meshA));
+    EXPECT_FALSE(drawing.m_meshIds.exists(meshB));
+    EXPECT_FALSE(drawing.m_texIds.exists(tex));
+    EXPECT_FALSE(drawingRes.m_resToMesh.contains(resMeshB));
+    EXPECT_FALSE(drawingRes.m_resToTex.contains(resTex));
+    EXPECT_FALSE(scnRender.m_mesh[entA0].has_value());
+    EXPECT_FALSE(scnRender.m_diffuseTex[entB].has_value());
+
+    // Next frame
+    drawingRes.m_meshNew.clear();
+    drawingRes.m_meshRemoved.clear();
+    drawingRes.m_texNew.clear();
+    drawingRes.m_texRemoved.clear();
+
+    // Last user of A, pretend it had bounds
+    drawing.m_meshBounds[meshA] = MeshBounds{{1.0f, 2.0f, 3.0f}, 4.0f};
+    std::array<DrawEnt, 1> const deleteSecond{entA1};
+    SysRender::update_delete_drawing(scnRender, drawing, drawingRes, resources, deleteSecond.begin(), deleteSecond.end());
+
+    EXPECT_TRUE(drawingRes.m_meshNew.empty());
+    EXPECT_EQ(drawingRes.m_meshRemoved, (std::vector<ResId>{resMeshA}));
+    EXPECT_FALSE(drawing.m_meshIds.exists(meshA));
+    EXPECT_TRUE(drawingRes.m_meshToRes.empty());
+    EXPECT_LT(drawing.m_meshBounds[meshA].m_radius, 0.0f);
+
+    // Can be owned again afterwards
+    MeshId const meshAgain = SysRender::own_mesh_resource(drawing, drawingRes, resources, resMeshA);
+    EXPECT_TRUE(drawing.m_meshIds.exists(meshAgain));
+    EXPECT_EQ(drawingRes.m_meshNew, (std::vector<ResId>{resMeshA}));
+
+    SysRender::clear_resource_owners(drawing, drawingRes, resources);
+}
+
+// Test that LOD meshes are released along with their full-detail mesh, unless a DrawEnt still
+// uses them directly
+TEST(DrawingResources, ReleaseLods)
+{
+    Resources resources;
+    resources.resize_types(ResTypeIdReg_t::size());
+    resources.data_register<Magnum::Trade::MeshData>(restypes::gc_mesh);
+    PkgId const pkg = resources.pkg_create();
+
+    ResId const resBase = resources.create(restypes::gc_mesh, pkg, SharedString::create_reference("Tank"));
+    ResId const resLod1 = resources.create(restypes::gc_mesh, pkg, SharedString::create_reference("Tank_LOD1"));
+    ResId const resLod2 = resources.create(restypes::gc_mesh, pkg, SharedString::create_reference("Tank_LOD2"));
+
+    ACtxDrawing     drawing;
+    ACtxDrawingRes  drawingRes;
+    ACtxSceneRender scnRender;
+
+    std::array<DrawEnt, 2> drawEnts;
+    scnRender.m_drawIds.create(drawEnts.begin(), drawEnts.end());
+    scnRender.resize_draw();
+    auto const [entBase, entLod2] = drawEnts;
+
+    MeshId const base = SysRender::own_mesh_resource(drawing, drawingRes, resources, resBase);
+    std::array<ResId, 2> const lodRes{resLod1, resLod2};
+    SysRender::own_mesh_lods(drawing, drawingRes, resources, base, {lodRes.data(), lodRes.size()});
+
+    ASSERT_TRUE(drawing.m_meshLods.contains(base));
+    MeshLodChain const &chain = drawing.m_meshLods.at(base);
+    ASSERT_EQ(chain.m_levels.size(), 2u);
+    MeshId const lod1 = chain.m_levels[0].m_mesh;
+    MeshId const lod2 = chain.m_levels[1].m_mesh;
+
+    // Owning them again doesn't add more references
+    SysRender::own_mesh_lods(drawing, drawingRes, resources, base, {lodRes.data(), lodRes.size()});
+    EXPECT_EQ(drawing.m_meshRefCounts[std::size_t(lod1)], 1);
+
+    // LOD2 is also drawn on its own
+    scnRender.m_mesh[entBase] = drawing.m_meshRefCounts.ref_add(base);
+    scnRender.m_mesh[entLod2] = drawing.m_meshRefCounts.ref_add(lod2);
+
+    std::array<DrawEnt, 1> const deleteBase{entBase};
+    SysRender::update_delete_drawing(scnRender, drawing, drawingRes, resources, deleteBase.begin(), deleteBase.end());
+
+    EXPECT_EQ(drawingRes.m_meshRemoved, (std::vector<ResId>{resBase, resLod1}));
+    EXPECT_FALSE(drawing.m_meshIds.exists(base));
+    EXPECT_FALSE(drawing.m_meshIds.exists(lod1));
+    EXPECT_TRUE (drawing.m_meshIds.exists(lod2));
+    EXPECT_FALSE(drawing.m_meshLods.contains(base));
+    EXPECT_TRUE (drawingRes.m_meshLodOwners.empty());
+
+    // Last user of LOD2
+    drawingRes.m_meshRemoved.clear();
+    std::array<DrawEnt, 1> const deleteLod2{entLod2};
+    SysRender::update_delete_drawing(scnRender, drawing, drawingRes, resources, deleteLod2.begin(), deleteLod2.end());
+
+    EXPECT_EQ(drawingRes.m_meshRemoved, (std::vector<ResId>{resLod2}));
+    EXPECT_FALSE(drawing.m_meshIds.exists(lod2));
+    EXPECT_TRUE (drawingRes.m_meshToRes.empty());
+
+    SysRender::clear_resource_owners(drawing, drawingRes, resources);
+}
+
+// Test splitting sorted DrawEnts into runs that are drawn instanced together, the same way the
+// Phong and Flat shaders compare mesh, texture, and color
+TEST(InstancedDraw, RunsSplitOnAnyChange)
+{
+    struct State
+    {
+        int mesh;
+        int tex;
+        int color;
+    };
+
+    std::array<State, 7> const states
+    {{
+        {0, 0, 0}, {0, 0, 0}, {0, 0, 0},    // same everything
+        {0, 1, 0},                          // texture differs
+        {0, 1, 1}, {0, 1, 1},               // color differs
+        {2, 1, 1}                           // mesh differs
+    }};
+
+    std::array<DrawEnt, 7> ents;
+    for (std::size_t i = 0; i < ents.size(); ++i)
+    {
+        ents[i] = DrawEnt(uint32_t(i));
+    }
+
+    auto const same_as = [&states] (DrawEnt const a, DrawEnt const b) noexcept
+    {
+        State const &sa = states[a.value];
+        State const &sb = states[b.value];
+        return sa.mesh == sb.mesh && sa.tex == sb.tex && sa.color == sb.color;
+    };
+
+    std::vector<std::size_t> runEnds;
+    for (std::size_t first = 0; first < ents.size(); first = runEnds.back())
+    {
+        runEnds.push_back(SysRender::run_end(ents, first, same_as));
+    }
+    EXPECT_EQ(runEnds, (std::vector<std::size_t>{3, 4, 6, 7}));
+
+    // Last entity on its own
+    EXPECT_EQ(SysRender::run_end(ents, 6, same_as), 7u);
+}
+
+TEST(MeshLods, SplitLodName)
+{
+    using Split_t = std::pair<std::string_view, int>;
+
+    EXPECT_EQ(split_lod_name("Engine_LOD1"),    Split_t("Engine", 1));
+    EXPECT_EQ(split_lod_name("Engine_LOD0"),    Split_t("Engine", 0));
+    EXPECT_EQ(split_lod_name("Engine_LOD12"),   Split_t("Engine", 12));
+    EXPECT_EQ(split_lod_name("a_b_LOD3"),       Split_t("a_b", 3));
+
+    // Not following the convention, the whole name is LOD 0
+    EXPECT_EQ(split_lod_name("Engine"),         Split_t("Engine", 0));
+    EXPECT_EQ(split_lod_name("Engine_LOD"),     Split_t("Engine_LOD", 0));
+    EXPECT_EQ(split_lod_name("Engine_LOD1234"), Split_t("Engine_LOD1234", 0));
+    EXPECT_EQ(split_lod_name("Engine_lod1"),    Split_t("Engine_lod1", 0));
+    EXPECT_EQ(split_lod_name("Engine2"),        Split_t("Engine2", 0));
+    EXPECT_EQ(split_lod_name("_LOD1"),          Split_t("_LOD1", 0));
+    EXPECT_EQ(split_lod_name(""),               Split_t("", 0));
+}
+
+TEST(MeshLods, LinkByName)
+{
+    std::array<std::string_view, 7> const names
+    {
+        "Tank_LOD2",    // 0
+        "Engine",       // 1
+        "Tank",         // 2
+        "Engine_LOD1",  // 3
+        "Tank_LOD1",    // 4
+        "",             // 5, not loaded
+        "Nozzle_LOD1"   // 6, no base mesh
+    };
+
+    ImporterData importData;
+    link_mesh_lods(names, importData);
+
+    EXPECT_EQ(importData.m_meshNextLod, (std::vector<int>{-1, 3, 4, -1, 0, -1, -1}));
+    EXPECT_EQ(importData.m_meshIsLod,   (std::vector<bool>{true, false, false, true, true, false, false}));
+}
+
+// Test that LODs switch only once the screen size passes a threshold by the hysteresis margin,
+// so a mesh sitting right at the threshold doesn't flip back and forth
+TEST(MeshLods, SelectWithHysteresis)
+{
+    ACtxDrawing     drawing;
+    ACtxSceneRender scnRender;
+
+    MeshId const base   = drawing.m_meshIds.create();
+    MeshId const lod    = drawing.m_meshIds.create();
+    drawing.m_meshBounds.resize(drawing.m_meshIds.capacity());
+    drawing.m_meshBounds[base] = MeshBounds{{0.0f, 0.0f, 0.0f}, 1.0f};
+
+    // Switch at a screen size of 0.5
+    SysRender::set_mesh_lods(drawing, base, {&lod, 1}, 0.5f);
+
+    std::array<DrawEnt, 1> drawEnts;
+    scnRender.m_drawIds.create(drawEnts.begin(), drawEnts.end());
+    scnRender.resize_draw();
+    DrawEnt const ent = drawEnts[0];
+    scnRender.m_mesh[ent] = drawing.m_meshRefCounts.ref_add(base);
+    scnRender.m_visible.insert(ent);
+
+    // 90 degree FOV and square aspect ratio, so screen size is 1 / distance for a unit sphere.
+    // With hysteresis of 0.1, LOD 1 is used below 0.45 (distance 2.22), and LOD 0 again above
+    // 0.55 (distance 1.82).
+    Camera camera;
+    camera.m_fov         = Magnum::Deg(90.0f);
+    camera.m_aspectRatio = 1.0f;
+
+    std::size_t const drawEntCount = scnRender.m_drawIds.capacity();
+
+    auto const select_at = [&] (float distance) -> MeshId
+    {
+        scnRender.m_meshDirty.clear();
+        scnRender.m_drawTransform[ent] = Matrix4::translation({0.0f, 0.0f, -distance});
+        SysRender::select_lods(scnRender, drawing, camera, 0.1f, 0, drawEntCount);
+        return scnRender.m_meshLod[ent];
+    };
+
+    constexpr MeshId full = lgrn::id_null<MeshId>();
+
+    EXPECT_EQ(select_at(1.5f), full);
+    EXPECT_TRUE(scnRender.m_meshDirty.empty());
+
+    // Going back and forth across the threshold, but not past the margin
+    for (float const distance : {1.9f, 2.1f, 1.95f, 2.05f, 2.2f})
+    {
+        EXPECT_EQ(select_at(distance), full);
+        EXPECT_TRUE(scnRender.m_meshDirty.empty());
+    }
+
+    EXPECT_EQ(select_at(2.5f), lod);
+    EXPECT_EQ(scnRender.m_meshDirty, (std::vector<DrawEnt>{ent}));
+
+    for (float const distance : {2.1f, 1.9f, 2.05f, 1.85f})
+    {
+        EXPECT_EQ(select_at(distance), lod);
+        EXPECT_TRUE(scnRender.m_meshDirty.empty());
+    }
+
+    EXPECT_EQ(select_at(1.7f), full);
+    EXPECT_EQ(scnRender.m_meshDirty, (std::vector<DrawEnt>{ent}));
+
+    // m_fov is horizontal. A wider aspect ratio narrows the vertical FOV, making the same mesh
+    // larger on screen.
+    camera.m_aspectRatio = 2.0f;
+    EXPECT_EQ(select_at(3.0f), full);
+    camera.m_aspectRatio = 1.0f;
+    EXPECT_EQ(select_at(3.0f), lod);
+
+    SysRender::clear_owners(scnRender, drawing);
+}
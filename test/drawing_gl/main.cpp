@@ -0,0 +1,112 @@
+/**
+ * Open Space Program
+ * Copyright © 2019-2024 Open Space Program Project
+ *
+ * MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include <osp/drawing_gl/rendergl.h>
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+using namespace osp;
+using namespace osp::draw;
+
+namespace
+{
+
+std::vector<ResId> make_queue(std::size_t count)
+{
+    std::vector<ResId> queue;
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        queue.push_back(ResId(uint32_t(i)));
+    }
+    return queue;
+}
+
+} // namespace
+
+// Test that uploads stop once the budget is used up, oldest first, and leave the rest in order
+TEST(UploadQueue, BudgetKeepsOrder)
+{
+    std::vector<ResId> queue = make_queue(5);
+    std::vector<ResId> uploaded;
+    std::size_t used = 0;
+
+    auto const upload = [&uploaded] (ResId const res) -> std::size_t
+    {
+        uploaded.push_back(res);
+        return 40;
+    };
+
+    SysRenderGL::upload_queue(queue, used, 100, upload);
+    EXPECT_EQ(uploaded, (std::vector<ResId>{ResId(0u), ResId(1u), ResId(2u)}));
+    EXPECT_EQ(queue,    (std::vector<ResId>{ResId(3u), ResId(4u)}));
+    EXPECT_EQ(used, 120u);
+
+    // Next frame continues where the last one stopped
+    used = 0;
+    uploaded.clear();
+    SysRenderGL::upload_queue(queue, used, 100, upload);
+    EXPECT_EQ(uploaded, (std::vector<ResId>{ResId(3u), ResId(4u)}));
+    EXPECT_TRUE(queue.empty());
+}
+
+// Test that at least one resource is uploaded even if it's larger than the whole budget
+TEST(UploadQueue, AtLeastOne)
+{
+    std::vector<ResId> queue = make_queue(3);
+    std::vector<ResId> uploaded;
+    std::size_t used = 0;
+
+    SysRenderGL::upload_queue(queue, used, 10, [&uploaded] (ResId const res) -> std::size_t
+    {
+        uploaded.push_back(res);
+        return 1000;
+    });
+    EXPECT_EQ(uploaded, (std::vector<ResId>{ResId(0u)}));
+    EXPECT_EQ(queue.size(), 2u);
+
+    // Resources that had nothing to upload (such as ones released while queued) don't count
+    queue = make_queue(3);
+    uploaded.clear();
+    used = 0;
+    SysRenderGL::upload_queue(queue, used, 0, [&uploaded] (ResId const res) -> std::size_t
+    {
+        uploaded.push_back(res);
+        return (res == ResId(0u)) ? 0 : 1000;
+    });
+    EXPECT_EQ(uploaded, (std::vector<ResId>{ResId(0u), ResId(1u)}));
+    EXPECT_EQ(queue,    (std::vector<ResId>{ResId(2u)}));
+
+    // Once something was uploaded earlier in the frame, a spent budget uploads nothing more
+    uploaded.clear();
+    used = 1000;
+    SysRenderGL::upload_queue(queue, used, 10, [&uploaded] (ResId const res) -> std::size_t
+    {
+        uploaded.push_back(res);
+        return 1000;
+    });
+    EXPECT_TRUE(uploaded.empty());
+    EXPECT_EQ(queue.size(), 1u);
+}
@@ -0,0 +1,419 @@
+/**
+ * Open Space Program
+ * Copyright © 2019-2024 Open Space Program Project
+ *
+ * MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include <adera/drawing_gl/flat_shader.h>
+#include <adera/drawing_gl/phong_shader.h>
+#include <osp/core/Resources.h>
+#include <osp/drawing/drawing_fn.h>
+#include <osp/drawing/own_restypes.h>
+#include <osp/drawing_gl/rendergl.h>
+
+#include <Magnum/Image.h>
+#include <Magnum/PixelFormat.h>
+#include <Magnum/GL/Context.h>
+#include <Magnum/GL/Extensions.h>
+#include <Magnum/GL/Framebuffer.h>
+#include <Magnum/GL/Renderbuffer.h>
+#include <Magnum/GL/RenderbufferFormat.h>
+#include <Magnum/GL/Renderer.h>
+#include <Magnum/MeshTools/Compile.h>
+#include <Magnum/Platform/GLContext.h>
+#include <Magnum/Platform/WindowlessEglApplication.h>
+#include <Magnum/Primitives/Cube.h>
+#include <Magnum/Primitives/Icosphere.h>
+#include <Magnum/Trade/MeshData.h>
+
+#include <Corrade/Containers/ArrayViewStl.h>
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <array>
+#include <cstdlib>
+#include <memory>
+#include <vector>
+
+using namespace osp;
+using namespace osp::draw;
+using namespace adera::shader;
+
+using Corrade::Containers::arrayView;
+using Magnum::GL::Framebuffer;
+using Magnum::GL::FramebufferClear;
+using Magnum::GL::Renderbuffer;
+using Magnum::GL::RenderbufferFormat;
+using Pixels_t = std::vector<Magnum::UnsignedByte>;
+
+// for the 0xrrggbb_rgbf and angle literals
+using namespace Magnum::Math::Literals;
+
+namespace
+{
+
+constexpr Magnum::Vector2i gc_fbSize{128, 64};
+
+/**
+ * @brief Headless GL context shared by all tests, such as Mesa's llvmpipe through EGL
+ *
+ * Tests are skipped if no context can be created.
+ */
+class HeadlessGL : public ::testing::Test
+{
+protected:
+    static void SetUpTestSuite()
+    {
+        using namespace Magnum::Platform;
+
+        s_pWindowless = std::make_unique<WindowlessEglContext>(WindowlessEglContext::Configuration{});
+        if ( ! s_pWindowless->isCreated() || ! s_pWindowless->makeCurrent() )
+        {
+            s_pWindowless.reset();
+            return;
+        }
+
+        s_pContext = std::make_unique<GLContext>(Corrade::NoCreate, 0, nullptr);
+        if ( ! s_pContext->tryCreate() )
+        {
+            s_pContext.reset();
+            s_pWindowless.reset();
+        }
+    }
+
+    static void TearDownTestSuite()
+    {
+        s_pContext.reset();
+        s_pWindowless.reset();
+    }
+
+    void SetUp() override
+    {
+        if (s_pContext == nullptr)
+        {
+            GTEST_SKIP() << "No headless GL context available";
+        }
+        if ( ! Magnum::GL::Context::current().isExtensionSupported<Magnum::GL::Extensions::ARB::instanced_arrays>() )
+        {
+            GTEST_SKIP() << "Instancing not supported";
+        }
+    }
+
+    static inline std::unique_ptr<Magnum::Platform::WindowlessEglContext>   s_pWindowless;
+    static inline std::unique_ptr<Magnum::Platform::GLContext>              s_pContext;
+};
+
+/**
+ * @brief DrawEnts in a grid, in runs that share a mesh and color and runs that don't, drawn
+ *        to an offscreen framebuffer
+ */
+struct InstancingScene
+{
+    InstancingScene()
+    {
+        m_colorRb.setStorage(RenderbufferFormat::RGBA8, gc_fbSize);
+        m_depthRb.setStorage(RenderbufferFormat::DepthComponent24, gc_fbSize);
+        m_fbo.attachRenderbuffer(Framebuffer::ColorAttachment{0}, m_colorRb)
+             .attachRenderbuffer(Framebuffer::BufferAttachment::Depth, m_depthRb);
+
+        MeshGlId const cube     = add_mesh(Magnum::Primitives::cubeSolid());
+        MeshGlId const sphere   = add_mesh(Magnum::Primitives::icosphereSolid(1));
+
+        Magnum::Color4 const red  = 0xff4020_rgbf;
+        Magnum::Color4 const blue = 0x2060ff_rgbf;
+
+        std::array<MeshGlId, 8>       const meshes{cube, cube, cube, sphere, sphere, cube, cube, sphere};
+        std::array<Magnum::Color4, 8> const colors{red,  red,  red,  red,    red,    blue, blue, blue};
+
+        m_ents.resize(meshes.size());
+        m_scnRender.m_drawIds.create(m_ents.begin(), m_ents.end());
+        m_scnRender.resize_draw();
+        m_scnRenderGl.m_meshId      .resize(m_scnRender.m_drawIds.capacity());
+        m_scnRenderGl.m_diffuseTexId.resize(m_scnRender.m_drawIds.capacity());
+
+        for (std::size_t i = 0; i < m_ents.size(); ++i)
+        {
+            DrawEnt const ent = m_ents[i];
+            Vector3 const pos{-3.0f + 2.0f * float(i % 4), (i < 4) ? 1.0f : -1.0f, -6.0f};
+
+            m_scnRender.m_drawTransform[ent]
+                    = Matrix4::translation(pos)
+                    * Matrix4::rotation(Magnum::Deg(25.0f * float(i + 1)), Vector3{1.0f, 1.0f, 0.0f}.normalized())
+                    * Matrix4::scaling(Vector3{0.6f});
+            m_scnRender.m_color[ent]            = colors[i];
+            m_scnRenderGl.m_meshId[ent].m_glId  = meshes[i];
+        }
+    }
+
+    MeshGlId add_mesh(Magnum::Trade::MeshData const& data)
+    {
+        MeshGlId const meshId = m_renderGl.m_meshIds.create();
+        m_renderGl.m_meshGl.emplace(meshId, Magnum::MeshTools::compile(data));
+        return meshId;
+    }
+
+    std::vector<DrawPacket> make_packets() const
+    {
+        std::vector<DrawPacket> packets;
+        for (DrawEnt const ent : m_ents)
+        {
+            packets.push_back(SysRender::make_packet(m_scnRender.m_drawTransform[ent], m_viewProj));
+        }
+        return packets;
+    }
+
+    template <typename DRAW_T>
+    Pixels_t render(DRAW_T&& draw)
+    {
+        m_fbo.bind();
+        m_fbo.clear(FramebufferClear::Color | FramebufferClear::Depth);
+        Magnum::GL::Renderer::enable(Magnum::GL::Renderer::Feature::DepthTest);
+
+        draw();
+
+        Magnum::Image2D const image = m_fbo.read(Magnum::Range2Di{{}, gc_fbSize}, {Magnum::PixelFormat::RGBA8Unorm});
+        return {image.data().begin(), image.data().end()};
+    }
+
+    RenderGL                m_renderGl;
+    ACtxSceneRender         m_scnRender;
+    ACtxSceneRenderGL       m_scnRenderGl;
+    std::vector<DrawEnt>    m_ents;
+
+    ViewProjMatrix          m_viewProj{Matrix4{}, Matrix4::perspectiveProjection(60.0_degf, 2.0f, 0.1f, 100.0f)};
+
+    Renderbuffer            m_colorRb;
+    Renderbuffer            m_depthRb;
+    Framebuffer             m_fbo{Magnum::Range2Di{{}, gc_fbSize}};
+};
+
+std::size_t count_drawn(Pixels_t const& pixels)
+{
+    std::size_t count = 0;
+    for (std::size_t i = 0; i < pixels.size(); i += 4)
+    {
+        count += std::size_t(pixels[i] != 0 || pixels[i + 1] != 0 || pixels[i + 2] != 0);
+    }
+    return count;
+}
+
+int max_difference(Pixels_t const& a, Pixels_t const& b)
+{
+    int maxDiff = 0;
+    for (std::size_t i = 0; i < std::min(a.size(), b.size()); ++i)
+    {
+        maxDiff = std::max(maxDiff, std::abs(int(a[i]) - int(b[i])));
+    }
+    return maxDiff;
+}
+
+/**
+ * @brief Draw the scene one entity at a time, instanced, and one at a time again, and check
+ *        that all three come out the same
+ *
+ * The last pass checks that instance buffers left attached to GL meshes don't affect shaders
+ * that aren't instanced.
+ */
+template <typename DRAW_ONE_T, typename DRAW_MANY_T>
+void check_instanced_matches(InstancingScene& rScene, DRAW_ONE_T&& drawOne, DRAW_MANY_T&& drawMany)
+{
+    Pixels_t const perEnt = rScene.render(drawOne);
+    ASSERT_EQ(perEnt.size(), std::size_t(gc_fbSize.product()) * 4);
+    EXPECT_GT(count_drawn(perEnt), perEnt.size() / 4 / 10);
+    EXPECT_TRUE(rScene.m_renderGl.m_meshInstanceBuf.empty());
+
+    // Instance matrices are multiplied by identity uniforms, so results should be exact. Allow
+    // for one step of rounding anyways.
+    EXPECT_LE(max_difference(rScene.render([&] { drawMany(ArrayView<DrawPacket const>{}); }), perEnt), 1);
+    EXPECT_EQ(rScene.m_renderGl.m_meshInstanceBuf.size(), 2u);
+
+    std::vector<DrawPacket> const packets = rScene.make_packets();
+    EXPECT_LE(max_difference(rScene.render([&] { drawMany(arrayView(packets)); }), perEnt), 1);
+
+    EXPECT_EQ(rScene.render(drawOne), perEnt);
+}
+
+} // namespace
+
+TEST_F(HeadlessGL, PhongInstancedMatchesPerEntity)
+{
+    InstancingScene scene;
+
+    ACtxDrawPhong phong;
+    phong.shaderUntextured          = PhongGL{PhongGL::Configuration{}.setLightCount(2)};
+    phong.shaderUntexturedInstanced = PhongGL{PhongGL::Configuration{}
+                                              .setFlags(PhongGL::Flag::InstancedTransformation)
+                                              .setLightCount(2)};
+    phong.assign_pointers(scene.m_scnRender, scene.m_scnRenderGl, scene.m_renderGl);
+
+    EntityToDraw::UserData_t const userData{&phong, &phong.shaderUntextured};
+    ViewProjMatrix const &viewProj = scene.m_viewProj;
+
+    check_instanced_matches(scene,
+        [&] ()
+        {
+            setup_phong(viewProj, userData);
+            for (DrawEnt const ent : scene.m_ents)
+            {
+                draw_ent_phong(ent, viewProj, userData);
+            }
+        },
+        [&] (ArrayView<DrawPacket const> packets)
+        {
+            setup_phong(viewProj, userData);
+            draw_ents_phong_instanced(arrayView(scene.m_ents), packets, viewProj, userData);
+        });
+}
+
+TEST_F(HeadlessGL, FlatInstancedMatchesPerEntity)
+{
+    InstancingScene scene;
+
+    ACtxDrawFlat flat;
+    flat.shaderUntextured           = FlatGL3D{FlatGL3D::Configuration{}};
+    flat.shaderUntexturedInstanced  = FlatGL3D{FlatGL3D::Configuration{}.setFlags(FlatGL3D::Flag::InstancedTransformation)};
+    flat.assign_pointers(scene.m_scnRender, scene.m_scnRenderGl, scene.m_renderGl);
+
+    EntityToDraw::UserData_t const userData{&flat, &flat.shaderUntextured};
+    ViewProjMatrix const &viewProj = scene.m_viewProj;
+
+    check_instanced_matches(scene,
+        [&] ()
+        {
+            setup_flat(viewProj, userData);
+            for (DrawEnt const ent : scene.m_ents)
+            {
+                draw_ent_flat(ent, viewProj, userData);
+            }
+        },
+        [&] (ArrayView<DrawPacket const> packets)
+        {
+            setup_flat(viewProj, userData);
+            draw_ents_flat_instanced(arrayView(scene.m_ents), packets, viewProj, userData);
+        });
+}
+
+// Test that a DrawEnt keeps drawing its previous mesh until the one it switches to is uploaded,
+// and that DrawEnts without any uploaded mesh aren't drawn at all
+TEST_F(HeadlessGL, KeepsPreviousMeshUntilUploaded)
+{
+    Resources resources;
+    resources.resize_types(ResTypeIdReg_t::size());
+    resources.data_register<Magnum::Trade::MeshData>(restypes::gc_mesh);
+    PkgId const pkg = resources.pkg_create();
+
+    ResId const resCube   = resources.create(restypes::gc_mesh, pkg, SharedString::create_reference("Cube"));
+    ResId const resSphere = resources.create(restypes::gc_mesh, pkg, SharedString::create_reference("Sphere"));
+    resources.data_add<Magnum::Trade::MeshData>(restypes::gc_mesh, resCube,   Magnum::Primitives::cubeSolid());
+    resources.data_add<Magnum::Trade::MeshData>(restypes::gc_mesh, resSphere, Magnum::Primitives::icosphereSolid(1));
+
+    InstancingScene scene;
+    ACtxDrawing     drawing;
+    ACtxDrawingRes  drawingRes;
+
+    ACtxSceneRender     &rScnRender     = scene.m_scnRender;
+    ACtxSceneRenderGL   &rScnRenderGl   = scene.m_scnRenderGl;
+    RenderGL            &rRenderGl      = scene.m_renderGl;
+
+    // Only the first two entities are used, starting without any GL mesh
+    DrawEnt const entA = scene.m_ents[0];
+    DrawEnt const entB = scene.m_ents[1];
+    rScnRenderGl.m_meshId[entA] = {};
+    rScnRenderGl.m_meshId[entB] = {};
+
+    MeshId const cube   = SysRender::own_mesh_resource(drawing, drawingRes, resources, resCube);
+    MeshId const sphere = SysRender::own_mesh_resource(drawing, drawingRes, resources, resSphere);
+    SysRenderGL::compile_resource_meshes(drawingRes, resources, rRenderGl);
+
+    MeshGlId const cubeGl   = rRenderGl.m_resToMesh.at(resCube);
+    MeshGlId const sphereGl = rRenderGl.m_resToMesh.at(resSphere);
+    MeshGlId const null     = lgrn::id_null<MeshGlId>();
+
+    ACtxDrawFlat flat;
+    flat.shaderUntextured = FlatGL3D{FlatGL3D::Configuration{}};
+    flat.assign_pointers(rScnRender, rScnRenderGl, rRenderGl);
+
+    EntityToDraw::UserData_t const userData{&flat, &flat.shaderUntextured};
+    ViewProjMatrix const &viewProj = scene.m_viewProj;
+
+    auto const sync = [&] (DrawEnt const ent)
+    {
+        SysRenderGL::sync_drawent_mesh(ent, rScnRender.m_mesh, rScnRender.m_meshLod, drawingRes.m_meshToRes, rScnRenderGl, rRenderGl);
+    };
+    auto const upload_one = [&] ()
+    {
+        // Budget of a single byte still uploads one resource
+        SysRenderGL::upload_pending(rRenderGl, resources, 1);
+        SysRenderGL::sync_drawent_pending(rScnRenderGl, rRenderGl);
+    };
+    auto const draw = [&] ()
+    {
+        setup_flat(viewProj, userData);
+        draw_ent_flat(entA, viewProj, userData);
+        draw_ent_flat(entB, viewProj, userData);
+    };
+
+    // Nothing uploaded yet, A isn't drawn
+    rScnRender.m_mesh[entA] = drawing.m_meshRefCounts.ref_add(cube);
+    sync(entA);
+    EXPECT_EQ(rScnRenderGl.m_meshId[entA].m_glId,           null);
+    EXPECT_EQ(rScnRenderGl.m_meshId[entA].m_pendingGlId,    cubeGl);
+    EXPECT_EQ(count_drawn(scene.render(draw)), 0u);
+
+    // Cube was queued first
+    upload_one();
+    EXPECT_EQ(rScnRenderGl.m_meshId[entA].m_glId,           cubeGl);
+    EXPECT_EQ(rScnRenderGl.m_meshId[entA].m_pendingGlId,    null);
+    EXPECT_FALSE(rRenderGl.m_meshResident.contains(sphereGl));
+
+    Pixels_t const cubeOnly = scene.render(draw);
+    EXPECT_GT(count_drawn(cubeOnly), 0u);
+
+    // A switches to the sphere through its LOD, and B starts using the sphere. A keeps drawing
+    // the cube, and B isn't drawn.
+    rScnRender.m_meshLod[entA]  = sphere;
+    rScnRender.m_mesh[entB]     = drawing.m_meshRefCounts.ref_add(sphere);
+    sync(entA);
+    sync(entB);
+    EXPECT_EQ(rScnRenderGl.m_meshId[entA].m_glId,           cubeGl);
+    EXPECT_EQ(rScnRenderGl.m_meshId[entA].m_pendingGlId,    sphereGl);
+    EXPECT_EQ(rScnRenderGl.m_meshId[entB].m_glId,           null);
+    EXPECT_EQ(scene.render(draw), cubeOnly);
+
+    upload_one();
+    EXPECT_EQ(rScnRenderGl.m_meshId[entA].m_glId, sphereGl);
+    EXPECT_EQ(rScnRenderGl.m_meshId[entB].m_glId, sphereGl);
+    EXPECT_TRUE(rScnRenderGl.m_meshPending.empty());
+    EXPECT_NE(scene.render(draw), cubeOnly);
+
+    // Deleting the last users releases both GL meshes
+    rScnRender.m_meshLod[entA] = lgrn::id_null<MeshId>();
+    std::array<DrawEnt, 2> const toDelete{entA, entB};
+    SysRender::update_delete_drawing(rScnRender, drawing, drawingRes, resources, toDelete.begin(), toDelete.end());
+    SysRenderGL::compile_resource_meshes(drawingRes, resources, rRenderGl);
+    EXPECT_FALSE(rRenderGl.m_meshResident.contains(cubeGl));
+    EXPECT_FALSE(rRenderGl.m_meshResident.contains(sphereGl));
+    EXPECT_FALSE(rRenderGl.m_meshGl.contains(cubeGl));
+
+    SysRender::clear_resource_owners(drawing, drawingRes, resources);
+    SysRenderGL::clear_resource_owners(rRenderGl, resources);
+}
@@ -0,0 +1,90 @@
+/**
+ * Open Space Program
+ * Copyright © 2019-2024 Open Space Program Project
+ *
+ * MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include <ospnewton/activescene/newtoninteg_fn.h>
+
+#include <gtest/gtest.h>
+
+#include <array>
+
+using namespace ospnewton;
+using osp::Matrix4;
+using osp::Vector3;
+using osp::active::ACtxPhysics;
+
+namespace
+{
+
+Vector3 body_position(ACtxNwtWorld const& ctxWorld, BodyId const bodyId)
+{
+    Matrix4 matrix;
+    NewtonBodyGetMatrix(ctxWorld.m_bodyPtrs[bodyId].get(), matrix.data());
+    return matrix.translation();
+}
+
+} // namespace
+
+// Test translating bodies after a floating origin shift, including deleted bodies
+TEST(Newton, TranslateBodies)
+{
+    ACtxNwtWorld ctxWorld{1};
+
+    std::array<BodyId, 4> bodies;
+    ctxWorld.m_bodyIds.create(bodies.begin(), bodies.end());
+    SysNewton::resize_body_data(ctxWorld);
+
+    std::array<Vector3, 4> const start{ Vector3{1.0f, 2.0f, 3.0f}, Vector3{-10.0f, 0.0f, 0.0f},
+                                        Vector3{0.0f, 0.0f, 0.0f}, Vector3{500.0f, 500.0f, 500.0f} };
+
+    for (std::size_t i = 0; i < bodies.size(); ++i)
+    {
+        NwtColliderPtr_t pCollision{ NewtonCreateSphere(ctxWorld.m_world.get(), 1.0f, 0, nullptr) };
+        Matrix4 const matrix = Matrix4::translation(start[i]);
+        ctxWorld.m_bodyPtrs[bodies[i]].reset(NewtonCreateDynamicBody(ctxWorld.m_world.get(), pCollision.get(), matrix.data()));
+    }
+
+    // Deleted body leaves a null pointer behind
+    ctxWorld.m_bodyPtrs[bodies[2]].reset();
+    ctxWorld.m_bodyIds.remove(bodies[2]);
+
+    // Split into two ranges
+    Vector3 const translate{-512.0f, 1024.0f, 0.0f};
+    SysNewton::translate_bodies(ctxWorld, translate, 0, 2);
+    SysNewton::translate_bodies(ctxWorld, translate, 2, BodyId(ctxWorld.m_bodyPtrs.size()));
+
+    EXPECT_EQ(body_position(ctxWorld, bodies[0]), start[0] + translate);
+    EXPECT_EQ(body_position(ctxWorld, bodies[1]), start[1] + translate);
+    EXPECT_EQ(body_position(ctxWorld, bodies[3]), start[3] + translate);
+
+    // Requested through ACtxPhysics, applied and cleared before the next step
+    ACtxPhysics ctxPhys;
+    ctxPhys.m_originTranslate = {0.0f, 0.0f, 256.0f};
+    SysNewton::update_translate(ctxPhys, ctxWorld);
+    EXPECT_TRUE(ctxPhys.m_originTranslate.isZero());
+    EXPECT_EQ(body_position(ctxWorld, bodies[0]), start[0] + translate + Vector3(0.0f, 0.0f, 256.0f));
+
+    // Nothing requested, nothing moves
+    SysNewton::update_translate(ctxPhys, ctxWorld);
+    EXPECT_EQ(body_position(ctxWorld, bodies[0]), start[0] + translate + Vector3(0.0f, 0.0f, 256.0f));
+}
@@ -0,0 +1,242 @@
+/**
+ * Open Space Program
+ * Copyright © 2019-2022 Open Space Program Project
+ *
+ * MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include <osp/drawing/render_queue.h>
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <numeric>
+#include <random>
+
+using namespace osp;
+using namespace osp::draw;
+
+namespace
+{
+
+void draw_dummy_a(DrawEnt, ViewProjMatrix const&, EntityToDraw::UserData_t) noexcept { }
+void draw_dummy_b(DrawEnt, ViewProjMatrix const&, EntityToDraw::UserData_t) noexcept { }
+
+} // namespace
+
+// Test that fields are packed in order of importance
+TEST(RenderQueue, KeyFields)
+{
+    // Any difference in a more significant field outweighs all less significant fields
+    EXPECT_LT(RenderKey::pack(0, 5, 255, 65535, 16383, 65535), RenderKey::pack(1, 0, 0, 0, 0, 0));
+    EXPECT_LT(RenderKey::pack(0, 0, 255, 65535, 16383, 65535), RenderKey::pack(0, 1, 0, 0, 0, 0));
+    EXPECT_LT(RenderKey::pack(0, 0, 0,   65535, 16383, 65535), RenderKey::pack(0, 0, 1, 0, 0, 0));
+    EXPECT_LT(RenderKey::pack(0, 0, 0,   0,     16383, 65535), RenderKey::pack(0, 0, 0, 1, 0, 0));
+    EXPECT_LT(RenderKey::pack(0, 0, 0,   0,     0,     65535), RenderKey::pack(0, 0, 0, 0, 1, 0));
+
+    // Values too large for their field must not leak into other fields
+    EXPECT_EQ(RenderKey::pack(0, 0, 0, 0, 0, 0x10000), RenderKey::pack(0, 0, 0, 0, 0, 0));
+
+    // Depth increases with distance, and flips for back-to-front
+    EXPECT_LT(SysRenderQueue::depth_key(1.0f, 1000.0f), SysRenderQueue::depth_key(10.0f, 1000.0f));
+    EXPECT_GT(SysRenderQueue::depth_key_back_to_front(SysRenderQueue::depth_key(1.0f, 1000.0f)),
+              SysRenderQueue::depth_key_back_to_front(SysRenderQueue::depth_key(10.0f, 1000.0f)));
+}
+
+// Test that radix sort matches a stable comparison sort
+TEST(RenderQueue, Sort)
+{
+    std::mt19937_64 gen(1234);
+
+    for (std::size_t const count : {0u, 1u, 2u, 17u, 1000u, 50000u})
+    {
+        RenderQueue queue;
+        queue.keys.resize(count);
+        queue.ents.resize(count);
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            // Few distinct values in the upper bits, like a real scene with few shaders
+            uint64_t const key = RenderKey::pack(0, uint32_t(gen() % 3), uint32_t(gen() % 4), uint32_t(gen() % 100), 0, uint32_t(gen()));
+            queue.keys[i] = key;
+            queue.ents[i] = DrawEnt::from_index(i);
+        }
+
+        std::vector<std::size_t> expected(count);
+        std::iota(expected.begin(), expected.end(), 0);
+        std::stable_sort(expected.begin(), expected.end(), [&queue] (std::size_t const lhs, std::size_t const rhs)
+        {
+            return queue.keys[lhs] < queue.keys[rhs];
+        });
+
+        SysRenderQueue::sort(queue);
+
+        ASSERT_EQ(queue.keys.size(), count);
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            ASSERT_EQ(queue.ents[i], DrawEnt::from_index(expected[i]));
+        }
+    }
+}
+
+// Test ordering and state changes of a sorted queue of 100k DrawEnts
+TEST(RenderQueue, BuildAndSort100k)
+{
+    constexpr std::size_t count = 100000;
+
+    std::mt19937 gen(5678);
+    std::uniform_real_distribution<float> posDist(-1000.0f, 1000.0f);
+
+    ACtxSceneRender scnRender;
+    std::vector<DrawEnt> ents(count);
+    scnRender.m_drawIds.create(ents.begin(), ents.end());
+    scnRender.resize_draw();
+
+    int dataA = 0;
+    int dataB = 0;
+
+    RenderGroup group;
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        DrawEnt const drawEnt = ents[i];
+        scnRender.m_drawTransform[drawEnt] = Matrix4::translation({posDist(gen), posDist(gen), posDist(gen)});
+        scnRender.m_onScreen.insert(drawEnt);
+
+        // Interleave a few draw functions and materials, as if entities were spawned in a
+        // random order
+        switch (gen() % 4)
+        {
+        case 0: group.entities.emplace(drawEnt, EntityToDraw{&draw_dummy_a, {&dataA}}); break;
+        case 1: group.entities.emplace(drawEnt, EntityToDraw{&draw_dummy_a, {&dataB}}); break;
+        case 2: group.entities.emplace(drawEnt, EntityToDraw{&draw_dummy_b, {&dataA}}); break;
+        case 3: group.entities.emplace(drawEnt, EntityToDraw{&draw_dummy_b, {&dataB}}); break;
+        }
+    }
+
+    Matrix4 const view = Matrix4::translation({0.0f, 0.0f, -2000.0f});
+
+    RenderQueue queue;
+    SysRenderQueue::build(queue, {
+            .group      = group,
+            .visible    = scnRender.m_onScreen,
+            .scnRender  = scnRender,
+            .view       = view,
+            .farPlane   = 10000.0f,
+            .pass       = 0 });
+    SysRenderQueue::sort(queue);
+
+    ASSERT_EQ(queue.ents.size(), count);
+    ASSERT_EQ(queue.shaders.size(), 2u);
+    ASSERT_EQ(queue.materials.size(), 2u);
+    EXPECT_TRUE(std::is_sorted(queue.keys.begin(), queue.keys.end()));
+
+    // Only 4 distinct shader and material combinations, so there should only be 3 changes
+    int stateChanges = 0;
+    for (std::size_t i = 1; i < count; ++i)
+    {
+        EntityToDraw const &prev = group.entities.get(queue.ents[i - 1]);
+        EntityToDraw const &curr = group.entities.get(queue.ents[i]);
+        stateChanges += (prev.draw != curr.draw || prev.data != curr.data) ? 1 : 0;
+    }
+    EXPECT_EQ(stateChanges, 3);
+
+    // Within the same state, closer entities are drawn first
+    for (std::size_t i = 1; i < count; ++i)
+    {
+        EntityToDraw const &prev = group.entities.get(queue.ents[i - 1]);
+        EntityToDraw const &curr = group.entities.get(queue.ents[i]);
+        if (prev.draw == curr.draw && prev.data == curr.data)
+        {
+            float const prevZ = scnRender.m_drawTransform[queue.ents[i - 1]].translation().z();
+            float const currZ = scnRender.m_drawTransform[queue.ents[i]]    .translation().z();
+            ASSERT_GE(prevZ + 1.0f, currZ); // Quantized, allow some slack
+        }
+    }
+
+    // Packets prepared in separate chunks match the queue order
+    ViewProjMatrix const viewProj{view, Matrix4::perspectiveProjection(Deg(45.0f), 1.0f, 1.0f, 10000.0f)};
+    for (std::size_t first = 0; first < count; first += 4096)
+    {
+        SysRenderQueue::prepare_packets(queue, scnRender, viewProj, first, std::min(first + 4096, count));
+    }
+
+    ASSERT_EQ(queue.packets.size(), count);
+    for (std::size_t i = 0; i < count; i += 997)
+    {
+        Matrix4 const &drawTf = scnRender.m_drawTransform[queue.ents[i]];
+        EXPECT_EQ(queue.packets[i].m_viewTf,     view * drawTf);
+        EXPECT_EQ(queue.packets[i].m_viewProjTf, viewProj.m_proj * (view * drawTf));
+        EXPECT_EQ(queue.packets[i].m_normal,     (view * drawTf).normalMatrix());
+    }
+}
+
+// Test that back-to-front queues are ordered by depth alone, furthest first
+TEST(RenderQueue, BackToFront)
+{
+    constexpr std::size_t count = 10000;
+
+    std::mt19937 gen(91011);
+    std::uniform_real_distribution<float> posDist(-1000.0f, 1000.0f);
+
+    ACtxSceneRender scnRender;
+    std::vector<DrawEnt> ents(count);
+    scnRender.m_drawIds.create(ents.begin(), ents.end());
+    scnRender.resize_draw();
+
+    int dataA = 0;
+
+    RenderGroup group;
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        DrawEnt const drawEnt = ents[i];
+        scnRender.m_drawTransform[drawEnt] = Matrix4::translation({posDist(gen), posDist(gen), posDist(gen)});
+        scnRender.m_onScreen.insert(drawEnt);
+        group.entities.emplace(drawEnt, EntityToDraw{(gen() % 2 == 0) ? &draw_dummy_a : &draw_dummy_b, {&dataA}});
+    }
+
+    Matrix4 const view = Matrix4::translation({0.0f, 0.0f, -2000.0f});
+
+    RenderQueue queue;
+    SysRenderQueue::build(queue, {
+            .group          = group,
+            .visible        = scnRender.m_onScreen,
+            .scnRender      = scnRender,
+            .view           = view,
+            .farPlane       = 10000.0f,
+            .pass           = 1,
+            .backToFront    = true });
+    SysRenderQueue::sort(queue);
+
+    ASSERT_EQ(queue.ents.size(), count);
+    EXPECT_TRUE(std::is_sorted(queue.keys.begin(), queue.keys.end()));
+
+    // Only the pass is state, draw functions are interleaved by depth
+    for (uint64_t const key : queue.keys)
+    {
+        EXPECT_EQ(key & queue.stateMask, RenderKey::pack(1, 0, 0, 0, 0, 0));
+    }
+
+    // Camera looks down -Z from z=2000, so lower Z is further away
+    for (std::size_t i = 1; i < count; ++i)
+    {
+        float const prevZ = scnRender.m_drawTransform[queue.ents[i - 1]].translation().z();
+        float const currZ = scnRender.m_drawTransform[queue.ents[i]]    .translation().z();
+        ASSERT_LE(prevZ, currZ + 1.0f); // Quantized, allow some slack
+    }
+}
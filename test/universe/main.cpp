@@ -24,12 +24,27 @@
  */
 #include <osp/universe/universe.h>
 #include <osp/universe/coordinates.h>
+#include <osp/universe/hierarchy.h>
+#include <osp/universe/integrators.h>
+#include <osp/universe/kepler.h>
+#include <osp/universe/nbody.h>
+#include <osp/universe/snapshot.h>
+#include <osp/universe/spatialindex.h>
+#include <osp/universe/transfer.h>
 #include <osp/core/math_2pow.h>
 
+#include <Corrade/Containers/ArrayViewStl.h>
 #include <Magnum/Math/Functions.h>
 
 #include <gtest/gtest.h>
 
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <random>
+
 using namespace osp;
 using namespace osp::universe;
 
@@ -72,6 +87,33 @@ static void expect_inverse(CoordTransformer const& a, CoordTransformer const& b)
     EXPECT_TRUE(d.is_identity());
 }
 
+/**
+ * @brief Partition and allocate satellite positions and velocities, and optionally rotations and masses
+ *
+ * Sets m_satCapacity, but leaves m_satCount to the caller.
+ */
+static void alloc_sats(CoSpaceSatData& rData, std::size_t const capacity, bool const rotations = false, bool const masses = false)
+{
+    std::size_t bytesUsed = 0;
+    partition(bytesUsed, capacity, rData.m_satPositions[0]);
+    partition(bytesUsed, capacity, rData.m_satPositions[1]);
+    partition(bytesUsed, capacity, rData.m_satPositions[2]);
+    partition(bytesUsed, capacity, rData.m_satVelocities[0]);
+    partition(bytesUsed, capacity, rData.m_satVelocities[1]);
+    partition(bytesUsed, capacity, rData.m_satVelocities[2]);
+    if (rotations)
+    {
+        partition(bytesUsed, capacity, rData.m_satRotations[0], rData.m_satRotations[1],
+                                       rData.m_satRotations[2], rData.m_satRotations[3]);
+    }
+    if (masses)
+    {
+        partition(bytesUsed, capacity, rData.m_satMasses);
+    }
+    rData.m_data        = sat_data_alloc(bytesUsed);
+    rData.m_satCapacity = uint32_t(capacity);
+}
+
 
 // Test transforming positions between coordinate spaces using CoordTransformer
 TEST(Universe, CoordTransformer)
@@ -206,3 +248,1381 @@ TEST(Universe, CoordTransformerRotations)
 }
 
 // TODO: Test CoordTransformer for hopping across nested rotated coordinate spaces
+
+// Test aligned satellite data and vectorized integration against a scalar reference
+TEST(Universe, SatIntegrate)
+{
+    constexpr std::size_t   satCount    = 1001; // Odd number, leaves a scalar remainder
+    constexpr int           precision   = 10;
+    constexpr double        deltaTime   = 1.0 / 60.0;
+    constexpr double        gm          = 10000000000.0;
+
+    CoSpaceSatData data;
+    alloc_sats(data, satCount);
+
+    SatPosViews_t const pos = sat_views(data.m_satPositions,  data.m_data, satCount);
+    SatVelViews_t const vel = sat_views(data.m_satVelocities, data.m_data, satCount);
+
+    // Expect each column to start on an aligned address
+    for (int dim = 0; dim < 3; ++dim)
+    {
+        EXPECT_EQ(reinterpret_cast<std::uintptr_t>(&pos[dim][0]) % gc_satDataAlign, 0);
+        EXPECT_EQ(reinterpret_cast<std::uintptr_t>(&vel[dim][0]) % gc_satDataAlign, 0);
+    }
+
+    std::mt19937 gen(42);
+    std::uniform_int_distribution<spaceint_t> posDist(-mul_2pow<spaceint_t, spaceint_t>(20000, precision),
+                                                       mul_2pow<spaceint_t, spaceint_t>(20000, precision));
+    std::uniform_real_distribution<double> velDist(-800.0, 800.0);
+
+    std::vector<Vector3g> expectPos(satCount);
+    std::vector<Vector3d> expectVel(satCount);
+
+    for (std::size_t i = 0; i < satCount; ++i)
+    {
+        expectPos[i] = { posDist(gen), posDist(gen), posDist(gen) };
+        expectVel[i] = { velDist(gen), velDist(gen), velDist(gen) };
+        for (int dim = 0; dim < 3; ++dim)
+        {
+            pos[dim][i] = expectPos[i][dim];
+            vel[dim][i] = expectVel[i][dim];
+        }
+    }
+
+    double const metersPerUnit = mul_2pow<double, spaceint_t>(1.0, -precision);
+    double const posPerVel     = deltaTime / metersPerUnit;
+
+    sat_integrate_positions(pos, vel, posPerVel);
+    sat_accel_central_gravity(pos, vel, metersPerUnit, gm, deltaTime);
+
+    for (std::size_t i = 0; i < satCount; ++i)
+    {
+        Vector3g &rPos = expectPos[i];
+        Vector3d &rVel = expectVel[i];
+        for (int dim = 0; dim < 3; ++dim)
+        {
+            rPos[dim] += spaceint_t(rVel[dim] * posPerVel);
+        }
+        Vector3d const posMeters = Vector3d(rPos) * metersPerUnit;
+        double const r = posMeters.length();
+        rVel += -posMeters * deltaTime * gm / (r * r * r);
+
+        ASSERT_EQ(rPos, Vector3g(pos[0][i], pos[1][i], pos[2][i]));
+        EXPECT_NEAR(rVel.x(), vel[0][i], 1e-9);
+        EXPECT_NEAR(rVel.y(), vel[1][i], 1e-9);
+        EXPECT_NEAR(rVel.z(), vel[2][i], 1e-9);
+    }
+}
+
+// Compare Barnes-Hut accelerations against a direct sum
+TEST(Universe, NBodyBarnesHut)
+{
+    constexpr std::size_t   satCount    = 2000;
+    constexpr int           precision   = 10;
+    constexpr double        deltaTime   = 1.0;
+
+    CoSpaceSatData data;
+    alloc_sats(data, satCount, false, true);
+
+    SatPosViews_t const pos  = sat_views(data.m_satPositions,  data.m_data, satCount);
+    SatVelViews_t const vel  = sat_views(data.m_satVelocities, data.m_data, satCount);
+    SatMassView_t const mass = data.m_satMasses.view(Corrade::Containers::arrayView(data.m_data), satCount);
+
+    // Bodies spread over a 100km cube, clustered in a few places to make the tree uneven
+    std::mt19937 gen(42);
+    std::uniform_real_distribution<double> massDist(1.0e12, 1.0e15);
+    std::normal_distribution<double> clusterDist(0.0, 5000.0);
+    std::uniform_real_distribution<double> centerDist(-50000.0, 50000.0);
+
+    std::array<Vector3d, 4> centers;
+    for (Vector3d &rCenter : centers)
+    {
+        rCenter = {centerDist(gen), centerDist(gen), centerDist(gen)};
+    }
+
+    for (std::size_t i = 0; i < satCount; ++i)
+    {
+        Vector3d const &center = centers[i % centers.size()];
+        for (int dim = 0; dim < 3; ++dim)
+        {
+            double const meters = center[dim] + clusterDist(gen);
+            pos[dim][i] = spaceint_t(mul_2pow<double, spaceint_t>(meters, precision));
+            vel[dim][i] = 0.0;
+        }
+        mass[i] = massDist(gen);
+    }
+
+    double const metersPerUnit = mul_2pow<double, spaceint_t>(1.0, -precision);
+
+    NBodyParams params;
+    params.m_theta = 0.5;
+
+    nbody_accelerate_direct(pos, mass, vel, 0, satCount, metersPerUnit, params, deltaTime);
+
+    std::vector<Vector3d> expectAccel(satCount);
+    for (std::size_t i = 0; i < satCount; ++i)
+    {
+        expectAccel[i] = {vel[0][i], vel[1][i], vel[2][i]};
+        vel[0][i] = vel[1][i] = vel[2][i] = 0.0;
+    }
+
+    NBodyOctree tree;
+    nbody_build(tree, pos, mass, metersPerUnit, params);
+
+    // Split into ranges
+    constexpr std::size_t chunk = 300;
+    for (std::size_t first = 0; first < satCount; first += chunk)
+    {
+        nbody_accelerate(tree, pos, mass, vel, first, std::min(first + chunk, satCount), params, deltaTime);
+    }
+
+    // Every body must be in exactly one leaf
+    std::vector<int> seen(satCount, 0);
+    for (NBodyNode const &node : tree.m_nodes)
+    {
+        if (node.m_descendants == 0)
+        {
+            for (uint32_t i = node.m_bodyFirst; i < node.m_bodyFirst + node.m_bodyCount; ++i)
+            {
+                ++seen[tree.m_bodies[i]];
+            }
+        }
+    }
+    EXPECT_TRUE(std::all_of(seen.begin(), seen.end(), [] (int count) { return count == 1; }));
+
+    // Root contains all mass
+    double totalMass = 0.0;
+    for (std::size_t i = 0; i < satCount; ++i)
+    {
+        totalMass += mass[i];
+    }
+    EXPECT_NEAR(tree.m_nodes[0].m_mass, totalMass, totalMass * 1e-12);
+
+    double maxRelError = 0.0;
+    double sumRelError = 0.0;
+    for (std::size_t i = 0; i < satCount; ++i)
+    {
+        Vector3d const accel{vel[0][i], vel[1][i], vel[2][i]};
+        double const relError = (accel - expectAccel[i]).length() / expectAccel[i].length();
+        maxRelError = std::max(maxRelError, relError);
+        sumRelError += relError;
+    }
+
+    EXPECT_LT(sumRelError / satCount, 0.01);
+    EXPECT_LT(maxRelError, 0.1);
+
+    // Refit after moving bodies must match a fresh build's root
+    for (std::size_t i = 0; i < satCount; ++i)
+    {
+        pos[0][i] += 1000;
+    }
+    nbody_refit(tree, pos, mass);
+    NBodyOctree rebuilt;
+    nbody_build(rebuilt, pos, mass, metersPerUnit, params);
+    Vector3d const refitCom   = tree.m_nodes[0].m_centerOfMass    + Vector3d(tree.m_origin)    * metersPerUnit;
+    Vector3d const rebuiltCom = rebuilt.m_nodes[0].m_centerOfMass + Vector3d(rebuilt.m_origin) * metersPerUnit;
+    EXPECT_NEAR(refitCom.x(), rebuiltCom.x(), 1e-6);
+    EXPECT_NEAR(refitCom.y(), rebuiltCom.y(), 1e-6);
+    EXPECT_NEAR(refitCom.z(), rebuiltCom.z(), 1e-6);
+}
+
+// Refit after a body moved far outside of its node, it must not attract itself
+TEST(Universe, NBodyRefitSelfExclusion)
+{
+    constexpr std::size_t   clusterSize = 16;
+    constexpr std::size_t   satCount    = clusterSize * 2;
+    constexpr int           precision   = 10;
+
+    CoSpaceSatData data;
+    alloc_sats(data, satCount, false, true);
+
+    SatPosViews_t const pos  = sat_views(data.m_satPositions,  data.m_data, satCount);
+    SatVelViews_t const vel  = sat_views(data.m_satVelocities, data.m_data, satCount);
+    SatMassView_t const mass = data.m_satMasses.view(Corrade::Containers::arrayView(data.m_data), satCount);
+
+    auto const to_pos = [] (double meters)
+    {
+        return spaceint_t(mul_2pow<double, spaceint_t>(meters, precision));
+    };
+
+    // Two small clusters 1000km apart
+    std::mt19937 gen(42);
+    std::uniform_real_distribution<double> offsetDist(0.0, 100.0);
+    for (std::size_t i = 0; i < satCount; ++i)
+    {
+        double const clusterX = (i < clusterSize) ? 0.0 : 1.0e6;
+        pos[0][i] = to_pos(clusterX + offsetDist(gen));
+        pos[1][i] = to_pos(offsetDist(gen));
+        pos[2][i] = to_pos(offsetDist(gen));
+        vel[0][i] = vel[1][i] = vel[2][i] = 0.0;
+        mass[i] = 1.0e12;
+    }
+
+    double const metersPerUnit = mul_2pow<double, spaceint_t>(1.0, -precision);
+
+    NBodyParams params;
+    params.m_theta = 0.5;
+
+    NBodyOctree tree;
+    nbody_build(tree, pos, mass, metersPerUnit, params);
+
+    // Move body 0 far away from the first cluster. Its old nodes are now small and far away,
+    // and their centers of mass include body 0 itself.
+    pos[1][0] = to_pos(5.0e5);
+    nbody_refit(tree, pos, mass);
+
+    nbody_accelerate_direct(pos, mass, vel, 0, satCount, metersPerUnit, params, 1.0);
+
+    std::vector<Vector3d> expectAccel(satCount);
+    for (std::size_t i = 0; i < satCount; ++i)
+    {
+        expectAccel[i] = {vel[0][i], vel[1][i], vel[2][i]};
+        vel[0][i] = vel[1][i] = vel[2][i] = 0.0;
+    }
+
+    nbody_accelerate(tree, pos, mass, vel, 0, satCount, params, 1.0);
+
+    for (std::size_t i = 0; i < satCount; ++i)
+    {
+        Vector3d const accel{vel[0][i], vel[1][i], vel[2][i]};
+        ASSERT_TRUE(std::isfinite(accel.dot()));
+    }
+
+    // Approximating any node that holds body 0 would include its own mass, and be far off
+    Vector3d const accel{vel[0][0], vel[1][0], vel[2][0]};
+    EXPECT_LT((accel - expectAccel[0]).length() / expectAccel[0].length(), 1e-3);
+
+    // Same as a fresh build once rebuilt
+    nbody_build(tree, pos, mass, metersPerUnit, params);
+    vel[0][0] = vel[1][0] = vel[2][0] = 0.0;
+    nbody_accelerate(tree, pos, mass, vel, 0, 1, params, 1.0);
+    Vector3d const rebuiltAccel{vel[0][0], vel[1][0], vel[2][0]};
+    EXPECT_LT((rebuiltAccel - expectAccel[0]).length() / expectAccel[0].length(), 1e-3);
+}
+
+// Test grouping CoSpaces by depth, and stepping children after their parent satellites move
+TEST(Universe, CoSpaceLevels)
+{
+    Universe universe;
+
+    // 0 -> 1 -> 3
+    //   -> 2
+    // 4
+    std::array<CoSpaceId, 5> ids;
+    universe.m_coordIds.create(ids.begin(), ids.end());
+    universe.m_coordCommon.resize(universe.m_coordIds.capacity());
+
+    universe.m_coordCommon[ids[1]].m_parent     = ids[0];
+    universe.m_coordCommon[ids[1]].m_parentSat  = 1;
+    universe.m_coordCommon[ids[2]].m_parent     = ids[0];
+    universe.m_coordCommon[ids[3]].m_parent     = ids[1];
+
+    CoSpaceLevels levels;
+    coord_levels_build(levels, universe);
+
+    ASSERT_EQ(levels.level_count(), 3);
+    ASSERT_EQ(levels.level(0).size(), 2);
+    ASSERT_EQ(levels.level(1).size(), 2);
+    ASSERT_EQ(levels.level(2).size(), 1);
+    EXPECT_EQ(levels.level(0)[0], ids[0]);
+    EXPECT_EQ(levels.level(0)[1], ids[4]);
+    EXPECT_EQ(levels.level(1)[0], ids[1]);
+    EXPECT_EQ(levels.level(1)[1], ids[2]);
+    EXPECT_EQ(levels.level(2)[0], ids[3]);
+
+    // Give the root CoSpace two moving satellites
+    constexpr std::size_t satCount = 2;
+    CoSpaceCommon &rRoot = universe.m_coordCommon[ids[0]];
+    rRoot.m_satCount = satCount;
+    alloc_sats(rRoot, satCount, true);
+
+    auto const [x, y, z]        = sat_views(rRoot.m_satPositions,  rRoot.m_data, satCount);
+    auto const [vx, vy, vz]     = sat_views(rRoot.m_satVelocities, rRoot.m_data, satCount);
+    auto const [qx, qy, qz, qw] = sat_views(rRoot.m_satRotations,  rRoot.m_data, satCount);
+
+    Quaterniond const rot = Quaterniond::rotation(Radd{0.5}, Vector3d{0.0, 0.0, 1.0});
+    for (std::size_t i = 0; i < satCount; ++i)
+    {
+        x[i]  = 1000 * spaceint_t(i);
+        y[i]  = 0;
+        z[i]  = 0;
+        vx[i] = 0.0;
+        vy[i] = 2.0;
+        vz[i] = 0.0;
+        qx[i] = rot.vector().x();
+        qy[i] = rot.vector().y();
+        qz[i] = rot.vector().z();
+        qw[i] = rot.scalar();
+    }
+
+    // Step 1 second, level by level. No acceleration models, satellites only drift
+    SatIntegratorScratch scratch;
+    for (std::size_t depth = 0; depth < levels.level_count(); ++depth)
+    {
+        coord_step_range(universe, levels.level(depth), {}, scratch, 1.0);
+    }
+
+    // 2 m/s for 1 second, default precision of 10 = 2048 units
+    EXPECT_EQ(y[1], 2048);
+
+    // Child 1 follows satellite 1, child 2 has no parent satellite and stays put
+    CoSpaceCommon const &child1 = universe.m_coordCommon[ids[1]];
+    CoSpaceCommon const &child2 = universe.m_coordCommon[ids[2]];
+    EXPECT_EQ(child1.m_position, Vector3g(1000, 2048, 0));
+    EXPECT_EQ(child1.m_rotation, rot);
+    EXPECT_EQ(child2.m_position, Vector3g(0, 0, 0));
+}
+
+// Compare batched transforms against CoordTransformer::transform_position
+TEST(Universe, CoordTransformBatch)
+{
+    constexpr std::size_t satCount = 1001;
+
+    CoSpaceSatData data;
+    alloc_sats(data, satCount);
+
+    SatPosViews_t const pos = sat_views(data.m_satPositions, data.m_data, satCount);
+
+    std::mt19937 gen(42);
+    std::uniform_int_distribution<spaceint_t> posDist(-sci64(150, 9, 10), sci64(150, 9, 10));
+    for (std::size_t i = 0; i < satCount; ++i)
+    {
+        pos[0][i] = posDist(gen);
+        pos[1][i] = posDist(gen);
+        pos[2][i] = posDist(gen);
+    }
+
+    CoSpaceTransform const parent { .m_precision = 10 };
+    CoSpaceTransform const child
+    {
+        .m_rotation  = Quaterniond::rotation(37.0_deg, Vector3d{1.0, 2.0, 3.0}.normalized()),
+        .m_position  = {sci64(150, 9, 10), sci64(-20, 9, 10), sci64(42, 0, 10)},
+        .m_precision = 13
+    };
+    CoSpaceTransform const unrotated
+    {
+        .m_position  = {sci64(5, 6, 10), sci64(7, 6, 10), sci64(-3, 6, 10)},
+        .m_precision = 8
+    };
+
+    std::array<CoordTransformer, 4> const transformers
+    {
+        coord_parent_to_child(parent, child),       // rotate out, n > 0
+        coord_child_to_parent(parent, child),       // rotate in, n < 0
+        coord_parent_to_child(parent, unrotated),   // no rotation, n < 0
+        coord_child_to_parent(parent, unrotated)    // no rotation, n > 0
+    };
+
+    std::vector<spaceint_t> outData(satCount * 3);
+    std::vector<Vector3>    outMeters(satCount);
+    SatPosViews_t const out
+    {
+        Corrade::Containers::arrayView(outData).slice(0,            satCount),
+        Corrade::Containers::arrayView(outData).slice(satCount,     satCount * 2),
+        Corrade::Containers::arrayView(outData).slice(satCount * 2, satCount * 3)
+    };
+    SatPosViewsConst_t const in{pos[0], pos[1], pos[2]};
+
+    for (CoordTransformer const &tf : transformers)
+    {
+        coord_transform_positions(tf, in, out);
+        coord_transform_positions_meters(tf, in, 1.0 / 1024.0, Corrade::Containers::arrayView(outMeters));
+
+        for (std::size_t i = 0; i < satCount; ++i)
+        {
+            Vector3g const expected = tf.transform_position({pos[0][i], pos[1][i], pos[2][i]});
+            expect_near_vec(Vector3g(out[0][i], out[1][i], out[2][i]), expected, 2);
+            EXPECT_NEAR(outMeters[i].x(), float(double(expected.x()) / 1024.0), std::abs(outMeters[i].x()) * 1e-6f + 0.01f);
+        }
+    }
+}
+
+// Test cached transforms between CoSpaces in different branches of the hierarchy
+TEST(Universe, CoordTransformCache)
+{
+    Universe universe;
+
+    // 0 -> 1 -> 2
+    //   -> 3
+    std::array<CoSpaceId, 4> ids;
+    universe.m_coordIds.create(ids.begin(), ids.end());
+    universe.m_coordCommon.resize(universe.m_coordIds.capacity());
+
+    CoSpaceCommon &rPlanet  = universe.m_coordCommon[ids[1]];
+    CoSpaceCommon &rMoon    = universe.m_coordCommon[ids[2]];
+    CoSpaceCommon &rStation = universe.m_coordCommon[ids[3]];
+
+    rPlanet.m_parent        = ids[0];
+    rPlanet.m_position      = {sci64(150, 9, 10), sci64(150, 9, 10), 0};
+    rPlanet.m_rotation      = Quaterniond::rotation(90.0_deg, {0.0, 0.0, 1.0});
+    rPlanet.m_precision     = 12;
+    rMoon.m_parent          = ids[1];
+    rMoon.m_position        = {sci64(400, 6, 12), 0, 0};
+    rMoon.m_precision       = 14;
+    rStation.m_parent       = ids[0];
+    rStation.m_position     = {sci64(-30, 9, 10), 0, sci64(2, 6, 10)};
+    rStation.m_precision    = 10;
+
+    // Manually composite moon -> planet -> sun -> station
+    CoSpaceCommon const &sun = universe.m_coordCommon[ids[0]];
+    CoordTransformer const moonToStation = coord_composite(
+            coord_parent_to_child(sun, rStation),
+            coord_composite(coord_child_to_parent(sun, rPlanet), coord_child_to_parent(rPlanet, rMoon)));
+
+    CoordTransformCache cache;
+
+    CoordTransformer const between = coord_transformer_between(universe, ids[2], ids[3]);
+    CoordTransformer const cached  = coord_cached_transformer(cache, universe, ids[2], ids[3]);
+
+    Vector3g const testPos{sci64(1, 6, 14), sci64(-2, 6, 14), sci64(3, 3, 14)};
+    EXPECT_EQ(between.transform_position(testPos), moonToStation.transform_position(testPos));
+    EXPECT_EQ(cached.transform_position(testPos),  moonToStation.transform_position(testPos));
+
+    // Station's origin in the station's own space is zero
+    EXPECT_EQ(coord_cached_transformer(cache, universe, ids[0], ids[3]).transform_position(rStation.m_position), gc_v3gZero);
+
+    // Moving the planet must invalidate the cached moon -> station transform once announced
+    rPlanet.m_position.x() += sci64(1, 3, 10);
+    EXPECT_EQ(coord_cached_transformer(cache, universe, ids[2], ids[3]).transform_position(testPos),
+              cached.transform_position(testPos));
+    coord_transform_changed(rPlanet);
+    CoordTransformer const moved = coord_cached_transformer(cache, universe, ids[2], ids[3]);
+    EXPECT_EQ(moved.transform_position(testPos),
+              coord_transformer_between(universe, ids[2], ids[3]).transform_position(testPos));
+    EXPECT_NE(moved.transform_position(testPos), cached.transform_position(testPos));
+
+    // Invalidating the moon removes entries that pass through it
+    std::size_t const before = cache.m_entries.size();
+    coord_cache_invalidate(cache, ids[2]);
+    EXPECT_EQ(cache.m_entries.size(), before - 1);
+}
+
+// Move satellites into a rotating, moving CoSpace that starts with no capacity
+TEST(Universe, SatTransfer)
+{
+    Universe universe;
+
+    // 0 -> 1 (parent sat 0)
+    //   -> 2 (parent sat 5)
+    //   -> 3 (parent sat 4)
+    std::array<CoSpaceId, 4> ids;
+    universe.m_coordIds.create(ids.begin(), ids.end());
+    universe.m_coordCommon.resize(universe.m_coordIds.capacity());
+
+    constexpr std::size_t rootSatCount = 6;
+    CoSpaceCommon &rRoot  = universe.m_coordCommon[ids[0]];
+    CoSpaceCommon &rChild = universe.m_coordCommon[ids[1]];
+    alloc_sats(rRoot, rootSatCount, true, true);
+    alloc_sats(rChild, 0, true, true);
+    rRoot.m_satCount = rootSatCount;
+
+    Quaterniond const childRot = Quaterniond::rotation(Radd{0.5 * 3.14159265358979323846}, Vector3d{0.0, 0.0, 1.0});
+    auto const sat_rot = [] (std::size_t const i)
+    {
+        return Quaterniond::rotation(Radd{0.1 * double(i)}, Vector3d{1.0, 0.0, 0.0});
+    };
+
+    {
+        auto const [x, y, z]        = sat_views(rRoot.m_satPositions,  rRoot.m_data, rootSatCount);
+        auto const [vx, vy, vz]     = sat_views(rRoot.m_satVelocities, rRoot.m_data, rootSatCount);
+        auto const [qx, qy, qz, qw] = sat_views(rRoot.m_satRotations,  rRoot.m_data, rootSatCount);
+        auto const mass             = rRoot.m_satMasses.view(Corrade::Containers::arrayView(rRoot.m_data), rootSatCount);
+
+        for (std::size_t i = 0; i < rootSatCount; ++i)
+        {
+            Quaterniond const rot = (i == 0) ? childRot : sat_rot(i);
+            x[i]    = 1000 * spaceint_t(i);
+            y[i]    = 500 * spaceint_t(i);
+            z[i]    = 0;
+            vx[i]   = (i == 0) ? 3.0 : 0.0;
+            vy[i]   = 0.0;
+            vz[i]   = double(i);
+            qx[i]   = rot.vector().x();
+            qy[i]   = rot.vector().y();
+            qz[i]   = rot.vector().z();
+            qw[i]   = rot.scalar();
+            mass[i] = 100.0 + double(i);
+        }
+    }
+
+    std::array<SatId, 4> const parentSats{lgrn::id_null<SatId>(), 0, 5, 4};
+    for (std::size_t i = 1; i < ids.size(); ++i)
+    {
+        CoSpaceCommon &rCommon = universe.m_coordCommon[ids[i]];
+        rCommon.m_parent    = ids[0];
+        rCommon.m_parentSat = parentSats[i];
+        coord_sync_parent_sat(rCommon, rRoot);
+    }
+
+    // Sat 4 leaves first and sat 5 is swapped into its place, then sat 1 leaves and sat 5 (now
+    // at 4) is swapped again into 1
+    std::vector<SatTransfer> const transfers{ {ids[0], 4, ids[1]}, {ids[0], 1, ids[1]} };
+    std::vector<SatRemap> remaps;
+    sat_transfer(universe, transfers, remaps);
+
+    ASSERT_EQ(rRoot.m_satCount, 4);
+    ASSERT_EQ(rChild.m_satCount, 2);
+    EXPECT_GE(rChild.m_satCapacity, 2);
+
+    auto const find_remap = [&remaps] (CoSpaceId const coSpace, SatId const sat) -> SatRemap const*
+    {
+        auto const found = std::find_if(remaps.begin(), remaps.end(), [&] (SatRemap const& remap)
+        {
+            return remap.m_oldCoSpace == coSpace && remap.m_oldSat == sat;
+        });
+        return (found != remaps.end()) ? &*found : nullptr;
+    };
+
+    ASSERT_EQ(remaps.size(), 3);
+    ASSERT_NE(find_remap(ids[0], 1), nullptr);
+    ASSERT_NE(find_remap(ids[0], 4), nullptr);
+    ASSERT_NE(find_remap(ids[0], 5), nullptr);
+    EXPECT_EQ(find_remap(ids[0], 1)->m_newCoSpace, ids[1]);
+    EXPECT_EQ(find_remap(ids[0], 1)->m_newSat, 0);
+    EXPECT_EQ(find_remap(ids[0], 4)->m_newCoSpace, ids[1]);
+    EXPECT_EQ(find_remap(ids[0], 4)->m_newSat, 1);
+    EXPECT_EQ(find_remap(ids[0], 5)->m_newCoSpace, ids[0]);
+    EXPECT_EQ(find_remap(ids[0], 5)->m_newSat, 1);
+
+    // Old sat 5 is intact in its new slot
+    {
+        auto const [x, y, z]        = sat_views(rRoot.m_satPositions,  rRoot.m_data, rRoot.m_satCount);
+        auto const [vx, vy, vz]     = sat_views(rRoot.m_satVelocities, rRoot.m_data, rRoot.m_satCount);
+        auto const [qx, qy, qz, qw] = sat_views(rRoot.m_satRotations,  rRoot.m_data, rRoot.m_satCount);
+        auto const mass             = rRoot.m_satMasses.view(Corrade::Containers::arrayView(rRoot.m_data), rRoot.m_satCount);
+
+        EXPECT_EQ(Vector3g(x[1], y[1], z[1]), Vector3g(5000, 2500, 0));
+        EXPECT_EQ(vz[1], 5.0);
+        EXPECT_EQ(Quaterniond({qx[1], qy[1], qz[1]}, qw[1]), sat_rot(5));
+        EXPECT_EQ(mass[1], 105.0);
+        EXPECT_EQ(mass[3], 103.0);
+    }
+
+    // Child CoSpace is rotated 90 degrees about Z and moving at 3 m/s along X
+    auto const check_child = [&] (SatId const sat, std::size_t const original, Vector3g const expectPos)
+    {
+        auto const [x, y, z]        = sat_views(rChild.m_satPositions,  rChild.m_data, rChild.m_satCount);
+        auto const [vx, vy, vz]     = sat_views(rChild.m_satVelocities, rChild.m_data, rChild.m_satCount);
+        auto const [qx, qy, qz, qw] = sat_views(rChild.m_satRotations,  rChild.m_data, rChild.m_satCount);
+        auto const mass             = rChild.m_satMasses.view(Corrade::Containers::arrayView(rChild.m_data), rChild.m_satCount);
+
+        expect_near_vec(Vector3g(x[sat], y[sat], z[sat]), expectPos, 1);
+
+        Vector3d const expectVel = childRot.inverted().transformVector(Vector3d{-3.0, 0.0, double(original)});
+        EXPECT_NEAR((Vector3d{vx[sat], vy[sat], vz[sat]} - expectVel).length(), 0.0, 1e-9);
+
+        Quaterniond const expectRot = childRot.inverted() * sat_rot(original);
+        EXPECT_NEAR(double(Magnum::Math::angle(Quaterniond({qx[sat], qy[sat], qz[sat]}, qw[sat]), expectRot)), 0.0, 1e-6);
+
+        EXPECT_EQ(mass[sat], 100.0 + double(original));
+    };
+
+    check_child(0, 1, {500, -1000, 0});
+    check_child(1, 4, {2000, -4000, 0});
+
+    // CoSpaces follow their parent satellites
+    CoSpaceCommon const &swappedFollower  = universe.m_coordCommon[ids[2]];
+    CoSpaceCommon const &movedFollower    = universe.m_coordCommon[ids[3]];
+    EXPECT_EQ(swappedFollower.m_parent, ids[0]);
+    EXPECT_EQ(swappedFollower.m_parentSat, 1);
+    EXPECT_EQ(movedFollower.m_parent, ids[1]);
+    EXPECT_EQ(movedFollower.m_parentSat, 1);
+    expect_near_vec(movedFollower.m_position, {2000, -4000, 0}, 1);
+
+    // One more forces the child to grow again, keeping its existing satellites
+    remaps.clear();
+    std::vector<SatTransfer> const transfers2{ {ids[0], 3, ids[1]} };
+    sat_transfer(universe, transfers2, remaps);
+
+    ASSERT_EQ(rRoot.m_satCount, 3);
+    ASSERT_EQ(rChild.m_satCount, 3);
+    EXPECT_EQ(rChild.m_satCapacity, 4);
+    EXPECT_EQ(remaps.size(), 1);
+
+    check_child(0, 1, {500, -1000, 0});
+    check_child(1, 4, {2000, -4000, 0});
+    check_child(2, 3, {1500, -3000, 0});
+}
+
+// Move satellites into CoSpaces that only use some columns, or were never partitioned at all
+TEST(Universe, SatTransferSparse)
+{
+    Universe universe;
+
+    std::array<CoSpaceId, 3> ids;
+    universe.m_coordIds.create(ids.begin(), ids.end());
+    universe.m_coordCommon.resize(universe.m_coordIds.capacity());
+
+    constexpr std::size_t rootSatCount = 8;
+    CoSpaceCommon &rRoot   = universe.m_coordCommon[ids[0]];
+    CoSpaceCommon &rSparse = universe.m_coordCommon[ids[1]];
+    CoSpaceCommon &rEmpty  = universe.m_coordCommon[ids[2]];
+    alloc_sats(rRoot, rootSatCount, true, true);
+    rRoot.m_satCount = rootSatCount;
+
+    // Both children sit at the root's origin, with no rotation
+    rSparse.m_parent = ids[0];
+    rEmpty.m_parent  = ids[0];
+
+    // Positions and velocities only, with one satellite already in it and no room for more
+    alloc_sats(rSparse, 1);
+    rSparse.m_satCount = 1;
+    {
+        auto const [x, y, z]    = sat_views(rSparse.m_satPositions,  rSparse.m_data, 1);
+        auto const [vx, vy, vz] = sat_views(rSparse.m_satVelocities, rSparse.m_data, 1);
+        x[0] = 7;
+        y[0] = 8;
+        z[0] = 9;
+        vx[0] = vy[0] = vz[0] = -1.0;
+    }
+
+    // rEmpty keeps its default layout, where every column is unused and m_data is empty
+
+    {
+        auto const [x, y, z]        = sat_views(rRoot.m_satPositions,  rRoot.m_data, rootSatCount);
+        auto const [vx, vy, vz]     = sat_views(rRoot.m_satVelocities, rRoot.m_data, rootSatCount);
+        auto const [qx, qy, qz, qw] = sat_views(rRoot.m_satRotations,  rRoot.m_data, rootSatCount);
+        auto const mass             = rRoot.m_satMasses.view(Corrade::Containers::arrayView(rRoot.m_data), rootSatCount);
+
+        for (std::size_t i = 0; i < rootSatCount; ++i)
+        {
+            x[i]    = 100 * spaceint_t(i);
+            y[i]    = -100 * spaceint_t(i);
+            z[i]    = 1;
+            vx[i]   = double(i);
+            vy[i]   = 0.0;
+            vz[i]   = 0.0;
+            qx[i]   = qy[i] = qz[i] = 0.0;
+            qw[i]   = 1.0;
+            mass[i] = 100.0 + double(i);
+        }
+    }
+
+    std::vector<SatTransfer> const transfers{
+        {ids[0], 2, ids[1]}, {ids[0], 3, ids[1]}, {ids[0], 5, ids[1]},
+        {ids[0], 6, ids[2]}, {ids[0], 7, ids[2]} };
+    std::vector<SatRemap> remaps;
+    sat_transfer(universe, transfers, remaps);
+
+    ASSERT_EQ(rRoot.m_satCount, 3);
+    ASSERT_EQ(rSparse.m_satCount, 4);
+    ASSERT_EQ(rEmpty.m_satCount, 2);
+
+    // Sparse CoSpace grew, keeping its layout and its existing satellite
+    EXPECT_GE(rSparse.m_satCapacity, 4);
+    EXPECT_TRUE(rSparse.m_satRotations[0].not_used());
+    EXPECT_TRUE(rSparse.m_satMasses.not_used());
+    {
+        auto const [x, y, z]    = sat_views(rSparse.m_satPositions,  rSparse.m_data, rSparse.m_satCount);
+        auto const [vx, vy, vz] = sat_views(rSparse.m_satVelocities, rSparse.m_data, rSparse.m_satCount);
+
+        EXPECT_EQ(Vector3g(x[0], y[0], z[0]), Vector3g(7, 8, 9));
+        EXPECT_EQ(vx[0], -1.0);
+
+        std::array<std::size_t, 3> const originals{2, 3, 5};
+        for (std::size_t i = 0; i < originals.size(); ++i)
+        {
+            auto const o = spaceint_t(originals[i]);
+            EXPECT_EQ(Vector3g(x[i + 1], y[i + 1], z[i + 1]), Vector3g(100 * o, -100 * o, 1));
+            EXPECT_EQ(vx[i + 1], double(originals[i]));
+        }
+    }
+
+    // Never-partitioned CoSpace only gets positions
+    EXPECT_GE(rEmpty.m_satCapacity, 2);
+    EXPECT_FALSE(rEmpty.m_satPositions[0].not_used());
+    EXPECT_TRUE(rEmpty.m_satVelocities[0].not_used());
+    EXPECT_TRUE(rEmpty.m_satRotations[0].not_used());
+    EXPECT_TRUE(rEmpty.m_satMasses.not_used());
+    {
+        auto const [x, y, z] = sat_views(rEmpty.m_satPositions, rEmpty.m_data, rEmpty.m_satCount);
+        EXPECT_EQ(Vector3g(x[0], y[0], z[0]), Vector3g(600, -600, 1));
+        EXPECT_EQ(Vector3g(x[1], y[1], z[1]), Vector3g(700, -700, 1));
+    }
+
+    // Transferring back into the full CoSpace gives it defaults for the columns that were dropped
+    remaps.clear();
+    std::vector<SatTransfer> const transfersBack{ {ids[2], 0, ids[0]} };
+    sat_transfer(universe, transfersBack, remaps);
+    ASSERT_EQ(rRoot.m_satCount, 4);
+    ASSERT_EQ(rEmpty.m_satCount, 1);
+    {
+        auto const [x, y, z]        = sat_views(rRoot.m_satPositions,  rRoot.m_data, rRoot.m_satCount);
+        auto const [vx, vy, vz]     = sat_views(rRoot.m_satVelocities, rRoot.m_data, rRoot.m_satCount);
+        auto const [qx, qy, qz, qw] = sat_views(rRoot.m_satRotations,  rRoot.m_data, rRoot.m_satCount);
+        EXPECT_EQ(Vector3g(x[3], y[3], z[3]), Vector3g(600, -600, 1));
+        EXPECT_EQ(Vector3d(vx[3], vy[3], vz[3]), Vector3d(0.0));
+        EXPECT_EQ(Quaterniond({qx[3], qy[3], qz[3]}, qw[3]), Quaterniond{});
+    }
+}
+
+// Save, load, and incrementally save a Universe
+TEST(Universe, Snapshot)
+{
+    std::string const path = (std::filesystem::temp_directory_path() / "osp_test_universe_snapshot.bin").string();
+
+    // 0: Satellites with masses, 1: Satellites without masses, 2: removed, 3: no satellites
+    Universe universe;
+    std::array<CoSpaceId, 4> ids;
+    universe.m_coordIds.create(ids.begin(), ids.end());
+    universe.m_coordIds.remove(ids[2]);
+    universe.m_coordCommon.resize(universe.m_coordIds.capacity());
+
+    auto const init_sats = [] (CoSpaceCommon& rCommon, std::size_t const count, bool const hasMass, int const seed)
+    {
+        alloc_sats(rCommon, count, true, hasMass);
+        rCommon.m_satCount = uint32_t(count);
+
+        // Fill every byte, including padding between partitions
+        std::mt19937 gen(seed);
+        std::uniform_int_distribution<int> byteDist(0, 255);
+        for (unsigned char &rByte : rCommon.m_data)
+        {
+            rByte = static_cast<unsigned char>(byteDist(gen));
+        }
+    };
+
+    CoSpaceCommon &rRoot  = universe.m_coordCommon[ids[0]];
+    CoSpaceCommon &rChild = universe.m_coordCommon[ids[1]];
+    init_sats(rRoot, 1000, true, 1);
+    init_sats(rChild, 10, false, 2);
+    rChild.m_parent     = ids[0];
+    rChild.m_parentSat  = 5;
+    rChild.m_precision  = 8;
+    rChild.m_position   = {1, -2, 3};
+    rChild.m_rotation   = Quaterniond::rotation(Radd{0.25}, Vector3d{0.0, 1.0, 0.0});
+    universe.m_coordCommon[ids[3]].m_parent = ids[0];
+
+    auto const expect_same = [] (Universe const& a, Universe const& b)
+    {
+        ASSERT_EQ(a.m_coordIds.capacity(), b.m_coordIds.capacity());
+        for (CoSpaceId id = 0; id < a.m_coordIds.capacity(); ++id)
+        {
+            ASSERT_EQ(a.m_coordIds.exists(id), b.m_coordIds.exists(id));
+            if ( ! a.m_coordIds.exists(id) )
+            {
+                continue;
+            }
+            CoSpaceCommon const &ca = a.m_coordCommon[id];
+            CoSpaceCommon const &cb = b.m_coordCommon[id];
+            EXPECT_EQ(ca.m_parent,      cb.m_parent);
+            EXPECT_EQ(ca.m_parentSat,   cb.m_parentSat);
+            EXPECT_EQ(ca.m_precision,   cb.m_precision);
+            EXPECT_EQ(ca.m_position,    cb.m_position);
+            EXPECT_EQ(ca.m_rotation,    cb.m_rotation);
+            EXPECT_EQ(ca.m_satCount,    cb.m_satCount);
+            EXPECT_EQ(ca.m_satCapacity, cb.m_satCapacity);
+            EXPECT_EQ(ca.m_satPositions[1].m_offset, cb.m_satPositions[1].m_offset);
+            EXPECT_EQ(ca.m_satRotations[3].m_stride, cb.m_satRotations[3].m_stride);
+            EXPECT_EQ(ca.m_satMasses.not_used(),     cb.m_satMasses.not_used());
+            ASSERT_EQ(ca.m_data.size(), cb.m_data.size());
+            EXPECT_TRUE(std::equal(ca.m_data.begin(), ca.m_data.end(), cb.m_data.begin()));
+        }
+    };
+
+    UniverseSnapshot snapshot;
+    ASSERT_EQ(snapshot_save(universe, path, snapshot), ESnapshotResult::Success);
+    EXPECT_EQ(snapshot.m_blobsWritten, 2);
+
+    Universe loaded;
+    UniverseSnapshot loadedSnapshot;
+    ASSERT_EQ(snapshot_load(loaded, path, loadedSnapshot), ESnapshotResult::Success);
+    expect_same(universe, loaded);
+
+    // Satellite data points straight into the page-aligned mapping
+    CoSpaceCommon &rLoadedChild = loaded.m_coordCommon[ids[1]];
+    EXPECT_EQ(reinterpret_cast<std::uintptr_t>(rLoadedChild.m_data.data()) % gc_snapshotPageSize, 0);
+    EXPECT_GE(rLoadedChild.m_data.data(), loaded.m_snapshotMapping.data());
+
+    // Saving again with nothing changed writes no blobs
+    ASSERT_EQ(snapshot_save(universe, path, snapshot), ESnapshotResult::Success);
+    EXPECT_EQ(snapshot.m_blobsWritten, 0);
+
+    // Modifying the loaded Universe doesn't touch the file until saved. The file changed since
+    // loadedSnapshot was made, so this save is a full one.
+    auto const [x, y, z] = sat_views(rLoadedChild.m_satPositions, rLoadedChild.m_data, rLoadedChild.m_satCount);
+    x[3] = 123456789;
+    {
+        Universe reloaded;
+        UniverseSnapshot reloadedSnapshot;
+        ASSERT_EQ(snapshot_load(reloaded, path, reloadedSnapshot), ESnapshotResult::Success);
+        expect_same(universe, reloaded);
+    }
+
+    ASSERT_EQ(snapshot_save(loaded, path, loadedSnapshot), ESnapshotResult::Success);
+    EXPECT_EQ(loadedSnapshot.m_blobsWritten, 2);
+
+    // Incremental save, only the changed CoSpace is written
+    x[4] = 987654321;
+    auto const fileSizeBefore = std::filesystem::file_size(path);
+    ASSERT_EQ(snapshot_save(loaded, path, loadedSnapshot), ESnapshotResult::Success);
+    EXPECT_EQ(loadedSnapshot.m_blobsWritten, 1);
+    EXPECT_LT(std::filesystem::file_size(path) - fileSizeBefore, rLoadedChild.m_data.size() + 2 * gc_snapshotPageSize);
+
+    {
+        Universe reloaded;
+        UniverseSnapshot reloadedSnapshot;
+        ASSERT_EQ(snapshot_load(reloaded, path, reloadedSnapshot), ESnapshotResult::Success);
+        expect_same(loaded, reloaded);
+    }
+
+    // snapshot last saw the file before loadedSnapshot's full save. Generations never repeat, so
+    // it can't mistake the new file for the one it saw and must do a full save.
+    EXPECT_GT(loadedSnapshot.m_generation, snapshot.m_generation);
+    ASSERT_EQ(snapshot_save(universe, path, snapshot), ESnapshotResult::Success);
+    EXPECT_EQ(snapshot.m_blobsWritten, 2);
+
+    std::filesystem::remove(path);
+
+    Universe missing;
+    UniverseSnapshot missingSnapshot;
+    EXPECT_EQ(snapshot_load(missing, path, missingSnapshot), ESnapshotResult::CantOpenFile);
+}
+
+// Snapshots with bad directory records must be rejected without touching the Universe
+TEST(Universe, SnapshotCorrupt)
+{
+    std::string const path = (std::filesystem::temp_directory_path() / "osp_test_universe_snapshot_corrupt.bin").string();
+
+    // 0 -> 1
+    Universe universe;
+    std::array<CoSpaceId, 2> ids;
+    universe.m_coordIds.create(ids.begin(), ids.end());
+    universe.m_coordCommon.resize(universe.m_coordIds.capacity());
+    alloc_sats(universe.m_coordCommon[ids[0]], 4);
+    universe.m_coordCommon[ids[0]].m_satCount = 4;
+    universe.m_coordCommon[ids[1]].m_parent     = ids[0];
+    universe.m_coordCommon[ids[1]].m_parentSat  = 2;
+
+    UniverseSnapshot snapshot;
+    ASSERT_EQ(snapshot_save(universe, path, snapshot), ESnapshotResult::Success);
+
+    std::vector<char> original(std::filesystem::file_size(path));
+    {
+        std::ifstream file(path, std::ios::in | std::ios::binary);
+        file.read(original.data(), std::streamsize(original.size()));
+    }
+
+    // Offsets within the file format, see snapshot.cpp
+    constexpr std::size_t headerDirOffset   = 32;
+    constexpr std::size_t recordSize        = 280;
+    constexpr std::size_t recordId          = 0;
+    constexpr std::size_t recordParent      = 4;
+    constexpr std::size_t recordParentSat   = 8;
+    constexpr std::size_t recordDataOffset  = 80;
+
+    uint64_t dirOffset;
+    std::memcpy(&dirOffset, original.data() + headerDirOffset, sizeof(dirOffset));
+
+    // Write a modified copy of the file, then try loading it
+    auto const load_patched = [&] (std::size_t const record, std::size_t const field, auto const value)
+    {
+        std::vector<char> patched = original;
+        std::memcpy(patched.data() + dirOffset + record * recordSize + field, &value, sizeof(value));
+        {
+            std::ofstream file(path, std::ios::out | std::ios::trunc | std::ios::binary);
+            file.write(patched.data(), std::streamsize(patched.size()));
+        }
+        Universe loaded;
+        UniverseSnapshot loadedSnapshot;
+        ESnapshotResult const result = snapshot_load(loaded, path, loadedSnapshot);
+        EXPECT_TRUE(loaded.m_coordCommon.empty());
+        return result;
+    };
+
+    EXPECT_EQ(load_patched(1, recordId,         uint32_t(0)),           ESnapshotResult::Corrupt); // Duplicate
+    EXPECT_EQ(load_patched(1, recordId,         uint32_t(0xFFFFFFFF)),  ESnapshotResult::Corrupt); // Absurd ID
+    EXPECT_EQ(load_patched(0, recordParent,     uint32_t(1)),           ESnapshotResult::Corrupt); // 0 -> 1 -> 0
+    EXPECT_EQ(load_patched(1, recordParent,     uint32_t(7)),           ESnapshotResult::Corrupt); // Missing parent
+    EXPECT_EQ(load_patched(1, recordParentSat,  uint32_t(4)),           ESnapshotResult::Corrupt); // Missing satellite
+
+    // Wraps around to a small number if added without care
+    EXPECT_EQ(load_patched(0, recordDataOffset, uint64_t(0) - gc_snapshotPageSize), ESnapshotResult::Corrupt);
+
+    // Unmodified file still loads
+    EXPECT_EQ(load_patched(0, recordId, uint32_t(ids[0])), ESnapshotResult::Success);
+
+    std::filesystem::remove(path);
+}
+
+// Compare accuracy and cost of each integrator on circular orbits, with long time steps
+TEST(Universe, SatIntegratorAccuracy)
+{
+    constexpr std::size_t   satCount    = 64;
+    constexpr int           precision   = 10;
+    constexpr double        gm          = 3.986004418e14;   // Earth
+    constexpr double        minRadius   = 7.0e6;
+    constexpr double        maxRadius   = 8.0e6;
+    constexpr int           orbits      = 10;
+
+    SatCentralGravity gravity{ .m_gm = gm };
+
+    CoSpaceCommon space;
+    space.m_precision = precision;
+    space.m_satCount  = satCount;
+    alloc_sats(space, satCount);
+
+    double const metersPerUnit = mul_2pow<double, int>(1.0, -precision);
+
+    std::mt19937 gen(1234);
+    std::uniform_real_distribution<double> radiusDist(minRadius, maxRadius);
+    std::uniform_real_distribution<double> angleDist(0.0, 6.283185307179586);
+
+    std::vector<double> radii(satCount);
+    std::vector<double> phases(satCount);
+    std::vector<Vector3d> axes(satCount);
+    for (std::size_t i = 0; i < satCount; ++i)
+    {
+        radii[i]  = radiusDist(gen);
+        phases[i] = angleDist(gen);
+        axes[i]   = Vector3d{std::sin(angleDist(gen)), std::cos(angleDist(gen)), 1.0}.normalized();
+    }
+
+    // Position and velocity of a circular orbit, tilted about axes[i]
+    auto const exact = [&] (std::size_t const i, double const time) -> std::pair<Vector3d, Vector3d>
+    {
+        double const omega  = std::sqrt(gm / (radii[i] * radii[i] * radii[i]));
+        double const angle  = phases[i] + omega * time;
+        Quaterniond const tilt = Quaterniond::rotation(Radd{0.5}, Vector3d{axes[i].y(), -axes[i].x(), 0.0}.normalized());
+        Vector3d const pos = tilt.transformVector(Vector3d{std::cos(angle), std::sin(angle), 0.0} * radii[i]);
+        Vector3d const vel = tilt.transformVector(Vector3d{-std::sin(angle), std::cos(angle), 0.0} * (radii[i] * omega));
+        return {pos, vel};
+    };
+
+    auto const reset = [&] ()
+    {
+        auto const [x, y, z]    = sat_views(space.m_satPositions,  space.m_data, satCount);
+        auto const [vx, vy, vz] = sat_views(space.m_satVelocities, space.m_data, satCount);
+        for (std::size_t i = 0; i < satCount; ++i)
+        {
+            auto const [pos, vel] = exact(i, 0.0);
+            x[i]  = spaceint_t(std::llround(pos.x() / metersPerUnit));
+            y[i]  = spaceint_t(std::llround(pos.y() / metersPerUnit));
+            z[i]  = spaceint_t(std::llround(pos.z() / metersPerUnit));
+            vx[i] = vel.x();
+            vy[i] = vel.y();
+            vz[i] = vel.z();
+        }
+    };
+
+    struct Result
+    {
+        double  maxEnergyError;     // Relative to each satellite's initial specific energy
+        double  maxPositionError;   // Relative to orbit radius, at the end
+        uint64_t evaluations;
+    };
+
+    auto const run = [&] (ESatIntegrator const method, double const deltaTime, double const adaptiveEta) -> Result
+    {
+        reset();
+
+        SatDynamics dynamics;
+        dynamics.m_models.push_back({ .m_func = &sat_accel_model_central, .m_pData = &gravity });
+        dynamics.m_integrator.m_method      = method;
+        dynamics.m_integrator.m_adaptiveEta = adaptiveEta;
+
+        SatIntegratorScratch scratch;
+
+        double const period = 2.0 * 3.141592653589793 * std::sqrt(maxRadius * maxRadius * maxRadius / gm);
+        auto const   steps  = std::size_t(orbits * period / deltaTime);
+        uint64_t const evalsPerSubstep = (method == ESatIntegrator::RK4) ? 4 : 1;
+
+        Result result{0.0, 0.0, 0};
+
+        auto const [x, y, z]    = sat_views(space.m_satPositions,  space.m_data, satCount);
+        auto const [vx, vy, vz] = sat_views(space.m_satVelocities, space.m_data, satCount);
+
+        auto const energy_error = [&] (std::size_t const i)
+        {
+            double const expect = -gm / (2.0 * radii[i]);
+            double const r      = (Vector3d(Vector3g{x[i], y[i], z[i]}) * metersPerUnit).length();
+            double const v      = Vector3d{vx[i], vy[i], vz[i]}.length();
+            return std::abs((0.5 * v * v - gm / r - expect) / expect);
+        };
+
+        for (std::size_t step = 0; step < steps; ++step)
+        {
+            // Leapfrog's extra evaluation at the start of each call is counted as well
+            uint32_t const substeps = sat_integrate(space, dynamics, scratch, deltaTime);
+            result.evaluations += substeps * evalsPerSubstep + ((method == ESatIntegrator::Leapfrog) ? 1 : 0);
+
+            if (step % 16 == 0)
+            {
+                for (std::size_t i = 0; i < satCount; ++i)
+                {
+                    result.maxEnergyError = std::max(result.maxEnergyError, energy_error(i));
+                }
+            }
+        }
+
+        for (std::size_t i = 0; i < satCount; ++i)
+        {
+            Vector3d const expectPos = exact(i, double(steps) * deltaTime).first;
+            Vector3d const actualPos = Vector3d(Vector3g{x[i], y[i], z[i]}) * metersPerUnit;
+            result.maxPositionError = std::max(result.maxPositionError, (actualPos - expectPos).length() / radii[i]);
+        }
+
+        return result;
+    };
+
+    // ~6000 second orbits. 60 seconds is 3600x larger than a 1/60 frame
+    Result const euler60     = run(ESatIntegrator::SymplecticEuler, 60.0, 0.0);
+    Result const leapfrog6   = run(ESatIntegrator::Leapfrog, 6.0, 0.0);
+    Result const leapfrog60  = run(ESatIntegrator::Leapfrog, 60.0, 0.0);
+    Result const rk4_60      = run(ESatIntegrator::RK4, 60.0, 0.0);
+    Result const adaptive    = run(ESatIntegrator::Leapfrog, 600.0, 0.02);
+
+    // Symplectic methods keep energy error bounded instead of growing with every orbit
+    EXPECT_LT(euler60.maxEnergyError,       1e-1);
+    EXPECT_LT(leapfrog60.maxEnergyError,    1e-3);
+    EXPECT_LT(leapfrog6.maxEnergyError,     leapfrog60.maxEnergyError);
+    EXPECT_LT(rk4_60.maxEnergyError,        1e-5);
+
+    // Higher order means better positions for the same step
+    EXPECT_LT(leapfrog60.maxPositionError,  euler60.maxPositionError);
+    EXPECT_LT(rk4_60.maxPositionError,      leapfrog60.maxPositionError);
+
+    // Adaptive substepping splits the 10-minute steps into pieces
+    EXPECT_LT(adaptive.maxEnergyError,      1e-3);
+    EXPECT_GT(adaptive.evaluations,         2 * std::uint64_t(orbits * 6000.0 / 600.0));
+}
+
+//-----------------------------------------------------------------------------
+
+TEST(Universe, KeplerPropagation)
+{
+    constexpr double gm = 3.986004418e14;   // Earth
+
+    // Circular orbit, half a period later is on the opposite side
+    {
+        double const radius = 7.0e6;
+        double const speed  = std::sqrt(gm / radius);
+        KeplerOrbit const orbit = kepler_from_state({radius, 0.0, 0.0}, {0.0, speed, 0.0}, gm, 100.0);
+
+        Vector3d pos;
+        Vector3d vel;
+        kepler_state_at(orbit, 100.0 + 0.5 * orbit.m_period, pos, vel);
+        EXPECT_LT((pos - Vector3d{-radius, 0.0, 0.0}).length(), 1e-3);
+        EXPECT_LT((vel - Vector3d{0.0, -speed, 0.0}).length(), 1e-6);
+    }
+
+    // Elliptic, hyperbolic, and nearly parabolic orbits, evaluated far before and after epoch
+    std::array<std::pair<Vector3d, Vector3d>, 4> const cases{{
+        {{7.0e6, 0.0, 0.0},     {0.0, 9000.0, 1000.0}},
+        {{7.0e6, -2.0e6, 0.0},  {-3000.0, 5000.0, 0.0}},
+        {{7.0e6, 0.0, 0.0},     {0.0, 12000.0, 0.0}},
+        {{7.0e6, 0.0, 0.0},     {0.0, std::sqrt(2.0 * gm / 7.0e6), 0.0}}
+    }};
+
+    std::mt19937 gen(4321);
+    std::uniform_real_distribution<double> timeDist(-1.0e5, 1.0e5);
+
+    for (auto const& [pos0, vel0] : cases)
+    {
+        KeplerOrbit const orbit = kepler_from_state(pos0, vel0, gm, 0.0);
+
+        double const energy0  = 0.5 * Magnum::Math::dot(vel0, vel0) - gm / pos0.length();
+        Vector3d const angMo0 = Magnum::Math::cross(pos0, vel0);
+
+        for (int i = 0; i < 32; ++i)
+        {
+            double const time = timeDist(gen);
+
+            Vector3d pos;
+            Vector3d vel;
+            kepler_state_at(orbit, time, pos, vel);
+
+            // Energy and angular momentum are conserved
+            double const energy = 0.5 * Magnum::Math::dot(vel, vel) - gm / pos.length();
+            EXPECT_LT(std::abs(energy - energy0), 1e-8 * gm / pos0.length());
+            EXPECT_LT((Magnum::Math::cross(pos, vel) - angMo0).length(), 1e-8 * angMo0.length());
+
+            // Velocity matches change in position
+            constexpr double h = 0.01;
+            Vector3d posBefore, posAfter, unused;
+            kepler_state_at(orbit, time - h, posBefore, unused);
+            kepler_state_at(orbit, time + h, posAfter,  unused);
+            EXPECT_LT(((posAfter - posBefore) / (2.0 * h) - vel).length(), 1e-3 * vel.length());
+
+            // Going back to the original epoch from the new state gives the original state
+            KeplerOrbit const back = kepler_from_state(pos, vel, gm, time);
+            Vector3d posBack;
+            Vector3d velBack;
+            kepler_state_at(back, 0.0, posBack, velBack);
+            EXPECT_LT((posBack - pos0).length(), 1e-6 * std::max(pos0.length(), pos.length()));
+            EXPECT_LT((velBack - vel0).length(), 1e-6 * vel0.length());
+        }
+    }
+}
+
+//-----------------------------------------------------------------------------
+
+TEST(Universe, SatRails)
+{
+    constexpr std::size_t   satCount    = 4096;
+    constexpr int           precision   = 10;
+    constexpr double        gm          = 3.986004418e14;
+    constexpr double        deltaTime   = 1.0;
+    constexpr std::size_t   steps       = 600;
+
+    SatCentralGravity gravity{ .m_gm = gm };
+
+    auto const make_space = [] (CoSpaceCommon& rSpace)
+    {
+        rSpace.m_precision = precision;
+        rSpace.m_satCount  = satCount;
+        alloc_sats(rSpace, satCount);
+    };
+
+    double const metersPerUnit = mul_2pow<double, int>(1.0, -precision);
+
+    std::mt19937 gen(99);
+    std::uniform_real_distribution<double> radiusDist(7.0e6, 4.2e7);
+    std::uniform_real_distribution<double> angleDist(0.0, 6.283185307179586);
+
+    std::vector<KeplerOrbit> exact(satCount);
+    for (std::size_t i = 0; i < satCount; ++i)
+    {
+        double const radius = radiusDist(gen);
+        double const angle  = angleDist(gen);
+        Quaterniond const tilt = Quaterniond::rotation(Radd{angleDist(gen)}, Vector3d{std::sin(angle), std::cos(angle), 0.0});
+        exact[i] = kepler_from_state(tilt.transformVector({radius, 0.0, 0.0}),
+                                     tilt.transformVector({0.0, std::sqrt(gm / radius), 0.0}), gm, 0.0);
+    }
+
+    auto const reset = [&] (CoSpaceCommon& rSpace)
+    {
+        auto const [x, y, z]    = sat_views(rSpace.m_satPositions,  rSpace.m_data, satCount);
+        auto const [vx, vy, vz] = sat_views(rSpace.m_satVelocities, rSpace.m_data, satCount);
+        for (std::size_t i = 0; i < satCount; ++i)
+        {
+            x[i]  = spaceint_t(std::llround(exact[i].m_position.x() / metersPerUnit));
+            y[i]  = spaceint_t(std::llround(exact[i].m_position.y() / metersPerUnit));
+            z[i]  = spaceint_t(std::llround(exact[i].m_position.z() / metersPerUnit));
+            vx[i] = exact[i].m_velocity.x();
+            vy[i] = exact[i].m_velocity.y();
+            vz[i] = exact[i].m_velocity.z();
+        }
+    };
+
+    auto const sat_pos = [] (CoSpaceCommon const& space, SatId const sat) -> Vector3g
+    {
+        auto const [x, y, z] = sat_views(space.m_satPositions, space.m_data, space.m_satCount);
+        return {x[sat], y[sat], z[sat]};
+    };
+
+    SatDynamics dynamics;
+    dynamics.m_models.push_back({ .m_func = &sat_accel_model_central, .m_pData = &gravity });
+    SatIntegratorScratch scratch;
+
+    // Reference, integrating every satellite every step
+    CoSpaceCommon full;
+    make_space(full);
+    reset(full);
+
+    for (std::size_t step = 0; step < steps; ++step)
+    {
+        sat_integrate(full, dynamics, scratch, deltaTime);
+    }
+
+    // On rails, SceneFrame follows satellite 0
+    CoSpaceCommon space;
+    make_space(space);
+    reset(space);
+
+    SatRails rails;
+    rails.m_gm              = gm;
+    rails.m_railsDistance   = 5.0e6;
+    rails.m_activeDistance  = 4.0e6;
+    dynamics.m_pRails       = &rails;
+
+    std::size_t maxActive = 0;
+
+    for (std::size_t step = 0; step < steps; ++step)
+    {
+        sat_rails_integrate(space, rails, dynamics, scratch, deltaTime);
+        sat_rails_update(space, rails, sat_pos(space, 0));
+        maxActive = std::max(maxActive, rails.m_active.size());
+    }
+
+    EXPECT_FALSE(sat_rails_on_rails(rails, 0));
+    EXPECT_GT(maxActive, 1);
+    EXPECT_LT(maxActive, satCount / 16);
+
+    // Satellites on rails end up where integrating them would have
+    sat_rails_evaluate_all(space, rails);
+    double maxError = 0.0;
+    for (SatId sat = 0; sat < satCount; ++sat)
+    {
+        Vector3d pos;
+        Vector3d vel;
+        kepler_state_at(exact[sat], double(steps) * deltaTime, pos, vel);
+
+        maxError = std::max(maxError, (Vector3d(sat_pos(space, sat)) * metersPerUnit - pos).length());
+        EXPECT_LT((Vector3d(sat_pos(full, sat)) * metersPerUnit - pos).length(), 10.0);
+    }
+    EXPECT_LT(maxError, 10.0);
+
+    // Teleporting the SceneFrame next to a satellite on rails brings it off rails right away
+    SatId const far = SatId(satCount - 1);
+    ASSERT_TRUE(sat_rails_on_rails(rails, far));
+    sat_rails_integrate(space, rails, dynamics, scratch, deltaTime);
+    sat_rails_update(space, rails, sat_rails_position(space, rails, far));
+    EXPECT_FALSE(sat_rails_on_rails(rails, far));
+
+    // Swap-removing satellite 0 moves the last satellite into its place, keeping its rails state
+    bool const lastOnRails = sat_rails_on_rails(rails, SatId(satCount - 2));
+    std::vector<SatRemap> const remaps{ {0, SatId(satCount - 2), 0, 0} };
+    sat_rails_remap(rails, 0, uint32_t(satCount - 2), remaps);
+    EXPECT_EQ(sat_rails_on_rails(rails, 0), lastOnRails);
+    EXPECT_EQ(rails.m_activeIdx.size(), satCount - 2);
+    for (std::size_t i = 0; i < rails.m_active.size(); ++i)
+    {
+        EXPECT_EQ(rails.m_activeIdx[rails.m_active[i]], i);
+    }
+}
+
+//-----------------------------------------------------------------------------
+
+TEST(Universe, SatGridIndex)
+{
+    constexpr std::size_t   satCount    = 4000;
+    constexpr int           precision   = 10;
+    constexpr double        deltaTime   = 1.0;
+    constexpr spaceint_t    extent      = spaceint_t(1) << 32;  // ~4000km
+
+    Universe universe;
+    std::array<CoSpaceId, 2> ids;
+    universe.m_coordIds.create(ids.begin(), ids.end());
+    universe.m_coordCommon.resize(universe.m_coordIds.capacity());
+
+    for (CoSpaceId const id : ids)
+    {
+        CoSpaceCommon &rCommon = universe.m_coordCommon[id];
+        alloc_sats(rCommon, (id == ids[0]) ? satCount : 0);
+        rCommon.m_precision = precision;
+    }
+
+    CoSpaceCommon &rSpace = universe.m_coordCommon[ids[0]];
+    rSpace.m_satCount = satCount;
+    universe.m_coordCommon[ids[1]].m_parent = ids[0];
+
+    std::mt19937 gen(555);
+    std::uniform_int_distribution<spaceint_t> posDist(-extent, extent);
+    std::normal_distribution<double> velDist(0.0, 300.0);
+    {
+        auto const [x, y, z]    = sat_views(rSpace.m_satPositions,  rSpace.m_data, satCount);
+        auto const [vx, vy, vz] = sat_views(rSpace.m_satVelocities, rSpace.m_data, satCount);
+        for (std::size_t i = 0; i < satCount; ++i)
+        {
+            x[i] = posDist(gen);
+            y[i] = posDist(gen);
+            z[i] = posDist(gen);
+
+            // Some satellites sit still, some are very fast
+            double const speedScale = (i % 4 == 0) ? 0.0 : ((i % 4 == 1) ? 30.0 : 1.0);
+            vx[i] = velDist(gen) * speedScale;
+            vy[i] = velDist(gen) * speedScale;
+            vz[i] = velDist(gen) * speedScale;
+        }
+    }
+
+    auto const brute_radius = [] (CoSpaceCommon const& space, Vector3g const center, spaceint_t const radius)
+    {
+        auto const [x, y, z] = sat_views(space.m_satPositions, space.m_data, space.m_satCount);
+        std::vector<SatId> out;
+        for (SatId sat = 0; sat < space.m_satCount; ++sat)
+        {
+            Vector3d const diff{Vector3g{x[sat] - center.x(), y[sat] - center.y(), z[sat] - center.z()}};
+            if (diff.dot() <= double(radius) * double(radius))
+            {
+                out.push_back(sat);
+            }
+        }
+        return out;
+    };
+
+    auto const check_queries = [&] (SatGridIndex const& index, CoSpaceCommon const& space)
+    {
+        std::vector<SatId> found;
+        for (int i = 0; i < 8; ++i)
+        {
+            Vector3g const   center{posDist(gen), posDist(gen), posDist(gen)};
+            spaceint_t const radius = posDist(gen) / 8 + extent / 8;
+
+            sat_index_radius(index, space, nullptr, center, radius, found);
+            std::vector<SatId> expect = brute_radius(space, center, radius);
+            std::sort(found.begin(), found.end());
+            EXPECT_EQ(found, expect);
+
+            // k nearest are the k smallest distances of a brute force search
+            constexpr std::size_t k = 10;
+            sat_index_nearest(index, space, nullptr, center, k, found);
+            std::vector<SatId> all = brute_radius(space, center, std::numeric_limits<spaceint_t>::max() / 4);
+            auto const [x, y, z] = sat_views(space.m_satPositions, space.m_data, space.m_satCount);
+            auto const dist = [&] (SatId const sat)
+            {
+                return Vector3d{Vector3g{x[sat] - center.x(), y[sat] - center.y(), z[sat] - center.z()}}.dot();
+            };
+            std::sort(all.begin(), all.end(), [&] (SatId const a, SatId const b) { return dist(a) < dist(b); });
+            ASSERT_EQ(found.size(), std::min(k, all.size()));
+            for (std::size_t j = 0; j < found.size(); ++j)
+            {
+                EXPECT_EQ(dist(found[j]), dist(all[j]));
+            }
+        }
+    };
+
+    SatGridIndex index;
+    index.m_cellShift = 28;     // ~260km cells
+    sat_index_build(index, rSpace, nullptr, deltaTime);
+
+    // Count how many satellites get looked at per update
+    uint64_t checked = 0;
+
+    SatDynamics const    dynamics;
+    SatIntegratorScratch scratch;
+    constexpr std::size_t steps = 300;
+    for (std::size_t step = 0; step < steps; ++step)
+    {
+        sat_integrate(rSpace, dynamics, scratch, deltaTime);
+
+        checked += index.m_due[(index.m_update + 1) % SatGridIndex::smc_maxInterval].size();
+        sat_index_update(index, rSpace, nullptr, deltaTime);
+
+        if (step % 100 == 0)
+        {
+            check_queries(index, rSpace);
+        }
+    }
+
+    EXPECT_LT(checked, steps * satCount / 4);
+
+    // Transfer some satellites away, then refile what moved around
+    std::vector<SatTransfer> transfers;
+    for (SatId sat = 0; sat < satCount; sat += 7)
+    {
+        transfers.push_back({ids[0], sat, ids[1]});
+    }
+    std::vector<SatRemap> remaps;
+    sat_transfer(universe, transfers, remaps);
+
+    SatGridIndex otherIndex;
+    otherIndex.m_cellShift = 28;
+    sat_index_build(otherIndex, universe.m_coordCommon[ids[1]], nullptr, deltaTime);
+    sat_index_remap(index, universe.m_coordCommon[ids[0]], nullptr, ids[0], remaps, deltaTime);
+    EXPECT_EQ(index.m_satCount, satCount - transfers.size());
+
+    for (std::size_t step = 0; step < 100; ++step)
+    {
+        for (CoSpaceId const id : ids)
+        {
+            sat_integrate(universe.m_coordCommon[id], dynamics, scratch, deltaTime);
+        }
+        sat_index_update(index,      universe.m_coordCommon[ids[0]], nullptr, deltaTime);
+        sat_index_update(otherIndex, universe.m_coordCommon[ids[1]], nullptr, deltaTime);
+    }
+
+    check_queries(index,      universe.m_coordCommon[ids[0]]);
+    check_queries(otherIndex, universe.m_coordCommon[ids[1]]);
+}